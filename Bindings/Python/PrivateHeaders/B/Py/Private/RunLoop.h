@@ -12,6 +12,8 @@ struct B_PyRunLoopImpl {
   // other PyRunLoop subclasses, forwards to Python methods
   // calls.
   struct B_RunLoopVTable vtable;
+  // Mirrors struct B_RunLoop.  Always NULL.
+  struct B_Tracer *tracer;
 
   // Points to the containing PyRunLoop.
   // TODO(strager): Use an offsetof trick instead.
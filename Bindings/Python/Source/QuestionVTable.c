@@ -102,6 +102,19 @@ b_py_question_replicate_(
   return true;
 }
 
+static B_WUR B_FUNC struct B_IQuestion *
+b_py_question_retain_(
+    B_BORROW struct B_IQuestion const *question) {
+  Py_INCREF((PyObject *) question);
+  return (struct B_IQuestion *) question;
+}
+
+static B_WUR B_FUNC void
+b_py_question_release_(
+    B_TRANSFER struct B_IQuestion *question) {
+  Py_DECREF((PyObject *) question);
+}
+
 static B_WUR B_FUNC bool
 b_py_question_serialize_(
     B_BORROW struct B_IQuestion const *question,
@@ -142,6 +155,8 @@ b_py_python_question_vtable_ = {
   .replicate = b_py_question_replicate_,
   .serialize = b_py_question_serialize_,
   .deserialize = b_py_question_deserialize_,
+  .retain = b_py_question_retain_,
+  .release = b_py_question_release_,
 };
 
 static PyTypeObject
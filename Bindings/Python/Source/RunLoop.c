@@ -114,7 +114,9 @@ b_py_run_loop_new_(
       .add_process_id = NULL,
       .run = NULL,
       .stop = NULL,
+      .exec = NULL,
     },
+    .tracer = NULL,
     .run_loop_py = rl_py,
   };
   return self;
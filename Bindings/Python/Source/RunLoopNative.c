@@ -90,7 +90,9 @@ b_py_run_loop_native_allocate_(
       .add_process_id = NULL,
       .run = NULL,
       .stop = NULL,
+      .exec = NULL,
     },
+    .tracer = NULL,
     .run_loop_py = &rl_py->super,
   };
   rl_py->native_run_loop = native_run_loop;
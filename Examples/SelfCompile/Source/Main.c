@@ -1,19 +1,26 @@
 #include <B/AnswerContext.h>
 #include <B/AnswerFuture.h>
+#include <B/Daemon.h>
 #include <B/Database.h>
 #include <B/Error.h>
 #include <B/FileQuestion.h>
+#include <B/FileWatcher.h>
+#include <B/Jobserver.h>
 #include <B/Main.h>
 #include <B/Process.h>
+#include <B/ProcessQueue.h>
 #include <B/QuestionAnswer.h>
 #include <B/RunLoop.h>
+#include <B/Tracer.h>
 
 #include <assert.h>
 #include <errno.h>
+#include <signal.h>
 #include <sqlite3.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 static char const
 out_path_[] = "SelfCompile";
@@ -21,22 +28,34 @@ out_path_[] = "SelfCompile";
 static char const *
 sources_[] = {
   "Examples/SelfCompile/Source/Main.c",
+  "Source/AnswerCache.c",
   "Source/AnswerContext.c",
   "Source/AnswerFuture.c",
   "Source/Assertions.c",
+  "Source/Compression.c",
+  "Source/Daemon.c",
   "Source/Database.c",
   "Source/FileQuestion.c",
+  "Source/FileWatcher.c",
+  "Source/Jobserver.c",
   "Source/Main.c",
   "Source/Memory.c",
   "Source/Mutex.c",
+  "Source/Process.c",
+  "Source/ProcessQueue.c",
   "Source/QuestionAnswer.c",
+  "Source/QuestionMap.c",
   "Source/RunLoop.c",
   "Source/RunLoopKqueue.c",
   "Source/RunLoopSigchld.c",
+  "Source/RunLoopSimulated.c",
   "Source/RunLoopUtil.c",
   "Source/SQLite3.c",
   "Source/Serialize.c",
+  "Source/Simulator.c",
+  "Source/Tracer.c",
   "Source/UUID.c",
+  "Source/WorkerPool.c",
   "Vendor/sphlib-3.0/c/sha2.c",
   "Vendor/sqlite-3.8.4.1/sqlite3.c",
 };
@@ -90,15 +109,13 @@ exec_cancel_callback_(
 static bool
 exec_(
     B_TRANSFER struct B_AnswerContext *ac,
+    char const *pool_name,
     char const *const *command_args,
     B_OUT struct B_Error *e) {
-  struct B_RunLoop *rl;
-  if (!b_answer_context_run_loop(ac, &rl, e)) {
-    return false;
-  }
   print_command_(command_args);
-  if (!b_run_loop_exec_basic(
-      rl,
+  if (!b_answer_context_exec(
+      ac,
+      pool_name,
       command_args,
       exec_callback_,
       exec_cancel_callback_,
@@ -145,7 +162,7 @@ link_exec_(
     command[arg++] = command_suffix[i];
   }
   command[arg++] = NULL;
-  if (!exec_(ac, command, e)) {
+  if (!exec_(ac, "link", command, e)) {
     return false;
   }
   for (size_t i = 0; i < SOURCE_COUNT_; ++i) {
@@ -258,7 +275,7 @@ compile_exec_(
     c_path,
     NULL,
   };
-  if (!exec_(ac, command, e)) {
+  if (!exec_(ac, "compile", command, e)) {
     free(c_path);
     return false;
   }
@@ -340,8 +357,8 @@ dispatch_question_(
     B_BORROW struct B_Main *main,
     B_TRANSFER struct B_AnswerContext *ac,
     B_OUT struct B_Error *e) {
-  (void) opaque;
   (void) main;
+  struct B_Daemon *daemon = *(struct B_Daemon **) opaque;
   struct B_IQuestion *question;
   struct B_QuestionVTable const *question_vtable;
   if (!b_answer_context_question(
@@ -353,6 +370,11 @@ dispatch_question_(
     return false;
   }
   printf("dispatch_question(%s)\n", path);
+  if (daemon) {
+    if (!b_daemon_report_progress(daemon, path, e)) {
+      return false;
+    }
+  }
   if (strcmp(path, out_path_) == 0) {
     if (!link_(ac, e)) {
       return false;
@@ -379,6 +401,105 @@ dispatch_question_(
   return true;
 }
 
+static B_FUNC bool
+print_cycle_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t count,
+    B_OUT struct B_Error *e) {
+  (void) opaque;
+  (void) vtables;
+  fprintf(stderr, "Dependency cycle:");
+  for (size_t i = 0; i <= count; ++i) {
+    // Every question is a B_FileQuestion.
+    char const *path;
+    if (!b_file_question_path(
+        questions[i % count], &path, e)) {
+      return false;
+    }
+    fprintf(stderr, i < count ? " %s ->" : " %s\n", path);
+  }
+  return true;
+}
+
+// b_run_loop_exec starts each process in its own process
+// group, so SIGINT from Ctrl-C (and SIGTERM sent to our
+// process group) reaches only us.  See NOTE[process
+// groups].  We forward it by cancelling main, which
+// terminates the processes.  The run loop cannot be called
+// from a signal handler, so interrupt_handler_ only sets
+// interrupted_, and check_interrupted_ polls it.
+static volatile sig_atomic_t interrupted_ = 0;
+
+enum {
+  INTERRUPT_POLL_MS_ = 100,
+};
+
+struct InterruptClosure_ {
+  struct B_Main *main;
+  struct B_RunLoop *run_loop;
+};
+
+static void
+interrupt_handler_(
+    int signal_number) {
+  (void) signal_number;
+  interrupted_ = 1;
+}
+
+static B_FUNC bool
+ignore_cancel_(
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *e) {
+  (void) opaque;
+  (void) e;
+  return true;
+}
+
+static B_FUNC bool
+check_interrupted_(
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *e) {
+  struct InterruptClosure_ const *closure = opaque;
+  if (interrupted_) {
+    fprintf(stderr, "Interrupted; cancelling\n");
+    return b_main_cancel(closure->main, e);
+  }
+  return b_run_loop_add_timer(
+    closure->run_loop,
+    INTERRUPT_POLL_MS_,
+    check_interrupted_,
+    ignore_cancel_,
+    closure,
+    sizeof(*closure),
+    e);
+}
+
+// Makes SIGINT and SIGTERM cancel main while run_loop
+// runs.  A second signal terminates us immediately.
+static B_FUNC bool
+forward_interrupts_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_RunLoop *run_loop,
+    B_OUT struct B_Error *e) {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = interrupt_handler_;
+  action.sa_flags = (int) (SA_RESETHAND | SA_RESTART);
+  if (sigemptyset(&action.sa_mask) != 0
+      || sigaction(SIGINT, &action, NULL) != 0
+      || sigaction(SIGTERM, &action, NULL) != 0) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+  struct InterruptClosure_ closure = {
+    .main = main,
+    .run_loop = run_loop,
+  };
+  return check_interrupted_(&closure, e);
+}
+
 static B_FUNC bool
 root_question_answered_(
     B_BORROW struct B_AnswerFuture *future,
@@ -393,16 +514,135 @@ root_question_answered_(
   return true;
 }
 
+static B_FUNC bool
+explain_invalidation_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Invalidation const *invalidation,
+    B_OUT struct B_Error *e) {
+  (void) opaque;
+  (void) e;
+  // Only file questions are checked, and file questions
+  // are file paths.
+  char const *path = (char const *) invalidation->question;
+  char const *cause = (char const *) invalidation->cause;
+  if (invalidation->depth == 0) {
+    fprintf(stderr, "%s: changed\n", path);
+  } else {
+    fprintf(
+      stderr,
+      "%s: depends on %s (%s changed; depth %zu)\n",
+      path,
+      (char const *) invalidation->parent,
+      cause,
+      invalidation->depth);
+  }
+  return true;
+}
+
+struct PlanTotals_ {
+  size_t run_count;
+  size_t reuse_count;
+  int64_t run_time_us;
+};
+
+static B_FUNC bool
+print_plan_entry_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_PlanEntry const *entry,
+    B_OUT struct B_Error *e) {
+  (void) e;
+  struct PlanTotals_ *totals = opaque;
+  // File questions are file paths.
+  char const *path = (char const *) entry->question;
+  if (!entry->will_execute) {
+    totals->reuse_count += 1;
+    printf("reuse %s\n", path);
+  } else if (entry->execution_count == 0) {
+    totals->run_count += 1;
+    printf("run %s (never run before)\n", path);
+  } else {
+    totals->run_count += 1;
+    totals->run_time_us += entry->mean_wall_time_us;
+    printf(
+      "run %s (about %lld ms)\n",
+      path,
+      (long long) (entry->mean_wall_time_us / 1000));
+  }
+  return true;
+}
+
+enum {
+  MAX_POOL_COUNT_ = 8,
+  // Memory assumed for a process whose question never
+  // ran before.
+  DEFAULT_PROCESS_MEMORY_MIB_ = 1024,
+};
+
+struct Pool_ {
+  char const *name;
+  size_t slots;
+};
+
+struct Options_ {
+  // --explain prints why cached answers were discarded.
+  bool explain;
+  // --dry-run prints which questions would be answered
+  // and which answers would be reused, then exits.
+  bool dry_run;
+  // --prefetch starts answering each question's previous
+  // dependencies as soon as the question is dispatched.
+  bool prefetch;
+  // --keep-going keeps building after a question fails.
+  // Otherwise, the first failure cancels the build.
+  bool keep_going;
+  // -j N runs at most N processes at once.  Defaults to
+  // the number of online processors.
+  size_t job_slots;
+  // --pool NAME:N runs at most N processes at once in the
+  // pool NAME ("compile" or "link").
+  struct Pool_ pools[MAX_POOL_COUNT_];
+  size_t pool_count;
+  // --memory-budget MIB runs processes only while their
+  // estimated memory use totals at most MIB mebibytes.  0
+  // if unlimited.
+  size_t memory_budget_mib;
+  // --daemon SOCKET builds whenever a client connects to
+  // SOCKET, until --stop-daemon SOCKET.
+  char const *daemon_socket;
+  // --client SOCKET asks the daemon listening on SOCKET
+  // to build.  The daemon builds in its own working
+  // directory.
+  char const *client_socket;
+  // --stop-daemon SOCKET stops the daemon listening on
+  // SOCKET.
+  char const *stop_daemon_socket;
+  // --trace FILE writes a profile of the build to FILE,
+  // viewable in chrome://tracing.  See NOTE[tracing].
+  char const *trace_path;
+};
+
 static bool
 run_(
+    struct Options_ const *options,
     int *exit_code,
     struct B_Error *e) {
   bool ok;
 
   struct B_Database *database = NULL;
   struct B_RunLoop *run_loop = NULL;
+  struct B_ProcessQueue *process_queue = NULL;
+  struct B_Jobserver *jobserver = NULL;
   struct B_Main *main = NULL;
+  struct B_Daemon *daemon = NULL;
+  struct B_FileWatcher *file_watcher = NULL;
+  struct B_Tracer *tracer = NULL;
 
+  if (options->trace_path) {
+    if (!b_tracer_open(options->trace_path, &tracer, e)) {
+      tracer = NULL;
+      goto fail;
+    }
+  }
   if (!b_database_open_sqlite3(
       "SelfCompile.cache",
       SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
@@ -412,11 +652,12 @@ run_(
     database = NULL;
     goto fail;
   }
+  b_database_set_tracer(database, tracer);
   struct B_QuestionVTable const *const vtables[] = {
     b_file_question_vtable(),
   };
-  // FIXME(strager): Design problem: this does not interact
-  // well with Main's AnswerCache.
+  // main is not allocated yet, so it has no answers to
+  // forget.  See NOTE[answer cache].
   if (!b_database_check_all(
       database,
       vtables,
@@ -424,22 +665,137 @@ run_(
       e)) {
     goto fail;
   }
+  if (options->explain) {
+    if (!b_database_invalidations(
+        database,
+        vtables,
+        sizeof(vtables) / sizeof(*vtables),
+        explain_invalidation_,
+        NULL,
+        e)) {
+      goto fail;
+    }
+  }
+  if (options->dry_run) {
+    struct B_IQuestion const *root
+      = (struct B_IQuestion const *) out_path_;
+    struct B_QuestionVTable const *root_vtable
+      = b_file_question_vtable();
+    struct PlanTotals_ totals = {
+      .run_count = 0,
+      .reuse_count = 0,
+      .run_time_us = 0,
+    };
+    if (!b_database_plan(
+        database,
+        &root,
+        &root_vtable,
+        1,
+        vtables,
+        sizeof(vtables) / sizeof(*vtables),
+        print_plan_entry_,
+        &totals,
+        e)) {
+      goto fail;
+    }
+    printf(
+      "%zu to run (about %lld ms serially), %zu to reuse\n",
+      totals.run_count,
+      (long long) (totals.run_time_us / 1000),
+      totals.reuse_count);
+    ok = true;
+    *exit_code = 0;
+    goto done;
+  }
 
   if (!b_run_loop_allocate_preferred(&run_loop, e)) {
     run_loop = NULL;
     goto fail;
   }
+  b_run_loop_set_tracer(run_loop, tracer);
+  if (!b_process_queue_allocate(
+      run_loop, options->job_slots, &process_queue, e)) {
+    process_queue = NULL;
+    goto fail;
+  }
+  for (size_t i = 0; i < options->pool_count; ++i) {
+    if (!b_process_queue_add_pool(
+        process_queue,
+        options->pools[i].name,
+        options->pools[i].slots,
+        e)) {
+      goto fail;
+    }
+  }
+  if (options->memory_budget_mib > 0) {
+    int64_t mib = 1024 * 1024;
+    b_process_queue_set_memory_budget(
+      process_queue,
+      (int64_t) options->memory_budget_mib * mib,
+      (int64_t) DEFAULT_PROCESS_MEMORY_MIB_ * mib);
+  }
+  // Share job slots with a parent make, or else let build
+  // tools we run share ours.
+  if (!b_jobserver_allocate_from_environment(
+      &jobserver, e)) {
+    if (!b_jobserver_allocate_server(
+        options->job_slots, &jobserver, e)) {
+      jobserver = NULL;
+      goto fail;
+    }
+  }
+  b_process_queue_set_jobserver(process_queue, jobserver);
+  b_process_queue_set_tracer(process_queue, tracer);
 
   if (!b_main_allocate(
       database,
       run_loop,
       dispatch_question_,
-      NULL,
+      &daemon,
       &main,
       e)) {
     main = NULL;
     goto fail;
   }
+  b_main_set_process_queue(main, process_queue);
+  b_main_set_cycle_callback(main, print_cycle_, NULL);
+  b_main_set_cancel_on_failure(main, !options->keep_going);
+  b_main_set_tracer(main, tracer);
+  if (options->prefetch) {
+    b_main_enable_prefetch(
+      main, vtables, sizeof(vtables) / sizeof(*vtables));
+  }
+
+  if (options->daemon_socket) {
+    if (!b_daemon_allocate(
+        database,
+        main,
+        run_loop,
+        vtables,
+        sizeof(vtables) / sizeof(*vtables),
+        options->daemon_socket,
+        &daemon,
+        e)) {
+      daemon = NULL;
+      goto fail;
+    }
+    // Without a file watcher, the daemon checks every
+    // answer before each build.
+    if (!b_file_watcher_allocate(&file_watcher, e)) {
+      file_watcher = NULL;
+      if (e->posix_error != ENOTSUP) {
+        goto fail;
+      }
+    } else {
+      b_daemon_set_file_watcher(daemon, file_watcher);
+    }
+    if (!b_daemon_serve(daemon, e)) {
+      goto fail;
+    }
+    ok = true;
+    *exit_code = 0;
+    goto done;
+  }
 
   struct B_IQuestion *question;
   if (!b_file_question_allocate(
@@ -467,6 +823,9 @@ run_(
     goto fail;
   }
 
+  if (!forward_interrupts_(main, run_loop, e)) {
+    goto fail;
+  }
   if (!b_run_loop_run(run_loop, e)) {
     goto fail;
   }
@@ -497,19 +856,44 @@ run_(
   *exit_code = 0;
 
 done:
-  if (main) {
-    if (!b_main_deallocate(main, e)) {
+  if (daemon) {
+    if (!b_daemon_deallocate(daemon, e)) {
       ok = false;
     }
   }
+  if (file_watcher) {
+    b_file_watcher_deallocate(file_watcher);
+  }
+  // Cancelled processes fail their answer contexts, so
+  // deallocate main last.
   if (run_loop) {
     b_run_loop_deallocate(run_loop);
   }
+  if (process_queue) {
+    if (!b_process_queue_deallocate(process_queue, e)) {
+      ok = false;
+    }
+  }
+  if (jobserver) {
+    if (!b_jobserver_deallocate(jobserver, e)) {
+      ok = false;
+    }
+  }
+  if (main) {
+    if (!b_main_deallocate(main, e)) {
+      ok = false;
+    }
+  }
   if (database) {
     if (!b_database_close(database, e)) {
       ok = false;
     }
   }
+  if (tracer) {
+    if (!b_tracer_close(tracer, e)) {
+      ok = false;
+    }
+  }
   return ok;
 
 fail:
@@ -517,15 +901,155 @@ fail:
   goto done;
 }
 
+static B_FUNC bool
+print_progress_(
+    B_BORROW void *opaque,
+    B_BORROW char const *message,
+    B_OUT struct B_Error *e) {
+  (void) opaque;
+  (void) e;
+  printf("%s\n", message);
+  return true;
+}
+
+static bool
+run_client_(
+    char const *socket_path,
+    int *exit_code,
+    struct B_Error *e) {
+  enum B_AnswerFutureState state;
+  if (!b_daemon_client_answer(
+      socket_path,
+      (struct B_IQuestion const *) out_path_,
+      b_file_question_vtable(),
+      print_progress_,
+      NULL,
+      &state,
+      e)) {
+    return false;
+  }
+  if (state == B_FUTURE_FAILED) {
+    fprintf(stderr, "Answering question FAILED\n");
+    *exit_code = 2;
+    return true;
+  }
+  *exit_code = 0;
+  return true;
+}
+
+// Parses a positive integer.
+static bool
+parse_positive_(
+    char const *string,
+    size_t *out) {
+  char *end;
+  errno = 0;
+  unsigned long slots = strtoul(string, &end, 10);
+  if (errno != 0
+      || end == string
+      || *end != '\0'
+      || slots == 0) {
+    return false;
+  }
+  *out = slots;
+  return true;
+}
+
 int
 main(
     int argc,
     char **argv) {
-  (void) argc;
-  (void) argv;
+  long processor_count = sysconf(_SC_NPROCESSORS_ONLN);
+  struct Options_ options = {
+    .explain = false,
+    .dry_run = false,
+    .prefetch = false,
+    .keep_going = false,
+    .job_slots
+      = processor_count > 0 ? (size_t) processor_count : 1,
+    .pool_count = 0,
+    .memory_budget_mib = 0,
+    .daemon_socket = NULL,
+    .client_socket = NULL,
+    .stop_daemon_socket = NULL,
+    .trace_path = NULL,
+  };
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--explain") == 0) {
+      options.explain = true;
+    } else if (strcmp(argv[i], "--dry-run") == 0) {
+      options.dry_run = true;
+    } else if (strcmp(argv[i], "--prefetch") == 0) {
+      options.prefetch = true;
+    } else if (strcmp(argv[i], "--keep-going") == 0) {
+      options.keep_going = true;
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      i += 1;
+      if (!parse_positive_(argv[i], &options.job_slots)) {
+        fprintf(stderr, "Invalid job count: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--pool") == 0
+        && i + 1 < argc) {
+      i += 1;
+      // NAME:N
+      char *colon = strrchr(argv[i], ':');
+      struct Pool_ *pool
+        = &options.pools[options.pool_count];
+      if (!colon
+          || colon == argv[i]
+          || options.pool_count >= MAX_POOL_COUNT_
+          || !parse_positive_(colon + 1, &pool->slots)) {
+        fprintf(stderr, "Invalid pool: %s\n", argv[i]);
+        return 1;
+      }
+      *colon = '\0';
+      pool->name = argv[i];
+      options.pool_count += 1;
+    } else if (strcmp(argv[i], "--memory-budget") == 0
+        && i + 1 < argc) {
+      i += 1;
+      if (!parse_positive_(
+          argv[i], &options.memory_budget_mib)) {
+        fprintf(
+          stderr, "Invalid memory budget: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--daemon") == 0
+        && i + 1 < argc) {
+      i += 1;
+      options.daemon_socket = argv[i];
+    } else if (strcmp(argv[i], "--client") == 0
+        && i + 1 < argc) {
+      i += 1;
+      options.client_socket = argv[i];
+    } else if (strcmp(argv[i], "--stop-daemon") == 0
+        && i + 1 < argc) {
+      i += 1;
+      options.stop_daemon_socket = argv[i];
+    } else if (strcmp(argv[i], "--trace") == 0
+        && i + 1 < argc) {
+      i += 1;
+      options.trace_path = argv[i];
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 1;
+    }
+  }
   int exit_code;
   struct B_Error error;
-  if (!run_(&exit_code, &error)) {
+  bool ok;
+  if (options.stop_daemon_socket) {
+    ok = b_daemon_client_stop(
+      options.stop_daemon_socket, &error);
+    exit_code = 0;
+  } else if (options.client_socket) {
+    ok = run_client_(
+      options.client_socket, &exit_code, &error);
+  } else {
+    ok = run_(&options, &exit_code, &error);
+  }
+  if (!ok) {
     fprintf(
       stderr, "Error: %s\n", strerror(error.posix_error));
     return 1;
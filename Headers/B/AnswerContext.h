@@ -1,6 +1,8 @@
 #pragma once
 
 #include <B/Attributes.h>
+#include <B/RunLoop.h>
+#include <B/WorkerPool.h>
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -31,6 +33,57 @@ b_answer_context_run_loop(
     B_OUT_BORROW struct B_RunLoop **,
     B_OUT struct B_Error *);
 
+// Like b_run_loop_exec_basic with the answer context's
+// run loop.  The resources consumed by the process are
+// attributed to the answer context.
+B_WUR B_EXPORT_FUNC bool
+b_answer_context_exec_basic(
+    B_BORROW struct B_AnswerContext *,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *);
+
+// Like b_answer_context_exec_basic, but if the B_Main has
+// a process queue (see b_main_set_process_queue), the
+// process is queued in the named pool (see
+// b_process_queue_exec).  The process's memory use is
+// estimated from the peak RSS of the question's earlier
+// executions, and queued with the answer context's
+// priority (see NOTE[priorities]).  If the B_Main is
+// cancelled, raises ECANCELED.  See NOTE[cancellation].
+B_WUR B_EXPORT_FUNC bool
+b_answer_context_exec(
+    B_BORROW struct B_AnswerContext *,
+    B_BORROW_OPTIONAL char const *pool_name,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *);
+
+// Calls function on one of the B_Main's worker threads
+// (see b_main_set_worker_pool), then callback on the run
+// loop's thread.  If the B_Main has no worker pool,
+// function is called later on the run loop's thread.  The
+// CPU time used by function is attributed to the answer
+// context.
+//
+// function must not use the answer context or any other
+// non-thread-safe object.  See NOTE[worker threads].
+B_WUR B_EXPORT_FUNC bool
+b_answer_context_run_in_worker(
+    B_BORROW struct B_AnswerContext *,
+    B_WorkerPoolFunction *function,
+    B_WorkerPoolCallback *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *work_data,
+    size_t work_data_size,
+    B_OUT struct B_Error *);
+
 B_WUR B_EXPORT_FUNC bool
 b_answer_context_need_one(
     B_BORROW struct B_AnswerContext *,
@@ -39,6 +92,8 @@ b_answer_context_need_one(
     B_OUT_TRANSFER struct B_AnswerFuture **,
     B_OUT struct B_Error *);
 
+// The questions inherit the answer context's priority.
+// See NOTE[priorities].
 B_WUR B_EXPORT_FUNC bool
 b_answer_context_need(
     B_BORROW struct B_AnswerContext *,
@@ -48,6 +103,21 @@ b_answer_context_need(
     B_OUT_TRANSFER struct B_AnswerFuture **,
     B_OUT struct B_Error *);
 
+// Like b_answer_context_need, but the questions are
+// answered with at least the given priority.  Questions
+// with higher priorities are dispatched (and their
+// processes started) first.  The default priority is 0.
+// See NOTE[priorities].
+B_WUR B_EXPORT_FUNC bool
+b_answer_context_need_with_priority(
+    B_BORROW struct B_AnswerContext *,
+    B_BORROW struct B_IQuestion *const *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t count,
+    int priority,
+    B_OUT_TRANSFER struct B_AnswerFuture **,
+    B_OUT struct B_Error *);
+
 B_WUR B_EXPORT_FUNC bool
 b_answer_context_succeed(
     B_TRANSFER struct B_AnswerContext *,
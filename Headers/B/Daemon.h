@@ -0,0 +1,108 @@
+#pragma once
+
+#include <B/AnswerFuture.h>
+#include <B/Attributes.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct B_Database;
+struct B_Error;
+struct B_FileWatcher;
+struct B_IQuestion;
+struct B_Main;
+struct B_QuestionVTable;
+struct B_RunLoop;
+
+// Answers questions for clients connecting over a
+// Unix-domain socket, keeping a B_Main (and its caches)
+// alive between builds.  See NOTE[daemon].
+struct B_Daemon;
+
+typedef B_FUNC bool
+B_DaemonProgressCallback(
+    B_BORROW void *opaque,
+    B_BORROW char const *message,
+    B_OUT struct B_Error *);
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Listens on socket_path.  If another daemon is listening
+// on socket_path, raises EADDRINUSE.  Clients may ask
+// questions with any of the given vtables, and answers to
+// questions with these vtables are checked before each
+// request.  database, main, run_loop, and vtables must
+// outlive the daemon.
+B_WUR B_EXPORT_FUNC bool
+b_daemon_allocate(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_RunLoop *run_loop,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW char const *socket_path,
+    B_OUT_TRANSFER struct B_Daemon **,
+    B_OUT struct B_Error *);
+
+// Stops listening and removes the socket.
+B_WUR B_EXPORT_FUNC bool
+b_daemon_deallocate(
+    B_TRANSFER struct B_Daemon *,
+    B_OUT struct B_Error *);
+
+// Makes the daemon recheck only the B_FileQuestion-s
+// whose files watcher reports as changed, instead of
+// checking every answer before each request.  If watcher
+// is NULL, every answer is checked again.  watcher must
+// outlive the daemon, and must not be used by anyone else.
+// See NOTE[daemon].
+B_EXPORT_FUNC void
+b_daemon_set_file_watcher(
+    B_BORROW struct B_Daemon *,
+    B_BORROW_OPTIONAL struct B_FileWatcher *watcher);
+
+// Answers clients' requests, one client at a time, until
+// a client calls b_daemon_client_stop.
+B_WUR B_EXPORT_FUNC bool
+b_daemon_serve(
+    B_BORROW struct B_Daemon *,
+    B_OUT struct B_Error *);
+
+// Sends message to the client whose question is being
+// answered, if any.  Call this from B_Main's callback, for
+// example.  If the client went away, the message is
+// dropped.
+B_WUR B_EXPORT_FUNC bool
+b_daemon_report_progress(
+    B_BORROW struct B_Daemon *,
+    B_BORROW char const *message,
+    B_OUT struct B_Error *);
+
+// Asks the daemon listening on socket_path to answer the
+// question, calling progress_callback (if not NULL) for
+// each message the daemon reports.  *out_state is set to
+// B_FUTURE_RESOLVED or B_FUTURE_FAILED.  If no daemon is
+// listening, raises ECONNREFUSED or ENOENT.
+B_WUR B_EXPORT_FUNC bool
+b_daemon_client_answer(
+    B_BORROW char const *socket_path,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_BORROW_OPTIONAL B_DaemonProgressCallback *
+      progress_callback,
+    B_BORROW void *progress_callback_opaque,
+    B_OUT enum B_AnswerFutureState *out_state,
+    B_OUT struct B_Error *);
+
+// Makes b_daemon_serve return in the daemon listening on
+// socket_path.
+B_WUR B_EXPORT_FUNC bool
+b_daemon_client_stop(
+    B_BORROW char const *socket_path,
+    B_OUT struct B_Error *);
+
+#if defined(__cplusplus)
+}
+#endif
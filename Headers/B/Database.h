@@ -4,12 +4,104 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 struct B_Error;
+struct B_IQuestion;
 struct B_QuestionVTable;
+struct B_Tracer;
 
 struct B_Database;
 
+// The number of executions remembered for each question.
+// A macro (not an enumerator) so the database schema can
+// spell it in SQL.
+#define B_EXECUTION_HISTORY_SIZE 16
+
+// Statistics over the remembered executions of a question.
+// Times are in microseconds unless noted otherwise.  If
+// execution_count is zero, all fields are zero.
+struct B_ExecutionSummary {
+  int64_t execution_count;
+  // Executions which did not answer the question.
+  int64_t failure_count;
+  // Wall and CPU times are over executions which answered
+  // the question (zero if none did); failures often stop
+  // early.  Wall times exclude time spent waiting on other
+  // questions.  See NOTE[execution time].
+  int64_t mean_wall_time_us;
+  int64_t max_wall_time_us;
+  int64_t mean_cpu_time_us;
+  int64_t max_peak_rss_bytes;
+  int64_t mean_bytes_read;
+  int64_t mean_bytes_written;
+  // Milliseconds since the Unix epoch.
+  int64_t last_started_at_ms;
+};
+
+// Why b_database_check_all deleted an answer.  See
+// NOTE[invalidation log].
+struct B_Invalidation {
+  // The question whose answer was deleted.
+  struct B_IQuestion const *question;
+  struct B_QuestionVTable const *question_vtable;
+
+  // The question whose recorded answer no longer matched
+  // its actual answer.  Equal to question if depth is 0.
+  struct B_IQuestion const *cause;
+  struct B_QuestionVTable const *cause_vtable;
+
+  // The dependency of question through which the
+  // invalidation reached question, or NULL if depth is 0.
+  struct B_IQuestion const *parent;
+  struct B_QuestionVTable const *parent_vtable;
+
+  // The number of dependencies between cause and question.
+  size_t depth;
+};
+
+typedef B_FUNC bool
+B_InvalidationCallback(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Invalidation const *,
+    B_OUT struct B_Error *);
+
+// A question visited by b_database_plan.  See NOTE[plan].
+struct B_PlanEntry {
+  struct B_IQuestion const *question;
+  struct B_QuestionVTable const *question_vtable;
+  // If true, the question has no answer, so it would be
+  // answered.  If false, its answer would be reused.
+  bool will_execute;
+  // From the question's execution history (see
+  // b_database_summarize_executions).  Zero if the
+  // question was never answered.
+  int64_t execution_count;
+  // The question's own cost, excluding its dependencies'
+  // costs, so the entries of a plan can be summed.
+  int64_t mean_wall_time_us;
+};
+
+typedef B_FUNC bool
+B_PlanCallback(
+    B_BORROW void *opaque,
+    B_BORROW struct B_PlanEntry const *,
+    B_OUT struct B_Error *);
+
+typedef B_FUNC bool
+B_DependencyCallback(
+    B_BORROW void *opaque,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_OUT struct B_Error *);
+
+typedef B_FUNC bool
+B_QuestionCallback(
+    B_BORROW void *opaque,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_OUT struct B_Error *);
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -27,6 +119,18 @@ b_database_close(
     B_TRANSFER struct B_Database *,
     B_OUT struct B_Error *);
 
+// Makes the database record writes and long waits for its
+// lock.  Must not be called while other threads use the
+// database.  tracer must outlive the database or be
+// replaced with NULL.  See NOTE[tracing].
+B_EXPORT_FUNC void
+b_database_set_tracer(
+    B_BORROW struct B_Database *,
+    B_BORROW_OPTIONAL struct B_Tracer *tracer);
+
+// Deletes answers which no longer match their questions'
+// actual answers, and answers which depend upon them.
+// Deleted answers are logged; see b_database_invalidations.
 B_WUR B_EXPORT_FUNC bool
 b_database_check_all(
     B_BORROW struct B_Database *,
@@ -34,6 +138,180 @@ b_database_check_all(
     size_t question_vtable_count,
     B_OUT struct B_Error *);
 
+// Like b_database_check_all, but only the answers to the
+// given questions are rechecked.  Answers which depend
+// upon a deleted answer are deleted too.  Use this if the
+// questions whose answers might have changed are known,
+// e.g. from a B_FileWatcher or another file watcher.  The
+// cost depends on the number of given questions and
+// invalidated answers, not on the size of the database.
+B_WUR B_EXPORT_FUNC bool
+b_database_check_changed(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t question_count,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t vtable_count,
+    B_OUT struct B_Error *);
+
+// Calls callback for each question which has an answer.
+// Questions whose UUID does not match any of
+// question_vtables are skipped.  callback must not call
+// into the database.
+B_WUR B_EXPORT_FUNC bool
+b_database_answered_questions(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t question_vtable_count,
+    B_BORROW B_QuestionCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *);
+
+// Sets *out to a mark for
+// b_database_answered_questions_since.
+B_WUR B_EXPORT_FUNC bool
+b_database_answers_mark(
+    B_BORROW struct B_Database *,
+    B_OUT int64_t *,
+    B_OUT struct B_Error *);
+
+// Like b_database_answered_questions, but skips answers
+// recorded before b_database_answers_mark set mark.  A
+// mark of 0 skips nothing.  If answers were deleted (e.g.
+// by b_database_check_all) after mark was set, answers
+// recorded since might be skipped too; take a new mark
+// after deleting answers.
+B_WUR B_EXPORT_FUNC bool
+b_database_answered_questions_since(
+    B_BORROW struct B_Database *,
+    int64_t mark,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t question_vtable_count,
+    B_BORROW B_QuestionCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *);
+
+// Calls callback for each answer deleted by the most
+// recent b_database_check_all or
+// b_database_check_changed, in order of increasing depth.
+// Following parent links from an invalidation gives the
+// path from its cause.
+//
+// If a logged question's UUID does not match any of
+// question_vtables, raises ENOENT.  callback must not call
+// into the database.
+B_WUR B_EXPORT_FUNC bool
+b_database_invalidations(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t question_vtable_count,
+    B_BORROW B_InvalidationCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *);
+
+// Writes every answer and dependency in the database to
+// the file at file_path, replacing its contents.  The
+// database can be written to by other connections while
+// exporting.
+//
+// The file format is versioned and checksummed; see
+// NOTE[export format].
+B_WUR B_EXPORT_FUNC bool
+b_database_export(
+    B_BORROW struct B_Database *,
+    B_BORROW char const *file_path,
+    B_OUT struct B_Error *);
+
+// Merges answers and dependencies from a file created by
+// b_database_export into the database in a single
+// transaction.  Answers already in the database take
+// precedence over imported answers.
+//
+// If the file is corrupt or truncated, raises EINVAL.  If
+// the file was created by an incompatible version of b,
+// raises ENOTSUP.  The database is not modified if this
+// function fails.
+B_WUR B_EXPORT_FUNC bool
+b_database_import(
+    B_BORROW struct B_Database *,
+    B_BORROW char const *file_path,
+    B_OUT struct B_Error *);
+
+// Merges answers and dependencies from the databases at
+// sqlite_paths into the database.  Each source database is
+// merged in its own transaction.
+//
+// If both databases have an answer for a question, the
+// more recently recorded answer is kept.  Dependencies are
+// unioned.  The source databases are not modified.
+//
+// If a source database was created by a different version
+// of b, raises ENOTSUP.  If a source database does not
+// exist, raises ENOENT.
+B_WUR B_EXPORT_FUNC bool
+b_database_merge(
+    B_BORROW struct B_Database *,
+    B_BORROW char const *const *sqlite_paths,
+    size_t sqlite_path_count,
+    B_OUT struct B_Error *);
+
+// Calls callback for each question which the given
+// question was recorded needing, in the order the
+// dependencies were recorded.  Recorded dependencies
+// outlive the question's answer, so they describe the
+// question's most recent successful answer.
+//
+// Dependencies whose UUID does not match any of
+// question_vtables are skipped.  callback must not call
+// into the database.
+B_WUR B_EXPORT_FUNC bool
+b_database_recorded_dependencies(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t question_vtable_count,
+    B_BORROW B_DependencyCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *);
+
+// Calls callback for each question which answering roots
+// would ask, without answering anything.  Call
+// b_database_check_all first so stale answers are not
+// reported as reused.  Each question is reported once, in
+// breadth-first order from each root.
+//
+// Dependencies of a question which would be answered are
+// taken from its last answer, so the question may ask
+// questions which are not reported.  Questions whose UUID
+// does not match any of question_vtables are not reported.
+// callback must not call into the database.
+B_WUR B_EXPORT_FUNC bool
+b_database_plan(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *const *roots,
+    B_BORROW struct B_QuestionVTable const *const *
+      root_vtables,
+    size_t root_count,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t question_vtable_count,
+    B_BORROW B_PlanCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *);
+
+// Summarizes the most recent executions of the question.
+// See B_EXECUTION_HISTORY_SIZE.
+B_WUR B_EXPORT_FUNC bool
+b_database_summarize_executions(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_OUT struct B_ExecutionSummary *,
+    B_OUT struct B_Error *);
+
 #if defined(__cplusplus)
 }
 #endif
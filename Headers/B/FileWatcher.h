@@ -0,0 +1,60 @@
+#pragma once
+
+#include <B/Attributes.h>
+
+#include <stdbool.h>
+
+struct B_Error;
+
+// Learns which files named by B_FileQuestion-s might have
+// changed, without reading them.  See NOTE[file watcher].
+struct B_FileWatcher;
+
+typedef B_FUNC bool
+B_FileWatcherCallback(
+    B_BORROW void *opaque,
+    B_BORROW char const *file_path,
+    B_OUT struct B_Error *);
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// If the system has no supported file notification API
+// (e.g. inotify), raises ENOTSUP.
+B_WUR B_EXPORT_FUNC bool
+b_file_watcher_allocate(
+    B_OUT_TRANSFER struct B_FileWatcher **,
+    B_OUT struct B_Error *);
+
+B_EXPORT_FUNC void
+b_file_watcher_deallocate(
+    B_TRANSFER struct B_FileWatcher *);
+
+// Starts watching the file at file_path, which need not
+// exist.  If file_path was already watched, *out_added is
+// set to false.  Changes made before the file was watched
+// are not reported.
+B_WUR B_EXPORT_FUNC bool
+b_file_watcher_watch(
+    B_BORROW struct B_FileWatcher *,
+    B_BORROW char const *file_path,
+    B_OUT bool *out_added,
+    B_OUT struct B_Error *);
+
+// Calls callback, without blocking, for each watched file
+// which might have changed since the previous call.  If
+// changes might have been missed, *out_overflowed is set
+// to true and callback is not called; assume every file
+// changed.
+B_WUR B_EXPORT_FUNC bool
+b_file_watcher_take_changes(
+    B_BORROW struct B_FileWatcher *,
+    B_BORROW B_FileWatcherCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT bool *out_overflowed,
+    B_OUT struct B_Error *);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <B/Attributes.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct B_Error;
+
+// A GNU make jobserver.  See NOTE[jobserver].
+struct B_Jobserver;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Connects to the jobserver named in the MAKEFLAGS
+// environment variable, e.g. by a parent make.  If
+// MAKEFLAGS names no jobserver, raises ENOENT.  If the
+// jobserver's file descriptors were not inherited, raises
+// EBADF.
+B_WUR B_EXPORT_FUNC bool
+b_jobserver_allocate_from_environment(
+    B_OUT_TRANSFER struct B_Jobserver **,
+    B_OUT struct B_Error *);
+
+// Creates a jobserver allowing job_slots jobs, and points
+// MAKEFLAGS at it so child processes (e.g. make) share
+// the jobserver's tokens.  b_jobserver_deallocate restores
+// MAKEFLAGS.
+B_WUR B_EXPORT_FUNC bool
+b_jobserver_allocate_server(
+    size_t job_slots,
+    B_OUT_TRANSFER struct B_Jobserver **,
+    B_OUT struct B_Error *);
+
+// Releases every held token.
+B_WUR B_EXPORT_FUNC bool
+b_jobserver_deallocate(
+    B_TRANSFER struct B_Jobserver *,
+    B_OUT struct B_Error *);
+
+// Takes a token from the jobserver without blocking.  If
+// no token is available, *acquired is set to false.
+B_WUR B_EXPORT_FUNC bool
+b_jobserver_try_acquire(
+    B_BORROW struct B_Jobserver *,
+    B_OUT bool *acquired,
+    B_OUT struct B_Error *);
+
+// Returns a token taken by b_jobserver_try_acquire.
+B_WUR B_EXPORT_FUNC bool
+b_jobserver_release(
+    B_BORROW struct B_Jobserver *,
+    B_OUT struct B_Error *);
+
+B_WUR B_EXPORT_FUNC size_t
+b_jobserver_held_count(
+    B_BORROW struct B_Jobserver const *);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -1,16 +1,22 @@
 #pragma once
 
 #include <B/Attributes.h>
+#include <B/Process.h>
 
 #include <stdbool.h>
+#include <stddef.h>
 
 struct B_AnswerContext;
 struct B_AnswerFuture;
 struct B_Database;
 struct B_Error;
 struct B_IQuestion;
+struct B_ProcessExitStatus;
+struct B_ProcessQueue;
 struct B_QuestionVTable;
 struct B_RunLoop;
+struct B_Tracer;
+struct B_WorkerPool;
 
 struct B_Main;
 
@@ -21,6 +27,97 @@ B_MainCallback(
     B_TRANSFER struct B_AnswerContext *,
     B_OUT struct B_Error *);
 
+// Called with the questions of a dependency cycle:
+// questions[0] needs questions[1], ..., and
+// questions[count - 1] needs questions[0].
+typedef B_FUNC bool
+B_MainCycleCallback(
+    B_BORROW void *opaque,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t count,
+    B_OUT struct B_Error *);
+
+enum B_MainCacheHit {
+  // The answer was resolved earlier by main.  See
+  // NOTE[answer cache].
+  B_MAIN_CACHE_HIT_MEMORY = 1,
+
+  // The answer was recorded in the database.
+  B_MAIN_CACHE_HIT_DATABASE = 2,
+};
+
+// Hooks which report what main does, e.g. for metrics or
+// a progress display.  Each hook is optional.  Hooks are
+// called on the run loop's thread and must not call into
+// main.  See NOTE[main observers].
+struct B_MainObserver {
+  // b_main_answer or b_answer_context_need was called for
+  // the question.
+  B_FUNC void (*question_requested)(
+      B_BORROW void *opaque,
+      B_BORROW struct B_Main *,
+      B_BORROW struct B_IQuestion const *,
+      B_BORROW struct B_QuestionVTable const *);
+
+  // The question was answered without dispatching it.
+  B_FUNC void (*cache_hit)(
+      B_BORROW void *opaque,
+      B_BORROW struct B_Main *,
+      B_BORROW struct B_IQuestion const *,
+      B_BORROW struct B_QuestionVTable const *,
+      enum B_MainCacheHit);
+
+  // The question is about to be given to main's callback.
+  B_FUNC void (*dispatched)(
+      B_BORROW void *opaque,
+      B_BORROW struct B_Main *,
+      B_BORROW struct B_IQuestion const *,
+      B_BORROW struct B_QuestionVTable const *);
+
+  // A dispatched question succeeded.
+  B_FUNC void (*resolved)(
+      B_BORROW void *opaque,
+      B_BORROW struct B_Main *,
+      B_BORROW struct B_IQuestion const *,
+      B_BORROW struct B_QuestionVTable const *);
+
+  // A dispatched question failed (or was cancelled).
+  B_FUNC void (*failed)(
+      B_BORROW void *opaque,
+      B_BORROW struct B_Main *,
+      B_BORROW struct B_IQuestion const *,
+      B_BORROW struct B_QuestionVTable const *);
+
+  // The database recorded that from needs to.
+  B_FUNC void (*dependency_recorded)(
+      B_BORROW void *opaque,
+      B_BORROW struct B_Main *,
+      B_BORROW struct B_IQuestion const *from,
+      B_BORROW struct B_QuestionVTable const *from_vtable,
+      B_BORROW struct B_IQuestion const *to,
+      B_BORROW struct B_QuestionVTable const *to_vtable);
+
+  // A process started by b_answer_context_exec for the
+  // question began running.
+  B_FUNC void (*process_started)(
+      B_BORROW void *opaque,
+      B_BORROW struct B_Main *,
+      B_BORROW struct B_IQuestion const *,
+      B_BORROW struct B_QuestionVTable const *,
+      B_ProcessID);
+
+  // A process started by b_answer_context_exec for the
+  // question exited.
+  B_FUNC void (*process_exited)(
+      B_BORROW void *opaque,
+      B_BORROW struct B_Main *,
+      B_BORROW struct B_IQuestion const *,
+      B_BORROW struct B_QuestionVTable const *,
+      B_BORROW struct B_ProcessExitStatus const *);
+};
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -39,6 +136,79 @@ b_main_deallocate(
     B_TRANSFER struct B_Main *,
     B_OUT struct B_Error *);
 
+// Enables speculative prefetching: when a question is
+// dispatched, the questions it needed when it was last
+// answered are answered in parallel.  Only questions
+// with one of the given vtables are prefetched.  vtables
+// must outlive main.  See NOTE[prefetch].
+B_EXPORT_FUNC void
+b_main_enable_prefetch(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count);
+
+// Makes b_answer_context_exec queue processes on the
+// given queue (or, if queue is NULL, start them
+// immediately).  queue must outlive main.
+B_EXPORT_FUNC void
+b_main_set_process_queue(
+    B_BORROW struct B_Main *main,
+    B_BORROW_OPTIONAL struct B_ProcessQueue *queue);
+
+// Makes the failure of any question cancel main (see
+// b_main_cancel).  Defaults to false.
+B_EXPORT_FUNC void
+b_main_set_cancel_on_failure(
+    B_BORROW struct B_Main *main,
+    bool cancel_on_failure);
+
+// Fails questions in flight as soon as possible, and
+// terminates their processes.  Questions answered after
+// the questions in flight finish are answered normally.
+// Must be called on main's run loop's thread.  See
+// NOTE[cancellation].
+B_WUR B_EXPORT_FUNC bool
+b_main_cancel(
+    B_BORROW struct B_Main *main,
+    B_OUT struct B_Error *);
+
+// Makes b_answer_context_run_in_worker call functions on
+// the given pool's threads (or, if pool is NULL, on the
+// run loop's thread).  pool must outlive main.  See
+// NOTE[worker threads].
+B_EXPORT_FUNC void
+b_main_set_worker_pool(
+    B_BORROW struct B_Main *main,
+    B_BORROW_OPTIONAL struct B_WorkerPool *pool);
+
+// Makes main (and processes started without a queue; see
+// b_main_set_process_queue) write trace events to the
+// given tracer (or, if tracer is NULL, stop tracing).
+// tracer must outlive main.  Must be called before
+// questions are answered.  See NOTE[tracing].
+B_EXPORT_FUNC void
+b_main_set_tracer(
+    B_BORROW struct B_Main *main,
+    B_BORROW_OPTIONAL struct B_Tracer *tracer);
+
+// Makes main call observer's hooks (or, if observer is
+// NULL, no hooks).  observer is copied.  See NOTE[main
+// observers].
+B_EXPORT_FUNC void
+b_main_set_observer(
+    B_BORROW struct B_Main *main,
+    B_BORROW_OPTIONAL struct B_MainObserver const *observer,
+    B_BORROW void *observer_opaque);
+
+// Makes main call callback when b_answer_context_need
+// would complete a dependency cycle.  The need fails with
+// ELOOP regardless.  See NOTE[dependency cycles].
+B_EXPORT_FUNC void
+b_main_set_cycle_callback(
+    B_BORROW struct B_Main *main,
+    B_BORROW_OPTIONAL B_MainCycleCallback *callback,
+    B_BORROW void *callback_opaque);
+
 B_WUR B_EXPORT_FUNC bool
 b_main_answer(
     B_BORROW struct B_Main *main,
@@ -47,6 +217,18 @@ b_main_answer(
     B_OUT_TRANSFER struct B_AnswerFuture **,
     B_OUT struct B_Error *);
 
+// Drops main's cached answer for the question, if any, so
+// the next b_main_answer for the question looks in the
+// database.  Call this for each question invalidated by
+// b_database_check_all.  Questions being answered are
+// unaffected.
+B_WUR B_EXPORT_FUNC bool
+b_main_forget(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_OUT struct B_Error *);
+
 #if defined(__cplusplus)
 }
 #endif
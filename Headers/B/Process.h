@@ -3,8 +3,12 @@
 #include <B/Attributes.h>
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+struct B_Error;
+struct B_RunLoop;
+
 typedef int64_t B_ProcessID;
 
 enum B_ProcessExitStatusType {
@@ -31,6 +35,23 @@ struct B_ProcessExitStatusException {
   uint32_t code;
 };
 
+// Resources consumed by a process and its reaped
+// children.  Fields are zero if the platform does not
+// report them.
+struct B_ProcessResourceUsage {
+  // User plus system CPU time, in microseconds.
+  int64_t cpu_time_us;
+
+  // Peak resident set size, in bytes.
+  int64_t peak_rss_bytes;
+
+  // Bytes read from and written to storage.  These are
+  // approximations derived from block counts, and do not
+  // include reads served by the page cache.
+  int64_t bytes_read;
+  int64_t bytes_written;
+};
+
 struct B_ProcessExitStatus {
   enum B_ProcessExitStatusType type;
   union {
@@ -43,6 +64,9 @@ struct B_ProcessExitStatus {
     // B_PROCESS_EXIT_STATUS_EXCEPTION
     struct B_ProcessExitStatusException exception;
   } u;
+
+  // Not compared by b_process_exit_status_equal.
+  struct B_ProcessResourceUsage usage;
 };
 
 #if defined(__cplusplus)
@@ -54,6 +78,25 @@ b_process_exit_status_equal(
     struct B_ProcessExitStatus const *,
     struct B_ProcessExitStatus const *);
 
+// Asks each process's group to exit (with SIGTERM), then
+// returns.  Once grace_period_ms have passed, a timer on
+// run_loop forces the groups still running to exit (with
+// SIGKILL); so does deallocating run_loop first.
+// Processes are not reaped, so whoever started them (e.g.
+// run_loop) still sees them exit.  See NOTE[process
+// groups].
+//
+// Each process must be a child of this process which has
+// not been reaped.  Must be called on run_loop's thread
+// (see b_run_loop_add_timer).
+B_WUR B_EXPORT_FUNC bool
+b_process_terminate(
+    B_BORROW struct B_RunLoop *run_loop,
+    B_BORROW B_ProcessID const *process_ids,
+    size_t process_count,
+    int64_t grace_period_ms,
+    B_OUT struct B_Error *);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <B/Attributes.h>
+#include <B/Process.h>
+#include <B/RunLoop.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct B_Error;
+struct B_Jobserver;
+struct B_Tracer;
+
+// Limits how many processes run at once.  See
+// NOTE[process queue].
+struct B_ProcessQueue;
+
+// For b_process_queue_exec, if a process's memory use is
+// not known.
+enum {
+  B_PROCESS_QUEUE_UNKNOWN_MEMORY = -1,
+};
+
+// Called when a queued process starts running.
+typedef B_FUNC void
+B_ProcessQueueStartFunction(
+    B_ProcessID,
+    B_BORROW void const *callback_data);
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// The queue starts processes using run_loop.
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_allocate(
+    B_BORROW struct B_RunLoop *run_loop,
+    size_t job_slots,
+    B_OUT_TRANSFER struct B_ProcessQueue **,
+    B_OUT struct B_Error *);
+
+// Calls the cancel callback of each waiting process.  The
+// run loop must be deallocated first, so no callbacks for
+// running processes are called afterwards.
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_deallocate(
+    B_TRANSFER struct B_ProcessQueue *,
+    B_OUT struct B_Error *);
+
+// Calls the cancel callback of each waiting process, then
+// terminates running processes (see b_process_terminate)
+// without waiting for them.  The callbacks of terminated
+// processes are called when the run loop sees them exit.
+// Must be called on the run loop's thread.
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_cancel(
+    B_BORROW struct B_ProcessQueue *,
+    int64_t grace_period_ms,
+    B_OUT struct B_Error *);
+
+// Limits processes started in the named pool to slots
+// running at once, in addition to the queue's job slots.
+// If the pool already exists, raises EEXIST.
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_add_pool(
+    B_BORROW struct B_ProcessQueue *,
+    B_BORROW char const *pool_name,
+    size_t slots,
+    B_OUT struct B_Error *);
+
+// Makes each running process except the first hold a
+// token from jobserver.  The queue must be jobserver's
+// only user, and must have no running processes.  See
+// NOTE[jobserver].
+B_EXPORT_FUNC void
+b_process_queue_set_jobserver(
+    B_BORROW struct B_ProcessQueue *,
+    B_BORROW_OPTIONAL struct B_Jobserver *);
+
+// Makes the queue record the lifetime of each process.
+// The queue must have no running processes.  See
+// NOTE[tracing].
+B_EXPORT_FUNC void
+b_process_queue_set_tracer(
+    B_BORROW struct B_ProcessQueue *,
+    B_BORROW_OPTIONAL struct B_Tracer *);
+
+// Starts processes only while the sum of their memory
+// estimates is at most budget_bytes (or, if budget_bytes
+// is 0, without regard to memory).  Processes with an
+// unknown estimate are assumed to need
+// default_process_bytes.  The queue must have no running
+// or waiting processes.  See NOTE[memory budget].
+B_EXPORT_FUNC void
+b_process_queue_set_memory_budget(
+    B_BORROW struct B_ProcessQueue *,
+    int64_t budget_bytes,
+    int64_t default_process_bytes);
+
+B_WUR B_EXPORT_FUNC size_t
+b_process_queue_running_count(
+    B_BORROW struct B_ProcessQueue const *);
+
+B_WUR B_EXPORT_FUNC size_t
+b_process_queue_waiting_count(
+    B_BORROW struct B_ProcessQueue const *);
+
+// Sum of the memory estimates of running processes.
+B_WUR B_EXPORT_FUNC int64_t
+b_process_queue_running_memory_bytes(
+    B_BORROW struct B_ProcessQueue const *);
+
+// Like b_run_loop_exec_basic, but if no job slot (or no
+// slot in the pool named pool_name, or not enough of the
+// memory budget) is free, the process waits until one is.
+// A pool which was never added has no limit of its own.
+// command_args and callback_data are copied.
+//
+// If a waiting process cannot be started, its
+// cancel_callback is called.
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_exec_basic(
+    B_BORROW struct B_ProcessQueue *,
+    B_BORROW_OPTIONAL char const *pool_name,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *);
+
+// Like b_process_queue_exec_basic, but the process is
+// estimated to need memory_bytes of memory (or
+// B_PROCESS_QUEUE_UNKNOWN_MEMORY).
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_exec(
+    B_BORROW struct B_ProcessQueue *,
+    B_BORROW_OPTIONAL char const *pool_name,
+    int64_t memory_bytes,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *);
+
+// Like b_process_queue_exec, but waiting processes with a
+// higher priority start first.  Processes with equal
+// priorities start in the order they were queued.
+// b_process_queue_exec uses priority 0.
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_exec_with_priority(
+    B_BORROW struct B_ProcessQueue *,
+    B_BORROW_OPTIONAL char const *pool_name,
+    int64_t memory_bytes,
+    int priority,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *);
+
+// Like b_process_queue_exec_with_priority, but calls
+// start_callback (if not NULL) with the process's ID when
+// the process starts.
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_exec_with_start_callback(
+    B_BORROW struct B_ProcessQueue *,
+    B_BORROW_OPTIONAL char const *pool_name,
+    int64_t memory_bytes,
+    int priority,
+    B_BORROW char const *const *command_args,
+    B_OPTIONAL B_ProcessQueueStartFunction *start_callback,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *);
+
+#if defined(__cplusplus)
+}
+#endif
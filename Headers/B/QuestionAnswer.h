@@ -65,8 +65,41 @@ struct B_QuestionVTable {
       B_BORROW struct B_ByteSource *,
       B_OUT_TRANSFER struct B_IQuestion **,
       B_OUT struct B_Error *);
+
+  // Optional.  If questions are reference counted, retain
+  // adds a reference and returns the question, and release
+  // removes a reference.  retain and release must both be
+  // NULL or both be non-NULL.  See NOTE[question
+  // references].
+  B_WUR B_FUNC struct B_IQuestion *(*retain)(
+      B_BORROW struct B_IQuestion const *);
+
+  B_FUNC void (*release)(
+      B_TRANSFER struct B_IQuestion *);
 };
 
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Sets *out to a question equal to the given question.
+// If the question is reference counted, *out is the given
+// question, retained; otherwise, *out is a replica.  *out
+// must be given to b_question_release.  See
+// NOTE[question references].
+B_WUR B_EXPORT_FUNC bool
+b_question_retain(
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_OUT_TRANSFER struct B_IQuestion **out,
+    B_OUT struct B_Error *);
+
+// Releases a question given by b_question_retain.
+B_EXPORT_FUNC void
+b_question_release(
+    B_TRANSFER struct B_IQuestion *,
+    B_BORROW struct B_QuestionVTable const *);
+
 B_WUR B_EXPORT_FUNC bool
 b_question_serialize_to_memory(
     B_BORROW struct B_IQuestion const *,
@@ -98,3 +131,7 @@ b_answer_deserialize_from_memory(
     size_t data_size,
     B_OUT_TRANSFER struct B_IAnswer **,
     struct B_Error *);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -8,6 +8,7 @@
 #include <stdint.h>
 
 struct B_Error;
+struct B_Tracer;
 struct siginfo;
 
 struct B_RunLoop;
@@ -52,10 +53,34 @@ struct B_RunLoopVTable {
       B_BORROW void const *callback_data,
       size_t callback_data_size,
       B_OUT struct B_Error *);
+
+  // Optional.  If not NULL, b_run_loop_exec calls this
+  // instead of starting a process, e.g. to simulate
+  // processes (see NOTE[simulation]).
+  B_WUR B_FUNC bool (*exec)(
+      B_BORROW struct B_RunLoop *,
+      B_BORROW char const *const *command_args,
+      B_RunLoopProcessFunction *callback,
+      B_RunLoopFunction *cancel_callback,
+      B_BORROW void const *callback_data,
+      size_t callback_data_size,
+      B_OUT B_ProcessID *out_process_id,
+      B_OUT struct B_Error *);
+
+  B_WUR B_FUNC bool (*add_timer)(
+      B_BORROW struct B_RunLoop *,
+      int64_t delay_ms,
+      B_RunLoopFunction *callback,
+      B_RunLoopFunction *cancel,
+      B_BORROW void const *callback_data,
+      size_t callback_data_size,
+      B_OUT struct B_Error *);
 };
 
 struct B_RunLoop {
   struct B_RunLoopVTable vtable;
+  // NULL unless tracing.  See NOTE[tracing].
+  struct B_Tracer *tracer;
   // Abstract.
 };
 
@@ -87,6 +112,14 @@ B_WUR B_EXPORT_FUNC void
 b_run_loop_deallocate(
     B_TRANSFER struct B_RunLoop *);
 
+// Makes the run loop record the time it spends waiting for
+// work.  tracer must outlive the run loop or be replaced
+// with NULL.  See NOTE[tracing].
+B_EXPORT_FUNC void
+b_run_loop_set_tracer(
+    B_BORROW struct B_RunLoop *,
+    B_BORROW_OPTIONAL struct B_Tracer *tracer);
+
 B_WUR B_EXPORT_FUNC bool
 b_run_loop_add_function(
     B_BORROW struct B_RunLoop *,
@@ -106,6 +139,26 @@ b_run_loop_add_process_id(
     size_t callback_data_size,
     B_OUT struct B_Error *);
 
+// Calls callback on the run loop's thread once delay_ms
+// have passed.  If the run loop is deallocated first,
+// cancel is called instead.  Unlike
+// b_run_loop_add_function, must be called on the run
+// loop's thread (e.g. from another callback) or while the
+// run loop is not running.
+B_WUR B_EXPORT_FUNC bool
+b_run_loop_add_timer(
+    B_BORROW struct B_RunLoop *,
+    int64_t delay_ms,
+    B_RunLoopFunction *callback,
+    B_RunLoopFunction *cancel,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *);
+
+// Runs functions and process callbacks until
+// b_run_loop_stop is called.  The run loop can then be run
+// again.  If a function or timer callback fails, raises
+// its error.
 B_WUR B_EXPORT_FUNC bool
 b_run_loop_run(
     B_BORROW struct B_RunLoop *,
@@ -124,6 +177,24 @@ B_EXPORT_FUNC_CDECL void
 b_run_loop_sigchld_handler(
     int signal_number);
 
+// Like b_run_loop_exec_basic, but also gives the ID of
+// the started process.
+//
+// The process is started in a new process group, so it
+// does not receive SIGINT when the user presses Ctrl-C.
+// Callers should catch SIGINT and terminate the process
+// (e.g. with b_main_cancel).  See NOTE[process groups].
+B_WUR B_EXPORT_FUNC bool
+b_run_loop_exec(
+    B_BORROW struct B_RunLoop *,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT B_ProcessID *out_process_id,
+    B_OUT struct B_Error *);
+
 B_WUR B_EXPORT_FUNC bool
 b_run_loop_exec_basic(
     B_BORROW struct B_RunLoop *,
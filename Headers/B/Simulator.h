@@ -0,0 +1,137 @@
+#pragma once
+
+#include <B/Attributes.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct B_AnswerContext;
+struct B_Database;
+struct B_Error;
+struct B_Main;
+struct B_ProcessExitStatus;
+struct B_QuestionVTable;
+struct B_RunLoop;
+
+// Replays a recorded build with simulated processes.  See
+// NOTE[simulation].
+struct B_Simulation;
+
+// Decides how a simulated process started with
+// command_args behaves: it runs for *duration_us of
+// virtual time, then exits with *exit_status.
+typedef B_FUNC bool
+B_SimulatedProcessFunction(
+    B_BORROW void *opaque,
+    B_BORROW char const *const *command_args,
+    B_OUT int64_t *duration_us,
+    B_OUT struct B_ProcessExitStatus *exit_status,
+    B_OUT struct B_Error *);
+
+// What a simulated run loop has seen so far.
+struct B_SimulationReport {
+  // Virtual time from the run loop's allocation until the
+  // last simulated process exited.
+  int64_t makespan_us;
+  // Number of simulated processes which exited.
+  size_t process_count;
+  // Most simulated processes running at once.
+  size_t peak_running_count;
+  // Sum of the durations of the simulated processes which
+  // exited.
+  int64_t busy_us;
+  // Time cores spent not running a simulated process,
+  // summed over core_count cores.  Never negative.
+  int64_t idle_core_us;
+};
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Allocates a run loop whose processes are simulated.
+// b_run_loop_exec asks process_function how each process
+// behaves instead of starting it, and b_run_loop_run
+// advances virtual time from one process's exit or timer
+// to the next.  Functions run at the current virtual
+// time.
+//
+// Simulated processes cannot be terminated, and
+// b_run_loop_add_process_id raises ENOTSUP.  If
+// b_run_loop_run has nothing to do before it is stopped,
+// it raises EDEADLK instead of waiting, so functions must
+// not be added from other threads (e.g. by a
+// B_WorkerPool).
+B_WUR B_EXPORT_FUNC bool
+b_run_loop_allocate_simulated(
+    B_BORROW B_SimulatedProcessFunction *process_function,
+    B_BORROW void *process_function_opaque,
+    B_OUT_TRANSFER struct B_RunLoop **,
+    B_OUT struct B_Error *);
+
+// The run loop's virtual time, in microseconds since the
+// run loop was allocated.  run_loop must have been
+// allocated by b_run_loop_allocate_simulated.
+B_WUR B_EXPORT_FUNC int64_t
+b_run_loop_simulated_now_us(
+    B_BORROW struct B_RunLoop *run_loop);
+
+// Reports what the run loop has seen so far, as if its
+// processes had core_count cores to run on.  run_loop
+// must have been allocated by
+// b_run_loop_allocate_simulated.
+B_EXPORT_FUNC void
+b_run_loop_simulated_report(
+    B_BORROW struct B_RunLoop *run_loop,
+    size_t core_count,
+    B_OUT struct B_SimulationReport *);
+
+// Allocates a simulation which replays the build recorded
+// in history.  Only questions answered in history with
+// one of question_vtables are replayed.  history and
+// question_vtables must outlive the simulation.
+//
+// database is for the B_Main.  It must hold no answers
+// (e.g. it is new, or opened with ":memory:").  A summary
+// of each question's executions in history is recorded in
+// it, so B_Main and B_ProcessQueue estimate questions as
+// they would have when history was recorded.
+B_WUR B_EXPORT_FUNC bool
+b_simulation_allocate(
+    B_BORROW struct B_Database *history,
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t question_vtable_count,
+    B_OUT_TRANSFER struct B_Simulation **,
+    B_OUT struct B_Error *);
+
+// Deallocates the simulation's run loop, which cancels
+// its callbacks.  Deallocate the simulation before the
+// B_ProcessQueue and B_Main which use its run loop.
+B_EXPORT_FUNC void
+b_simulation_deallocate(
+    B_TRANSFER struct B_Simulation *);
+
+// The simulated run loop to give to b_main_allocate and
+// b_process_queue_allocate.  See
+// b_run_loop_allocate_simulated.
+B_WUR B_EXPORT_FUNC B_BORROW struct B_RunLoop *
+b_simulation_run_loop(
+    B_BORROW struct B_Simulation *);
+
+// A B_MainCallback which answers questions as they were
+// answered when history was recorded.  opaque must be the
+// simulation.  The B_Main must use the database given to
+// b_simulation_allocate and the simulation's run loop.
+B_WUR B_EXPORT_FUNC bool
+b_simulation_dispatch(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_TRANSFER struct B_AnswerContext *,
+    B_OUT struct B_Error *);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <B/Attributes.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct B_Error;
+
+// Writes a profile of a build in Chrome's trace event
+// format, viewable in chrome://tracing or Perfetto.  See
+// NOTE[tracing].
+//
+// Thread-safe.
+struct B_Tracer;
+
+// An optional argument attached to a trace event.
+struct B_TraceArg {
+  char const *name;
+  // If NULL, the argument is integer.  Otherwise, the
+  // argument is a string of string_size bytes.
+  uint8_t const *string;
+  size_t string_size;
+  int64_t integer;
+};
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Creates (or truncates) the file at path, then writes
+// events to it as they happen.
+B_WUR B_EXPORT_FUNC bool
+b_tracer_open(
+    B_BORROW char const *path,
+    B_OUT_TRANSFER struct B_Tracer **,
+    B_OUT struct B_Error *);
+
+// Finishes and closes the file.  Raises the first error
+// (if any) encountered while writing events.
+B_WUR B_EXPORT_FUNC bool
+b_tracer_close(
+    B_TRANSFER struct B_Tracer *,
+    B_OUT struct B_Error *);
+
+// The current time for trace events, in microseconds.
+B_WUR B_EXPORT_FUNC int64_t
+b_tracer_now_us(
+    void);
+
+// Writes a span on the calling thread.  Spans on one
+// thread must nest.
+B_EXPORT_FUNC void
+b_tracer_span(
+    B_BORROW struct B_Tracer *,
+    B_BORROW char const *category,
+    B_BORROW char const *name,
+    int64_t start_us,
+    int64_t end_us,
+    B_BORROW_OPTIONAL struct B_TraceArg const *);
+
+// Begins a span which may overlap other spans, e.g. the
+// lifetime of a question.  Spans with the same category
+// and id form one track.
+B_EXPORT_FUNC void
+b_tracer_begin_async(
+    B_BORROW struct B_Tracer *,
+    B_BORROW char const *category,
+    B_BORROW char const *name,
+    uint64_t id,
+    int64_t at_us,
+    B_BORROW_OPTIONAL struct B_TraceArg const *);
+
+// Ends a span begun by b_tracer_begin_async.
+B_EXPORT_FUNC void
+b_tracer_end_async(
+    B_BORROW struct B_Tracer *,
+    B_BORROW char const *category,
+    B_BORROW char const *name,
+    uint64_t id,
+    int64_t at_us);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <B/Attributes.h>
+#include <B/Error.h>
+#include <B/RunLoop.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Runs functions on a fixed set of threads, reporting
+// completion on a run loop's thread.  See NOTE[worker
+// threads].
+struct B_WorkerPool;
+
+// Called on a worker thread.  work_data is the pool's
+// copy of the data given to b_worker_pool_submit, and may
+// be modified.
+typedef B_FUNC bool
+B_WorkerPoolFunction(
+    B_BORROW void *work_data,
+    B_OUT struct B_Error *);
+
+// Called on the run loop's thread after the
+// B_WorkerPoolFunction returns, with the same work_data.
+// If the function failed, work_error is the error it
+// raised; otherwise, work_error.posix_error is 0.  If the
+// pool could not report the function's completion to the
+// run loop, work_error is why (see NOTE[worker threads]).
+typedef B_FUNC bool
+B_WorkerPoolCallback(
+    B_BORROW void *work_data,
+    struct B_Error work_error,
+    B_OUT struct B_Error *);
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Starts thread_count threads.  Callbacks are called by
+// run_loop, which must outlive the pool.
+B_WUR B_EXPORT_FUNC bool
+b_worker_pool_allocate(
+    B_BORROW struct B_RunLoop *run_loop,
+    size_t thread_count,
+    B_OUT_TRANSFER struct B_WorkerPool **,
+    B_OUT struct B_Error *);
+
+// Waits for running functions to return, then calls the
+// cancel callback of each function which has not started.
+// Callbacks of functions which returned are still called
+// by the run loop.
+B_WUR B_EXPORT_FUNC bool
+b_worker_pool_deallocate(
+    B_TRANSFER struct B_WorkerPool *,
+    B_OUT struct B_Error *);
+
+// Calls function on one of the pool's threads, then
+// callback on the run loop's thread.  Functions start in
+// the order they were submitted.  work_data is copied.
+//
+// If the function never runs (e.g. the pool is
+// deallocated first), or if the run loop is deallocated
+// before calling callback, cancel_callback is called
+// instead of callback.
+B_WUR B_EXPORT_FUNC bool
+b_worker_pool_submit(
+    B_BORROW struct B_WorkerPool *,
+    B_WorkerPoolFunction *function,
+    B_WorkerPoolCallback *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *work_data,
+    size_t work_data_size,
+    B_OUT struct B_Error *);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <B/Attributes.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct B_AnswerFuture;
+struct B_Error;
+struct B_QuestionKey;
+
+// A bounded in-memory cache mapping B_QuestionKey-s to
+// resolved B_AnswerFuture-s.  When full, inserting evicts
+// an entry using the CLOCK (second chance) policy.  See
+// NOTE[answer cache].
+struct B_AnswerCache;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+B_WUR B_EXPORT_FUNC bool
+b_answer_cache_allocate(
+    size_t capacity,
+    B_OUT_TRANSFER struct B_AnswerCache **,
+    B_OUT struct B_Error *);
+
+// Deallocates the cache, releasing its futures.
+B_EXPORT_FUNC void
+b_answer_cache_deallocate(
+    B_TRANSFER struct B_AnswerCache *);
+
+B_WUR B_EXPORT_FUNC size_t
+b_answer_cache_count(
+    B_BORROW struct B_AnswerCache const *);
+
+// Sets *out to a retained future for the key, or to NULL
+// if the key is not cached.
+B_EXPORT_FUNC void
+b_answer_cache_look_up(
+    B_BORROW struct B_AnswerCache *,
+    B_BORROW struct B_QuestionKey const *,
+    B_OUT_TRANSFER struct B_AnswerFuture **out);
+
+// Caches a resolved future, retaining it.  On success, the
+// cache takes ownership of the key.  If the key is already
+// cached, the cache is unchanged.
+B_WUR B_EXPORT_FUNC bool
+b_answer_cache_insert(
+    B_BORROW struct B_AnswerCache *,
+    B_TRANSFER struct B_QuestionKey *,
+    B_BORROW struct B_AnswerFuture *,
+    B_OUT struct B_Error *);
+
+// Removes the key's entry, releasing its future.  If the
+// key is not cached, the cache is unchanged.
+B_EXPORT_FUNC void
+b_answer_cache_remove(
+    B_BORROW struct B_AnswerCache *,
+    B_BORROW struct B_QuestionKey const *);
+
+#if defined(__cplusplus)
+}
+#endif
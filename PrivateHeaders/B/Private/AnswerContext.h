@@ -2,12 +2,15 @@
 
 #include <B/Attributes.h>
 #include <B/Private/AnswerFuture.h>
+#include <B/Process.h>
 
 #include <stdbool.h>
+#include <stdint.h>
 
 struct B_AnswerFuture;
 struct B_Database;
 struct B_IQuestion;
+struct B_MainNode;
 struct B_QuestionVTable;
 
 struct B_AnswerContext {
@@ -16,6 +19,32 @@ struct B_AnswerContext {
   struct B_IQuestion *question;
   struct B_QuestionVTable const *question_vtable;
   struct B_AnswerFuture *answer_future;
+  // The question in B_Main's in-flight dependency graph.
+  // Set by B_Main.  See NOTE[dependency cycles].
+  struct B_MainNode *main_node;
+  // Higher is more urgent.  Set by B_Main.  See
+  // NOTE[priorities].
+  int priority;
+  // Identifies the question in trace events.  Set by
+  // B_Main.  See NOTE[tracing].
+  uint64_t trace_id;
+
+  // Cost of answering the question so far.  Recorded in
+  // the database when the question is answered or fails.
+  // See NOTE[execution history] and NOTE[execution time].
+  int64_t started_at_ms;
+  // Zero until B_Main dispatches the question.
+  int64_t dispatched_at_monotonic_us;
+  // Waits (for needed questions or for a process queue)
+  // in progress, and when the first of them began.
+  size_t wait_count;
+  int64_t wait_started_at_monotonic_us;
+  // Time spent waiting, excluding waits in progress.
+  int64_t waited_us;
+  struct B_ProcessResourceUsage process_usage;
+  // Exit status of the most recent process which failed,
+  // or 0.
+  int64_t process_exit_status;
 };
 
 B_WUR B_EXPORT_FUNC bool
@@ -32,4 +61,10 @@ b_answer_context_deallocate(
     B_TRANSFER struct B_AnswerContext *,
     B_OUT struct B_Error *);
 
+// Called by B_Main just before it gives the answer
+// context to its callback.  See NOTE[execution time].
+B_EXPORT_FUNC void
+b_answer_context_mark_dispatched(
+    B_BORROW struct B_AnswerContext *);
+
 // For methods, see <B/AnswerContext.h>.
@@ -30,6 +30,14 @@
     B_BUG(); \
   } while (0)
 
+// Hints that cond is usually false, e.g. for checks of
+// optional hooks.
+#if B_CONFIG_BUILTIN_EXPECT
+# define B_UNLIKELY(cond) __builtin_expect(!!(cond), 0)
+#else
+# define B_UNLIKELY(cond) (cond)
+#endif
+
 #if B_CONFIG_C_STATIC_ASSERT
 # define B_STATIC_ASSERT(_cond, _message) \
   _Static_assert(_cond, _message)
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <B/Attributes.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct B_Error;
+
+enum {
+  // b_lz_decompress never produces more than
+  // B_LZ_MAX_EXPANSION bytes per byte of compressed data.
+  // (Each continuation byte of a match length adds at
+  // most 255 bytes of output.)  See NOTE[lz format].
+  B_LZ_MAX_EXPANSION = 255,
+};
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+// Compresses data_size bytes of data with a fast LZ77
+// codec.  See NOTE[lz format].
+//
+// If the compressed data would not fit in out_capacity
+// bytes, returns false.  Otherwise, writes the compressed
+// data to out, writes its size to out_size, and returns
+// true.
+//
+// Compression is deterministic: the same input always
+// produces the same output.
+B_WUR B_EXPORT_FUNC bool
+b_lz_compress(
+    B_BORROW uint8_t const *data,
+    size_t data_size,
+    B_OUT uint8_t *out,
+    size_t out_capacity,
+    B_OUT size_t *out_size);
+
+// Decompresses data produced by b_lz_compress into exactly
+// out_size bytes.  If the data is malformed or does not
+// decompress to exactly out_size bytes, raises EINVAL.
+B_WUR B_EXPORT_FUNC bool
+b_lz_decompress(
+    B_BORROW uint8_t const *data,
+    size_t data_size,
+    B_OUT uint8_t *out,
+    size_t out_size,
+    B_OUT struct B_Error *);
+
+#if defined(__cplusplus)
+}
+#endif
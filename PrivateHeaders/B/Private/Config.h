@@ -40,6 +40,28 @@
 # define B_CONFIG_EVENTFD 0
 #endif
 
+#if defined(__linux__)
+# define B_CONFIG_INOTIFY 1
+#else
+# define B_CONFIG_INOTIFY 0
+#endif
+
+#if defined(__APPLE__) || defined(__FreeBSD__) \
+  || defined(__linux__)
+// wait4 reports the resource usage of a reaped process.
+# define B_CONFIG_WAIT4 1
+#else
+# define B_CONFIG_WAIT4 0
+#endif
+
+#if defined(__APPLE__)
+// struct rusage's ru_maxrss is in bytes on OS X and in
+// kilobytes elsewhere.
+# define B_CONFIG_RUSAGE_MAXRSS_BYTES 1
+#else
+# define B_CONFIG_RUSAGE_MAXRSS_BYTES 0
+#endif
+
 #if defined(__APPLE__) || defined(__FreeBSD__)
 # define B_CONFIG_KQUEUE 1
 #else
@@ -52,3 +74,9 @@
 #else
 # define B_CONFIG_BROKEN_PSELECT 0
 #endif
+
+#if defined(__GNUC__)
+# define B_CONFIG_BUILTIN_EXPECT 1
+#else
+# define B_CONFIG_BUILTIN_EXPECT 0
+#endif
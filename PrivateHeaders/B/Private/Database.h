@@ -3,14 +3,33 @@
 #include <B/Attributes.h>
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 struct B_Error;
+struct B_ExecutionSummary;
 struct B_IAnswer;
 struct B_IQuestion;
 struct B_QuestionVTable;
 
 struct B_Database;
 
+// The cost of one attempt to answer a question.  See
+// NOTE[execution history].
+struct B_ExecutionRecord {
+  // Milliseconds since the Unix epoch.
+  int64_t started_at_ms;
+  // Time spent running, excluding waits.  See
+  // NOTE[execution time].
+  int64_t wall_time_us;
+  int64_t cpu_time_us;
+  int64_t peak_rss_bytes;
+  // Zero if the question was answered.
+  int64_t exit_status;
+  int64_t bytes_read;
+  int64_t bytes_written;
+};
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -24,6 +43,19 @@ b_database_record_dependency(
     B_BORROW struct B_QuestionVTable const *to_vtable,
     B_OUT struct B_Error *);
 
+// Like b_database_record_dependency, but records several
+// dependencies of one question in a single transaction.
+B_WUR B_EXPORT_FUNC bool
+b_database_record_dependencies(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *from,
+    B_BORROW struct B_QuestionVTable const *from_vtable,
+    B_BORROW struct B_IQuestion const *const *to,
+    B_BORROW struct B_QuestionVTable const *const *
+      to_vtables,
+    size_t to_count,
+    B_OUT struct B_Error *);
+
 B_WUR B_EXPORT_FUNC bool
 b_database_record_answer(
     B_BORROW struct B_Database *,
@@ -40,6 +72,44 @@ b_database_look_up_answer(
     B_OPTIONAL_OUT_TRANSFER struct B_IAnswer **,
     B_OUT struct B_Error *);
 
+// Like b_database_look_up_answer, but looks up several
+// questions in a single transaction.  out[i] is set to
+// the answer to questions[i], or to NULL if the question
+// has no answer.
+B_WUR B_EXPORT_FUNC bool
+b_database_look_up_answers(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t count,
+    B_OUT_TRANSFER struct B_IAnswer **out,
+    B_OUT struct B_Error *);
+
+// Like b_database_summarize_executions, but summarizes
+// several questions in a single transaction.  out[i] is
+// set to the summary of questions[i].
+B_WUR B_EXPORT_FUNC bool
+b_database_summarize_all_executions(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t count,
+    B_OUT struct B_ExecutionSummary *out,
+    B_OUT struct B_Error *);
+
+// Records an execution of the question, forgetting the
+// question's oldest execution if there are more than
+// B_EXECUTION_HISTORY_SIZE.
+B_WUR B_EXPORT_FUNC bool
+b_database_record_execution(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_BORROW struct B_ExecutionRecord const *,
+    B_OUT struct B_Error *);
+
 // For more methods, see <B/Database.h>.
 
 #if defined(__cplusplus)
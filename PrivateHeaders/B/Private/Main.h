@@ -2,10 +2,26 @@
 
 #include <B/Attributes.h>
 
+#include <stdbool.h>
+#include <stddef.h>
+
+struct B_AnswerContext;
+struct B_AnswerFuture;
+struct B_Error;
+struct B_IQuestion;
+struct B_MainObserver;
+struct B_ProcessQueue;
+struct B_QuestionVTable;
 struct B_RunLoop;
+struct B_Tracer;
+struct B_WorkerPool;
 
 struct B_Main;
 
+// A question in B_Main's in-flight dependency graph.  See
+// NOTE[dependency cycles].
+struct B_MainNode;
+
 #if defined(__cplusplus)
 extern "C" {
 #endif
@@ -14,6 +30,87 @@ B_WUR B_FUNC B_BORROW struct B_RunLoop *
 b_main_run_loop(
     B_BORROW struct B_Main *);
 
+// NULL if processes are not queued.
+B_WUR B_FUNC B_BORROW struct B_ProcessQueue *
+b_main_process_queue(
+    B_BORROW struct B_Main *);
+
+// The queue used if b_main_process_queue is NULL.  See
+// NOTE[cancellation].
+B_WUR B_FUNC B_BORROW struct B_ProcessQueue *
+b_main_unlimited_process_queue(
+    B_BORROW struct B_Main *);
+
+// See NOTE[cancellation].
+B_WUR B_FUNC bool
+b_main_cancelled(
+    B_BORROW struct B_Main *);
+
+// NULL if worker functions run on the run loop's thread.
+B_WUR B_FUNC B_BORROW struct B_WorkerPool *
+b_main_worker_pool(
+    B_BORROW struct B_Main *);
+
+// NULL if tracing is disabled.  See NOTE[tracing].
+B_WUR B_FUNC B_BORROW struct B_Tracer *
+b_main_tracer(
+    B_BORROW struct B_Main *);
+
+// Hooks given to b_main_set_observer.  Never NULL, but
+// each hook may be.  See NOTE[main observers].
+B_WUR B_FUNC B_BORROW struct B_MainObserver const *
+b_main_observer(
+    B_BORROW struct B_Main *,
+    B_OUT_BORROW void **opaque);
+
+// Like b_main_answer, but records that the answer
+// context's question depends upon the given question.  If
+// the dependency would complete a cycle, *out is a failed
+// future (with ELOOP) and the dependency is not recorded.
+// See NOTE[dependency cycles].
+//
+// The question is answered with at least the given
+// priority.  See NOTE[priorities].
+B_WUR B_FUNC bool
+b_main_need(
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_AnswerContext *,
+    B_BORROW struct B_IQuestion *,
+    B_BORROW struct B_QuestionVTable const *,
+    int priority,
+    B_OUT_TRANSFER struct B_AnswerFuture **out,
+    B_OUT struct B_Error *);
+
+// Like b_main_need, but for several questions.  out must
+// have room for count futures.  See NOTE[batched needs].
+B_WUR B_FUNC bool
+b_main_need_all(
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_AnswerContext *,
+    B_BORROW struct B_IQuestion *const *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t count,
+    int priority,
+    B_OUT_TRANSFER struct B_AnswerFuture **out,
+    B_OUT struct B_Error *);
+
+// Keeps the node's memory alive after its question is
+// answered, so a callback can safely ask whether the
+// question is still in flight.
+B_FUNC void
+b_main_node_retain(
+    B_BORROW struct B_MainNode *);
+
+B_FUNC void
+b_main_node_release(
+    B_TRANSFER struct B_MainNode *);
+
+// The node's question's answer context, or NULL if the
+// question was answered (or failed).
+B_WUR B_FUNC B_BORROW struct B_AnswerContext *
+b_main_node_answer_context(
+    B_BORROW struct B_MainNode *);
+
 // For more methods, see <B/Main.h>.
 
 #if defined(__cplusplus)
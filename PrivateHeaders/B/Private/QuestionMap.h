@@ -0,0 +1,95 @@
+#pragma once
+
+#include <B/Attributes.h>
+#include <B/UUID.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct B_Error;
+struct B_IQuestion;
+struct B_QuestionVTable;
+
+// A question's identity: its vtable's UUID and its
+// serialized form.  Two questions with equal keys are the
+// same question.
+struct B_QuestionKey {
+  struct B_UUID uuid;
+  uint8_t *data;
+  size_t data_size;
+  uint64_t hash;
+};
+
+// A hash table mapping B_QuestionKey-s to non-NULL values.
+// Values are borrowed; keys are owned by the map.
+struct B_QuestionMap;
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+B_WUR B_EXPORT_FUNC bool
+b_question_key_initialize(
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_OUT_TRANSFER struct B_QuestionKey *,
+    B_OUT struct B_Error *);
+
+B_EXPORT_FUNC void
+b_question_key_deinitialize(
+    B_TRANSFER struct B_QuestionKey *);
+
+B_WUR B_EXPORT_FUNC bool
+b_question_key_equal(
+    B_BORROW struct B_QuestionKey const *,
+    B_BORROW struct B_QuestionKey const *);
+
+B_WUR B_EXPORT_FUNC bool
+b_question_map_allocate(
+    B_OUT_TRANSFER struct B_QuestionMap **,
+    B_OUT struct B_Error *);
+
+// Deallocates the map and its keys.  Values are not
+// touched.
+B_EXPORT_FUNC void
+b_question_map_deallocate(
+    B_TRANSFER struct B_QuestionMap *);
+
+B_WUR B_EXPORT_FUNC size_t
+b_question_map_count(
+    B_BORROW struct B_QuestionMap const *);
+
+// Sets *out to the value for the key, or to NULL if the
+// key is not in the map.
+B_EXPORT_FUNC void
+b_question_map_find(
+    B_BORROW struct B_QuestionMap const *,
+    B_BORROW struct B_QuestionKey const *,
+    B_OUT_BORROW void **out);
+
+// Adds a key which is not in the map.  On success, the
+// map takes ownership of the key.
+B_WUR B_EXPORT_FUNC bool
+b_question_map_insert(
+    B_BORROW struct B_QuestionMap *,
+    B_TRANSFER struct B_QuestionKey *,
+    B_BORROW void *value,
+    B_OUT struct B_Error *);
+
+// Removes the key from the map, setting *out to its value.
+// If the key is not in the map, sets *out to NULL.
+//
+// If out_key is not NULL and the key was in the map,
+// ownership of the map's copy of the key is transferred to
+// *out_key.
+B_EXPORT_FUNC void
+b_question_map_remove(
+    B_BORROW struct B_QuestionMap *,
+    B_BORROW struct B_QuestionKey const *,
+    B_OUT_BORROW void **out,
+    B_OPTIONAL_OUT_TRANSFER struct B_QuestionKey *out_key);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -2,28 +2,48 @@
 
 #include <B/Attributes.h>
 #include <B/Private/Config.h>
+#include <B/Private/Mutex.h>
 #include <B/Private/Queue.h>
 #include <B/RunLoop.h>
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 struct B_Error;
 struct B_ProcessExitStatus;
+struct B_ProcessResourceUsage;
+struct rusage;
 
 struct B_RunLoopFunctionEntry;
+struct B_RunLoopTimerEntry;
 
-typedef B_SLIST_HEAD(, B_RunLoopFunctionEntry)
-B_RunLoopFunctionList;
+// Functions may be added from any thread (see
+// NOTE[worker threads]), but are run on the run loop's
+// thread.
+typedef struct {
+  struct B_Mutex lock;
+  B_SLIST_HEAD(, B_RunLoopFunctionEntry) entries;
+} B_RunLoopFunctionList;
+
+// Timers are added and run on the run loop's thread.
+// Entries are sorted by deadline.  Timers with the same
+// deadline run in the order they were added.
+typedef struct {
+  B_SLIST_HEAD(, B_RunLoopTimerEntry) entries;
+} B_RunLoopTimerList;
 
 #if defined(__cplusplus)
 extern "C" {
 #endif
 
-B_FUNC void
+B_WUR B_FUNC bool
 b_run_loop_function_list_initialize(
-    B_OUT_TRANSFER B_RunLoopFunctionList *);
+    B_OUT_TRANSFER B_RunLoopFunctionList *,
+    B_OUT struct B_Error *);
 
+// Calls the cancel callback of each function.  Errors are
+// ignored, since run loop deallocation cannot fail.
 B_FUNC void
 b_run_loop_function_list_deinitialize(
     B_BORROW struct B_RunLoop *,
@@ -38,11 +58,77 @@ b_run_loop_function_list_add_function(
     size_t callback_data_size,
     B_OUT struct B_Error *);
 
-B_FUNC void
+// Runs the first function, if any.  If the function
+// fails, raises its error; the function is not retried.
+B_WUR B_FUNC bool
 b_run_loop_function_list_run_one(
     B_BORROW struct B_RunLoop *,
     B_BORROW B_RunLoopFunctionList *,
-    B_OUT bool *keep_going);
+    B_OUT bool *keep_going,
+    B_OUT struct B_Error *);
+
+B_FUNC void
+b_run_loop_timer_list_initialize(
+    B_OUT_TRANSFER B_RunLoopTimerList *);
+
+// Calls the cancel callback of each timer.
+B_FUNC void
+b_run_loop_timer_list_deinitialize(
+    B_TRANSFER B_RunLoopTimerList *);
+
+// deadline_us is in the run loop's clock (e.g.
+// b_run_loop_now_us).
+B_WUR B_FUNC bool
+b_run_loop_timer_list_add_timer(
+    B_BORROW B_RunLoopTimerList *,
+    int64_t deadline_us,
+    B_TRANSFER B_RunLoopFunction *callback,
+    B_TRANSFER B_RunLoopFunction *cancel_callback,
+    B_TRANSFER void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *);
+
+// Sets *out_deadline_us to the earliest deadline and
+// returns true, or returns false if there are no timers.
+B_WUR B_FUNC bool
+b_run_loop_timer_list_next_deadline(
+    B_BORROW B_RunLoopTimerList const *,
+    B_OUT int64_t *out_deadline_us);
+
+// Milliseconds until the earliest deadline (rounded up),
+// or -1 if there are no timers, for poll.
+B_WUR B_FUNC int
+b_run_loop_timer_list_timeout_ms(
+    B_BORROW B_RunLoopTimerList const *,
+    int64_t now_us);
+
+// Runs each timer whose deadline is at or before now_us.
+// If a callback fails, the timers after it are left for a
+// later call.
+B_WUR B_FUNC bool
+b_run_loop_timer_list_run_due(
+    B_BORROW B_RunLoopTimerList *,
+    int64_t now_us,
+    B_OUT struct B_Error *);
+
+// The monotonic clock used for real run loops' timers.
+B_WUR B_FUNC int64_t
+b_run_loop_now_us(
+    void);
+
+// now_us plus delay_ms, saturating instead of overflowing.
+B_WUR B_FUNC int64_t
+b_run_loop_deadline_us(
+    int64_t now_us,
+    int64_t delay_ms);
+
+// Records the time since idle_start_us as a span if the
+// run loop has a tracer and waited long enough to matter.
+// See NOTE[tracing].
+B_FUNC void
+b_run_loop_trace_idle(
+    B_BORROW struct B_RunLoop *,
+    int64_t idle_start_us);
 
 #if B_CONFIG_POSIX_PROCESS
 B_WUR B_FUNC struct B_ProcessExitStatus
@@ -50,6 +136,12 @@ b_exit_status_from_waitpid_status(
     int waitpid_status);
 #endif
 
+#if B_CONFIG_WAIT4
+B_WUR B_FUNC struct B_ProcessResourceUsage
+b_process_resource_usage_from_rusage(
+    B_BORROW struct rusage const *);
+#endif
+
 #if defined(__cplusplus)
 }
 #endif
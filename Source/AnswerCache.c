@@ -0,0 +1,212 @@
+#include <B/AnswerFuture.h>
+#include <B/Error.h>
+#include <B/Memory.h>
+#include <B/Private/AnswerCache.h>
+#include <B/Private/Assertions.h>
+#include <B/Private/Memory.h>
+#include <B/Private/QuestionMap.h>
+
+struct B_AnswerCacheSlot_ {
+  // Owned by B_AnswerCache::map.  Meaningless if future is
+  // NULL.
+  struct B_QuestionKey key;
+  // NULL if the slot is empty.
+  struct B_AnswerFuture *future;
+  // Set when the slot is looked up; cleared when the clock
+  // hand passes over the slot.
+  bool referenced;
+};
+
+struct B_AnswerCache {
+  // Maps B_QuestionKey-s to B_AnswerCacheSlot_-s.
+  struct B_QuestionMap *map;
+  struct B_AnswerCacheSlot_ *slots;
+  size_t capacity;
+  // Slots [0, slot_count) are filled, except for slots
+  // emptied by b_answer_cache_remove.
+  size_t slot_count;
+  // Number of filled slots.
+  size_t count;
+  size_t hand;
+};
+
+// Picks the slot for a new entry.  If the cache is full,
+// the returned slot is filled and must be evicted.
+static B_FUNC struct B_AnswerCacheSlot_ *
+b_answer_cache_victim_(
+    B_BORROW struct B_AnswerCache *cache) {
+  B_PRECONDITION(cache);
+
+  if (cache->slot_count < cache->capacity) {
+    return &cache->slots[cache->slot_count];
+  }
+  for (;;) {
+    struct B_AnswerCacheSlot_ *slot
+      = &cache->slots[cache->hand];
+    cache->hand = (cache->hand + 1) % cache->capacity;
+    if (!slot->future) {
+      return slot;
+    } else if (slot->referenced) {
+      slot->referenced = false;
+    } else {
+      return slot;
+    }
+  }
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_answer_cache_allocate(
+    size_t capacity,
+    B_OUT_TRANSFER struct B_AnswerCache **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(capacity > 0);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_AnswerCache *cache = NULL;
+  struct B_QuestionMap *map = NULL;
+  struct B_AnswerCacheSlot_ *slots = NULL;
+  if (!b_allocate(sizeof(*cache), (void **) &cache, e)) {
+    goto fail;
+  }
+  if (!b_question_map_allocate(&map, e)) {
+    goto fail;
+  }
+  if (!b_allocate2(
+      sizeof(*slots), capacity, (void **) &slots, e)) {
+    goto fail;
+  }
+  for (size_t i = 0; i < capacity; ++i) {
+    slots[i].future = NULL;
+    slots[i].referenced = false;
+  }
+  *cache = (struct B_AnswerCache) {
+    .map = map,
+    .slots = slots,
+    .capacity = capacity,
+    .slot_count = 0,
+    .count = 0,
+    .hand = 0,
+  };
+  *out = cache;
+  return true;
+
+fail:
+  if (map) {
+    b_question_map_deallocate(map);
+  }
+  if (cache) {
+    b_deallocate(cache);
+  }
+  return false;
+}
+
+B_EXPORT_FUNC void
+b_answer_cache_deallocate(
+    B_TRANSFER struct B_AnswerCache *cache) {
+  B_PRECONDITION(cache);
+
+  for (size_t i = 0; i < cache->slot_count; ++i) {
+    if (cache->slots[i].future) {
+      b_answer_future_release(cache->slots[i].future);
+    }
+  }
+  b_question_map_deallocate(cache->map);
+  b_deallocate(cache->slots);
+  b_deallocate(cache);
+}
+
+B_WUR B_EXPORT_FUNC size_t
+b_answer_cache_count(
+    B_BORROW struct B_AnswerCache const *cache) {
+  B_PRECONDITION(cache);
+
+  return cache->count;
+}
+
+B_EXPORT_FUNC void
+b_answer_cache_look_up(
+    B_BORROW struct B_AnswerCache *cache,
+    B_BORROW struct B_QuestionKey const *key,
+    B_OUT_TRANSFER struct B_AnswerFuture **out) {
+  B_PRECONDITION(cache);
+  B_PRECONDITION(key);
+  B_OUT_PARAMETER(out);
+
+  void *value;
+  b_question_map_find(cache->map, key, &value);
+  if (!value) {
+    *out = NULL;
+    return;
+  }
+  struct B_AnswerCacheSlot_ *slot = value;
+  slot->referenced = true;
+  b_answer_future_retain(slot->future);
+  *out = slot->future;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_answer_cache_insert(
+    B_BORROW struct B_AnswerCache *cache,
+    B_TRANSFER struct B_QuestionKey *key,
+    B_BORROW struct B_AnswerFuture *future,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(cache);
+  B_PRECONDITION(key);
+  B_PRECONDITION(future);
+  B_OUT_PARAMETER(e);
+
+  void *existing;
+  b_question_map_find(cache->map, key, &existing);
+  if (existing) {
+    b_question_key_deinitialize(key);
+    return true;
+  }
+
+  struct B_AnswerCacheSlot_ *slot
+    = b_answer_cache_victim_(cache);
+  struct B_QuestionKey new_key = *key;
+  if (!b_question_map_insert(cache->map, key, slot, e)) {
+    return false;
+  }
+  if (slot->future) {
+    void *evicted;
+    b_question_map_remove(
+      cache->map, &slot->key, &evicted, NULL);
+    B_ASSERT(evicted == slot);
+    b_answer_future_release(slot->future);
+  } else {
+    if (slot == &cache->slots[cache->slot_count]) {
+      cache->slot_count += 1;
+    }
+    cache->count += 1;
+  }
+  b_answer_future_retain(future);
+  *slot = (struct B_AnswerCacheSlot_) {
+    .key = new_key,
+    .future = future,
+    .referenced = false,
+  };
+  return true;
+}
+
+B_EXPORT_FUNC void
+b_answer_cache_remove(
+    B_BORROW struct B_AnswerCache *cache,
+    B_BORROW struct B_QuestionKey const *key) {
+  B_PRECONDITION(cache);
+  B_PRECONDITION(key);
+
+  void *value;
+  b_question_map_remove(cache->map, key, &value, NULL);
+  if (!value) {
+    return;
+  }
+  // Leave a hole for b_answer_cache_victim_ to fill.
+  struct B_AnswerCacheSlot_ *slot = value;
+  b_answer_future_release(slot->future);
+  slot->future = NULL;
+  slot->referenced = false;
+  B_ASSERT(cache->count > 0);
+  cache->count -= 1;
+}
@@ -1,17 +1,176 @@
 #include <B/AnswerContext.h>
+#include <B/Database.h>
 #include <B/Error.h>
 #include <B/Main.h>
 #include <B/Memory.h>
 #include <B/Private/AnswerContext.h>
 #include <B/Private/Assertions.h>
+#include <B/Private/Callback.h>
 #include <B/Private/Database.h>
 #include <B/Private/Log.h>
 #include <B/Private/Memory.h>
+#include <B/ProcessQueue.h>
 #include <B/QuestionAnswer.h>
 #include <B/Private/Main.h>
+#include <B/Tracer.h>
+#include <B/WorkerPool.h>
 
 #include <errno.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// NOTE[execution time]: An execution's wall_time_us (see
+// NOTE[execution history]) is the time the question spent
+// running: from when B_Main dispatched it until it was
+// answered (or failed), minus the time it spent waiting
+// for the questions it needed and for a process queue to
+// start its processes.  It is thus the question's own
+// cost, excluding its dependencies' costs and time lost
+// to contention, so costs can be summed along a chain of
+// dependencies.  Overlapping waits are subtracted once.
+// Time spent waiting for a worker thread is not
+// subtracted.
+
+struct B_AnswerContextExecClosure_ {
+  struct B_AnswerContext *ac;
+  // Copied from ac, which the cancel callback must not
+  // touch.  See NOTE[tracing].
+  struct B_Tracer *tracer;
+  uint64_t trace_id;
+  B_RunLoopProcessFunction *callback;
+  B_RunLoopFunction *cancel_callback;
+  union B_UserData user_data;
+};
+
+struct B_AnswerContextNeedClosure_ {
+  struct B_Tracer *tracer;
+  uint64_t trace_id;
+};
+
+// See NOTE[execution time].
+struct B_AnswerContextNeedWaitClosure_ {
+  // Retained.  The answer context may finish before the
+  // needed question does.
+  struct B_MainNode *node;
+};
+
+struct B_AnswerContextWorkClosure_ {
+  struct B_AnswerContext *ac;
+  B_WorkerPoolFunction *function;
+  B_WorkerPoolCallback *callback;
+  B_RunLoopFunction *cancel_callback;
+  // CPU time used by function.  Written on the worker
+  // thread, and read on the run loop's thread after
+  // function returns.
+  int64_t cpu_time_us;
+  union B_UserData user_data;
+};
+
+static int64_t
+b_clock_us_(
+    clockid_t clock) {
+  struct timespec now;
+  int rc = clock_gettime(clock, &now);
+  // CLOCK_REALTIME and CLOCK_MONOTONIC are always
+  // supported.
+  B_ASSERT(rc == 0);
+  (void) rc;
+  return (int64_t) now.tv_sec * 1000000
+    + (int64_t) (now.tv_nsec / 1000);
+}
+
+// See NOTE[execution time].
+static B_FUNC void
+b_answer_context_begin_wait_(
+    B_BORROW struct B_AnswerContext *ac) {
+  B_PRECONDITION(ac);
+
+  if (ac->wait_count == 0) {
+    ac->wait_started_at_monotonic_us
+      = b_clock_us_(CLOCK_MONOTONIC);
+  }
+  ac->wait_count += 1;
+}
+
+static B_FUNC void
+b_answer_context_end_wait_(
+    B_BORROW struct B_AnswerContext *ac) {
+  B_PRECONDITION(ac);
+  B_PRECONDITION(ac->wait_count > 0);
+
+  ac->wait_count -= 1;
+  if (ac->wait_count == 0) {
+    ac->waited_us += b_clock_us_(CLOCK_MONOTONIC)
+      - ac->wait_started_at_monotonic_us;
+  }
+}
+
+// See NOTE[execution time].
+static int64_t
+b_answer_context_running_time_us_(
+    B_BORROW struct B_AnswerContext const *ac) {
+  B_PRECONDITION(ac);
+  B_PRECONDITION(ac->dispatched_at_monotonic_us != 0);
+
+  int64_t now_us = b_clock_us_(CLOCK_MONOTONIC);
+  int64_t waited_us = ac->waited_us;
+  if (ac->wait_count > 0) {
+    waited_us += now_us - ac->wait_started_at_monotonic_us;
+  }
+  int64_t running_us
+    = now_us - ac->dispatched_at_monotonic_us - waited_us;
+  return running_us > 0 ? running_us : 0;
+}
+
+// Returns false if there is nothing to record: the
+// question failed before being dispatched (e.g. because
+// B_Main was cancelled or found a cycle), so it never
+// executed.
+static B_WUR B_FUNC bool
+b_answer_context_execution_record_(
+    B_BORROW struct B_AnswerContext const *ac,
+    int64_t exit_status,
+    B_OUT struct B_ExecutionRecord *out) {
+  B_PRECONDITION(ac);
+  B_OUT_PARAMETER(out);
+
+  if (ac->dispatched_at_monotonic_us == 0) {
+    return false;
+  }
+  *out = (struct B_ExecutionRecord) {
+    .started_at_ms = ac->started_at_ms,
+    .wall_time_us = b_answer_context_running_time_us_(ac),
+    .cpu_time_us = ac->process_usage.cpu_time_us,
+    .peak_rss_bytes = ac->process_usage.peak_rss_bytes,
+    .exit_status = exit_status,
+    .bytes_read = ac->process_usage.bytes_read,
+    .bytes_written = ac->process_usage.bytes_written,
+  };
+  return true;
+}
+
+// Execution history is advisory (see NOTE[execution
+// time]), so failing to record it must not affect the
+// answer. Call after settling the answer future so waiters
+// are never left pending.
+static B_FUNC void
+b_answer_context_record_execution_(
+    B_BORROW struct B_AnswerContext *ac,
+    B_BORROW struct B_ExecutionRecord const *record) {
+  B_PRECONDITION(ac);
+  B_PRECONDITION(record);
+
+  if (!b_database_record_execution(
+      ac->database,
+      ac->question,
+      ac->question_vtable,
+      record,
+      &(struct B_Error) {.posix_error = 0})) {
+    // Ignore; see above.
+  }
+}
 
 B_WUR B_EXPORT_FUNC bool
 b_answer_context_allocate(
@@ -28,9 +187,10 @@ b_answer_context_allocate(
   B_OUT_PARAMETER(out);
   B_OUT_PARAMETER(e);
 
+  // See NOTE[question references].
   struct B_IQuestion *new_question;
-  if (!question_vtable->replicate(
-      question, &new_question, e)) {
+  if (!b_question_retain(
+      question, question_vtable, &new_question, e)) {
     return false;
   }
   struct B_AnswerContext *ac;
@@ -44,6 +204,21 @@ b_answer_context_allocate(
     .question = new_question,
     .question_vtable = question_vtable,
     // .answer_future
+    .main_node = NULL,
+    .priority = 0,
+    .trace_id = 0,
+    .started_at_ms = b_clock_us_(CLOCK_REALTIME) / 1000,
+    .dispatched_at_monotonic_us = 0,
+    .wait_count = 0,
+    .wait_started_at_monotonic_us = 0,
+    .waited_us = 0,
+    .process_usage = {
+      .cpu_time_us = 0,
+      .peak_rss_bytes = 0,
+      .bytes_read = 0,
+      .bytes_written = 0,
+    },
+    .process_exit_status = 0,
   };
   if (!b_answer_future_allocate_one(
       question_vtable->answer_vtable,
@@ -71,11 +246,22 @@ b_answer_context_deallocate(
   B_PRECONDITION(
     state == B_FUTURE_RESOLVED || state == B_FUTURE_FAILED);
   b_answer_future_release(ac->answer_future);
-  ac->question_vtable->deallocate(ac->question);
+  b_question_release(ac->question, ac->question_vtable);
   b_deallocate(ac);
   return true;
 }
 
+B_EXPORT_FUNC void
+b_answer_context_mark_dispatched(
+    B_BORROW struct B_AnswerContext *ac) {
+  B_PRECONDITION(ac);
+  B_PRECONDITION(ac->dispatched_at_monotonic_us == 0);
+
+  ac->started_at_ms = b_clock_us_(CLOCK_REALTIME) / 1000;
+  ac->dispatched_at_monotonic_us
+    = b_clock_us_(CLOCK_MONOTONIC);
+}
+
 B_WUR B_EXPORT_FUNC bool
 b_answer_context_question(
     B_BORROW struct B_AnswerContext *ac,
@@ -105,6 +291,386 @@ b_answer_context_run_loop(
   return true;
 }
 
+// See NOTE[tracing].
+static B_FUNC void
+b_answer_context_end_exec_trace_(
+    B_BORROW struct B_AnswerContextExecClosure_ const
+      *closure) {
+  B_PRECONDITION(closure);
+
+  if (closure->tracer) {
+    b_tracer_end_async(
+      closure->tracer,
+      "question",
+      "exec",
+      closure->trace_id,
+      b_tracer_now_us());
+  }
+}
+
+static B_FUNC bool
+b_answer_context_exec_callback_(
+    B_BORROW struct B_ProcessExitStatus const *exit_status,
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(exit_status);
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_AnswerContextExecClosure_ const *closure
+    = callback_data;
+  struct B_AnswerContext *ac = closure->ac;
+  b_answer_context_end_exec_trace_(closure);
+  struct B_ProcessResourceUsage const *usage
+    = &exit_status->usage;
+  ac->process_usage.cpu_time_us += usage->cpu_time_us;
+  if (usage->peak_rss_bytes
+      > ac->process_usage.peak_rss_bytes) {
+    ac->process_usage.peak_rss_bytes
+      = usage->peak_rss_bytes;
+  }
+  ac->process_usage.bytes_read += usage->bytes_read;
+  ac->process_usage.bytes_written += usage->bytes_written;
+  switch (exit_status->type) {
+  case B_PROCESS_EXIT_STATUS_CODE:
+    if (exit_status->u.code.exit_code != 0) {
+      ac->process_exit_status
+        = exit_status->u.code.exit_code;
+    }
+    break;
+  case B_PROCESS_EXIT_STATUS_SIGNAL:
+    // Mimic shells.
+    ac->process_exit_status
+      = 128 + exit_status->u.signal.signal_number;
+    break;
+  case B_PROCESS_EXIT_STATUS_EXCEPTION:
+    ac->process_exit_status
+      = (int64_t) exit_status->u.exception.code;
+    break;
+  }
+  void *observer_opaque;
+  struct B_MainObserver const *observer
+    = b_main_observer(ac->main, &observer_opaque);
+  if (B_UNLIKELY(observer->process_exited)) {
+    // See NOTE[main observers].
+    observer->process_exited(
+      observer_opaque,
+      ac->main,
+      ac->question,
+      ac->question_vtable,
+      exit_status);
+  }
+  // NOTE(strager): The callback may deallocate ac.
+  return closure->callback(
+    exit_status, closure->user_data.bytes, e);
+}
+
+static B_FUNC void
+b_answer_context_exec_start_callback_(
+    B_ProcessID process_id,
+    B_BORROW void const *callback_data) {
+  B_PRECONDITION(callback_data);
+
+  struct B_AnswerContextExecClosure_ const *closure
+    = callback_data;
+  struct B_AnswerContext *ac = closure->ac;
+  // The process is no longer queued.  See
+  // NOTE[execution time].
+  b_answer_context_end_wait_(ac);
+  void *observer_opaque;
+  struct B_MainObserver const *observer
+    = b_main_observer(ac->main, &observer_opaque);
+  if (B_UNLIKELY(observer->process_started)) {
+    // See NOTE[main observers].
+    observer->process_started(
+      observer_opaque,
+      ac->main,
+      ac->question,
+      ac->question_vtable,
+      process_id);
+  }
+}
+
+static B_FUNC bool
+b_answer_context_exec_cancel_callback_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_AnswerContextExecClosure_ const *closure
+    = callback_data;
+  b_answer_context_end_exec_trace_(closure);
+  return closure->cancel_callback(
+    closure->user_data.bytes, e);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_answer_context_exec_basic(
+    B_BORROW struct B_AnswerContext *ac,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  return b_answer_context_exec(
+    ac,
+    NULL,
+    command_args,
+    callback,
+    cancel_callback,
+    callback_data,
+    callback_data_size,
+    e);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_answer_context_exec(
+    B_BORROW struct B_AnswerContext *ac,
+    B_BORROW_OPTIONAL char const *pool_name,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(ac);
+  B_PRECONDITION(command_args);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(e);
+
+  if (b_main_cancelled(ac->main)) {
+    // See NOTE[cancellation].
+    *e = (struct B_Error) {.posix_error = ECANCELED};
+    return false;
+  }
+  struct B_ProcessQueue *queue
+    = b_main_process_queue(ac->main);
+  // The queue copies the closure, so the closure only
+  // needs to live until the exec call returns.
+  size_t closure_size = offsetof(
+    struct B_AnswerContextExecClosure_,
+    user_data.bytes[callback_data_size]);
+  struct B_AnswerContextExecClosure_ *closure;
+  if (!b_allocate(closure_size, (void **) &closure, e)) {
+    return false;
+  }
+  closure->ac = ac;
+  closure->tracer = b_main_tracer(ac->main);
+  closure->trace_id = ac->trace_id;
+  closure->callback = callback;
+  closure->cancel_callback = cancel_callback;
+  if (callback_data) {
+    memcpy(
+      closure->user_data.bytes,
+      callback_data,
+      callback_data_size);
+  }
+  // Estimate the process's memory use from the peak RSS
+  // of earlier executions.  See NOTE[memory budget].
+  int64_t memory_bytes = B_PROCESS_QUEUE_UNKNOWN_MEMORY;
+  if (queue) {
+    struct B_ExecutionSummary summary;
+    if (!b_database_summarize_executions(
+        ac->database,
+        ac->question,
+        ac->question_vtable,
+        &summary,
+        e)) {
+      b_deallocate(closure);
+      return false;
+    }
+    if (summary.max_peak_rss_bytes > 0) {
+      memory_bytes = summary.max_peak_rss_bytes;
+    }
+  } else {
+    // See NOTE[cancellation].
+    queue = b_main_unlimited_process_queue(ac->main);
+  }
+  if (closure->tracer) {
+    // Includes time spent queued.  See NOTE[tracing].
+    b_tracer_begin_async(
+      closure->tracer,
+      "question",
+      "exec",
+      ac->trace_id,
+      b_tracer_now_us(),
+      NULL);
+  }
+  // Time spent queued is not the question's cost.  See
+  // NOTE[execution time].
+  b_answer_context_begin_wait_(ac);
+  bool ok = b_process_queue_exec_with_start_callback(
+    queue,
+    pool_name,
+    memory_bytes,
+    ac->priority,
+    command_args,
+    b_answer_context_exec_start_callback_,
+    b_answer_context_exec_callback_,
+    b_answer_context_exec_cancel_callback_,
+    closure,
+    closure_size,
+    e);
+  if (!ok) {
+    b_answer_context_end_wait_(ac);
+    b_answer_context_end_exec_trace_(closure);
+  }
+  b_deallocate(closure);
+  return ok;
+}
+
+// Returns 0 if the calling thread's CPU clock is not
+// supported.
+static int64_t
+b_thread_cpu_time_us_(
+    void) {
+  struct timespec now;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0) {
+    return 0;
+  }
+  return (int64_t) now.tv_sec * 1000000
+    + (int64_t) (now.tv_nsec / 1000);
+}
+
+// Called on a worker thread.  See NOTE[worker threads].
+static B_FUNC bool
+b_answer_context_work_function_(
+    B_BORROW void *work_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(work_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_AnswerContextWorkClosure_ *closure
+    = *(struct B_AnswerContextWorkClosure_ **) work_data;
+  int64_t start_us = b_thread_cpu_time_us_();
+  bool ok = closure->function(
+    closure->user_data.bytes, e);
+  closure->cpu_time_us
+    = b_thread_cpu_time_us_() - start_us;
+  return ok;
+}
+
+static B_FUNC bool
+b_answer_context_work_callback_(
+    B_BORROW void *work_data,
+    struct B_Error work_error,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(work_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_AnswerContextWorkClosure_ *closure
+    = *(struct B_AnswerContextWorkClosure_ **) work_data;
+  closure->ac->process_usage.cpu_time_us
+    += closure->cpu_time_us;
+  // NOTE(strager): The callback may deallocate ac.
+  bool ok = closure->callback(
+    closure->user_data.bytes, work_error, e);
+  b_deallocate(closure);
+  return ok;
+}
+
+static B_FUNC bool
+b_answer_context_work_cancel_callback_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_AnswerContextWorkClosure_ *closure
+    = *(struct B_AnswerContextWorkClosure_ *const *)
+      callback_data;
+  bool ok = closure->cancel_callback(
+    closure->user_data.bytes, e);
+  b_deallocate(closure);
+  return ok;
+}
+
+// Used if the B_Main has no worker pool.
+static B_FUNC bool
+b_answer_context_work_inline_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_AnswerContextWorkClosure_ *closure
+    = *(struct B_AnswerContextWorkClosure_ *const *)
+      callback_data;
+  struct B_Error work_error = {.posix_error = 0};
+  if (!b_answer_context_work_function_(
+      &closure, &work_error)) {
+    // work_error is passed to the callback.
+  }
+  return b_answer_context_work_callback_(
+    &closure, work_error, e);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_answer_context_run_in_worker(
+    B_BORROW struct B_AnswerContext *ac,
+    B_WorkerPoolFunction *function,
+    B_WorkerPoolCallback *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *work_data,
+    size_t work_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(ac);
+  B_PRECONDITION(function);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(e);
+
+  // Unlike the exec closure, the work closure is shared
+  // between threads, so the pool (or run loop) copies a
+  // pointer to it.  The callbacks deallocate it.
+  size_t closure_size = offsetof(
+    struct B_AnswerContextWorkClosure_,
+    user_data.bytes[work_data_size]);
+  struct B_AnswerContextWorkClosure_ *closure;
+  if (!b_allocate(closure_size, (void **) &closure, e)) {
+    return false;
+  }
+  closure->ac = ac;
+  closure->function = function;
+  closure->callback = callback;
+  closure->cancel_callback = cancel_callback;
+  closure->cpu_time_us = 0;
+  if (work_data) {
+    memcpy(
+      closure->user_data.bytes,
+      work_data,
+      work_data_size);
+  }
+  struct B_WorkerPool *pool = b_main_worker_pool(ac->main);
+  bool ok;
+  if (pool) {
+    ok = b_worker_pool_submit(
+      pool,
+      b_answer_context_work_function_,
+      b_answer_context_work_callback_,
+      b_answer_context_work_cancel_callback_,
+      &closure,
+      sizeof(closure),
+      e);
+  } else {
+    ok = b_run_loop_add_function(
+      b_main_run_loop(ac->main),
+      b_answer_context_work_inline_,
+      b_answer_context_work_cancel_callback_,
+      &closure,
+      sizeof(closure),
+      e);
+  }
+  if (!ok) {
+    b_deallocate(closure);
+    return false;
+  }
+  return true;
+}
+
 B_WUR B_EXPORT_FUNC bool
 b_answer_context_need_one(
     B_BORROW struct B_AnswerContext *ac,
@@ -118,20 +684,13 @@ b_answer_context_need_one(
   B_OUT_PARAMETER(out);
   B_OUT_PARAMETER(e);
 
-  if (!b_database_record_dependency(
-      ac->database,
-      ac->question,
-      ac->question_vtable,
-      question,
-      question_vtable,
-      e)) {
-    return false;
-  }
   struct B_AnswerFuture *answer_future;
-  if (!b_main_answer(
+  if (!b_main_need(
       ac->main,
+      ac,
       question,
       question_vtable,
+      ac->priority,
       &answer_future,
       e)) {
     return false;
@@ -140,12 +699,54 @@ b_answer_context_need_one(
   return true;
 }
 
+static B_FUNC bool
+b_answer_context_need_callback_(
+    B_BORROW struct B_AnswerFuture *future,
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(future);
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_AnswerContextNeedClosure_ const *closure
+    = callback_data;
+  b_tracer_end_async(
+    closure->tracer,
+    "question",
+    "need",
+    closure->trace_id,
+    b_tracer_now_us());
+  return true;
+}
+
+// See NOTE[execution time].
+static B_FUNC bool
+b_answer_context_need_wait_callback_(
+    B_BORROW struct B_AnswerFuture *future,
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(future);
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_AnswerContextNeedWaitClosure_ const *closure
+    = callback_data;
+  struct B_AnswerContext *ac
+    = b_main_node_answer_context(closure->node);
+  if (ac) {
+    b_answer_context_end_wait_(ac);
+  }
+  b_main_node_release(closure->node);
+  return true;
+}
+
 B_WUR B_EXPORT_FUNC bool
-b_answer_context_need(
+b_answer_context_need_with_priority(
     B_BORROW struct B_AnswerContext *ac,
     B_BORROW struct B_IQuestion *const *questions,
     B_BORROW struct B_QuestionVTable const *const *vtables,
     size_t count,
+    int priority,
     B_OUT_TRANSFER struct B_AnswerFuture **out,
     B_OUT struct B_Error *e) {
   B_PRECONDITION(ac);
@@ -157,6 +758,8 @@ b_answer_context_need(
 
   bool ok;
   struct B_AnswerFuture **futures = NULL;
+  struct B_Tracer *tracer = b_main_tracer(ac->main);
+  bool traced = false;
 
   if (!b_allocate2(
       sizeof(*futures),
@@ -169,17 +772,74 @@ b_answer_context_need(
   for (size_t i = 0; i < count; ++i) {
     futures[i] = NULL;
   }
-  for (size_t i = 0; i < count; ++i) {
-    if (!b_answer_context_need_one(
-        ac, questions[i], vtables[i], &futures[i], e)) {
-      futures[i] = NULL;
-      goto fail;
-    }
+  if (tracer) {
+    // See NOTE[tracing].
+    b_tracer_begin_async(
+      tracer,
+      "question",
+      "need",
+      ac->trace_id,
+      b_tracer_now_us(),
+      &(struct B_TraceArg) {
+        .name = "count",
+        .string = NULL,
+        .string_size = 0,
+        .integer = (int64_t) count,
+      });
+    traced = true;
+  }
+  // See NOTE[batched needs].
+  if (!b_main_need_all(
+      ac->main,
+      ac,
+      questions,
+      vtables,
+      count,
+      priority,
+      futures,
+      e)) {
+    goto fail;
   }
   struct B_AnswerFuture *future;
   if (!b_answer_future_join(futures, count, &future, e)) {
     goto fail;
   }
+  // Callbacks are called most recently added first, so
+  // these end the wait before the joined future resolves.
+  // See NOTE[execution time].
+  for (size_t i = 0; i < count; ++i) {
+    struct B_AnswerContextNeedWaitClosure_ closure = {
+      .node = ac->main_node,
+    };
+    b_answer_context_begin_wait_(ac);
+    b_main_node_retain(closure.node);
+    if (!b_answer_future_add_callback(
+        futures[i],
+        b_answer_context_need_wait_callback_,
+        &closure,
+        sizeof(closure),
+        e)) {
+      b_main_node_release(closure.node);
+      b_answer_context_end_wait_(ac);
+      b_answer_future_release(future);
+      goto fail;
+    }
+  }
+  if (tracer) {
+    struct B_AnswerContextNeedClosure_ closure = {
+      .tracer = tracer,
+      .trace_id = ac->trace_id,
+    };
+    if (!b_answer_future_add_callback(
+        future,
+        b_answer_context_need_callback_,
+        &closure,
+        sizeof(closure),
+        e)) {
+      b_answer_future_release(future);
+      goto fail;
+    }
+  }
   for (size_t i = 0; i < count; ++i) {
     b_answer_future_release(futures[i]);
   }
@@ -198,10 +858,32 @@ done:
   return ok;
 
 fail:
+  if (traced) {
+    b_tracer_end_async(
+      tracer,
+      "question",
+      "need",
+      ac->trace_id,
+      b_tracer_now_us());
+  }
   ok = false;
   goto done;
 }
 
+B_WUR B_EXPORT_FUNC bool
+b_answer_context_need(
+    B_BORROW struct B_AnswerContext *ac,
+    B_BORROW struct B_IQuestion *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t count,
+    B_OUT_TRANSFER struct B_AnswerFuture **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(ac);
+
+  return b_answer_context_need_with_priority(
+    ac, questions, vtables, count, ac->priority, out, e);
+}
+
 B_WUR B_EXPORT_FUNC bool
 b_answer_context_succeed(
     B_TRANSFER struct B_AnswerContext *ac,
@@ -250,10 +932,16 @@ b_answer_context_succeed_answer(
   B_PRECONDITION(answer);
   B_OUT_PARAMETER(e);
 
+  struct B_ExecutionRecord record;
+  bool should_record = b_answer_context_execution_record_(
+    ac, 0, &record);
   if (!b_answer_future_resolve(
       ac->answer_future, answer, e)) {
     return false;
   }
+  if (should_record) {
+    b_answer_context_record_execution_(ac, &record);
+  }
   if (!b_answer_context_deallocate(ac, e)) {
     return false;
   }
@@ -268,9 +956,19 @@ b_answer_context_fail(
   B_PRECONDITION(ac);
   B_OUT_PARAMETER(e);
 
+  struct B_ExecutionRecord record;
+  bool should_record = b_answer_context_execution_record_(
+    ac,
+    ac->process_exit_status != 0
+      ? ac->process_exit_status
+      : error.posix_error,
+    &record);
   if (!b_answer_future_fail(ac->answer_future, error, e)) {
     return false;
   }
+  if (should_record) {
+    b_answer_context_record_execution_(ac, &record);
+  }
   if (!b_answer_context_deallocate(ac, e)) {
     return false;
   }
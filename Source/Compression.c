@@ -0,0 +1,313 @@
+// NOTE[lz format]: Compressed data is a series of
+// sequences.  Each sequence is:
+//
+//   token              1 byte: high nibble is the literal
+//                      length; low nibble is the match
+//                      length minus B_LZ_MIN_MATCH_
+//   literal length     optional; see below
+//   literals           literal length bytes
+//   match offset       2 bytes, little endian
+//   match length       optional; see below
+//
+// If a nibble is 15, the length continues in following
+// bytes: each byte is added to the length, stopping after
+// the first byte which is not 255.
+//
+// The final sequence has only a token, literals, and their
+// length.  Matches may overlap the bytes they produce
+// (i.e. offset may be smaller than the match length).
+//
+// The format is similar to LZ4's block format, but is not
+// compatible with it.
+
+#include <B/Error.h>
+#include <B/Private/Assertions.h>
+#include <B/Private/Compression.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+  B_LZ_MIN_MATCH_ = 4,
+  B_LZ_MAX_OFFSET_ = 0xFFFF,
+  B_LZ_NIBBLE_MAX_ = 15,
+  B_LZ_HASH_BITS_ = 12,
+};
+
+struct LZWriter_ {
+  uint8_t *cur;
+  uint8_t *end;
+};
+
+static uint32_t
+read_32_(
+    B_BORROW uint8_t const *data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+static size_t
+hash_32_(
+    uint32_t value) {
+  // Fibonacci hashing.
+  return (size_t) ((value * UINT32_C(2654435761))
+    >> (32 - B_LZ_HASH_BITS_));
+}
+
+static B_WUR bool
+write_byte_(
+    B_BORROW struct LZWriter_ *writer,
+    uint8_t byte) {
+  if (writer->cur == writer->end) {
+    return false;
+  }
+  *writer->cur++ = byte;
+  return true;
+}
+
+static B_WUR bool
+write_length_(
+    B_BORROW struct LZWriter_ *writer,
+    size_t length) {
+  while (length >= 255) {
+    if (!write_byte_(writer, 255)) {
+      return false;
+    }
+    length -= 255;
+  }
+  return write_byte_(writer, (uint8_t) length);
+}
+
+// Writes a sequence.  If match_length is 0, writes a final
+// sequence.
+static B_WUR bool
+write_sequence_(
+    B_BORROW struct LZWriter_ *writer,
+    B_BORROW uint8_t const *literals,
+    size_t literal_length,
+    size_t match_offset,
+    size_t match_length) {
+  size_t literal_nibble = literal_length < B_LZ_NIBBLE_MAX_
+    ? literal_length
+    : B_LZ_NIBBLE_MAX_;
+  size_t match_nibble = 0;
+  if (match_length > 0) {
+    B_ASSERT(match_length >= B_LZ_MIN_MATCH_);
+    match_nibble
+      = match_length - B_LZ_MIN_MATCH_ < B_LZ_NIBBLE_MAX_
+      ? match_length - B_LZ_MIN_MATCH_
+      : B_LZ_NIBBLE_MAX_;
+  }
+  if (!write_byte_(
+      writer,
+      (uint8_t) ((literal_nibble << 4) | match_nibble))) {
+    return false;
+  }
+  if (literal_nibble == B_LZ_NIBBLE_MAX_) {
+    if (!write_length_(
+        writer, literal_length - B_LZ_NIBBLE_MAX_)) {
+      return false;
+    }
+  }
+  if ((size_t) (writer->end - writer->cur)
+      < literal_length) {
+    return false;
+  }
+  memcpy(writer->cur, literals, literal_length);
+  writer->cur += literal_length;
+  if (match_length == 0) {
+    return true;
+  }
+
+  B_ASSERT(match_offset > 0);
+  B_ASSERT(match_offset <= B_LZ_MAX_OFFSET_);
+  if (!write_byte_(
+      writer, (uint8_t) (match_offset & 0xFF))) {
+    return false;
+  }
+  if (!write_byte_(writer, (uint8_t) (match_offset >> 8))) {
+    return false;
+  }
+  if (match_nibble == B_LZ_NIBBLE_MAX_) {
+    if (!write_length_(
+        writer,
+        match_length - B_LZ_MIN_MATCH_
+          - B_LZ_NIBBLE_MAX_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_lz_compress(
+    B_BORROW uint8_t const *data,
+    size_t data_size,
+    B_OUT uint8_t *out,
+    size_t out_capacity,
+    B_OUT size_t *out_size) {
+  B_PRECONDITION(data);
+  B_PRECONDITION(out);
+  B_OUT_PARAMETER(out_size);
+
+  struct LZWriter_ writer = {
+    .cur = out,
+    .end = out + out_capacity,
+  };
+
+  // Positions of recently-seen four-byte sequences, plus
+  // one.  Zero means no position.
+  size_t table[1 << B_LZ_HASH_BITS_];
+  memset(table, 0, sizeof(table));
+
+  size_t anchor = 0;
+  size_t i = 0;
+  while (i + B_LZ_MIN_MATCH_ <= data_size) {
+    uint32_t sequence = read_32_(&data[i]);
+    size_t hash = hash_32_(sequence);
+    size_t candidate_plus_one = table[hash];
+    table[hash] = i + 1;
+    if (candidate_plus_one == 0) {
+      i += 1;
+      continue;
+    }
+    size_t candidate = candidate_plus_one - 1;
+    B_ASSERT(candidate < i);
+    if (i - candidate > B_LZ_MAX_OFFSET_
+        || read_32_(&data[candidate]) != sequence) {
+      i += 1;
+      continue;
+    }
+
+    size_t match_length = B_LZ_MIN_MATCH_;
+    while (i + match_length < data_size
+        && data[candidate + match_length]
+          == data[i + match_length]) {
+      match_length += 1;
+    }
+    if (!write_sequence_(
+        &writer,
+        &data[anchor],
+        i - anchor,
+        i - candidate,
+        match_length)) {
+      return false;
+    }
+    i += match_length;
+    anchor = i;
+  }
+  if (!write_sequence_(
+      &writer,
+      &data[anchor],
+      data_size - anchor,
+      0,
+      0)) {
+    return false;
+  }
+
+  *out_size = (size_t) (writer.cur - out);
+  return true;
+}
+
+// Reads the continuation of a length.  See NOTE[lz format].
+static B_WUR bool
+read_length_(
+    B_BORROW uint8_t const **cur,
+    B_BORROW uint8_t const *end,
+    size_t limit,
+    B_IN_OUT size_t *length) {
+  for (;;) {
+    if (*cur == end) {
+      return false;
+    }
+    uint8_t byte = *(*cur)++;
+    *length += byte;
+    if (*length > limit) {
+      return false;
+    }
+    if (byte != 255) {
+      return true;
+    }
+  }
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_lz_decompress(
+    B_BORROW uint8_t const *data,
+    size_t data_size,
+    B_OUT uint8_t *out,
+    size_t out_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(data);
+  B_PRECONDITION(out);
+  B_OUT_PARAMETER(e);
+
+  uint8_t const *in_cur = data;
+  uint8_t const *in_end = data + data_size;
+  uint8_t *out_cur = out;
+  uint8_t *out_end = out + out_size;
+  for (;;) {
+    if (in_cur == in_end) {
+      goto malformed;
+    }
+    uint8_t token = *in_cur++;
+
+    size_t literal_length = (size_t) (token >> 4);
+    if (literal_length == B_LZ_NIBBLE_MAX_) {
+      if (!read_length_(
+          &in_cur, in_end, out_size, &literal_length)) {
+        goto malformed;
+      }
+    }
+    if ((size_t) (in_end - in_cur) < literal_length
+        || (size_t) (out_end - out_cur) < literal_length) {
+      goto malformed;
+    }
+    memcpy(out_cur, in_cur, literal_length);
+    in_cur += literal_length;
+    out_cur += literal_length;
+    if (in_cur == in_end) {
+      // Final sequence.
+      break;
+    }
+
+    if (in_end - in_cur < 2) {
+      goto malformed;
+    }
+    size_t match_offset = (size_t) in_cur[0]
+      | ((size_t) in_cur[1] << 8);
+    in_cur += 2;
+    if (match_offset == 0
+        || match_offset > (size_t) (out_cur - out)) {
+      goto malformed;
+    }
+    size_t match_length = (size_t) (token & 0x0F);
+    if (match_length == B_LZ_NIBBLE_MAX_) {
+      if (!read_length_(
+          &in_cur, in_end, out_size, &match_length)) {
+        goto malformed;
+      }
+    }
+    match_length += B_LZ_MIN_MATCH_;
+    if ((size_t) (out_end - out_cur) < match_length) {
+      goto malformed;
+    }
+    // The match may overlap the output, so copy
+    // byte-by-byte.
+    uint8_t const *match = out_cur - match_offset;
+    for (size_t j = 0; j < match_length; ++j) {
+      out_cur[j] = match[j];
+    }
+    out_cur += match_length;
+  }
+  if (out_cur != out_end) {
+    goto malformed;
+  }
+  return true;
+
+malformed:
+  *e = (struct B_Error) {.posix_error = EINVAL};
+  return false;
+}
@@ -0,0 +1,1078 @@
+// NOTE[daemon]: Each build pays to open the database,
+// prepare its statements, and fill B_Main's caches.  For a
+// no-op build, these costs dominate.  A B_Daemon keeps a
+// B_Database and a B_Main alive between builds, and thin
+// clients (b_daemon_client_answer) ask it questions over a
+// Unix-domain socket.
+//
+// Before answering a request, the daemon calls
+// b_database_check_all, then b_main_forget for each
+// invalidated question so B_Main's answer cache does not
+// hand out stale answers.  See NOTE[answer cache].
+//
+// If the daemon has a B_FileWatcher, it calls
+// b_database_check_changed instead, rechecking only the
+// B_FileQuestion-s whose files might have changed (and
+// those whose files were not watched yet).  Answers to
+// other questions are assumed to stay valid.  See
+// NOTE[file watcher].  Only answers recorded since the
+// previous request are listed to find files not watched
+// yet (see NOTE[answers mark]).
+//
+// The daemon answers one client at a time: it blocks in
+// accept() between requests, and runs the run loop while
+// answering a request.  (The run loop cannot watch file
+// descriptors, so the daemon cannot accept clients while
+// answering.)  Clients which connect while a request is
+// being answered wait in the listen backlog, so two
+// clients asking for the same question do not share its
+// answer context.
+
+// NOTE[daemon protocol]: Clients and the daemon exchange
+// messages over a stream socket.  Each message is a
+// one-byte type, then a four-byte big-endian payload size,
+// then the payload:
+//
+// * 'Q' (client to daemon): answer a question.  The
+//   payload is the question's 16-byte vtable UUID followed
+//   by the serialized question.
+// * 'S' (client to daemon): stop serving.  No payload.
+// * 'P' (daemon to client): progress.  The payload is a
+//   message to show to the user.
+// * 'R' (daemon to client): the request is done.  The
+//   payload is a one-byte B_DaemonResult_ followed by a
+//   four-byte big-endian POSIX error code (0 unless the
+//   result is B_DAEMON_RESULT_ERROR_).
+//
+// A connection carries one request.  After 'R' (or 'S'),
+// the daemon closes the connection.
+
+#include <B/AnswerFuture.h>
+#include <B/Daemon.h>
+#include <B/Database.h>
+#include <B/Error.h>
+#include <B/FileQuestion.h>
+#include <B/FileWatcher.h>
+#include <B/Main.h>
+#include <B/Memory.h>
+#include <B/Private/Assertions.h>
+#include <B/Private/Memory.h>
+#include <B/QuestionAnswer.h>
+#include <B/RunLoop.h>
+#include <B/UUID.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if defined(MSG_NOSIGNAL)
+# define B_DAEMON_SEND_FLAGS_ MSG_NOSIGNAL
+#else
+// SO_NOSIGPIPE is set on each socket instead.
+# define B_DAEMON_SEND_FLAGS_ 0
+#endif
+
+enum B_DaemonMessageType_ {
+  B_DAEMON_MESSAGE_REQUEST_ = 'Q',
+  B_DAEMON_MESSAGE_STOP_ = 'S',
+  B_DAEMON_MESSAGE_PROGRESS_ = 'P',
+  B_DAEMON_MESSAGE_RESULT_ = 'R',
+};
+
+enum B_DaemonResult_ {
+  B_DAEMON_RESULT_RESOLVED_ = 0,
+  B_DAEMON_RESULT_FAILED_ = 1,
+  // The daemon could not answer the question.
+  B_DAEMON_RESULT_ERROR_ = 2,
+};
+
+enum {
+  B_DAEMON_HEADER_SIZE_ = 5,
+  B_DAEMON_RESULT_SIZE_ = 5,
+  // Larger messages are rejected, in case the peer does
+  // not speak NOTE[daemon protocol].
+  B_DAEMON_MAX_PAYLOAD_SIZE_ = 16 * 1024 * 1024,
+  // How long the daemon waits for a client to send or
+  // receive data before dropping it.  The daemon answers
+  // one client at a time, so a stalled client would
+  // otherwise stall every other client.
+  B_DAEMON_CLIENT_TIMEOUT_S_ = 10,
+};
+
+struct B_Daemon {
+  struct B_Database *database;
+  struct B_Main *main;
+  struct B_RunLoop *run_loop;
+  struct B_QuestionVTable const *const *vtables;
+  size_t vtable_count;
+  // NULL if every answer is checked before each request.
+  struct B_FileWatcher *file_watcher;
+  // Answers to B_FileQuestion-s recorded before this mark
+  // are watched by file_watcher.  See NOTE[answers mark].
+  int64_t watched_answers_mark;
+  char *socket_path;
+  int listen_fd;
+  // -1 if no request is being answered, or if the client
+  // went away.
+  int client_fd;
+};
+
+static void
+b_daemon_encode_u32_(
+    uint32_t value,
+    B_OUT uint8_t *bytes) {
+  bytes[0] = (uint8_t) (value >> 24);
+  bytes[1] = (uint8_t) (value >> 16);
+  bytes[2] = (uint8_t) (value >> 8);
+  bytes[3] = (uint8_t) value;
+}
+
+static uint32_t
+b_daemon_decode_u32_(
+    B_BORROW uint8_t const *bytes) {
+  return ((uint32_t) bytes[0] << 24)
+    | ((uint32_t) bytes[1] << 16)
+    | ((uint32_t) bytes[2] << 8)
+    | (uint32_t) bytes[3];
+}
+
+// Keeps fd from leaking into processes started by the run
+// loop, and keeps writes to a closed peer from raising
+// SIGPIPE.  If accepted (i.e. fd is the daemon's end of a
+// client connection), also makes reads and writes fail
+// with EAGAIN after B_DAEMON_CLIENT_TIMEOUT_S_.
+static B_WUR B_FUNC bool
+b_daemon_configure_socket_(
+    int fd,
+    bool accepted,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(e);
+
+  int flags = fcntl(fd, F_GETFD);
+  if (flags == -1
+      || fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+#if defined(SO_NOSIGPIPE)
+  int on = 1;
+  if (setsockopt(
+      fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on))
+      == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+#endif
+  if (accepted) {
+    struct timeval timeout = {
+      .tv_sec = B_DAEMON_CLIENT_TIMEOUT_S_,
+      .tv_usec = 0,
+    };
+    int const options[] = {SO_RCVTIMEO, SO_SNDTIMEO};
+    for (size_t i = 0;
+        i < sizeof(options) / sizeof(*options);
+        ++i) {
+      if (setsockopt(
+          fd,
+          SOL_SOCKET,
+          options[i],
+          &timeout,
+          sizeof(timeout)) == -1) {
+        *e = (struct B_Error) {.posix_error = errno};
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_daemon_address_(
+    B_BORROW char const *socket_path,
+    B_OUT struct sockaddr_un *out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(socket_path);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  size_t length = strlen(socket_path);
+  if (length >= sizeof(out->sun_path)) {
+    *e = (struct B_Error) {.posix_error = ENAMETOOLONG};
+    return false;
+  }
+  memset(out, 0, sizeof(*out));
+  out->sun_family = AF_UNIX;
+  memcpy(out->sun_path, socket_path, length + 1);
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_daemon_socket_(
+    B_OUT int *out,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+  if (!b_daemon_configure_socket_(fd, false, e)) {
+    (void) close(fd);
+    return false;
+  }
+  *out = fd;
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_daemon_connect_(
+    B_BORROW char const *socket_path,
+    B_OUT int *out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(socket_path);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct sockaddr_un address;
+  if (!b_daemon_address_(socket_path, &address, e)) {
+    return false;
+  }
+  int fd;
+  if (!b_daemon_socket_(&fd, e)) {
+    return false;
+  }
+  if (connect(
+      fd, (struct sockaddr const *) &address,
+      sizeof(address)) == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    (void) close(fd);
+    return false;
+  }
+  *out = fd;
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_daemon_write_all_(
+    int fd,
+    B_BORROW uint8_t const *data,
+    size_t size,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(e);
+
+  while (size > 0) {
+    ssize_t rc = send(fd, data, size, B_DAEMON_SEND_FLAGS_);
+    if (rc == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      *e = (struct B_Error) {.posix_error = errno};
+      return false;
+    }
+    data += rc;
+    size -= (size_t) rc;
+  }
+  return true;
+}
+
+// If the peer closes the connection before size bytes are
+// read, raises ECONNRESET.
+static B_WUR B_FUNC bool
+b_daemon_read_all_(
+    int fd,
+    B_OUT uint8_t *data,
+    size_t size,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(e);
+
+  while (size > 0) {
+    ssize_t rc = read(fd, data, size);
+    if (rc == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      *e = (struct B_Error) {.posix_error = errno};
+      return false;
+    }
+    if (rc == 0) {
+      *e = (struct B_Error) {.posix_error = ECONNRESET};
+      return false;
+    }
+    data += rc;
+    size -= (size_t) rc;
+  }
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_daemon_send_message_(
+    int fd,
+    enum B_DaemonMessageType_ type,
+    B_BORROW uint8_t const *payload,
+    size_t payload_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(payload || payload_size == 0);
+  B_OUT_PARAMETER(e);
+
+  if (payload_size > B_DAEMON_MAX_PAYLOAD_SIZE_) {
+    *e = (struct B_Error) {.posix_error = EMSGSIZE};
+    return false;
+  }
+  uint8_t header[B_DAEMON_HEADER_SIZE_];
+  header[0] = (uint8_t) type;
+  b_daemon_encode_u32_((uint32_t) payload_size, &header[1]);
+  if (!b_daemon_write_all_(fd, header, sizeof(header), e)) {
+    return false;
+  }
+  return b_daemon_write_all_(fd, payload, payload_size, e);
+}
+
+// *out_payload is NUL-terminated (after payload_size
+// bytes) and must be deallocated with b_deallocate.
+static B_WUR B_FUNC bool
+b_daemon_receive_message_(
+    int fd,
+    B_OUT enum B_DaemonMessageType_ *out_type,
+    B_OUT_TRANSFER uint8_t **out_payload,
+    B_OUT size_t *out_payload_size,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(out_type);
+  B_OUT_PARAMETER(out_payload);
+  B_OUT_PARAMETER(out_payload_size);
+  B_OUT_PARAMETER(e);
+
+  uint8_t header[B_DAEMON_HEADER_SIZE_];
+  if (!b_daemon_read_all_(fd, header, sizeof(header), e)) {
+    return false;
+  }
+  uint32_t payload_size = b_daemon_decode_u32_(&header[1]);
+  if (payload_size > B_DAEMON_MAX_PAYLOAD_SIZE_) {
+    *e = (struct B_Error) {.posix_error = EMSGSIZE};
+    return false;
+  }
+  uint8_t *payload;
+  if (!b_allocate(
+      (size_t) payload_size + 1, (void **) &payload, e)) {
+    return false;
+  }
+  if (!b_daemon_read_all_(fd, payload, payload_size, e)) {
+    b_deallocate(payload);
+    return false;
+  }
+  payload[payload_size] = '\0';
+  *out_type = (enum B_DaemonMessageType_) header[0];
+  *out_payload = payload;
+  *out_payload_size = payload_size;
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_daemon_send_result_(
+    int fd,
+    enum B_DaemonResult_ result,
+    int posix_error,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(e);
+
+  uint8_t payload[B_DAEMON_RESULT_SIZE_];
+  payload[0] = (uint8_t) result;
+  b_daemon_encode_u32_((uint32_t) posix_error, &payload[1]);
+  return b_daemon_send_message_(
+    fd,
+    B_DAEMON_MESSAGE_RESULT_,
+    payload,
+    sizeof(payload),
+    e);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_daemon_allocate(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_RunLoop *run_loop,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW char const *socket_path,
+    B_OUT_TRANSFER struct B_Daemon **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(main);
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(socket_path);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_Daemon *daemon = NULL;
+  char *path = NULL;
+  int fd = -1;
+  struct sockaddr_un address;
+  if (!b_daemon_address_(socket_path, &address, e)) {
+    goto fail;
+  }
+  if (!b_strdup(socket_path, &path, e)) {
+    path = NULL;
+    goto fail;
+  }
+  if (!b_daemon_socket_(&fd, e)) {
+    fd = -1;
+    goto fail;
+  }
+  if (bind(
+      fd, (struct sockaddr const *) &address,
+      sizeof(address)) == -1) {
+    if (errno != EADDRINUSE) {
+      *e = (struct B_Error) {.posix_error = errno};
+      goto fail;
+    }
+    // The socket file might have been left behind by a
+    // daemon which crashed.  If nobody is listening,
+    // replace it.
+    int other_fd;
+    struct B_Error connect_error;
+    if (b_daemon_connect_(
+        socket_path, &other_fd, &connect_error)) {
+      (void) close(other_fd);
+      *e = (struct B_Error) {.posix_error = EADDRINUSE};
+      goto fail;
+    }
+    if (connect_error.posix_error != ECONNREFUSED) {
+      *e = (struct B_Error) {.posix_error = EADDRINUSE};
+      goto fail;
+    }
+    if (unlink(socket_path) == -1
+        || bind(
+          fd, (struct sockaddr const *) &address,
+          sizeof(address)) == -1) {
+      *e = (struct B_Error) {.posix_error = errno};
+      goto fail;
+    }
+  }
+  if (listen(fd, SOMAXCONN) == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    (void) unlink(socket_path);
+    goto fail;
+  }
+  if (!b_allocate(sizeof(*daemon), (void **) &daemon, e)) {
+    (void) unlink(socket_path);
+    goto fail;
+  }
+  *daemon = (struct B_Daemon) {
+    .database = database,
+    .main = main,
+    .run_loop = run_loop,
+    .vtables = vtables,
+    .vtable_count = vtable_count,
+    .file_watcher = NULL,
+    .watched_answers_mark = 0,
+    .socket_path = path,
+    .listen_fd = fd,
+    .client_fd = -1,
+  };
+  *out = daemon;
+  return true;
+
+fail:
+  if (fd != -1) {
+    (void) close(fd);
+  }
+  if (path) {
+    b_deallocate(path);
+  }
+  return false;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_daemon_deallocate(
+    B_TRANSFER struct B_Daemon *daemon,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(daemon);
+  B_PRECONDITION(daemon->client_fd == -1);
+  B_OUT_PARAMETER(e);
+
+  bool ok = true;
+  if (unlink(daemon->socket_path) == -1
+      && errno != ENOENT) {
+    *e = (struct B_Error) {.posix_error = errno};
+    ok = false;
+  }
+  (void) close(daemon->listen_fd);
+  b_deallocate(daemon->socket_path);
+  b_deallocate(daemon);
+  return ok;
+}
+
+B_EXPORT_FUNC void
+b_daemon_set_file_watcher(
+    B_BORROW struct B_Daemon *daemon,
+    B_BORROW_OPTIONAL struct B_FileWatcher *watcher) {
+  B_PRECONDITION(daemon);
+
+  daemon->file_watcher = watcher;
+  daemon->watched_answers_mark = 0;
+}
+
+// Paths of B_FileQuestion-s to recheck.
+struct B_DaemonPaths_ {
+  char **paths;
+  size_t count;
+  size_t capacity;
+  struct B_FileWatcher *file_watcher;
+};
+
+static B_FUNC bool
+b_daemon_add_path_(
+    B_BORROW void *opaque,
+    B_BORROW char const *file_path,
+    B_OUT struct B_Error *e) {
+  struct B_DaemonPaths_ *paths = opaque;
+  if (paths->count == paths->capacity) {
+    size_t capacity
+      = paths->capacity ? paths->capacity * 2 : 16;
+    char **new_paths;
+    bool ok;
+    if (paths->paths) {
+      ok = b_reallocate(
+        paths->paths,
+        sizeof(*new_paths) * capacity,
+        (void **) &new_paths,
+        e);
+    } else {
+      ok = b_allocate2(
+        sizeof(*new_paths),
+        capacity,
+        (void **) &new_paths,
+        e);
+    }
+    if (!ok) {
+      return false;
+    }
+    paths->paths = new_paths;
+    paths->capacity = capacity;
+  }
+  if (!b_strdup(
+      file_path, &paths->paths[paths->count], e)) {
+    return false;
+  }
+  paths->count += 1;
+  return true;
+}
+
+static B_FUNC bool
+b_daemon_watch_question_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *vtable,
+    B_OUT struct B_Error *e) {
+  (void) vtable;
+  struct B_DaemonPaths_ *paths = opaque;
+  char const *file_path;
+  if (!b_file_question_path(question, &file_path, e)) {
+    return false;
+  }
+  bool added;
+  if (!b_file_watcher_watch(
+      paths->file_watcher, file_path, &added, e)) {
+    return false;
+  }
+  // The file might have changed before it was watched.
+  if (added) {
+    return b_daemon_add_path_(paths, file_path, e);
+  }
+  return true;
+}
+
+// Rechecks answers which might be out of date.  See
+// NOTE[daemon].
+static B_WUR B_FUNC bool
+b_daemon_check_(
+    B_BORROW struct B_Daemon *daemon,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(daemon);
+  B_OUT_PARAMETER(e);
+
+  if (!daemon->file_watcher) {
+    return b_database_check_all(
+      daemon->database,
+      daemon->vtables,
+      daemon->vtable_count,
+      e);
+  }
+
+  struct B_QuestionVTable const *file_vtable
+    = b_file_question_vtable();
+  struct B_DaemonPaths_ paths = {
+    .paths = NULL,
+    .count = 0,
+    .capacity = 0,
+    .file_watcher = daemon->file_watcher,
+  };
+  struct B_QuestionVTable const **vtables = NULL;
+  bool ok = false;
+  bool overflowed;
+  if (!b_file_watcher_take_changes(
+      daemon->file_watcher,
+      b_daemon_add_path_,
+      &paths,
+      &overflowed,
+      e)) {
+    goto done;
+  }
+  // Watch files of questions answered since the last
+  // request.  Earlier answers' files are already watched.
+  if (!b_database_answered_questions_since(
+      daemon->database,
+      daemon->watched_answers_mark,
+      &file_vtable,
+      1,
+      b_daemon_watch_question_,
+      &paths,
+      e)) {
+    goto done;
+  }
+  if (overflowed) {
+    ok = b_database_check_all(
+      daemon->database,
+      daemon->vtables,
+      daemon->vtable_count,
+      e);
+    goto done;
+  }
+  if (paths.count > 0) {
+    if (!b_allocate2(
+        sizeof(*vtables),
+        paths.count,
+        (void **) &vtables,
+        e)) {
+      vtables = NULL;
+      goto done;
+    }
+    for (size_t i = 0; i < paths.count; ++i) {
+      vtables[i] = file_vtable;
+    }
+  }
+  ok = b_database_check_changed(
+    daemon->database,
+    (struct B_IQuestion const *const *) paths.paths,
+    vtables,
+    paths.count,
+    daemon->vtables,
+    daemon->vtable_count,
+    e);
+
+done:
+  // Checking deletes answers, so take the mark afterwards.
+  // See NOTE[answers mark].
+  if (ok) {
+    ok = b_database_answers_mark(
+      daemon->database, &daemon->watched_answers_mark, e);
+  }
+  if (vtables) {
+    b_deallocate(vtables);
+  }
+  for (size_t i = 0; i < paths.count; ++i) {
+    b_deallocate(paths.paths[i]);
+  }
+  if (paths.paths) {
+    b_deallocate(paths.paths);
+  }
+  return ok;
+}
+
+static B_FUNC bool
+b_daemon_forget_invalidation_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Invalidation const *invalidation,
+    B_OUT struct B_Error *e) {
+  struct B_Main *main = opaque;
+  return b_main_forget(
+    main,
+    invalidation->question,
+    invalidation->question_vtable,
+    e);
+}
+
+static B_FUNC bool
+b_daemon_request_answered_(
+    B_BORROW struct B_AnswerFuture *future,
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *e) {
+  (void) future;
+  struct B_RunLoop *run_loop
+    = *(struct B_RunLoop *const *) opaque;
+  return b_run_loop_stop(run_loop, e);
+}
+
+// Answers a 'Q' request.  See NOTE[daemon protocol].
+static B_WUR B_FUNC bool
+b_daemon_answer_(
+    B_BORROW struct B_Daemon *daemon,
+    B_BORROW uint8_t const *payload,
+    size_t payload_size,
+    B_OUT enum B_AnswerFutureState *out_state,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(daemon);
+  B_PRECONDITION(payload);
+  B_OUT_PARAMETER(out_state);
+  B_OUT_PARAMETER(e);
+
+  struct B_UUID uuid;
+  if (payload_size < sizeof(uuid.data)) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    return false;
+  }
+  memcpy(uuid.data, payload, sizeof(uuid.data));
+  struct B_QuestionVTable const *vtable = NULL;
+  for (size_t i = 0; i < daemon->vtable_count; ++i) {
+    if (b_uuid_equal(&daemon->vtables[i]->uuid, &uuid)) {
+      vtable = daemon->vtables[i];
+      break;
+    }
+  }
+  if (!vtable) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    return false;
+  }
+
+  if (!b_daemon_check_(daemon, e)) {
+    return false;
+  }
+  if (!b_database_invalidations(
+      daemon->database,
+      daemon->vtables,
+      daemon->vtable_count,
+      b_daemon_forget_invalidation_,
+      daemon->main,
+      e)) {
+    return false;
+  }
+
+  struct B_IQuestion *question;
+  if (!b_question_deserialize_from_memory(
+      vtable,
+      payload + sizeof(uuid.data),
+      payload_size - sizeof(uuid.data),
+      &question,
+      e)) {
+    return false;
+  }
+  struct B_AnswerFuture *future = NULL;
+  if (!b_main_answer(
+      daemon->main, question, vtable, &future, e)) {
+    future = NULL;
+    goto fail;
+  }
+  enum B_AnswerFutureState state;
+  if (!b_answer_future_state(future, &state, e)) {
+    goto fail;
+  }
+  if (state == B_FUTURE_PENDING) {
+    if (!b_answer_future_add_callback(
+        future,
+        b_daemon_request_answered_,
+        &daemon->run_loop,
+        sizeof(daemon->run_loop),
+        e)) {
+      goto fail;
+    }
+  }
+  while (state == B_FUTURE_PENDING) {
+    if (!b_run_loop_run(daemon->run_loop, e)) {
+      goto fail;
+    }
+    if (!b_answer_future_state(future, &state, e)) {
+      goto fail;
+    }
+  }
+  b_answer_future_release(future);
+  vtable->deallocate(question);
+  *out_state = state;
+  return true;
+
+fail:
+  if (future) {
+    b_answer_future_release(future);
+  }
+  vtable->deallocate(question);
+  return false;
+}
+
+// Errors talking to the client (including timeouts; see
+// B_DAEMON_CLIENT_TIMEOUT_S_) are not reported; the client
+// is dropped instead.
+static B_WUR B_FUNC bool
+b_daemon_serve_client_(
+    B_BORROW struct B_Daemon *daemon,
+    int fd,
+    B_OUT bool *out_stop,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(daemon);
+  B_OUT_PARAMETER(out_stop);
+  B_OUT_PARAMETER(e);
+
+  enum B_DaemonMessageType_ type;
+  uint8_t *payload;
+  size_t payload_size;
+  struct B_Error client_error;
+  if (!b_daemon_receive_message_(
+      fd, &type, &payload, &payload_size, &client_error)) {
+    *out_stop = false;
+    return true;
+  }
+  switch (type) {
+  case B_DAEMON_MESSAGE_STOP_:
+    b_deallocate(payload);
+    *out_stop = true;
+    return true;
+  case B_DAEMON_MESSAGE_REQUEST_:
+    break;
+  case B_DAEMON_MESSAGE_PROGRESS_:
+  case B_DAEMON_MESSAGE_RESULT_:
+  default:
+    b_deallocate(payload);
+    *out_stop = false;
+    return true;
+  }
+
+  daemon->client_fd = fd;
+  enum B_AnswerFutureState state;
+  struct B_Error answer_error;
+  bool answered = b_daemon_answer_(
+    daemon, payload, payload_size, &state, &answer_error);
+  b_deallocate(payload);
+  enum B_DaemonResult_ result;
+  int posix_error = 0;
+  if (!answered) {
+    result = B_DAEMON_RESULT_ERROR_;
+    posix_error = answer_error.posix_error;
+  } else if (state == B_FUTURE_RESOLVED) {
+    result = B_DAEMON_RESULT_RESOLVED_;
+  } else {
+    B_ASSERT(state == B_FUTURE_FAILED);
+    result = B_DAEMON_RESULT_FAILED_;
+  }
+  if (daemon->client_fd != -1) {
+    if (!b_daemon_send_result_(
+        fd, result, posix_error, &client_error)) {
+      // Client went away.
+    }
+  }
+  daemon->client_fd = -1;
+  *out_stop = false;
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_daemon_serve(
+    B_BORROW struct B_Daemon *daemon,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(daemon);
+  B_OUT_PARAMETER(e);
+
+  for (;;) {
+    int fd = accept(daemon->listen_fd, NULL, NULL);
+    if (fd == -1) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        // EINTR is likely SIGCHLD.
+        continue;
+      }
+      *e = (struct B_Error) {.posix_error = errno};
+      return false;
+    }
+    bool stop;
+    bool ok = b_daemon_configure_socket_(fd, true, e)
+      && b_daemon_serve_client_(daemon, fd, &stop, e);
+    (void) close(fd);
+    if (!ok) {
+      return false;
+    }
+    if (stop) {
+      return true;
+    }
+  }
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_daemon_report_progress(
+    B_BORROW struct B_Daemon *daemon,
+    B_BORROW char const *message,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(daemon);
+  B_PRECONDITION(message);
+  B_OUT_PARAMETER(e);
+
+  if (daemon->client_fd == -1) {
+    return true;
+  }
+  struct B_Error client_error;
+  if (!b_daemon_send_message_(
+      daemon->client_fd,
+      B_DAEMON_MESSAGE_PROGRESS_,
+      (uint8_t const *) message,
+      strlen(message),
+      &client_error)) {
+    // Client went away.  Keep answering the question so
+    // the answer is recorded for the next client.
+    daemon->client_fd = -1;
+  }
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_daemon_client_answer(
+    B_BORROW char const *socket_path,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *vtable,
+    B_BORROW_OPTIONAL B_DaemonProgressCallback *
+      progress_callback,
+    B_BORROW void *progress_callback_opaque,
+    B_OUT enum B_AnswerFutureState *out_state,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(socket_path);
+  B_PRECONDITION(question);
+  B_PRECONDITION(vtable);
+  B_OUT_PARAMETER(out_state);
+  B_OUT_PARAMETER(e);
+
+  int fd = -1;
+  uint8_t *question_data = NULL;
+  uint8_t *request = NULL;
+  uint8_t *payload = NULL;
+  size_t question_size;
+  if (!b_question_serialize_to_memory(
+      question,
+      vtable,
+      &question_data,
+      &question_size,
+      e)) {
+    question_data = NULL;
+    goto fail;
+  }
+  size_t request_size
+    = sizeof(vtable->uuid.data) + question_size;
+  if (!b_allocate(request_size, (void **) &request, e)) {
+    request = NULL;
+    goto fail;
+  }
+  memcpy(
+    request, vtable->uuid.data, sizeof(vtable->uuid.data));
+  memcpy(
+    request + sizeof(vtable->uuid.data),
+    question_data,
+    question_size);
+
+  if (!b_daemon_connect_(socket_path, &fd, e)) {
+    fd = -1;
+    goto fail;
+  }
+  if (!b_daemon_send_message_(
+      fd,
+      B_DAEMON_MESSAGE_REQUEST_,
+      request,
+      request_size,
+      e)) {
+    goto fail;
+  }
+  for (;;) {
+    enum B_DaemonMessageType_ type;
+    size_t payload_size;
+    if (!b_daemon_receive_message_(
+        fd, &type, &payload, &payload_size, e)) {
+      payload = NULL;
+      goto fail;
+    }
+    if (type == B_DAEMON_MESSAGE_PROGRESS_) {
+      if (progress_callback) {
+        if (!progress_callback(
+            progress_callback_opaque,
+            (char const *) payload,
+            e)) {
+          goto fail;
+        }
+      }
+      b_deallocate(payload);
+      payload = NULL;
+      continue;
+    }
+    if (type != B_DAEMON_MESSAGE_RESULT_
+        || payload_size != B_DAEMON_RESULT_SIZE_) {
+      *e = (struct B_Error) {.posix_error = EPROTO};
+      goto fail;
+    }
+    switch (payload[0]) {
+    case B_DAEMON_RESULT_RESOLVED_:
+      *out_state = B_FUTURE_RESOLVED;
+      break;
+    case B_DAEMON_RESULT_FAILED_:
+      *out_state = B_FUTURE_FAILED;
+      break;
+    case B_DAEMON_RESULT_ERROR_:
+      *e = (struct B_Error) {
+        .posix_error
+          = (int) b_daemon_decode_u32_(&payload[1]),
+      };
+      goto fail;
+    default:
+      *e = (struct B_Error) {.posix_error = EPROTO};
+      goto fail;
+    }
+    break;
+  }
+  b_deallocate(payload);
+  b_deallocate(request);
+  b_deallocate(question_data);
+  (void) close(fd);
+  return true;
+
+fail:
+  if (payload) {
+    b_deallocate(payload);
+  }
+  if (request) {
+    b_deallocate(request);
+  }
+  if (question_data) {
+    b_deallocate(question_data);
+  }
+  if (fd != -1) {
+    (void) close(fd);
+  }
+  return false;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_daemon_client_stop(
+    B_BORROW char const *socket_path,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(socket_path);
+  B_OUT_PARAMETER(e);
+
+  int fd;
+  if (!b_daemon_connect_(socket_path, &fd, e)) {
+    return false;
+  }
+  if (!b_daemon_send_message_(
+      fd, B_DAEMON_MESSAGE_STOP_, NULL, 0, e)) {
+    (void) close(fd);
+    return false;
+  }
+  // Wait for the daemon to close the connection, so the
+  // daemon has stopped serving when we return.
+  for (;;) {
+    uint8_t byte;
+    ssize_t rc = read(fd, &byte, 1);
+    if (rc == -1 && errno == EINTR) {
+      continue;
+    }
+    break;
+  }
+  (void) close(fd);
+  return true;
+}
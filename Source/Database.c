@@ -1,23 +1,67 @@
-// NOTE[schema]: There are two tables: dependencies and
-// answers.
+// NOTE[schema]: There are four tables: dependencies,
+// answers, executions, and invalidations.  Each question
+// has at most one answer, and each dependency is recorded
+// at most once.  The unique indexes enforcing this also
+// serve answer lookups and walking dependencies from a
+// question to its dependants.
+// dependencies_by_from_question serves walking
+// dependencies from a question to its dependencies.
+//
+// answers.recorded_at is the time (in milliseconds since
+// the Unix epoch) the answer was recorded.  It is used to
+// resolve conflicts when merging databases.
+//
+// NOTE[execution history]: executions holds the cost of
+// recent attempts to answer each question.  A trigger
+// keeps only the B_EXECUTION_HISTORY_SIZE most recent
+// executions of each question.  executions is not
+// exported, imported, or merged.  wall_time_us excludes
+// time spent waiting on other questions (see
+// NOTE[execution time]).
+//
+// NOTE[invalidation log]: invalidations holds the answers
+// deleted by the most recent b_database_check_all (or
+// b_database_check_changed), and why each was deleted.
+// cause_question_* is the question whose answer no longer
+// matched.  parent_question_* is the dependency through
+// which the invalidation reached the question (NULL if the
+// question is the cause), and depth is the number of
+// dependency edges between the cause and the question.
+// If an answer was invalidated along several paths, only
+// a shortest path is logged.
+//
+// NOTE[schema version]: PRAGMA user_version holds the
+// number of b_schema_migrations_ which have been applied
+// to the database.  Migrations are applied when the
+// database is opened.
 
 #include <B/Database.h>
 #include <B/Error.h>
 #include <B/Memory.h>
 #include <B/Private/Assertions.h>
+#include <B/Private/Compression.h>
 #include <B/Private/Database.h>
 #include <B/Private/Log.h>
 #include <B/Private/Memory.h>
 #include <B/Private/Mutex.h>
+#include <B/Private/QuestionMap.h>
 #include <B/Private/SQLite3.h>
 #include <B/QuestionAnswer.h>
+#include <B/Serialize.h>
+#include <B/Tracer.h>
 #include <B/UUID.h>
 
 #include <errno.h>
+#include <limits.h>
 #include <sqlite3.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 struct Buffer_ {
   uint8_t *data;
@@ -39,6 +83,7 @@ enum {
   B_INSERT_ANSWER_QUESTION_UUID = 1,
   B_INSERT_ANSWER_QUESTION_DATA = 2,
   B_INSERT_ANSWER_ANSWER_DATA = 3,
+  B_INSERT_ANSWER_RECORDED_AT = 4,
 };
 
 // NOTE[select answer query]: These are host parameter names
@@ -56,7 +101,10 @@ enum {
 
 // NOTE[recheck all answers query]: There are no inputs or
 // outputs for the b_database_recheck_all's query.  Instead,
-// a user-defined function is queried.
+// a user-defined function is queried, and invalid answers
+// are logged in invalidations with depth 0 (see
+// NOTE[invalidation log]).  NOTE[invalidate dependants
+// query] then logs the answers which depend on them.
 //
 // TODO(strager): sqlite3_create_function to check Answer-s,
 // ON CASCADE DELETE to delete dependencies.
@@ -66,14 +114,434 @@ enum {
   B_SELECT_ALL_ANSWERS_ANSWER_DATA = 3,
 };
 
+// NOTE[recheck answers query]: Like NOTE[recheck all
+// answers query], but only answers to questions in
+// temp.checked_questions are rechecked.  See NOTE[checked
+// questions].
+
+// NOTE[invalidate dependants query]: Logs in invalidations
+// the dependants of the questions logged with depth ?1,
+// with depth ?1 + 1.  Running it for depths 0, 1, 2, ...
+// until it logs nothing walks up the dependency graph
+// breadth first.  A question already logged is not logged
+// again, so each question is visited once (even if many
+// paths reach it), and the path logged is a shortest one.
+enum {
+  B_INVALIDATE_DEPENDANTS_DEPTH = 1,
+};
+
+// NOTE[checked questions]: b_database_check_changed fills
+// the connection's temp.checked_questions table with the
+// questions to recheck, then empties it.  These are host
+// parameter names for the INSERT query.
+enum {
+  B_INSERT_CHECKED_QUESTION_UUID = 1,
+  B_INSERT_CHECKED_QUESTION_DATA = 2,
+};
+
+// NOTE[select answered questions query]: These are host
+// parameter names for b_database_answered_questions's
+// SELECT query.  Answers whose rowid is at most ?1 are
+// skipped; see NOTE[answers mark].
+enum {
+  B_SELECT_ANSWERED_QUESTIONS_MARK = 1,
+};
+
+// NOTE[select answered questions query]: These are column
+// indices for results of b_database_answered_questions's
+// SELECT query.
+enum {
+  B_SELECT_ANSWERED_QUESTIONS_QUESTION_UUID = 0,
+  B_SELECT_ANSWERED_QUESTIONS_QUESTION_DATA = 1,
+};
+
+// NOTE[answers mark]: A mark (see b_database_answers_mark)
+// is the greatest rowid in answers, or 0 if answers is
+// empty.  SQLite gives each inserted row a rowid greater
+// than every rowid in the table, so answers recorded after
+// the mark was taken have greater rowids, unless rows with
+// greater rowids were deleted in between.
+
+// NOTE[export answers query]: These are column indices for
+// results of b_database_export's answers SELECT query.
+enum {
+  B_EXPORT_ANSWERS_QUESTION_UUID = 0,
+  B_EXPORT_ANSWERS_QUESTION_DATA = 1,
+  B_EXPORT_ANSWERS_ANSWER_DATA = 2,
+  B_EXPORT_ANSWERS_RECORDED_AT = 3,
+};
+
+// NOTE[export dependencies query]: These are column indices
+// for results of b_database_export's dependencies SELECT
+// query.
+enum {
+  B_EXPORT_DEPENDENCIES_FROM_QUESTION_UUID = 0,
+  B_EXPORT_DEPENDENCIES_FROM_QUESTION_DATA = 1,
+  B_EXPORT_DEPENDENCIES_TO_QUESTION_UUID = 2,
+  B_EXPORT_DEPENDENCIES_TO_QUESTION_DATA = 3,
+};
+
+// NOTE[insert execution query]: These are host parameter
+// names for b_database_record_execution's INSERT query.
+enum {
+  B_INSERT_EXECUTION_QUESTION_UUID = 1,
+  B_INSERT_EXECUTION_QUESTION_DATA = 2,
+  B_INSERT_EXECUTION_STARTED_AT = 3,
+  B_INSERT_EXECUTION_WALL_TIME_US = 4,
+  B_INSERT_EXECUTION_CPU_TIME_US = 5,
+  B_INSERT_EXECUTION_PEAK_RSS_BYTES = 6,
+  B_INSERT_EXECUTION_EXIT_STATUS = 7,
+  B_INSERT_EXECUTION_BYTES_READ = 8,
+  B_INSERT_EXECUTION_BYTES_WRITTEN = 9,
+};
+
+// NOTE[summarize executions query]: These are host
+// parameter names for b_database_summarize_executions's
+// SELECT query.
+enum {
+  B_SUMMARIZE_EXECUTIONS_QUESTION_UUID = 1,
+  B_SUMMARIZE_EXECUTIONS_QUESTION_DATA = 2,
+};
+
+// NOTE[summarize executions query]: These are column
+// indices for results of b_database_summarize_executions's
+// SELECT query.
+enum {
+  B_SUMMARIZE_EXECUTIONS_COUNT = 0,
+  B_SUMMARIZE_EXECUTIONS_FAILURE_COUNT = 1,
+  B_SUMMARIZE_EXECUTIONS_MEAN_WALL_TIME_US = 2,
+  B_SUMMARIZE_EXECUTIONS_MAX_WALL_TIME_US = 3,
+  B_SUMMARIZE_EXECUTIONS_MEAN_CPU_TIME_US = 4,
+  B_SUMMARIZE_EXECUTIONS_MAX_PEAK_RSS_BYTES = 5,
+  B_SUMMARIZE_EXECUTIONS_MEAN_BYTES_READ = 6,
+  B_SUMMARIZE_EXECUTIONS_MEAN_BYTES_WRITTEN = 7,
+  B_SUMMARIZE_EXECUTIONS_LAST_STARTED_AT = 8,
+};
+
+// NOTE[select dependencies query]: These are host
+// parameter names for b_database_recorded_dependencies's
+// SELECT query.
+enum {
+  B_SELECT_DEPENDENCIES_FROM_QUESTION_UUID = 1,
+  B_SELECT_DEPENDENCIES_FROM_QUESTION_DATA = 2,
+};
+
+// NOTE[select dependencies query]: These are column
+// indices for results of b_database_recorded_dependencies's
+// SELECT query.
+enum {
+  B_SELECT_DEPENDENCIES_TO_QUESTION_UUID = 0,
+  B_SELECT_DEPENDENCIES_TO_QUESTION_DATA = 1,
+};
+
+// NOTE[plan query]: These are host parameter names for
+// b_database_plan's SELECT query.
+enum {
+  B_PLAN_ROOT_QUESTION_UUID = 1,
+  B_PLAN_ROOT_QUESTION_DATA = 2,
+};
+
+// NOTE[plan query]: These are column indices for results
+// of b_database_plan's SELECT query.
+enum {
+  B_PLAN_QUESTION_UUID = 0,
+  B_PLAN_QUESTION_DATA = 1,
+  B_PLAN_ANSWERED = 2,
+  B_PLAN_EXECUTION_COUNT = 3,
+  B_PLAN_MEAN_WALL_TIME_US = 4,
+};
+
+// NOTE[select invalidations query]: These are column
+// indices for results of b_database_invalidations's SELECT
+// query.
+enum {
+  B_SELECT_INVALIDATIONS_QUESTION_UUID = 0,
+  B_SELECT_INVALIDATIONS_QUESTION_DATA = 1,
+  B_SELECT_INVALIDATIONS_CAUSE_QUESTION_UUID = 2,
+  B_SELECT_INVALIDATIONS_CAUSE_QUESTION_DATA = 3,
+  B_SELECT_INVALIDATIONS_PARENT_QUESTION_UUID = 4,
+  B_SELECT_INVALIDATIONS_PARENT_QUESTION_DATA = 5,
+  B_SELECT_INVALIDATIONS_DEPTH = 6,
+};
+
+// Spells an integer macro as an SQL literal.
+#define B_SQL_INTEGER_(x) B_SQL_INTEGER_EXPANDED_(x)
+#define B_SQL_INTEGER_EXPANDED_(x) #x
+
+// See NOTE[schema version].
+static char const *const
+b_schema_migrations_[] = {
+  // Version 1: the original schema.
+  "CREATE TABLE IF NOT EXISTS dependencies(\n"
+  "  from_question_uuid BLOB NOT NULL,\n"
+  "  from_question_data BLOB NOT NULL,\n"
+  "  to_question_uuid BLOB NOT NULL,\n"
+  "  to_question_data BLOB NOT NULL);\n"
+  "CREATE TABLE IF NOT EXISTS answers(\n"
+  "  question_uuid BLOB NOT NULL,\n"
+  "  question_data BLOB NOT NULL,\n"
+  "  answer_data BLOB NOT NULL);\n"
+  "PRAGMA user_version = 1;",
+
+  // Version 2: remove duplicates, add unique indexes, and
+  // add answers.recorded_at.
+  "DELETE FROM answers WHERE _rowid_ NOT IN (\n"
+  "  SELECT MAX(_rowid_) FROM answers\n"
+  "    GROUP BY question_uuid, question_data);\n"
+  "DELETE FROM dependencies WHERE _rowid_ NOT IN (\n"
+  "  SELECT MIN(_rowid_) FROM dependencies\n"
+  "    GROUP BY from_question_uuid,\n"
+  "      from_question_data,\n"
+  "      to_question_uuid,\n"
+  "      to_question_data);\n"
+  "DROP INDEX IF EXISTS answers_by_question;\n"
+  "DROP INDEX IF EXISTS dependencies_by_to_question;\n"
+  "CREATE UNIQUE INDEX answers_by_question\n"
+  "  ON answers(question_uuid, question_data);\n"
+  "CREATE UNIQUE INDEX dependencies_by_to_question\n"
+  "  ON dependencies(\n"
+  "    to_question_uuid,\n"
+  "    to_question_data,\n"
+  "    from_question_uuid,\n"
+  "    from_question_data);\n"
+  "ALTER TABLE answers\n"
+  "  ADD COLUMN recorded_at INTEGER NOT NULL DEFAULT 0;\n"
+  "PRAGMA user_version = 2;",
+
+  // Version 3: encode blobs.  See NOTE[blob encoding] and
+  // NOTE[b_encode_blob].
+  "CREATE TABLE encoded_dependencies(\n"
+  "  from_question_uuid BLOB NOT NULL,\n"
+  "  from_question_data BLOB NOT NULL,\n"
+  "  to_question_uuid BLOB NOT NULL,\n"
+  "  to_question_data BLOB NOT NULL);\n"
+  "INSERT INTO encoded_dependencies\n"
+  "  SELECT from_question_uuid,\n"
+  "      b_encode_blob(from_question_data),\n"
+  "      to_question_uuid,\n"
+  "      b_encode_blob(to_question_data)\n"
+  "    FROM dependencies;\n"
+  "DROP TABLE dependencies;\n"
+  "ALTER TABLE encoded_dependencies\n"
+  "  RENAME TO dependencies;\n"
+  "CREATE UNIQUE INDEX dependencies_by_to_question\n"
+  "  ON dependencies(\n"
+  "    to_question_uuid,\n"
+  "    to_question_data,\n"
+  "    from_question_uuid,\n"
+  "    from_question_data);\n"
+  "CREATE TABLE encoded_answers(\n"
+  "  question_uuid BLOB NOT NULL,\n"
+  "  question_data BLOB NOT NULL,\n"
+  "  answer_data BLOB NOT NULL,\n"
+  "  recorded_at INTEGER NOT NULL DEFAULT 0);\n"
+  "INSERT INTO encoded_answers\n"
+  "  SELECT question_uuid,\n"
+  "      b_encode_blob(question_data),\n"
+  "      b_encode_blob(answer_data),\n"
+  "      recorded_at\n"
+  "    FROM answers;\n"
+  "DROP TABLE answers;\n"
+  "ALTER TABLE encoded_answers RENAME TO answers;\n"
+  "CREATE UNIQUE INDEX answers_by_question\n"
+  "  ON answers(question_uuid, question_data);\n"
+  "PRAGMA user_version = 3;",
+
+  // Version 4: add executions.  See NOTE[execution
+  // history].  Changing B_EXECUTION_HISTORY_SIZE requires
+  // a migration which recreates executions_keep_recent.
+  "CREATE TABLE executions(\n"
+  "  question_uuid BLOB NOT NULL,\n"
+  "  question_data BLOB NOT NULL,\n"
+  "  started_at INTEGER NOT NULL,\n"
+  "  wall_time_us INTEGER NOT NULL,\n"
+  "  cpu_time_us INTEGER NOT NULL,\n"
+  "  peak_rss_bytes INTEGER NOT NULL,\n"
+  "  exit_status INTEGER NOT NULL,\n"
+  "  bytes_read INTEGER NOT NULL,\n"
+  "  bytes_written INTEGER NOT NULL);\n"
+  "CREATE INDEX executions_by_question\n"
+  "  ON executions(question_uuid, question_data, started_at);\n"
+  "CREATE TRIGGER executions_keep_recent\n"
+  "  AFTER INSERT ON executions\n"
+  "BEGIN\n"
+  "  DELETE FROM executions\n"
+  "    WHERE question_uuid = NEW.question_uuid\n"
+  "      AND question_data = NEW.question_data\n"
+  "      AND _rowid_ NOT IN (\n"
+  "        SELECT _rowid_ FROM executions\n"
+  "          WHERE question_uuid = NEW.question_uuid\n"
+  "            AND question_data = NEW.question_data\n"
+  "          ORDER BY started_at DESC, _rowid_ DESC\n"
+  "          LIMIT "
+    B_SQL_INTEGER_(B_EXECUTION_HISTORY_SIZE) ");\n"
+  "END;\n"
+  "PRAGMA user_version = 4;",
+
+  // Version 5: add invalidations.  See NOTE[invalidation
+  // log].
+  "CREATE TABLE invalidations(\n"
+  "  question_uuid BLOB NOT NULL,\n"
+  "  question_data BLOB NOT NULL,\n"
+  "  cause_question_uuid BLOB NOT NULL,\n"
+  "  cause_question_data BLOB NOT NULL,\n"
+  "  parent_question_uuid BLOB,\n"
+  "  parent_question_data BLOB,\n"
+  "  depth INTEGER NOT NULL);\n"
+  "CREATE UNIQUE INDEX invalidations_by_question\n"
+  "  ON invalidations(question_uuid, question_data);\n"
+  "CREATE INDEX invalidations_by_depth\n"
+  "  ON invalidations(depth);\n"
+  "PRAGMA user_version = 5;",
+
+  // Version 6: index dependencies by dependant.  See
+  // NOTE[schema].
+  "CREATE INDEX dependencies_by_from_question\n"
+  "  ON dependencies(\n"
+  "    from_question_uuid,\n"
+  "    from_question_data);\n"
+  "PRAGMA user_version = 6;",
+};
+
+enum {
+  B_SCHEMA_VERSION_ = sizeof(b_schema_migrations_)
+    / sizeof(*b_schema_migrations_),
+};
+
+// NOTE[blob encoding]: Question data and answer data are
+// stored encoded.  The first byte of an encoded blob
+// describes the remaining bytes:
+//
+//   B_BLOB_RAW_  the data, unmodified
+//   B_BLOB_LZ_   the size of the data (8 bytes, big
+//                endian), then the data compressed with
+//                b_lz_compress
+//
+// Data smaller than B_BLOB_COMPRESSION_THRESHOLD_ bytes,
+// and data which does not shrink when compressed, are
+// stored raw.
+//
+// Queries compare encoded question data directly, so
+// encoding must be deterministic.  Changing the encoding
+// requires a schema migration.
+enum {
+  B_BLOB_RAW_ = 0,
+  B_BLOB_LZ_ = 1,
+};
+
+enum {
+  B_BLOB_COMPRESSION_THRESHOLD_ = 256,
+  B_BLOB_LZ_HEADER_SIZE_ = 1 + 8,
+};
+
+// A decoded blob.  data points either into the encoded
+// blob or into storage.
+struct DecodedBuffer_ {
+  uint8_t const *data;
+  size_t size;
+  uint8_t *storage;
+};
+
+// NOTE[export format]: b_database_export writes the
+// following (integers are big endian):
+//
+//   magic              8 bytes: "b-cache\n"
+//   format version     4 bytes: B_EXPORT_FORMAT_VERSION_
+//   records            see below
+//   end tag            1 byte:  B_EXPORT_RECORD_END_
+//   answer count       8 bytes
+//   dependency count   8 bytes
+//   checksum           8 bytes: FNV-1a (64-bit) of every
+//                               preceding byte
+//
+// Each record starts with a one-byte tag.  An answer
+// record (B_EXPORT_RECORD_ANSWER_) is followed by the
+// question UUID (16 bytes), the question data, the answer
+// data, and the answer's recorded_at (8 bytes; see
+// NOTE[schema]).  A dependency record
+// (B_EXPORT_RECORD_DEPENDENCY_) is followed by the from
+// question UUID, the from question data, the to question
+// UUID, and the to question data.  Data fields are
+// serialized with b_serialize_data_and_size_8_be and hold
+// encoded blobs (see NOTE[blob encoding]).
+//
+// Answer records always precede dependency records.
+static uint8_t const
+b_export_magic_[8] = {
+  'b', '-', 'c', 'a', 'c', 'h', 'e', '\n',
+};
+
+enum {
+  B_EXPORT_FORMAT_VERSION_ = 3,
+};
+
+enum {
+  // How much of a data field deserialize_buffer_ reads
+  // before growing its buffer.
+  B_DESERIALIZE_BUFFER_CHUNK_SIZE_ = 64 * 1024,
+};
+
+enum {
+  B_EXPORT_RECORD_END_ = 0,
+  B_EXPORT_RECORD_ANSWER_ = 1,
+  B_EXPORT_RECORD_DEPENDENCY_ = 2,
+};
+
+// A B_ByteSink which writes to a FILE.  See
+// NOTE[export format].
+struct ExportSink_ {
+  struct B_ByteSink super;
+  FILE *file;
+  uint64_t checksum;
+};
+
+// A B_ByteSource which reads from a FILE.  See
+// NOTE[export format].
+struct ImportSource_ {
+  struct B_ByteSource super;
+  FILE *file;
+  uint64_t checksum;
+};
+
+B_STATIC_ASSERT(
+  offsetof(struct ExportSink_, super) == 0,
+  "ExportSink_::super must be the first member");
+
+B_STATIC_ASSERT(
+  offsetof(struct ImportSource_, super) == 0,
+  "ImportSource_::super must be the first member");
+
+static uint64_t const
+b_fnv1a_64_offset_basis_ = UINT64_C(14695981039346656037);
+
 struct B_Database {
   struct B_Mutex lock;
+  // NULL unless tracing.  Not guarded by lock.  See
+  // NOTE[tracing].
+  struct B_Tracer *tracer;
 
   sqlite3 *handle;
   sqlite3_stmt *insert_dependency_stmt;
   sqlite3_stmt *insert_answer_stmt;
   sqlite3_stmt *select_answer_stmt;
+  sqlite3_stmt *clear_invalidations_stmt;
   sqlite3_stmt *recheck_all_answers_stmt;
+  sqlite3_stmt *insert_checked_question_stmt;
+  sqlite3_stmt *clear_checked_questions_stmt;
+  sqlite3_stmt *recheck_answers_stmt;
+  sqlite3_stmt *invalidate_dependants_stmt;
+  sqlite3_stmt *delete_invalidated_answers_stmt;
+  sqlite3_stmt *select_answered_questions_stmt;
+  sqlite3_stmt *select_answers_mark_stmt;
+  sqlite3_stmt *select_invalidations_stmt;
+  sqlite3_stmt *export_answers_stmt;
+  sqlite3_stmt *export_dependencies_stmt;
+  sqlite3_stmt *import_answer_stmt;
+  sqlite3_stmt *import_dependency_stmt;
+  sqlite3_stmt *insert_execution_stmt;
+  sqlite3_stmt *summarize_executions_stmt;
+  sqlite3_stmt *select_dependencies_stmt;
+  sqlite3_stmt *plan_stmt;
 
   // Fields for UDFs (User Defined Functions).  Temporary.
   struct {
@@ -87,6 +555,17 @@ prepare_database_locked_(
     B_BORROW struct B_Database *,
     B_OUT struct B_Error *);
 
+static B_WUR B_FUNC bool
+migrate_schema_locked_(
+    B_BORROW struct B_Database *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+merge_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW char const *sqlite_path,
+    B_OUT struct B_Error *);
+
 static B_WUR B_FUNC bool
 record_answer_locked_(
     B_BORROW struct B_Database *,
@@ -95,26 +574,35 @@ record_answer_locked_(
     B_BORROW struct B_IAnswer const *,
     B_OUT struct B_Error *);
 
+// stmt must have the host parameters described by
+// NOTE[insert answer query].
 static B_WUR B_FUNC bool
 insert_answer_locked_(
     B_BORROW struct B_Database *,
+    B_BORROW sqlite3_stmt *,
     B_TRANSFER struct Buffer_ question_data,
     B_BORROW struct B_UUID const question_uuid,
     B_TRANSFER struct Buffer_ answer_data,
+    int64_t recorded_at,
     B_OUT struct B_Error *);
 
 static B_WUR B_FUNC bool
-record_dependency_locked_(
+record_dependencies_locked_(
     B_BORROW struct B_Database *,
     B_BORROW struct B_IQuestion const *from,
     B_BORROW struct B_QuestionVTable const *from_vtable,
-    B_BORROW struct B_IQuestion const *to,
-    B_BORROW struct B_QuestionVTable const *to_vtable,
+    B_BORROW struct B_IQuestion const *const *to,
+    B_BORROW struct B_QuestionVTable const *const *
+      to_vtables,
+    size_t to_count,
     B_OUT struct B_Error *);
 
+// stmt must have the host parameters described by
+// NOTE[insert dependency query].
 static B_WUR B_FUNC bool
 insert_dependency_locked_(
     B_BORROW struct B_Database *,
+    B_BORROW sqlite3_stmt *,
     B_TRANSFER struct Buffer_ from_data,
     struct B_UUID const from_uuid,
     B_TRANSFER struct Buffer_ to_data,
@@ -129,6 +617,112 @@ look_up_answer_locked_(
     B_OPTIONAL_OUT_TRANSFER struct B_IAnswer **,
     B_OUT struct B_Error *);
 
+static B_WUR B_FUNC bool
+look_up_answers_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *const *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t count,
+    B_OUT_TRANSFER struct B_IAnswer **,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+invalidations_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t vtable_count,
+    B_BORROW B_InvalidationCallback *,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *);
+
+static void
+release_invalidation_(
+    B_BORROW struct B_Invalidation *);
+
+static B_WUR B_FUNC bool
+recorded_dependencies_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t vtable_count,
+    B_BORROW B_DependencyCallback *,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+plan_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *const *roots,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t root_count,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t vtable_count,
+    B_BORROW B_PlanCallback *,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+plan_root_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *root,
+    B_BORROW struct B_QuestionVTable const *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t vtable_count,
+    B_BORROW struct B_QuestionMap *visited,
+    B_BORROW B_PlanCallback *,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *);
+
+static B_FUNC struct B_QuestionVTable const *
+find_question_vtable_(
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t vtable_count,
+    B_BORROW struct B_UUID const *);
+
+static B_WUR B_FUNC bool
+column_question_(
+    B_BORROW sqlite3_stmt *,
+    int uuid_column,
+    int data_column,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t vtable_count,
+    B_OUT_TRANSFER struct B_IQuestion const **,
+    B_OUT_BORROW struct B_QuestionVTable const **,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+record_execution_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_BORROW struct B_ExecutionRecord const *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+summarize_executions_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_OUT struct B_ExecutionSummary *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+summarize_all_executions_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *const *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t count,
+    B_OUT struct B_ExecutionSummary *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+encode_question_(
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_OUT_TRANSFER struct Buffer_ *,
+    B_OUT struct B_Error *);
+
 static B_WUR B_FUNC bool
 b_check_all_locked_(
     B_BORROW struct B_Database *,
@@ -136,6 +730,146 @@ b_check_all_locked_(
     size_t question_vtable_count,
     B_OUT struct B_Error *);
 
+static B_WUR B_FUNC bool
+check_changed_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *const *,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t question_count,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t vtable_count,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+step_statements_(
+    B_BORROW sqlite3_stmt *const *,
+    size_t count,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+invalidate_dependants_locked_(
+    B_BORROW struct B_Database *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+insert_checked_question_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_IQuestion const *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+answered_questions_locked_(
+    B_BORROW struct B_Database *,
+    int64_t mark,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t vtable_count,
+    B_BORROW B_QuestionCallback *,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+export_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct ExportSink_ *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+export_answers_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_ByteSink *,
+    B_OUT uint64_t *answer_count,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+export_dependencies_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_ByteSink *,
+    B_OUT uint64_t *dependency_count,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+import_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct ImportSource_ *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+import_answer_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_ByteSource *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+import_dependency_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW struct B_ByteSource *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+export_sink_write_bytes_(
+    B_BORROW struct B_ByteSink *,
+    B_BORROW uint8_t const *data,
+    size_t data_size,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+import_source_read_bytes_(
+    B_BORROW struct B_ByteSource *,
+    B_OUT uint8_t *data,
+    B_IN_OUT size_t *data_size,
+    B_OUT struct B_Error *);
+
+static uint64_t
+fnv1a_64_(
+    uint64_t hash,
+    B_BORROW uint8_t const *data,
+    size_t data_size);
+
+static B_WUR B_FUNC bool
+serialize_column_blob_(
+    B_BORROW struct B_ByteSink *,
+    B_BORROW sqlite3_stmt *,
+    int column,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+serialize_column_uuid_(
+    B_BORROW struct B_ByteSink *,
+    B_BORROW sqlite3_stmt *,
+    int column,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+deserialize_buffer_(
+    B_BORROW struct B_ByteSource *,
+    B_OUT_TRANSFER struct Buffer_ *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+deserialize_uuid_(
+    B_BORROW struct B_ByteSource *,
+    B_OUT struct B_UUID *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+exec_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW char const *query,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+query_int_locked_(
+    B_BORROW struct B_Database *,
+    B_BORROW char const *query,
+    size_t query_size,
+    B_OUT int *,
+    B_OUT struct B_Error *);
+
+static int64_t
+current_time_ms_(
+    void);
+
 static B_WUR B_FUNC bool
 bind_uuid_(
     B_BORROW sqlite3_stmt *,
@@ -160,12 +894,80 @@ question_answer_matches_locked_(
     int arg_count,
     B_BORROW sqlite3_value **args);
 
-static B_WUR B_FUNC bool
-value_uuid_(
-    B_BORROW sqlite3_value *,
-    B_OUT struct B_UUID *,
+static void
+encode_blob_(
+    B_BORROW sqlite3_context *,
+    int arg_count,
+    B_BORROW sqlite3_value **args);
+
+static B_WUR B_FUNC bool
+encode_buffer_(
+    B_IN_OUT struct Buffer_ *,
+    B_OUT struct B_Error *);
+
+static B_WUR B_FUNC bool
+decode_buffer_(
+    B_BORROW uint8_t const *data,
+    size_t data_size,
+    B_OUT_TRANSFER struct DecodedBuffer_ *,
+    B_OUT struct B_Error *);
+
+static void
+release_decoded_buffer_(
+    B_TRANSFER struct DecodedBuffer_ *);
+
+static B_WUR B_FUNC bool
+value_uuid_(
+    B_BORROW sqlite3_value *,
+    B_OUT struct B_UUID *,
     B_OUT struct B_Error *);
 
+enum {
+  // Shorter waits for the database's lock are not traced.
+  // See NOTE[tracing].
+  B_DATABASE_LOCK_WAIT_TRACE_US_ = 50,
+};
+
+static B_FUNC void
+lock_database_(
+    B_BORROW struct B_Database *database) {
+  B_PRECONDITION(database);
+
+  struct B_Tracer *tracer = database->tracer;
+  if (!tracer) {
+    b_mutex_lock(&database->lock);
+    return;
+  }
+  int64_t start_us = b_tracer_now_us();
+  b_mutex_lock(&database->lock);
+  int64_t end_us = b_tracer_now_us();
+  if (end_us - start_us >= B_DATABASE_LOCK_WAIT_TRACE_US_) {
+    b_tracer_span(
+      tracer, "database", "lock wait", start_us, end_us, NULL);
+  }
+}
+
+// Traces a database write which started at start_us (from
+// b_tracer_now_us) and just finished.
+static B_FUNC void
+trace_write_(
+    B_BORROW struct B_Database *database,
+    B_BORROW char const *name,
+    int64_t start_us) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(name);
+
+  if (database->tracer) {
+    b_tracer_span(
+      database->tracer,
+      "database",
+      name,
+      start_us,
+      b_tracer_now_us(),
+      NULL);
+  }
+}
+
 B_WUR B_EXPORT_FUNC bool
 b_database_open_sqlite3(
     B_BORROW char const *sqlite_path,
@@ -201,11 +1003,29 @@ b_database_open_sqlite3(
   }
   *database = (struct B_Database) {
     // .lock
+    .tracer = NULL,
     .handle = NULL,
     .insert_dependency_stmt = NULL,
     .insert_answer_stmt = NULL,
     .select_answer_stmt = NULL,
+    .clear_invalidations_stmt = NULL,
     .recheck_all_answers_stmt = NULL,
+    .insert_checked_question_stmt = NULL,
+    .clear_checked_questions_stmt = NULL,
+    .recheck_answers_stmt = NULL,
+    .invalidate_dependants_stmt = NULL,
+    .delete_invalidated_answers_stmt = NULL,
+    .select_answered_questions_stmt = NULL,
+    .select_answers_mark_stmt = NULL,
+    .select_invalidations_stmt = NULL,
+    .export_answers_stmt = NULL,
+    .export_dependencies_stmt = NULL,
+    .import_answer_stmt = NULL,
+    .import_dependency_stmt = NULL,
+    .insert_execution_stmt = NULL,
+    .summarize_executions_stmt = NULL,
+    .select_dependencies_stmt = NULL,
+    .plan_stmt = NULL,
     .udf = {
       .vtables = NULL,
       .vtable_count = 0,
@@ -272,10 +1092,77 @@ b_database_close(
     (void) sqlite3_finalize(
       database->select_answer_stmt);
   }
+  if (database->clear_invalidations_stmt) {
+    (void) sqlite3_finalize(
+      database->clear_invalidations_stmt);
+  }
   if (database->recheck_all_answers_stmt) {
     (void) sqlite3_finalize(
       database->recheck_all_answers_stmt);
   }
+  if (database->insert_checked_question_stmt) {
+    (void) sqlite3_finalize(
+      database->insert_checked_question_stmt);
+  }
+  if (database->clear_checked_questions_stmt) {
+    (void) sqlite3_finalize(
+      database->clear_checked_questions_stmt);
+  }
+  if (database->recheck_answers_stmt) {
+    (void) sqlite3_finalize(
+      database->recheck_answers_stmt);
+  }
+  if (database->invalidate_dependants_stmt) {
+    (void) sqlite3_finalize(
+      database->invalidate_dependants_stmt);
+  }
+  if (database->delete_invalidated_answers_stmt) {
+    (void) sqlite3_finalize(
+      database->delete_invalidated_answers_stmt);
+  }
+  if (database->select_answered_questions_stmt) {
+    (void) sqlite3_finalize(
+      database->select_answered_questions_stmt);
+  }
+  if (database->select_answers_mark_stmt) {
+    (void) sqlite3_finalize(
+      database->select_answers_mark_stmt);
+  }
+  if (database->select_invalidations_stmt) {
+    (void) sqlite3_finalize(
+      database->select_invalidations_stmt);
+  }
+  if (database->export_answers_stmt) {
+    (void) sqlite3_finalize(
+      database->export_answers_stmt);
+  }
+  if (database->export_dependencies_stmt) {
+    (void) sqlite3_finalize(
+      database->export_dependencies_stmt);
+  }
+  if (database->import_answer_stmt) {
+    (void) sqlite3_finalize(
+      database->import_answer_stmt);
+  }
+  if (database->import_dependency_stmt) {
+    (void) sqlite3_finalize(
+      database->import_dependency_stmt);
+  }
+  if (database->insert_execution_stmt) {
+    (void) sqlite3_finalize(
+      database->insert_execution_stmt);
+  }
+  if (database->summarize_executions_stmt) {
+    (void) sqlite3_finalize(
+      database->summarize_executions_stmt);
+  }
+  if (database->select_dependencies_stmt) {
+    (void) sqlite3_finalize(
+      database->select_dependencies_stmt);
+  }
+  if (database->plan_stmt) {
+    (void) sqlite3_finalize(database->plan_stmt);
+  }
   if (database->handle) {
     (void) sqlite3_close(database->handle);
   }
@@ -283,6 +1170,15 @@ b_database_close(
   return true;
 }
 
+B_EXPORT_FUNC void
+b_database_set_tracer(
+    B_BORROW struct B_Database *database,
+    B_BORROW_OPTIONAL struct B_Tracer *tracer) {
+  B_PRECONDITION(database);
+
+  database->tracer = tracer;
+}
+
 B_WUR B_EXPORT_FUNC bool
 b_database_record_dependency(
     B_BORROW struct B_Database *database,
@@ -298,13 +1194,66 @@ b_database_record_dependency(
   B_PRECONDITION(to_vtable);
   B_OUT_PARAMETER(e);
 
+  // See NOTE[tracing].
+  int64_t start_us
+    = database->tracer ? b_tracer_now_us() : 0;
   bool ok = true;
-  b_mutex_lock(&database->lock);
+  lock_database_(database);
+  {
+    ok = record_dependencies_locked_(
+      database, from, from_vtable, &to, &to_vtable, 1, e);
+  }
+  b_mutex_unlock(&database->lock);
+  trace_write_(database, "record dependency", start_us);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_database_record_dependencies(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *from,
+    B_BORROW struct B_QuestionVTable const *from_vtable,
+    B_BORROW struct B_IQuestion const *const *to,
+    B_BORROW struct B_QuestionVTable const *const *
+      to_vtables,
+    size_t to_count,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(from);
+  B_PRECONDITION(from_vtable);
+  B_PRECONDITION(to || to_count == 0);
+  B_PRECONDITION(to_vtables || to_count == 0);
+  B_OUT_PARAMETER(e);
+
+  if (to_count == 0) {
+    return true;
+  }
+  // See NOTE[tracing].
+  int64_t start_us
+    = database->tracer ? b_tracer_now_us() : 0;
+  bool ok = true;
+  lock_database_(database);
   {
-    ok = record_dependency_locked_(
-      database, from, from_vtable, to, to_vtable, e);
+    // One transaction avoids a journal sync per row.
+    ok = exec_locked_(database, "BEGIN IMMEDIATE;", e)
+      && record_dependencies_locked_(
+        database,
+        from,
+        from_vtable,
+        to,
+        to_vtables,
+        to_count,
+        e)
+      && exec_locked_(database, "COMMIT;", e);
+    if (!ok) {
+      (void) exec_locked_(
+        database,
+        "ROLLBACK;",
+        &(struct B_Error) {.posix_error = 0});
+    }
   }
   b_mutex_unlock(&database->lock);
+  trace_write_(database, "record dependencies", start_us);
   return ok;
 }
 
@@ -321,13 +1270,17 @@ b_database_record_answer(
   B_PRECONDITION(answer);
   B_OUT_PARAMETER(e);
 
+  // See NOTE[tracing].
+  int64_t start_us
+    = database->tracer ? b_tracer_now_us() : 0;
   bool ok = true;
-  b_mutex_lock(&database->lock);
+  lock_database_(database);
   {
     ok = record_answer_locked_(
       database, question, question_vtable, answer, e);
   }
   b_mutex_unlock(&database->lock);
+  trace_write_(database, "record answer", start_us);
   return ok;
 }
 
@@ -344,7 +1297,7 @@ b_database_look_up_answer(
   B_OUT_PARAMETER(out);
 
   bool ok = true;
-  b_mutex_lock(&database->lock);
+  lock_database_(database);
   {
     ok = look_up_answer_locked_(
       database, question, question_vtable, out, e);
@@ -353,6 +1306,34 @@ b_database_look_up_answer(
   return ok;
 }
 
+B_WUR B_EXPORT_FUNC bool
+b_database_look_up_answers(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t count,
+    B_OUT_TRANSFER struct B_IAnswer **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(questions || count == 0);
+  B_PRECONDITION(question_vtables || count == 0);
+  B_PRECONDITION(out || count == 0);
+  B_OUT_PARAMETER(e);
+
+  if (count == 0) {
+    return true;
+  }
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = look_up_answers_locked_(
+      database, questions, question_vtables, count, out, e);
+  }
+  b_mutex_unlock(&database->lock);
+  return ok;
+}
+
 B_WUR B_EXPORT_FUNC bool
 b_database_check_all(
     struct B_Database *database,
@@ -364,7 +1345,7 @@ b_database_check_all(
   B_OUT_PARAMETER(e);
 
   bool ok = true;
-  b_mutex_lock(&database->lock);
+  lock_database_(database);
   {
     ok = b_check_all_locked_(
       database, vtables, vtable_count, e);
@@ -373,376 +1354,2994 @@ b_database_check_all(
   return ok;
 }
 
-static B_WUR B_FUNC bool
-prepare_database_locked_(
+B_WUR B_EXPORT_FUNC bool
+b_database_check_changed(
     B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t question_count,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
     B_OUT struct B_Error *e) {
   B_PRECONDITION(database);
-  B_PRECONDITION(database->handle);
-  B_PRECONDITION(!database->insert_dependency_stmt);
-  B_PRECONDITION(!database->insert_answer_stmt);
-  B_PRECONDITION(!database->select_answer_stmt);
-  B_PRECONDITION(!database->recheck_all_answers_stmt);
+  B_PRECONDITION(questions || question_count == 0);
+  B_PRECONDITION(question_vtables || question_count == 0);
+  B_PRECONDITION(vtables);
   B_OUT_PARAMETER(e);
 
-  sqlite3 *handle = database->handle;
-  int rc;
-
-  // See NOTE[b_question_answer_matches].
-  rc = sqlite3_create_function_v2(
-    handle,
-    "b_question_answer_matches",
-    3,
-    SQLITE_DETERMINISTIC | SQLITE_UTF8,
-    database,
-    question_answer_matches_locked_,
-    NULL,
-    NULL,
-    NULL);
-  if (rc != SQLITE_OK) {
-    *e = b_sqlite3_error(rc);
-    goto fail;
-  }
-
-  // See NOTE[schema].
-  static char const create_table_query[] = ""
-    "CREATE TABLE IF NOT EXISTS dependencies(\n"
-    "  from_question_uuid BLOB NOT NULL,\n"
-    "  from_question_data BLOB NOT NULL,\n"
-    "  to_question_uuid BLOB NOT NULL,\n"
-    "  to_question_data BLOB NOT NULL);\n"
-    "CREATE TABLE IF NOT EXISTS answers(\n"
-    "  question_uuid BLOB NOT NULL,\n"
-    "  question_data BLOB NOT NULL,\n"
-    "  answer_data BLOB NOT NULL);\n";
-  rc = sqlite3_exec(
-    handle, create_table_query, NULL, NULL, NULL);
-  if (rc != SQLITE_OK) {
-    *e = b_sqlite3_error(rc);
-    goto fail;
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = check_changed_locked_(
+      database,
+      questions,
+      question_vtables,
+      question_count,
+      vtables,
+      vtable_count,
+      e);
   }
+  b_mutex_unlock(&database->lock);
+  return ok;
+}
 
-  // See NOTE[insert dependency query].
-  static char const insert_dependency_query[] = ""
-    "INSERT INTO dependencies(\n"
-    "  from_question_uuid,\n"
-    "  from_question_data,\n"
-    "  to_question_uuid,\n"
-    "  to_question_data)\n"
-    "VALUES (?1, ?2, ?3, ?4);";
-  if (!b_sqlite3_prepare(
-      handle,
-      insert_dependency_query,
-      sizeof(insert_dependency_query),
-      &database->insert_dependency_stmt,
-      e)) {
-    goto fail;
-  }
+B_WUR B_EXPORT_FUNC bool
+b_database_answered_questions(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW B_QuestionCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(e);
 
-  // See NOTE[insert answer query].
-  static char const insert_answer_query[] = ""
-    "INSERT INTO answers(\n"
-    "  question_uuid,\n"
-    "  question_data,\n"
-    "  answer_data)\n"
-    "VALUES (?1, ?2, ?3);";
-  if (!b_sqlite3_prepare(
-      handle,
-      insert_answer_query,
-      sizeof(insert_answer_query),
-      &database->insert_answer_stmt,
-      e)) {
-    goto fail;
-  }
+  return b_database_answered_questions_since(
+    database,
+    0,
+    vtables,
+    vtable_count,
+    callback,
+    callback_opaque,
+    e);
+}
 
-  // See NOTE[select answer query].
-  static char const select_answer_query[] = ""
-    "SELECT answer_data\n"
-    "  FROM answers\n"
-    "  WHERE question_uuid = ?1\n"
-    "    AND question_data = ?2;";
-  if (!b_sqlite3_prepare(
-      handle,
-      select_answer_query,
-      sizeof(select_answer_query),
-      &database->select_answer_stmt,
-      e)) {
-    goto fail;
-  }
+B_WUR B_EXPORT_FUNC bool
+b_database_answers_mark(
+    B_BORROW struct B_Database *database,
+    B_OUT int64_t *out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
 
-  // See NOTE[recheck all answers query].
-  static char const recheck_all_answers_query[] = ""
-    "WITH RECURSIVE invalid_answers(\n"
-    "    question_uuid,\n"
-    "    question_data) AS (\n"
-    "  -- Seed recursion with out-of-date answers."
-    "  -- See NOTE[b_question_answer_matches].\n"
-    "  SELECT question_uuid, question_data\n"
-    "    FROM answers\n"
-    "    WHERE b_question_answer_matches(\n"
-    "          question_uuid,\n"
-    "          question_data,\n"
-    "          answer_data) == 0\n"
-    "\n"
-    "  UNION ALL\n"
-    "\n"
-    "  -- Walk up the dependency graph.\n"
-    "  SELECT dep.from_question_uuid,\n"
-    "       dep.from_question_data\n"
-    "    FROM invalid_answers AS invalid\n"
-    "    INNER JOIN dependencies AS dep\n"
-    "    ON dep.to_question_uuid = invalid.question_uuid\n"
-    "       AND dep.to_question_data = invalid.question_data\n"
-    ")\n"
-    "-- Delete encountered rows.\n"
-    "DELETE FROM answers WHERE _rowid_ IN (\n"
-    "  SELECT answers._rowid_ FROM answers\n"
-    "    INNER JOIN invalid_answers AS invalid\n"
-    "    ON answers.question_uuid = invalid.question_uuid\n"
-    "       AND answers.question_data = invalid.question_data);";
-  if (!b_sqlite3_prepare(
-      handle,
-      recheck_all_answers_query,
-      sizeof(recheck_all_answers_query),
-      &database->recheck_all_answers_stmt,
-      e)) {
-    goto fail;
+  bool ok = true;
+  lock_database_(database);
+  {
+    sqlite3_stmt *stmt = database->select_answers_mark_stmt;
+    int rc = sqlite3_step(stmt);
+    if (rc != SQLITE_ROW) {
+      // An aggregate query always produces exactly one
+      // row.
+      B_ASSERT(rc != SQLITE_DONE);
+      *e = b_sqlite3_error(rc);
+      ok = false;
+    } else {
+      *out = sqlite3_column_int64(stmt, 0);
+      ok = b_sqlite3_step_expecting_end(stmt, e);
+    }
+    // Any error was raised by sqlite3_step already.
+    (void) sqlite3_reset(stmt);
   }
-
-  return true;
-
-fail:
-  // See NOTE[unprepare database].
-  return false;
+  b_mutex_unlock(&database->lock);
+  return ok;
 }
 
-static B_WUR B_FUNC bool
-record_answer_locked_(
+B_WUR B_EXPORT_FUNC bool
+b_database_answered_questions_since(
     B_BORROW struct B_Database *database,
-    B_BORROW struct B_IQuestion const *question,
-    B_BORROW struct B_QuestionVTable const *question_vtable,
-    B_BORROW struct B_IAnswer const *answer,
+    int64_t mark,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW B_QuestionCallback *callback,
+    B_BORROW void *callback_opaque,
     B_OUT struct B_Error *e) {
   B_PRECONDITION(database);
-  B_PRECONDITION(question);
-  B_PRECONDITION(question_vtable);
-  B_PRECONDITION(answer);
+  B_PRECONDITION(mark >= 0);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(callback);
   B_OUT_PARAMETER(e);
 
-  struct Buffer_ question_buffer = {
-    .data = NULL,
-    .size = 0,
-  };
-  struct Buffer_ answer_buffer = {
-    .data = NULL,
-    .size = 0,
-  };
-  if (!b_question_serialize_to_memory(
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = answered_questions_locked_(
+      database,
+      mark,
+      vtables,
+      vtable_count,
+      callback,
+      callback_opaque,
+      e);
+  }
+  b_mutex_unlock(&database->lock);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_database_export(
+    B_BORROW struct B_Database *database,
+    B_BORROW char const *file_path,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(file_path);
+  B_OUT_PARAMETER(e);
+
+  // Write to a temporary file next to file_path, then
+  // rename it into place, so readers never see a partial
+  // export and a failed export keeps the old one.
+  static char const temp_suffix[] = ".XXXXXX";
+  size_t file_path_length = strlen(file_path);
+  char *temp_path;
+  if (!b_allocate(
+      file_path_length + sizeof(temp_suffix),
+      (void **) &temp_path,
+      e)) {
+    return false;
+  }
+  memcpy(temp_path, file_path, file_path_length);
+  memcpy(
+    temp_path + file_path_length,
+    temp_suffix,
+    sizeof(temp_suffix));
+  int fd = mkstemp(temp_path);
+  if (fd == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    b_deallocate(temp_path);
+    return false;
+  }
+  // mkstemp creates the file with mode 0600.  Give it the
+  // mode fopen would have.  umask can only be read by
+  // setting it, so another thread creating a file now
+  // could briefly see an empty umask.
+  mode_t mask = umask(0);
+  (void) umask(mask);
+  if (fchmod(fd, 0666 & ~mask) != 0) {
+    *e = (struct B_Error) {.posix_error = errno};
+    (void) close(fd);
+    (void) unlink(temp_path);
+    b_deallocate(temp_path);
+    return false;
+  }
+  FILE *file = fdopen(fd, "wb");
+  if (!file) {
+    *e = (struct B_Error) {.posix_error = errno};
+    (void) close(fd);
+    (void) unlink(temp_path);
+    b_deallocate(temp_path);
+    return false;
+  }
+  struct ExportSink_ sink = {
+    .super = {
+      .write_bytes = export_sink_write_bytes_,
+      .deallocate = NULL,
+    },
+    .file = file,
+    .checksum = b_fnv1a_64_offset_basis_,
+  };
+
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = export_locked_(database, &sink, e);
+  }
+  b_mutex_unlock(&database->lock);
+  // Flush the export to disk before renaming it into
+  // place so a crash cannot leave a truncated export under
+  // file_path.
+  if (ok && (fflush(file) != 0 || fsync(fd) != 0)) {
+    *e = (struct B_Error) {.posix_error = errno};
+    ok = false;
+  }
+  if (fclose(file) != 0 && ok) {
+    *e = (struct B_Error) {.posix_error = errno};
+    ok = false;
+  }
+  if (ok && rename(temp_path, file_path) != 0) {
+    *e = (struct B_Error) {.posix_error = errno};
+    ok = false;
+  }
+  if (!ok) {
+    (void) unlink(temp_path);
+  }
+  b_deallocate(temp_path);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_database_import(
+    B_BORROW struct B_Database *database,
+    B_BORROW char const *file_path,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(file_path);
+  B_OUT_PARAMETER(e);
+
+  FILE *file = fopen(file_path, "rb");
+  if (!file) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+  struct ImportSource_ source = {
+    .super = {
+      .read_bytes = import_source_read_bytes_,
+      .deallocate = NULL,
+    },
+    .file = file,
+    .checksum = b_fnv1a_64_offset_basis_,
+  };
+
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = import_locked_(database, &source, e);
+  }
+  b_mutex_unlock(&database->lock);
+  (void) fclose(file);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_database_merge(
+    B_BORROW struct B_Database *database,
+    B_BORROW char const *const *sqlite_paths,
+    size_t sqlite_path_count,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(sqlite_paths);
+  B_OUT_PARAMETER(e);
+
+  bool ok = true;
+  lock_database_(database);
+  {
+    for (size_t i = 0; i < sqlite_path_count; ++i) {
+      ok = merge_locked_(database, sqlite_paths[i], e);
+      if (!ok) {
+        break;
+      }
+    }
+  }
+  b_mutex_unlock(&database->lock);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_database_invalidations(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW B_InvalidationCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(e);
+
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = invalidations_locked_(
+      database,
+      vtables,
+      vtable_count,
+      callback,
+      callback_opaque,
+      e);
+  }
+  b_mutex_unlock(&database->lock);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_database_recorded_dependencies(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW B_DependencyCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(e);
+
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = recorded_dependencies_locked_(
+      database,
       question,
       question_vtable,
-      &question_buffer.data,
-      &question_buffer.size,
+      vtables,
+      vtable_count,
+      callback,
+      callback_opaque,
+      e);
+  }
+  b_mutex_unlock(&database->lock);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_database_plan(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *const *roots,
+    B_BORROW struct B_QuestionVTable const *const *
+      root_vtables,
+    size_t root_count,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW B_PlanCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(roots);
+  B_PRECONDITION(root_vtables);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(e);
+
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = plan_locked_(
+      database,
+      roots,
+      root_vtables,
+      root_count,
+      vtables,
+      vtable_count,
+      callback,
+      callback_opaque,
+      e);
+  }
+  b_mutex_unlock(&database->lock);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_database_record_execution(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_BORROW struct B_ExecutionRecord const *record,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_PRECONDITION(record);
+  B_OUT_PARAMETER(e);
+
+  // See NOTE[tracing].
+  int64_t start_us
+    = database->tracer ? b_tracer_now_us() : 0;
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = record_execution_locked_(
+      database, question, question_vtable, record, e);
+  }
+  b_mutex_unlock(&database->lock);
+  trace_write_(database, "record execution", start_us);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_database_summarize_executions(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_OUT struct B_ExecutionSummary *out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = summarize_executions_locked_(
+      database, question, question_vtable, out, e);
+  }
+  b_mutex_unlock(&database->lock);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_database_summarize_all_executions(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t count,
+    B_OUT struct B_ExecutionSummary *out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(questions || count == 0);
+  B_PRECONDITION(question_vtables || count == 0);
+  B_PRECONDITION(out || count == 0);
+  B_OUT_PARAMETER(e);
+
+  if (count == 0) {
+    return true;
+  }
+  bool ok = true;
+  lock_database_(database);
+  {
+    ok = summarize_all_executions_locked_(
+      database, questions, question_vtables, count, out, e);
+  }
+  b_mutex_unlock(&database->lock);
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+prepare_database_locked_(
+    B_BORROW struct B_Database *database,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(database->handle);
+  B_PRECONDITION(!database->insert_dependency_stmt);
+  B_PRECONDITION(!database->insert_answer_stmt);
+  B_PRECONDITION(!database->select_answer_stmt);
+  B_PRECONDITION(!database->clear_invalidations_stmt);
+  B_PRECONDITION(!database->recheck_all_answers_stmt);
+  B_PRECONDITION(!database->insert_checked_question_stmt);
+  B_PRECONDITION(!database->clear_checked_questions_stmt);
+  B_PRECONDITION(!database->recheck_answers_stmt);
+  B_PRECONDITION(!database->invalidate_dependants_stmt);
+  B_PRECONDITION(
+    !database->delete_invalidated_answers_stmt);
+  B_PRECONDITION(
+    !database->select_answered_questions_stmt);
+  B_PRECONDITION(!database->select_answers_mark_stmt);
+  B_PRECONDITION(!database->select_invalidations_stmt);
+  B_PRECONDITION(!database->export_answers_stmt);
+  B_PRECONDITION(!database->export_dependencies_stmt);
+  B_PRECONDITION(!database->import_answer_stmt);
+  B_PRECONDITION(!database->import_dependency_stmt);
+  B_PRECONDITION(!database->insert_execution_stmt);
+  B_PRECONDITION(!database->summarize_executions_stmt);
+  B_PRECONDITION(!database->select_dependencies_stmt);
+  B_PRECONDITION(!database->plan_stmt);
+  B_OUT_PARAMETER(e);
+
+  sqlite3 *handle = database->handle;
+  int rc;
+
+  // See NOTE[b_question_answer_matches].
+  rc = sqlite3_create_function_v2(
+    handle,
+    "b_question_answer_matches",
+    3,
+    SQLITE_DETERMINISTIC | SQLITE_UTF8,
+    database,
+    question_answer_matches_locked_,
+    NULL,
+    NULL,
+    NULL);
+  if (rc != SQLITE_OK) {
+    *e = b_sqlite3_error(rc);
+    goto fail;
+  }
+
+  // See NOTE[b_encode_blob].
+  rc = sqlite3_create_function_v2(
+    handle,
+    "b_encode_blob",
+    1,
+    SQLITE_DETERMINISTIC | SQLITE_UTF8,
+    NULL,
+    encode_blob_,
+    NULL,
+    NULL,
+    NULL);
+  if (rc != SQLITE_OK) {
+    *e = b_sqlite3_error(rc);
+    goto fail;
+  }
+
+  if (!migrate_schema_locked_(database, e)) {
+    goto fail;
+  }
+
+  // See NOTE[insert dependency query].
+  static char const insert_dependency_query[] = ""
+    "INSERT OR IGNORE INTO dependencies(\n"
+    "  from_question_uuid,\n"
+    "  from_question_data,\n"
+    "  to_question_uuid,\n"
+    "  to_question_data)\n"
+    "VALUES (?1, ?2, ?3, ?4);";
+  if (!b_sqlite3_prepare(
+      handle,
+      insert_dependency_query,
+      sizeof(insert_dependency_query),
+      &database->insert_dependency_stmt,
       e)) {
     goto fail;
   }
-  if (!b_answer_serialize_to_memory(
-      answer,
-      question_vtable->answer_vtable,
-      &answer_buffer.data,
-      &answer_buffer.size,
+
+  // See NOTE[insert answer query].
+  static char const insert_answer_query[] = ""
+    "INSERT OR REPLACE INTO answers(\n"
+    "  question_uuid,\n"
+    "  question_data,\n"
+    "  answer_data,\n"
+    "  recorded_at)\n"
+    "VALUES (?1, ?2, ?3, ?4);";
+  if (!b_sqlite3_prepare(
+      handle,
+      insert_answer_query,
+      sizeof(insert_answer_query),
+      &database->insert_answer_stmt,
       e)) {
     goto fail;
   }
-  return insert_answer_locked_(
-    database,
-    question_buffer,
-    question_vtable->uuid,
+
+  // See NOTE[select answer query].
+  static char const select_answer_query[] = ""
+    "SELECT answer_data\n"
+    "  FROM answers\n"
+    "  WHERE question_uuid = ?1\n"
+    "    AND question_data = ?2;";
+  if (!b_sqlite3_prepare(
+      handle,
+      select_answer_query,
+      sizeof(select_answer_query),
+      &database->select_answer_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[invalidation log].
+  static char const clear_invalidations_query[] = ""
+    "DELETE FROM invalidations;";
+  if (!b_sqlite3_prepare(
+      handle,
+      clear_invalidations_query,
+      sizeof(clear_invalidations_query),
+      &database->clear_invalidations_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[recheck all answers query].
+  static char const recheck_all_answers_query[] = ""
+    "-- Log out-of-date answers.\n"
+    "-- See NOTE[b_question_answer_matches].\n"
+    "INSERT INTO invalidations\n"
+    "  SELECT question_uuid, question_data,\n"
+    "      question_uuid, question_data,\n"
+    "      NULL, NULL,\n"
+    "      0\n"
+    "    FROM answers\n"
+    "    WHERE b_question_answer_matches(\n"
+    "          question_uuid,\n"
+    "          question_data,\n"
+    "          answer_data) == 0;";
+  if (!b_sqlite3_prepare(
+      handle,
+      recheck_all_answers_query,
+      sizeof(recheck_all_answers_query),
+      &database->recheck_all_answers_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[checked questions].
+  if (!exec_locked_(
+      database,
+      "CREATE TEMP TABLE checked_questions(\n"
+      "  question_uuid BLOB NOT NULL,\n"
+      "  question_data BLOB NOT NULL);",
+      e)) {
+    goto fail;
+  }
+  static char const insert_checked_question_query[] = ""
+    "INSERT INTO temp.checked_questions(\n"
+    "  question_uuid,\n"
+    "  question_data)\n"
+    "VALUES (?1, ?2);";
+  if (!b_sqlite3_prepare(
+      handle,
+      insert_checked_question_query,
+      sizeof(insert_checked_question_query),
+      &database->insert_checked_question_stmt,
+      e)) {
+    goto fail;
+  }
+  static char const clear_checked_questions_query[] = ""
+    "DELETE FROM temp.checked_questions;";
+  if (!b_sqlite3_prepare(
+      handle,
+      clear_checked_questions_query,
+      sizeof(clear_checked_questions_query),
+      &database->clear_checked_questions_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[recheck answers query].
+  static char const recheck_answers_query[] = ""
+    "-- Log out-of-date answers to checked questions.\n"
+    "INSERT INTO invalidations\n"
+    "  SELECT answers.question_uuid,\n"
+    "      answers.question_data,\n"
+    "      answers.question_uuid,\n"
+    "      answers.question_data,\n"
+    "      NULL, NULL,\n"
+    "      0\n"
+    "    FROM temp.checked_questions AS checked\n"
+    "    INNER JOIN answers\n"
+    "    ON answers.question_uuid = checked.question_uuid\n"
+    "       AND answers.question_data\n"
+    "         = checked.question_data\n"
+    "    WHERE b_question_answer_matches(\n"
+    "          answers.question_uuid,\n"
+    "          answers.question_data,\n"
+    "          answers.answer_data) == 0;";
+  if (!b_sqlite3_prepare(
+      handle,
+      recheck_answers_query,
+      sizeof(recheck_answers_query),
+      &database->recheck_answers_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[invalidate dependants query].
+  static char const invalidate_dependants_query[] = ""
+    "INSERT OR IGNORE INTO invalidations\n"
+    "  SELECT dep.from_question_uuid,\n"
+    "      dep.from_question_data,\n"
+    "      invalid.cause_question_uuid,\n"
+    "      invalid.cause_question_data,\n"
+    "      invalid.question_uuid,\n"
+    "      invalid.question_data,\n"
+    "      invalid.depth + 1\n"
+    "    FROM invalidations AS invalid\n"
+    "    INNER JOIN dependencies AS dep\n"
+    "    ON dep.to_question_uuid = invalid.question_uuid\n"
+    "       AND dep.to_question_data = invalid.question_data\n"
+    "    WHERE invalid.depth = ?1;";
+  if (!b_sqlite3_prepare(
+      handle,
+      invalidate_dependants_query,
+      sizeof(invalidate_dependants_query),
+      &database->invalidate_dependants_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[invalidation log].  CROSS JOIN makes SQLite
+  // look up each invalidation in answers, rather than
+  // scanning every answer.
+  static char const delete_invalidated_answers_query[] = ""
+    "DELETE FROM answers WHERE _rowid_ IN (\n"
+    "  SELECT answers._rowid_ FROM invalidations AS invalid\n"
+    "    CROSS JOIN answers\n"
+    "    ON answers.question_uuid = invalid.question_uuid\n"
+    "       AND answers.question_data = invalid.question_data);";
+  if (!b_sqlite3_prepare(
+      handle,
+      delete_invalidated_answers_query,
+      sizeof(delete_invalidated_answers_query),
+      &database->delete_invalidated_answers_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[select answered questions query].
+  static char const select_answered_questions_query[] = ""
+    "SELECT question_uuid, question_data\n"
+    "  FROM answers\n"
+    "  WHERE _rowid_ > ?1;";
+  if (!b_sqlite3_prepare(
+      handle,
+      select_answered_questions_query,
+      sizeof(select_answered_questions_query),
+      &database->select_answered_questions_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[answers mark].
+  static char const select_answers_mark_query[] = ""
+    "SELECT IFNULL(MAX(_rowid_), 0) FROM answers;";
+  if (!b_sqlite3_prepare(
+      handle,
+      select_answers_mark_query,
+      sizeof(select_answers_mark_query),
+      &database->select_answers_mark_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[select invalidations query].
+  static char const select_invalidations_query[] = ""
+    "SELECT\n"
+    "    question_uuid,\n"
+    "    question_data,\n"
+    "    cause_question_uuid,\n"
+    "    cause_question_data,\n"
+    "    parent_question_uuid,\n"
+    "    parent_question_data,\n"
+    "    depth\n"
+    "  FROM invalidations\n"
+    "  ORDER BY depth, _rowid_;";
+  if (!b_sqlite3_prepare(
+      handle,
+      select_invalidations_query,
+      sizeof(select_invalidations_query),
+      &database->select_invalidations_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[export answers query].
+  static char const export_answers_query[] = ""
+    "SELECT\n"
+    "    question_uuid,\n"
+    "    question_data,\n"
+    "    answer_data,\n"
+    "    recorded_at\n"
+    "  FROM answers;";
+  if (!b_sqlite3_prepare(
+      handle,
+      export_answers_query,
+      sizeof(export_answers_query),
+      &database->export_answers_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[export dependencies query].
+  static char const export_dependencies_query[] = ""
+    "SELECT\n"
+    "    from_question_uuid,\n"
+    "    from_question_data,\n"
+    "    to_question_uuid,\n"
+    "    to_question_data\n"
+    "  FROM dependencies;";
+  if (!b_sqlite3_prepare(
+      handle,
+      export_dependencies_query,
+      sizeof(export_dependencies_query),
+      &database->export_dependencies_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // Host parameters match NOTE[insert answer query].
+  // Answers already in the database take precedence over
+  // imported answers.
+  static char const import_answer_query[] = ""
+    "INSERT OR IGNORE INTO answers(\n"
+    "  question_uuid,\n"
+    "  question_data,\n"
+    "  answer_data,\n"
+    "  recorded_at)\n"
+    "VALUES (?1, ?2, ?3, ?4);";
+  if (!b_sqlite3_prepare(
+      handle,
+      import_answer_query,
+      sizeof(import_answer_query),
+      &database->import_answer_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // Host parameters match NOTE[insert dependency query].
+  static char const import_dependency_query[] = ""
+    "INSERT OR IGNORE INTO dependencies(\n"
+    "  from_question_uuid,\n"
+    "  from_question_data,\n"
+    "  to_question_uuid,\n"
+    "  to_question_data)\n"
+    "VALUES (?1, ?2, ?3, ?4);";
+  if (!b_sqlite3_prepare(
+      handle,
+      import_dependency_query,
+      sizeof(import_dependency_query),
+      &database->import_dependency_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[insert execution query].
+  static char const insert_execution_query[] = ""
+    "INSERT INTO executions(\n"
+    "  question_uuid,\n"
+    "  question_data,\n"
+    "  started_at,\n"
+    "  wall_time_us,\n"
+    "  cpu_time_us,\n"
+    "  peak_rss_bytes,\n"
+    "  exit_status,\n"
+    "  bytes_read,\n"
+    "  bytes_written)\n"
+    "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9);";
+  if (!b_sqlite3_prepare(
+      handle,
+      insert_execution_query,
+      sizeof(insert_execution_query),
+      &database->insert_execution_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[summarize executions query].
+  static char const summarize_executions_query[] = ""
+    "SELECT\n"
+    "    COUNT(*),\n"
+    "    TOTAL(exit_status != 0),\n"
+    "    AVG(CASE WHEN exit_status = 0\n"
+    "      THEN wall_time_us END),\n"
+    "    MAX(CASE WHEN exit_status = 0\n"
+    "      THEN wall_time_us END),\n"
+    "    AVG(CASE WHEN exit_status = 0\n"
+    "      THEN cpu_time_us END),\n"
+    "    MAX(peak_rss_bytes),\n"
+    "    AVG(bytes_read),\n"
+    "    AVG(bytes_written),\n"
+    "    MAX(started_at)\n"
+    "  FROM executions\n"
+    "  WHERE question_uuid = ?1\n"
+    "    AND question_data = ?2;";
+  if (!b_sqlite3_prepare(
+      handle,
+      summarize_executions_query,
+      sizeof(summarize_executions_query),
+      &database->summarize_executions_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[select dependencies query].
+  static char const select_dependencies_query[] = ""
+    "SELECT to_question_uuid, to_question_data\n"
+    "  FROM dependencies\n"
+    "  WHERE from_question_uuid = ?1\n"
+    "    AND from_question_data = ?2\n"
+    "  ORDER BY _rowid_;";
+  if (!b_sqlite3_prepare(
+      handle,
+      select_dependencies_query,
+      sizeof(select_dependencies_query),
+      &database->select_dependencies_stmt,
+      e)) {
+    goto fail;
+  }
+
+  // See NOTE[plan query] and NOTE[plan].  UNION (rather
+  // than UNION ALL) visits each question once, even if
+  // dependencies form a cycle.
+  static char const plan_query[] = ""
+    "WITH RECURSIVE plan(question_uuid, question_data) AS (\n"
+    "  SELECT ?1, ?2\n"
+    "  UNION\n"
+    "  SELECT to_question_uuid, to_question_data\n"
+    "    FROM plan\n"
+    "    JOIN dependencies\n"
+    "      ON from_question_uuid = plan.question_uuid\n"
+    "        AND from_question_data = plan.question_data\n"
+    "    WHERE NOT EXISTS (\n"
+    "      SELECT 1 FROM answers\n"
+    "        WHERE answers.question_uuid\n"
+    "            = plan.question_uuid\n"
+    "          AND answers.question_data\n"
+    "            = plan.question_data))\n"
+    "SELECT\n"
+    "    question_uuid,\n"
+    "    question_data,\n"
+    "    EXISTS (\n"
+    "      SELECT 1 FROM answers\n"
+    "        WHERE answers.question_uuid\n"
+    "            = plan.question_uuid\n"
+    "          AND answers.question_data\n"
+    "            = plan.question_data),\n"
+    "    (SELECT COUNT(*) FROM executions\n"
+    "      WHERE executions.question_uuid\n"
+    "          = plan.question_uuid\n"
+    "        AND executions.question_data\n"
+    "          = plan.question_data),\n"
+    "    (SELECT AVG(wall_time_us) FROM executions\n"
+    "      WHERE executions.question_uuid\n"
+    "          = plan.question_uuid\n"
+    "        AND executions.question_data\n"
+    "          = plan.question_data)\n"
+    "  FROM plan;";
+  if (!b_sqlite3_prepare(
+      handle,
+      plan_query,
+      sizeof(plan_query),
+      &database->plan_stmt,
+      e)) {
+    goto fail;
+  }
+
+  return true;
+
+fail:
+  // See NOTE[unprepare database].
+  return false;
+}
+
+static B_WUR B_FUNC bool
+migrate_schema_locked_(
+    B_BORROW struct B_Database *database,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_OUT_PARAMETER(e);
+
+  // See NOTE[schema version].
+  static char const user_version_query[]
+    = "PRAGMA user_version;";
+  int version;
+  if (!query_int_locked_(
+      database,
+      user_version_query,
+      sizeof(user_version_query),
+      &version,
+      e)) {
+    return false;
+  }
+  if (version == B_SCHEMA_VERSION_) {
+    // Avoid taking a write lock in the common case.
+    return true;
+  }
+
+  if (!exec_locked_(database, "BEGIN IMMEDIATE;", e)) {
+    return false;
+  }
+  // Another connection may have migrated the database
+  // while we were not holding a lock.
+  if (!query_int_locked_(
+      database,
+      user_version_query,
+      sizeof(user_version_query),
+      &version,
+      e)) {
+    goto fail;
+  }
+  if (version < 0 || version > B_SCHEMA_VERSION_) {
+    // The database was created by a newer version of b.
+    *e = (struct B_Error) {.posix_error = ENOTSUP};
+    goto fail;
+  }
+  for (size_t i = (size_t) version;
+      i < (size_t) B_SCHEMA_VERSION_;
+      ++i) {
+    if (!exec_locked_(
+        database, b_schema_migrations_[i], e)) {
+      goto fail;
+    }
+  }
+  if (!exec_locked_(database, "COMMIT;", e)) {
+    goto fail;
+  }
+  return true;
+
+fail:
+  (void) exec_locked_(
+    database,
+    "ROLLBACK;",
+    &(struct B_Error) {.posix_error = 0});
+  return false;
+}
+
+// NOTE[merge query]: Answers missing from the destination
+// are copied.  If both databases have an answer for a
+// question, the destination's answer is kept unless the
+// source's answer differs and was recorded more recently.
+// Dependencies are unioned.
+//
+// Each source row costs one index probe, so merging is
+// linear in the size of the source database.
+static B_WUR B_FUNC bool
+merge_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW char const *sqlite_path,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(sqlite_path);
+  B_OUT_PARAMETER(e);
+
+  bool ok;
+  int rc;
+
+  // ATTACH creates missing databases.  Report an error
+  // instead.
+  if (access(sqlite_path, F_OK) != 0) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+
+  static char const attach_query[]
+    = "ATTACH DATABASE ?1 AS merge_source;";
+  sqlite3_stmt *attach_stmt;
+  if (!b_sqlite3_prepare(
+      database->handle,
+      attach_query,
+      sizeof(attach_query),
+      &attach_stmt,
+      e)) {
+    return false;
+  }
+  rc = sqlite3_bind_text(
+    attach_stmt, 1, sqlite_path, -1, SQLITE_STATIC);
+  if (rc != SQLITE_OK) {
+    *e = b_sqlite3_error(rc);
+    ok = false;
+  } else {
+    ok = b_sqlite3_step_expecting_end(attach_stmt, e);
+  }
+  (void) sqlite3_finalize(attach_stmt);
+  if (!ok) {
+    return false;
+  }
+
+  static char const user_version_query[]
+    = "PRAGMA merge_source.user_version;";
+  int version;
+  ok = query_int_locked_(
+    database,
+    user_version_query,
+    sizeof(user_version_query),
+    &version,
+    e);
+  if (!ok) goto detach;
+  if (version != B_SCHEMA_VERSION_) {
+    // The source database is not migrated, so it must
+    // have been written by this version.
+    *e = (struct B_Error) {.posix_error = ENOTSUP};
+    ok = false;
+    goto detach;
+  }
+
+  // See NOTE[merge query].
+  static char const merge_query[] = ""
+    "INSERT OR REPLACE INTO main.answers(\n"
+    "    question_uuid,\n"
+    "    question_data,\n"
+    "    answer_data,\n"
+    "    recorded_at)\n"
+    "  SELECT source.question_uuid,\n"
+    "      source.question_data,\n"
+    "      source.answer_data,\n"
+    "      source.recorded_at\n"
+    "    FROM merge_source.answers AS source\n"
+    "    LEFT JOIN main.answers AS destination\n"
+    "    ON destination.question_uuid = source.question_uuid\n"
+    "       AND destination.question_data\n"
+    "         = source.question_data\n"
+    "    WHERE destination._rowid_ IS NULL\n"
+    "       OR (source.recorded_at > destination.recorded_at\n"
+    "           AND source.answer_data\n"
+    "             != destination.answer_data);\n"
+    "INSERT OR IGNORE INTO main.dependencies(\n"
+    "    from_question_uuid,\n"
+    "    from_question_data,\n"
+    "    to_question_uuid,\n"
+    "    to_question_data)\n"
+    "  SELECT from_question_uuid,\n"
+    "      from_question_data,\n"
+    "      to_question_uuid,\n"
+    "      to_question_data\n"
+    "    FROM merge_source.dependencies;";
+  ok = exec_locked_(database, "BEGIN IMMEDIATE;", e);
+  if (!ok) goto detach;
+  ok = exec_locked_(database, merge_query, e)
+    && exec_locked_(database, "COMMIT;", e);
+  if (!ok) {
+    (void) exec_locked_(
+      database,
+      "ROLLBACK;",
+      &(struct B_Error) {.posix_error = 0});
+  }
+
+detach:
+  (void) exec_locked_(
+    database,
+    "DETACH DATABASE merge_source;",
+    &(struct B_Error) {.posix_error = 0});
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+record_answer_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_BORROW struct B_IAnswer const *answer,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_PRECONDITION(answer);
+  B_OUT_PARAMETER(e);
+
+  struct Buffer_ question_buffer = {
+    .data = NULL,
+    .size = 0,
+  };
+  struct Buffer_ answer_buffer = {
+    .data = NULL,
+    .size = 0,
+  };
+  if (!b_question_serialize_to_memory(
+      question,
+      question_vtable,
+      &question_buffer.data,
+      &question_buffer.size,
+      e)) {
+    goto fail;
+  }
+  if (!b_answer_serialize_to_memory(
+      answer,
+      question_vtable->answer_vtable,
+      &answer_buffer.data,
+      &answer_buffer.size,
+      e)) {
+    goto fail;
+  }
+  if (!encode_buffer_(&question_buffer, e)) {
+    goto fail;
+  }
+  if (!encode_buffer_(&answer_buffer, e)) {
+    goto fail;
+  }
+  return insert_answer_locked_(
+    database,
+    database->insert_answer_stmt,
+    question_buffer,
+    question_vtable->uuid,
     answer_buffer,
+    current_time_ms_(),
+    e);
+
+fail:
+  if (question_buffer.data) {
+    b_deallocate(question_buffer.data);
+  }
+  if (answer_buffer.data) {
+    b_deallocate(answer_buffer.data);
+  }
+  return false;
+}
+
+static B_WUR B_FUNC bool
+insert_answer_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW sqlite3_stmt *stmt,
+    B_TRANSFER struct Buffer_ question_data,
+    B_BORROW struct B_UUID const question_uuid,
+    B_TRANSFER struct Buffer_ answer_data,
+    int64_t recorded_at,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(stmt);
+
+  bool ok;
+  int rc;
+
+  bool need_free_question_data = true;
+  bool need_free_answer_data = true;
+
+  ok = bind_buffer_(
+    stmt, B_INSERT_ANSWER_QUESTION_DATA, question_data, e);
+  // FIXME(strager): Is this correct?
+  need_free_question_data = false;
+  if (!ok) goto done_no_reset;
+
+  ok = bind_uuid_(
+    stmt, B_INSERT_ANSWER_QUESTION_UUID, question_uuid, e);
+  if (!ok) goto done_no_reset;
+
+  ok = bind_buffer_(
+    stmt, B_INSERT_ANSWER_ANSWER_DATA, answer_data, e);
+  // FIXME(strager): Is this correct?
+  need_free_answer_data = false;
+  if (!ok) goto done_no_reset;
+
+  rc = sqlite3_bind_int64(
+    stmt, B_INSERT_ANSWER_RECORDED_AT, recorded_at);
+  if (rc != SQLITE_OK) {
+    *e = b_sqlite3_error(rc);
+    ok = false;
+    goto done_no_reset;
+  }
+
+  ok = b_sqlite3_step_expecting_end(stmt, e);
+  // TODO(strager): Error reporting.
+  (void) sqlite3_reset(stmt);
+
+done_no_reset:
+  (void) sqlite3_clear_bindings(stmt);
+  if (need_free_question_data) {
+    b_deallocate(question_data.data);
+  }
+  if (need_free_answer_data) {
+    b_deallocate(answer_data.data);
+  }
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+record_dependencies_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *from,
+    B_BORROW struct B_QuestionVTable const *from_vtable,
+    B_BORROW struct B_IQuestion const *const *to,
+    B_BORROW struct B_QuestionVTable const *const *
+      to_vtables,
+    size_t to_count,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(from);
+  B_PRECONDITION(from_vtable);
+  B_PRECONDITION(to);
+  B_PRECONDITION(to_vtables);
+  B_OUT_PARAMETER(e);
+
+  // Serialize and bind from only once.  Resetting the
+  // statement for each row keeps its bindings.
+  sqlite3_stmt *stmt = database->insert_dependency_stmt;
+  bool ok;
+  struct Buffer_ from_buffer = {
+    .data = NULL,
+    .size = 0,
+  };
+  if (!b_question_serialize_to_memory(
+      from,
+      from_vtable,
+      &from_buffer.data,
+      &from_buffer.size,
+      e)) {
+    return false;
+  }
+  if (!encode_buffer_(&from_buffer, e)) {
+    ok = false;
+    goto done;
+  }
+  ok = bind_uuid_(
+    stmt,
+    B_INSERT_DEPENDENCY_FROM_QUESTION_UUID,
+    from_vtable->uuid,
+    e);
+  if (!ok) goto done;
+  // b_sqlite3_bind_blob does not accept SQLITE_STATIC, so
+  // sqlite3 copies from_buffer, but only once.
+  ok = b_sqlite3_bind_blob(
+    stmt,
+    B_INSERT_DEPENDENCY_FROM_QUESTION_DATA,
+    from_buffer.data,
+    from_buffer.size,
+    SQLITE_TRANSIENT,
+    e);
+  if (!ok) goto done;
+  for (size_t i = 0; i < to_count; ++i) {
+    B_ASSERT(to[i]);
+    B_ASSERT(to_vtables[i]);
+    struct Buffer_ to_buffer;
+    ok = b_question_serialize_to_memory(
+      to[i],
+      to_vtables[i],
+      &to_buffer.data,
+      &to_buffer.size,
+      e);
+    if (!ok) goto done;
+    ok = encode_buffer_(&to_buffer, e);
+    if (!ok) {
+      b_deallocate(to_buffer.data);
+      goto done;
+    }
+    ok = bind_uuid_(
+      stmt,
+      B_INSERT_DEPENDENCY_TO_QUESTION_UUID,
+      to_vtables[i]->uuid,
+      e);
+    if (!ok) {
+      b_deallocate(to_buffer.data);
+      goto done;
+    }
+    ok = bind_buffer_(
+      stmt,
+      B_INSERT_DEPENDENCY_TO_QUESTION_DATA,
+      to_buffer,
+      e);
+    if (!ok) goto done;
+    ok = b_sqlite3_step_expecting_end(stmt, e);
+    // Any error was raised by sqlite3_step already.
+    (void) sqlite3_reset(stmt);
+    if (!ok) goto done;
+  }
+
+done:
+  (void) sqlite3_clear_bindings(stmt);
+  b_deallocate(from_buffer.data);
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+insert_dependency_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW sqlite3_stmt *stmt,
+    B_TRANSFER struct Buffer_ from_data,
+    struct B_UUID const from_uuid,
+    B_TRANSFER struct Buffer_ to_data,
+    struct B_UUID const to_uuid,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(stmt);
+  B_PRECONDITION(from_data.data);
+  B_PRECONDITION(to_data.data);
+  B_OUT_PARAMETER(e);
+
+  bool ok;
+
+  bool need_free_from_data = true;
+  bool need_free_to_data = true;
+
+  ok = bind_uuid_(
+    stmt,
+    B_INSERT_DEPENDENCY_FROM_QUESTION_UUID,
+    from_uuid,
+    e);
+  if (!ok) goto done_no_reset;
+
+  ok = bind_buffer_(
+    stmt,
+    B_INSERT_DEPENDENCY_FROM_QUESTION_DATA,
+    from_data,
+    e);
+  need_free_from_data = false;
+  if (!ok) goto done_no_reset;
+
+  ok = bind_uuid_(
+    stmt,
+    B_INSERT_DEPENDENCY_TO_QUESTION_UUID,
+    to_uuid,
+    e);
+  if (!ok) goto done_no_reset;
+
+  ok = bind_buffer_(
+    stmt,
+    B_INSERT_DEPENDENCY_TO_QUESTION_DATA,
+    to_data,
+    e);
+  need_free_to_data = false;
+  if (!ok) goto done_no_reset;
+
+  ok = b_sqlite3_step_expecting_end(stmt, e);
+  // TODO(strager): Error reporting.
+  (void) sqlite3_reset(stmt);
+
+done_no_reset:
+  (void) sqlite3_clear_bindings(stmt);
+  if (need_free_from_data) {
+    b_deallocate(from_data.data);
+  }
+  if (need_free_to_data) {
+    b_deallocate(to_data.data);
+  }
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+look_up_answer_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_OPTIONAL_OUT_TRANSFER struct B_IAnswer **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  bool ok;
+  int rc;
+
+  bool need_free_question_buffer = true;
+
+  struct Buffer_ question_buffer;
+  if (!b_question_serialize_to_memory(
+      question,
+      question_vtable,
+      &question_buffer.data,
+      &question_buffer.size,
+      e)) {
+    return false;
+  }
+  if (!encode_buffer_(&question_buffer, e)) {
+    b_deallocate(question_buffer.data);
+    return false;
+  }
+
+  sqlite3_stmt *stmt = database->select_answer_stmt;
+
+  ok = bind_buffer_(
+    stmt,
+    B_SELECT_ANSWER_QUESTION_DATA,
+    question_buffer,
+    e);
+  need_free_question_buffer = false;
+  if (!ok) goto done_no_reset;
+
+  ok = bind_uuid_(
+    stmt,
+    B_SELECT_ANSWER_QUESTION_UUID,
+    question_vtable->uuid,
+    e);
+  if (!ok) goto done_no_reset;
+
+  // Grab the first row.
+  rc = sqlite3_step(stmt);
+  if (rc == SQLITE_DONE) {
+    // No data.
+    *out = NULL;
+    ok = true;
+    goto done_reset;
+  } else if (rc != SQLITE_ROW) {
+    B_ASSERT(rc != SQLITE_OK);
+    *e = b_sqlite3_error(rc);
+    ok = false;
+    goto done_reset;
+  }
+
+  // Deserialize the answer.
+  struct Buffer_ answer_buffer;
+  // NOTE(strager): answer_buffer.data is valid until
+  // the call to b_sqlite3_step_expecting_end.
+  // NOTE(strager): Calls must be performed in this order
+  // (sqlite3_column_blob then sqlite3_column_bytes)
+  // according to the sqlite3 documentation.
+  answer_buffer.data = (void *) sqlite3_column_blob(
+    stmt, B_SELECT_ANSWER_ANSWER_DATA);
+  if (!answer_buffer.data
+      && sqlite3_errcode(database->handle)
+        == SQLITE_NOMEM) {
+    *e = b_sqlite3_error(SQLITE_NOMEM);
+    ok = false;
+    goto done_reset;
+  }
+  answer_buffer.size = (size_t) sqlite3_column_bytes(
+    stmt, B_SELECT_ANSWER_ANSWER_DATA);
+  if (!answer_buffer.data) {
+    // "The return value from sqlite3_column_blob() for
+    // a zero-length BLOB is a NULL pointer."
+    B_ASSERT(answer_buffer.size == 0);
+  }
+  struct DecodedBuffer_ decoded_answer;
+  ok = decode_buffer_(
+    answer_buffer.data,
+    answer_buffer.size,
+    &decoded_answer,
+    e);
+  if (!ok) {
+    goto done_reset;
+  }
+  struct B_IAnswer *answer;
+  ok = b_answer_deserialize_from_memory(
+    question_vtable->answer_vtable,
+    decoded_answer.data,
+    decoded_answer.size,
+    &answer,
+    e);
+  release_decoded_buffer_(&decoded_answer);
+  // Ignore errors, as our lookup is done.
+  (void) b_sqlite3_step_expecting_end(
+    stmt, &(struct B_Error) {.posix_error = 0});
+  if (!ok) {
+    goto done_reset;
+  }
+  *out = answer;
+
+  // TODO(strager): Error reporting.
+done_reset:
+  (void) sqlite3_reset(stmt);
+
+done_no_reset:
+  (void) sqlite3_clear_bindings(stmt);
+  if (need_free_question_buffer) {
+    b_deallocate(question_buffer.data);
+  }
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+look_up_answers_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t count,
+    B_OUT_TRANSFER struct B_IAnswer **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(questions);
+  B_PRECONDITION(question_vtables);
+  B_PRECONDITION(out);
+  B_OUT_PARAMETER(e);
+
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = NULL;
+  }
+  // One read transaction takes the database's shared lock
+  // once for all lookups.
+  if (!exec_locked_(database, "BEGIN;", e)) {
+    return false;
+  }
+  size_t i;
+  for (i = 0; i < count; ++i) {
+    if (!look_up_answer_locked_(
+        database,
+        questions[i],
+        question_vtables[i],
+        &out[i],
+        e)) {
+      goto fail;
+    }
+  }
+  if (!exec_locked_(database, "COMMIT;", e)) {
+    goto fail;
+  }
+  return true;
+
+fail:
+  (void) exec_locked_(
+    database,
+    "ROLLBACK;",
+    &(struct B_Error) {.posix_error = 0});
+  for (size_t j = 0; j < i; ++j) {
+    if (out[j]) {
+      question_vtables[j]->answer_vtable->deallocate(
+        out[j]);
+      out[j] = NULL;
+    }
+  }
+  return false;
+}
+
+static B_WUR B_FUNC bool
+b_check_all_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(vtables);
+  B_OUT_PARAMETER(e);
+
+  // Clearing the log, logging, and deleting must be
+  // atomic so the log describes the deleted answers.
+  if (!exec_locked_(database, "BEGIN IMMEDIATE;", e)) {
+    return false;
+  }
+
+  database->udf.vtables = vtables;
+  database->udf.vtable_count = vtable_count;
+
+  // See NOTE[invalidation log].
+  sqlite3_stmt *const log_stmts[] = {
+    database->clear_invalidations_stmt,
+    database->recheck_all_answers_stmt,
+  };
+  sqlite3_stmt *const delete_stmts[] = {
+    database->delete_invalidated_answers_stmt,
+  };
+  bool ok = step_statements_(
+    log_stmts, sizeof(log_stmts) / sizeof(*log_stmts), e);
+  if (ok) {
+    ok = invalidate_dependants_locked_(database, e);
+  }
+  if (ok) {
+    ok = step_statements_(
+      delete_stmts,
+      sizeof(delete_stmts) / sizeof(*delete_stmts),
+      e);
+  }
+
+  database->udf.vtables = NULL;
+  database->udf.vtable_count = 0;
+
+  if (ok) {
+    ok = exec_locked_(database, "COMMIT;", e);
+  }
+  if (!ok) {
+    (void) exec_locked_(
+      database,
+      "ROLLBACK;",
+      &(struct B_Error) {.posix_error = 0});
+  }
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+check_changed_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t question_count,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(questions || question_count == 0);
+  B_PRECONDITION(question_vtables || question_count == 0);
+  B_PRECONDITION(vtables);
+  B_OUT_PARAMETER(e);
+
+  // See b_check_all_locked_.
+  if (!exec_locked_(database, "BEGIN IMMEDIATE;", e)) {
+    return false;
+  }
+
+  database->udf.vtables = vtables;
+  database->udf.vtable_count = vtable_count;
+
+  // See NOTE[checked questions].
+  bool ok = true;
+  for (size_t i = 0; ok && i < question_count; ++i) {
+    ok = insert_checked_question_locked_(
+      database, questions[i], question_vtables[i], e);
+  }
+  // See NOTE[invalidation log].
+  sqlite3_stmt *const log_stmts[] = {
+    database->clear_invalidations_stmt,
+    database->recheck_answers_stmt,
+  };
+  sqlite3_stmt *const delete_stmts[] = {
+    database->delete_invalidated_answers_stmt,
+    database->clear_checked_questions_stmt,
+  };
+  if (ok) {
+    ok = step_statements_(
+      log_stmts, sizeof(log_stmts) / sizeof(*log_stmts), e);
+  }
+  if (ok) {
+    ok = invalidate_dependants_locked_(database, e);
+  }
+  if (ok) {
+    ok = step_statements_(
+      delete_stmts,
+      sizeof(delete_stmts) / sizeof(*delete_stmts),
+      e);
+  }
+
+  database->udf.vtables = NULL;
+  database->udf.vtable_count = 0;
+
+  if (ok) {
+    ok = exec_locked_(database, "COMMIT;", e);
+  }
+  if (!ok) {
+    // Rolling back also empties temp.checked_questions.
+    (void) exec_locked_(
+      database,
+      "ROLLBACK;",
+      &(struct B_Error) {.posix_error = 0});
+  }
+  return ok;
+}
+
+// Steps each statement once, in order, stopping at the
+// first error.
+static B_WUR B_FUNC bool
+step_statements_(
+    B_BORROW sqlite3_stmt *const *stmts,
+    size_t count,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(stmts);
+  B_OUT_PARAMETER(e);
+
+  for (size_t i = 0; i < count; ++i) {
+    bool ok = b_sqlite3_step_expecting_end(stmts[i], e);
+    // Any error was raised by sqlite3_step already.
+    (void) sqlite3_reset(stmts[i]);
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// See NOTE[invalidate dependants query].
+static B_WUR B_FUNC bool
+invalidate_dependants_locked_(
+    B_BORROW struct B_Database *database,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_OUT_PARAMETER(e);
+
+  sqlite3_stmt *stmt = database->invalidate_dependants_stmt;
+  for (int64_t depth = 0;; ++depth) {
+    int rc = sqlite3_bind_int64(
+      stmt, B_INVALIDATE_DEPENDANTS_DEPTH, depth);
+    if (rc != SQLITE_OK) {
+      *e = b_sqlite3_error(rc);
+      return false;
+    }
+    bool ok = b_sqlite3_step_expecting_end(stmt, e);
+    // Any error was raised by sqlite3_step already.
+    (void) sqlite3_reset(stmt);
+    if (!ok) {
+      return false;
+    }
+    if (sqlite3_changes(database->handle) == 0) {
+      return true;
+    }
+  }
+}
+
+static B_WUR B_FUNC bool
+insert_checked_question_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_OUT_PARAMETER(e);
+
+  struct Buffer_ question_buffer;
+  if (!encode_question_(
+      question, question_vtable, &question_buffer, e)) {
+    return false;
+  }
+
+  sqlite3_stmt *stmt
+    = database->insert_checked_question_stmt;
+  bool ok;
+
+  ok = bind_buffer_(
+    stmt,
+    B_INSERT_CHECKED_QUESTION_DATA,
+    question_buffer,
+    e);
+  if (!ok) goto done;
+
+  ok = bind_uuid_(
+    stmt,
+    B_INSERT_CHECKED_QUESTION_UUID,
+    question_vtable->uuid,
+    e);
+  if (!ok) goto done;
+
+  ok = b_sqlite3_step_expecting_end(stmt, e);
+  // Any error was raised by sqlite3_step already.
+  (void) sqlite3_reset(stmt);
+
+done:
+  (void) sqlite3_clear_bindings(stmt);
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+answered_questions_locked_(
+    B_BORROW struct B_Database *database,
+    int64_t mark,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW B_QuestionCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(mark >= 0);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(e);
+
+  sqlite3_stmt *stmt
+    = database->select_answered_questions_stmt;
+  int rc = sqlite3_bind_int64(
+    stmt, B_SELECT_ANSWERED_QUESTIONS_MARK, mark);
+  if (rc != SQLITE_OK) {
+    *e = b_sqlite3_error(rc);
+    return false;
+  }
+  bool ok;
+  for (;;) {
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE) {
+      ok = true;
+      break;
+    } else if (rc != SQLITE_ROW) {
+      B_ASSERT(rc != SQLITE_OK);
+      *e = b_sqlite3_error(rc);
+      ok = false;
+      break;
+    }
+    struct B_UUID uuid;
+    ok = value_uuid_(
+      sqlite3_column_value(
+        stmt, B_SELECT_ANSWERED_QUESTIONS_QUESTION_UUID),
+      &uuid,
+      e);
+    if (!ok) break;
+    if (!find_question_vtable_(
+        vtables, vtable_count, &uuid)) {
+      // Skip questions the caller does not know about.
+      continue;
+    }
+    struct B_IQuestion const *question;
+    struct B_QuestionVTable const *question_vtable;
+    ok = column_question_(
+      stmt,
+      B_SELECT_ANSWERED_QUESTIONS_QUESTION_UUID,
+      B_SELECT_ANSWERED_QUESTIONS_QUESTION_DATA,
+      vtables,
+      vtable_count,
+      &question,
+      &question_vtable,
+      e);
+    if (!ok) break;
+    ok = callback(
+      callback_opaque, question, question_vtable, e);
+    question_vtable->deallocate(
+      (struct B_IQuestion *) question);
+    if (!ok) break;
+  }
+  // Any error was raised by sqlite3_step already.
+  (void) sqlite3_reset(stmt);
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+invalidations_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW B_InvalidationCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(e);
+
+  sqlite3_stmt *stmt = database->select_invalidations_stmt;
+  struct B_Invalidation invalidation = {
+    .question = NULL,
+    .question_vtable = NULL,
+    .cause = NULL,
+    .cause_vtable = NULL,
+    .parent = NULL,
+    .parent_vtable = NULL,
+    .depth = 0,
+  };
+  bool ok;
+  for (;;) {
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE) {
+      ok = true;
+      break;
+    } else if (rc != SQLITE_ROW) {
+      B_ASSERT(rc != SQLITE_OK);
+      *e = b_sqlite3_error(rc);
+      ok = false;
+      break;
+    }
+    ok = column_question_(
+      stmt,
+      B_SELECT_INVALIDATIONS_QUESTION_UUID,
+      B_SELECT_INVALIDATIONS_QUESTION_DATA,
+      vtables,
+      vtable_count,
+      &invalidation.question,
+      &invalidation.question_vtable,
+      e);
+    if (!ok) break;
+    ok = column_question_(
+      stmt,
+      B_SELECT_INVALIDATIONS_CAUSE_QUESTION_UUID,
+      B_SELECT_INVALIDATIONS_CAUSE_QUESTION_DATA,
+      vtables,
+      vtable_count,
+      &invalidation.cause,
+      &invalidation.cause_vtable,
+      e);
+    if (!ok) break;
+    if (sqlite3_column_type(
+        stmt, B_SELECT_INVALIDATIONS_PARENT_QUESTION_UUID)
+        != SQLITE_NULL) {
+      ok = column_question_(
+        stmt,
+        B_SELECT_INVALIDATIONS_PARENT_QUESTION_UUID,
+        B_SELECT_INVALIDATIONS_PARENT_QUESTION_DATA,
+        vtables,
+        vtable_count,
+        &invalidation.parent,
+        &invalidation.parent_vtable,
+        e);
+      if (!ok) break;
+    }
+    sqlite3_int64 depth = sqlite3_column_int64(
+      stmt, B_SELECT_INVALIDATIONS_DEPTH);
+    B_ASSERT(depth >= 0);
+    invalidation.depth = (size_t) depth;
+
+    ok = callback(callback_opaque, &invalidation, e);
+    if (!ok) break;
+    release_invalidation_(&invalidation);
+  }
+  release_invalidation_(&invalidation);
+  // Any error was raised by sqlite3_step already.
+  (void) sqlite3_reset(stmt);
+  return ok;
+}
+
+static void
+release_invalidation_(
+    B_BORROW struct B_Invalidation *invalidation) {
+  B_PRECONDITION(invalidation);
+
+  if (invalidation->question) {
+    invalidation->question_vtable->deallocate(
+      (struct B_IQuestion *) invalidation->question);
+    invalidation->question = NULL;
+  }
+  if (invalidation->cause) {
+    invalidation->cause_vtable->deallocate(
+      (struct B_IQuestion *) invalidation->cause);
+    invalidation->cause = NULL;
+  }
+  if (invalidation->parent) {
+    invalidation->parent_vtable->deallocate(
+      (struct B_IQuestion *) invalidation->parent);
+    invalidation->parent = NULL;
+  }
+}
+
+static B_WUR B_FUNC bool
+recorded_dependencies_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW B_DependencyCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(e);
+
+  struct Buffer_ question_buffer;
+  if (!encode_question_(
+      question, question_vtable, &question_buffer, e)) {
+    return false;
+  }
+
+  sqlite3_stmt *stmt = database->select_dependencies_stmt;
+  struct B_IQuestion const *dependency = NULL;
+  struct B_QuestionVTable const *dependency_vtable = NULL;
+  bool ok;
+
+  ok = bind_buffer_(
+    stmt,
+    B_SELECT_DEPENDENCIES_FROM_QUESTION_DATA,
+    question_buffer,
+    e);
+  if (!ok) goto done_no_reset;
+
+  ok = bind_uuid_(
+    stmt,
+    B_SELECT_DEPENDENCIES_FROM_QUESTION_UUID,
+    question_vtable->uuid,
+    e);
+  if (!ok) goto done_no_reset;
+
+  for (;;) {
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE) {
+      ok = true;
+      break;
+    } else if (rc != SQLITE_ROW) {
+      B_ASSERT(rc != SQLITE_OK);
+      *e = b_sqlite3_error(rc);
+      ok = false;
+      break;
+    }
+    struct B_UUID uuid;
+    ok = value_uuid_(
+      sqlite3_column_value(
+        stmt, B_SELECT_DEPENDENCIES_TO_QUESTION_UUID),
+      &uuid,
+      e);
+    if (!ok) break;
+    if (!find_question_vtable_(
+        vtables, vtable_count, &uuid)) {
+      // Skip questions the caller does not know about.
+      continue;
+    }
+    ok = column_question_(
+      stmt,
+      B_SELECT_DEPENDENCIES_TO_QUESTION_UUID,
+      B_SELECT_DEPENDENCIES_TO_QUESTION_DATA,
+      vtables,
+      vtable_count,
+      &dependency,
+      &dependency_vtable,
+      e);
+    if (!ok) break;
+    ok = callback(
+      callback_opaque, dependency, dependency_vtable, e);
+    dependency_vtable->deallocate(
+      (struct B_IQuestion *) dependency);
+    if (!ok) break;
+  }
+  // Any error was raised by sqlite3_step already.
+  (void) sqlite3_reset(stmt);
+
+done_no_reset:
+  (void) sqlite3_clear_bindings(stmt);
+  return ok;
+}
+
+// NOTE[plan]: b_database_plan predicts what answering
+// questions would do.  A question with an answer would be
+// reused, so its dependencies would not be asked.  A
+// question without an answer would be answered, and would
+// probably ask the dependencies recorded when it was last
+// answered.  A single recursive query walks these
+// dependencies, so planning costs no more than one query
+// per root, and no question callbacks run.
+//
+// Each entry's estimated time is the question's mean
+// recorded wall time, which excludes time spent waiting
+// on its dependencies (see NOTE[execution time]).  Summing
+// the entries' times thus estimates the plan's serial
+// cost without counting any subtree twice.
+static B_WUR B_FUNC bool
+plan_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *const *roots,
+    B_BORROW struct B_QuestionVTable const *const *
+      root_vtables,
+    size_t root_count,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW B_PlanCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(roots);
+  B_PRECONDITION(root_vtables);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(e);
+
+  // Questions already reported, for questions reachable
+  // from several roots.
+  struct B_QuestionMap *visited;
+  if (!b_question_map_allocate(&visited, e)) {
+    return false;
+  }
+  bool ok = true;
+  for (size_t i = 0; ok && i < root_count; ++i) {
+    ok = plan_root_locked_(
+      database,
+      roots[i],
+      root_vtables[i],
+      vtables,
+      vtable_count,
+      visited,
+      callback,
+      callback_opaque,
+      e);
+  }
+  b_question_map_deallocate(visited);
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+plan_root_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_IQuestion const *root,
+    B_BORROW struct B_QuestionVTable const *root_vtable,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW struct B_QuestionMap *visited,
+    B_BORROW B_PlanCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(root);
+  B_PRECONDITION(root_vtable);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(visited);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(e);
+
+  struct Buffer_ root_buffer;
+  if (!encode_question_(
+      root, root_vtable, &root_buffer, e)) {
+    return false;
+  }
+
+  sqlite3_stmt *stmt = database->plan_stmt;
+  bool ok;
+
+  ok = bind_buffer_(
+    stmt, B_PLAN_ROOT_QUESTION_DATA, root_buffer, e);
+  if (!ok) goto done_no_reset;
+
+  ok = bind_uuid_(
+    stmt, B_PLAN_ROOT_QUESTION_UUID, root_vtable->uuid, e);
+  if (!ok) goto done_no_reset;
+
+  for (;;) {
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE) {
+      ok = true;
+      break;
+    } else if (rc != SQLITE_ROW) {
+      B_ASSERT(rc != SQLITE_OK);
+      *e = b_sqlite3_error(rc);
+      ok = false;
+      break;
+    }
+    struct B_UUID uuid;
+    ok = value_uuid_(
+      sqlite3_column_value(stmt, B_PLAN_QUESTION_UUID),
+      &uuid,
+      e);
+    if (!ok) break;
+    if (!find_question_vtable_(
+        vtables, vtable_count, &uuid)) {
+      // Skip questions the caller does not know about.
+      continue;
+    }
+    struct B_IQuestion const *question;
+    struct B_QuestionVTable const *question_vtable;
+    ok = column_question_(
+      stmt,
+      B_PLAN_QUESTION_UUID,
+      B_PLAN_QUESTION_DATA,
+      vtables,
+      vtable_count,
+      &question,
+      &question_vtable,
+      e);
+    if (!ok) break;
+
+    struct B_QuestionKey key;
+    ok = b_question_key_initialize(
+      question, question_vtable, &key, e);
+    if (!ok) {
+      question_vtable->deallocate(
+        (struct B_IQuestion *) question);
+      break;
+    }
+    void *found;
+    b_question_map_find(visited, &key, &found);
+    if (found) {
+      b_question_key_deinitialize(&key);
+      question_vtable->deallocate(
+        (struct B_IQuestion *) question);
+      continue;
+    }
+    // The map's values are unused, but must be non-NULL.
+    ok = b_question_map_insert(
+      visited, &key, (void *) question_vtable, e);
+    if (!ok) {
+      b_question_key_deinitialize(&key);
+      question_vtable->deallocate(
+        (struct B_IQuestion *) question);
+      break;
+    }
+
+    // NOTE(strager): NULL (AVG of no rows) reads as 0.
+    struct B_PlanEntry entry = {
+      .question = question,
+      .question_vtable = question_vtable,
+      .will_execute
+        = !sqlite3_column_int(stmt, B_PLAN_ANSWERED),
+      .execution_count = sqlite3_column_int64(
+        stmt, B_PLAN_EXECUTION_COUNT),
+      .mean_wall_time_us = sqlite3_column_int64(
+        stmt, B_PLAN_MEAN_WALL_TIME_US),
+    };
+    ok = callback(callback_opaque, &entry, e);
+    question_vtable->deallocate(
+      (struct B_IQuestion *) question);
+    if (!ok) break;
+  }
+  // Any error was raised by sqlite3_step already.
+  (void) sqlite3_reset(stmt);
+
+done_no_reset:
+  (void) sqlite3_clear_bindings(stmt);
+  return ok;
+}
+
+// Returns the vtable in vtables with the given UUID, or
+// NULL if there is none.
+static B_FUNC struct B_QuestionVTable const *
+find_question_vtable_(
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_BORROW struct B_UUID const *uuid) {
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(uuid);
+
+  for (size_t i = 0; i < vtable_count; ++i) {
+    if (b_uuid_equal(&vtables[i]->uuid, uuid)) {
+      return vtables[i];
+    }
+  }
+  return NULL;
+}
+
+// Deserializes a question stored in the given columns.  If
+// the question's UUID does not match any of vtables,
+// raises ENOENT.
+static B_WUR B_FUNC bool
+column_question_(
+    B_BORROW sqlite3_stmt *stmt,
+    int uuid_column,
+    int data_column,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count,
+    B_OUT_TRANSFER struct B_IQuestion const **out,
+    B_OUT_BORROW struct B_QuestionVTable const **out_vtable,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(stmt);
+  B_PRECONDITION(vtables);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(out_vtable);
+  B_OUT_PARAMETER(e);
+
+  struct B_UUID uuid;
+  if (!value_uuid_(
+      sqlite3_column_value(stmt, uuid_column), &uuid, e)) {
+    return false;
+  }
+  struct B_QuestionVTable const *question_vtable
+    = find_question_vtable_(vtables, vtable_count, &uuid);
+  if (!question_vtable) {
+    *e = (struct B_Error) {.posix_error = ENOENT};
+    return false;
+  }
+
+  void const *data;
+  size_t data_size;
+  if (!b_sqlite3_value_blob(
+      sqlite3_column_value(stmt, data_column),
+      &data,
+      &data_size,
+      e)) {
+    return false;
+  }
+  struct DecodedBuffer_ decoded;
+  if (!decode_buffer_(data, data_size, &decoded, e)) {
+    return false;
+  }
+  struct B_IQuestion *question;
+  bool ok = b_question_deserialize_from_memory(
+    question_vtable,
+    decoded.data,
+    decoded.size,
+    &question,
     e);
+  release_decoded_buffer_(&decoded);
+  if (!ok) {
+    return false;
+  }
+  *out = question;
+  *out_vtable = question_vtable;
+  return true;
+}
+
+static B_WUR B_FUNC bool
+export_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct ExportSink_ *sink,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(sink);
+  B_OUT_PARAMETER(e);
+
+  struct B_ByteSink *s = &sink->super;
+
+  // Read both tables in one transaction so the exported
+  // answers and dependencies are consistent with each
+  // other.
+  if (!exec_locked_(database, "BEGIN;", e)) {
+    return false;
+  }
+
+  // See NOTE[export format].
+  if (!b_serialize_bytes(
+      s, b_export_magic_, sizeof(b_export_magic_), e)) {
+    goto fail;
+  }
+  if (!b_serialize_4_be(s, B_EXPORT_FORMAT_VERSION_, e)) {
+    goto fail;
+  }
+  uint64_t answer_count;
+  if (!export_answers_locked_(
+      database, s, &answer_count, e)) {
+    goto fail;
+  }
+  uint64_t dependency_count;
+  if (!export_dependencies_locked_(
+      database, s, &dependency_count, e)) {
+    goto fail;
+  }
+  if (!b_serialize_1(s, B_EXPORT_RECORD_END_, e)) {
+    goto fail;
+  }
+  if (!b_serialize_8_be(s, answer_count, e)) {
+    goto fail;
+  }
+  if (!b_serialize_8_be(s, dependency_count, e)) {
+    goto fail;
+  }
+  uint64_t checksum = sink->checksum;
+  if (!b_serialize_8_be(s, checksum, e)) {
+    goto fail;
+  }
+
+  if (!exec_locked_(database, "COMMIT;", e)) {
+    goto fail;
+  }
+  return true;
 
 fail:
-  if (question_buffer.data) {
-    b_deallocate(question_buffer.data);
+  (void) exec_locked_(
+    database,
+    "ROLLBACK;",
+    &(struct B_Error) {.posix_error = 0});
+  return false;
+}
+
+static B_WUR B_FUNC bool
+export_answers_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_ByteSink *sink,
+    B_OUT uint64_t *answer_count,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(sink);
+  B_OUT_PARAMETER(answer_count);
+  B_OUT_PARAMETER(e);
+
+  sqlite3_stmt *stmt = database->export_answers_stmt;
+  uint64_t count = 0;
+  bool ok;
+  for (;;) {
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE) {
+      ok = true;
+      break;
+    } else if (rc != SQLITE_ROW) {
+      B_ASSERT(rc != SQLITE_OK);
+      *e = b_sqlite3_error(rc);
+      ok = false;
+      break;
+    }
+
+    // See NOTE[export format].
+    ok = b_serialize_1(sink, B_EXPORT_RECORD_ANSWER_, e);
+    if (!ok) break;
+    ok = serialize_column_uuid_(
+      sink, stmt, B_EXPORT_ANSWERS_QUESTION_UUID, e);
+    if (!ok) break;
+    ok = serialize_column_blob_(
+      sink, stmt, B_EXPORT_ANSWERS_QUESTION_DATA, e);
+    if (!ok) break;
+    ok = serialize_column_blob_(
+      sink, stmt, B_EXPORT_ANSWERS_ANSWER_DATA, e);
+    if (!ok) break;
+    ok = b_serialize_8_be(
+      sink,
+      (uint64_t) sqlite3_column_int64(
+        stmt, B_EXPORT_ANSWERS_RECORDED_AT),
+      e);
+    if (!ok) break;
+    count += 1;
   }
-  if (answer_buffer.data) {
-    b_deallocate(answer_buffer.data);
+  // Any error was raised by sqlite3_step already.
+  (void) sqlite3_reset(stmt);
+  if (ok) {
+    *answer_count = count;
   }
-  return false;
+  return ok;
 }
 
 static B_WUR B_FUNC bool
-insert_answer_locked_(
+export_dependencies_locked_(
     B_BORROW struct B_Database *database,
-    B_TRANSFER struct Buffer_ question_data,
-    B_BORROW struct B_UUID const question_uuid,
-    B_TRANSFER struct Buffer_ answer_data,
+    B_BORROW struct B_ByteSink *sink,
+    B_OUT uint64_t *dependency_count,
     B_OUT struct B_Error *e) {
-  sqlite3_stmt *stmt = database->insert_answer_stmt;
+  B_PRECONDITION(database);
+  B_PRECONDITION(sink);
+  B_OUT_PARAMETER(dependency_count);
+  B_OUT_PARAMETER(e);
 
+  sqlite3_stmt *stmt = database->export_dependencies_stmt;
+  uint64_t count = 0;
   bool ok;
+  for (;;) {
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_DONE) {
+      ok = true;
+      break;
+    } else if (rc != SQLITE_ROW) {
+      B_ASSERT(rc != SQLITE_OK);
+      *e = b_sqlite3_error(rc);
+      ok = false;
+      break;
+    }
 
-  bool need_free_question_data = true;
-  bool need_free_answer_data = true;
+    // See NOTE[export format].
+    ok = b_serialize_1(
+      sink, B_EXPORT_RECORD_DEPENDENCY_, e);
+    if (!ok) break;
+    ok = serialize_column_uuid_(
+      sink,
+      stmt,
+      B_EXPORT_DEPENDENCIES_FROM_QUESTION_UUID,
+      e);
+    if (!ok) break;
+    ok = serialize_column_blob_(
+      sink,
+      stmt,
+      B_EXPORT_DEPENDENCIES_FROM_QUESTION_DATA,
+      e);
+    if (!ok) break;
+    ok = serialize_column_uuid_(
+      sink,
+      stmt,
+      B_EXPORT_DEPENDENCIES_TO_QUESTION_UUID,
+      e);
+    if (!ok) break;
+    ok = serialize_column_blob_(
+      sink,
+      stmt,
+      B_EXPORT_DEPENDENCIES_TO_QUESTION_DATA,
+      e);
+    if (!ok) break;
+    count += 1;
+  }
+  // Any error was raised by sqlite3_step already.
+  (void) sqlite3_reset(stmt);
+  if (ok) {
+    *dependency_count = count;
+  }
+  return ok;
+}
 
-  ok = bind_buffer_(
-    stmt, B_INSERT_ANSWER_QUESTION_DATA, question_data, e);
-  // FIXME(strager): Is this correct?
-  need_free_question_data = false;
-  if (!ok) goto done_no_reset;
+static B_WUR B_FUNC bool
+import_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct ImportSource_ *source,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(source);
+  B_OUT_PARAMETER(e);
 
-  ok = bind_uuid_(
-    stmt, B_INSERT_ANSWER_QUESTION_UUID, question_uuid, e);
-  if (!ok) goto done_no_reset;
+  struct B_ByteSource *s = &source->super;
 
-  ok = bind_buffer_(
-    stmt, B_INSERT_ANSWER_ANSWER_DATA, answer_data, e);
-  // FIXME(strager): Is this correct?
-  need_free_answer_data = false;
-  if (!ok) goto done_no_reset;
+  // Merge everything or nothing.  IMMEDIATE avoids
+  // deadlocking with other writers when upgrading from a
+  // read lock.
+  if (!exec_locked_(database, "BEGIN IMMEDIATE;", e)) {
+    return false;
+  }
 
-  ok = b_sqlite3_step_expecting_end(stmt, e);
-  // TODO(strager): Error reporting.
-  (void) sqlite3_reset(stmt);
+  // See NOTE[export format].
+  uint8_t magic[sizeof(b_export_magic_)];
+  if (!b_deserialize_bytes(s, sizeof(magic), magic, e)) {
+    goto fail;
+  }
+  if (memcmp(magic, b_export_magic_, sizeof(magic)) != 0) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    goto fail;
+  }
+  uint32_t version;
+  if (!b_deserialize_4_be(s, &version, e)) {
+    goto fail;
+  }
+  if (version != B_EXPORT_FORMAT_VERSION_) {
+    *e = (struct B_Error) {.posix_error = ENOTSUP};
+    goto fail;
+  }
 
-done_no_reset:
-  (void) sqlite3_clear_bindings(stmt);
-  if (need_free_question_data) {
+  uint64_t answer_count = 0;
+  uint64_t dependency_count = 0;
+  for (;;) {
+    uint8_t tag;
+    if (!b_deserialize_1(s, &tag, e)) {
+      goto fail;
+    }
+    if (tag == B_EXPORT_RECORD_END_) {
+      break;
+    }
+    switch (tag) {
+    case B_EXPORT_RECORD_ANSWER_:
+      if (!import_answer_locked_(database, s, e)) {
+        goto fail;
+      }
+      answer_count += 1;
+      break;
+    case B_EXPORT_RECORD_DEPENDENCY_:
+      if (!import_dependency_locked_(database, s, e)) {
+        goto fail;
+      }
+      dependency_count += 1;
+      break;
+    default:
+      *e = (struct B_Error) {.posix_error = EINVAL};
+      goto fail;
+    }
+  }
+
+  uint64_t expected_answer_count;
+  if (!b_deserialize_8_be(s, &expected_answer_count, e)) {
+    goto fail;
+  }
+  uint64_t expected_dependency_count;
+  if (!b_deserialize_8_be(
+      s, &expected_dependency_count, e)) {
+    goto fail;
+  }
+  if (answer_count != expected_answer_count
+      || dependency_count != expected_dependency_count) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    goto fail;
+  }
+  uint64_t checksum = source->checksum;
+  uint64_t expected_checksum;
+  if (!b_deserialize_8_be(s, &expected_checksum, e)) {
+    goto fail;
+  }
+  if (checksum != expected_checksum) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    goto fail;
+  }
+  uint8_t trailing_byte;
+  size_t trailing_size = 1;
+  if (!s->read_bytes(
+      s, &trailing_byte, &trailing_size, e)) {
+    goto fail;
+  }
+  if (trailing_size != 0) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    goto fail;
+  }
+
+  if (!exec_locked_(database, "COMMIT;", e)) {
+    goto fail;
+  }
+  return true;
+
+fail:
+  if (e->posix_error == ENOSPC) {
+    // b_deserialize_* raise ENOSPC if the file is
+    // truncated.
+    *e = (struct B_Error) {.posix_error = EINVAL};
+  }
+  (void) exec_locked_(
+    database,
+    "ROLLBACK;",
+    &(struct B_Error) {.posix_error = 0});
+  return false;
+}
+
+static B_WUR B_FUNC bool
+import_answer_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_ByteSource *source,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(source);
+  B_OUT_PARAMETER(e);
+
+  struct Buffer_ question_data = {
+    .data = NULL,
+    .size = 0,
+  };
+  struct Buffer_ answer_data = {
+    .data = NULL,
+    .size = 0,
+  };
+  struct B_UUID question_uuid;
+  if (!deserialize_uuid_(source, &question_uuid, e)) {
+    goto fail;
+  }
+  if (!deserialize_buffer_(source, &question_data, e)) {
+    goto fail;
+  }
+  if (!deserialize_buffer_(source, &answer_data, e)) {
+    goto fail;
+  }
+  uint64_t recorded_at;
+  if (!b_deserialize_8_be(source, &recorded_at, e)) {
+    goto fail;
+  }
+  return insert_answer_locked_(
+    database,
+    database->import_answer_stmt,
+    question_data,
+    question_uuid,
+    answer_data,
+    (int64_t) recorded_at,
+    e);
+
+fail:
+  if (question_data.data) {
     b_deallocate(question_data.data);
   }
-  if (need_free_answer_data) {
+  if (answer_data.data) {
     b_deallocate(answer_data.data);
   }
-  return ok;
+  return false;
 }
 
 static B_WUR B_FUNC bool
-record_dependency_locked_(
+import_dependency_locked_(
     B_BORROW struct B_Database *database,
-    B_BORROW struct B_IQuestion const *from,
-    B_BORROW struct B_QuestionVTable const *from_vtable,
-    B_BORROW struct B_IQuestion const *to,
-    B_BORROW struct B_QuestionVTable const *to_vtable,
+    B_BORROW struct B_ByteSource *source,
     B_OUT struct B_Error *e) {
   B_PRECONDITION(database);
-  B_PRECONDITION(from);
-  B_PRECONDITION(from_vtable);
-  B_PRECONDITION(to);
-  B_PRECONDITION(to_vtable);
+  B_PRECONDITION(source);
   B_OUT_PARAMETER(e);
 
-  struct Buffer_ from_buffer = {
+  struct Buffer_ from_data = {
     .data = NULL,
     .size = 0,
   };
-  struct Buffer_ to_buffer = {
+  struct Buffer_ to_data = {
     .data = NULL,
     .size = 0,
   };
-  if (!b_question_serialize_to_memory(
-      from,
-      from_vtable,
-      &from_buffer.data,
-      &from_buffer.size,
-      e)) {
+  struct B_UUID from_uuid;
+  if (!deserialize_uuid_(source, &from_uuid, e)) {
     goto fail;
   }
-  if (!b_question_serialize_to_memory(
-      to,
-      to_vtable,
-      &to_buffer.data,
-      &to_buffer.size,
-      e)) {
+  if (!deserialize_buffer_(source, &from_data, e)) {
+    goto fail;
+  }
+  struct B_UUID to_uuid;
+  if (!deserialize_uuid_(source, &to_uuid, e)) {
+    goto fail;
+  }
+  if (!deserialize_buffer_(source, &to_data, e)) {
     goto fail;
   }
   return insert_dependency_locked_(
     database,
-    from_buffer,
-    from_vtable->uuid,
-    to_buffer,
-    to_vtable->uuid,
+    database->import_dependency_stmt,
+    from_data,
+    from_uuid,
+    to_data,
+    to_uuid,
     e);
 
 fail:
-  if (from_buffer.data) {
-    b_deallocate(from_buffer.data);
+  if (from_data.data) {
+    b_deallocate(from_data.data);
   }
-  if (to_buffer.data) {
-    b_deallocate(to_buffer.data);
+  if (to_data.data) {
+    b_deallocate(to_data.data);
   }
   return false;
 }
 
 static B_WUR B_FUNC bool
-insert_dependency_locked_(
+export_sink_write_bytes_(
+    B_BORROW struct B_ByteSink *super,
+    B_BORROW uint8_t const *data,
+    size_t data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(super);
+  B_PRECONDITION(data);
+  B_OUT_PARAMETER(e);
+
+  struct ExportSink_ *sink = (struct ExportSink_ *) super;
+  if (fwrite(data, 1, data_size, sink->file)
+      != data_size) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+  sink->checksum = fnv1a_64_(
+    sink->checksum, data, data_size);
+  return true;
+}
+
+static B_WUR B_FUNC bool
+import_source_read_bytes_(
+    B_BORROW struct B_ByteSource *super,
+    B_OUT uint8_t *data,
+    B_IN_OUT size_t *data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(super);
+  B_PRECONDITION(data);
+  B_PRECONDITION(data_size);
+  B_OUT_PARAMETER(e);
+
+  struct ImportSource_ *source
+    = (struct ImportSource_ *) super;
+  size_t read_size = fread(
+    data, 1, *data_size, source->file);
+  if (read_size != *data_size && ferror(source->file)) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+  source->checksum = fnv1a_64_(
+    source->checksum, data, read_size);
+  *data_size = read_size;
+  return true;
+}
+
+static uint64_t
+fnv1a_64_(
+    uint64_t hash,
+    B_BORROW uint8_t const *data,
+    size_t data_size) {
+  for (size_t i = 0; i < data_size; ++i) {
+    hash ^= data[i];
+    hash *= UINT64_C(1099511628211);
+  }
+  return hash;
+}
+
+static B_WUR B_FUNC bool
+serialize_column_blob_(
+    B_BORROW struct B_ByteSink *sink,
+    B_BORROW sqlite3_stmt *stmt,
+    int column,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(sink);
+  B_PRECONDITION(stmt);
+  B_PRECONDITION(column >= 0);
+  B_OUT_PARAMETER(e);
+
+  // NOTE(strager): Calls must be performed in this order
+  // (sqlite3_column_blob then sqlite3_column_bytes)
+  // according to the sqlite3 documentation.
+  uint8_t const *data = sqlite3_column_blob(stmt, column);
+  if (!data
+      && sqlite3_errcode(sqlite3_db_handle(stmt))
+        == SQLITE_NOMEM) {
+    *e = b_sqlite3_error(SQLITE_NOMEM);
+    return false;
+  }
+  int size = sqlite3_column_bytes(stmt, column);
+  B_ASSERT(size >= 0);
+  if (!data) {
+    // "The return value from sqlite3_column_blob() for
+    // a zero-length BLOB is a NULL pointer."
+    B_ASSERT(size == 0);
+    // b_serialize_data_and_size_8_be expects a non-NULL
+    // data pointer.
+    static uint8_t const empty[1] = {0};
+    data = empty;
+  }
+  return b_serialize_data_and_size_8_be(
+    sink, data, (size_t) size, e);
+}
+
+static B_WUR B_FUNC bool
+serialize_column_uuid_(
+    B_BORROW struct B_ByteSink *sink,
+    B_BORROW sqlite3_stmt *stmt,
+    int column,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(sink);
+  B_PRECONDITION(stmt);
+  B_PRECONDITION(column >= 0);
+  B_OUT_PARAMETER(e);
+
+  uint8_t const *data = sqlite3_column_blob(stmt, column);
+  int size = sqlite3_column_bytes(stmt, column);
+  if (!data || size != sizeof(struct B_UUID)) {
+    // Corrupt row.  EINVAL is the nearest B_Error.
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    return false;
+  }
+  return b_serialize_bytes(
+    sink, data, sizeof(struct B_UUID), e);
+}
+
+static B_WUR B_FUNC bool
+deserialize_buffer_(
+    B_BORROW struct B_ByteSource *source,
+    B_OUT_TRANSFER struct Buffer_ *out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(source);
+  // Callers expect *out to be untouched on failure.
+  B_PRECONDITION(out);
+  B_OUT_PARAMETER(e);
+
+  uint64_t size_64;
+  if (!b_deserialize_8_be(source, &size_64, e)) {
+    return false;
+  }
+  // sqlite3 cannot store larger blobs, so a larger size
+  // indicates corruption.
+  if (size_64 > (uint64_t) INT_MAX) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    return false;
+  }
+  size_t size = (size_t) size_64;
+  // The size comes from the file, so do not trust it until
+  // the bytes have been read: grow the buffer as bytes
+  // arrive.  A truncated file then costs at most twice its
+  // own size.
+  size_t capacity = size < B_DESERIALIZE_BUFFER_CHUNK_SIZE_
+    ? size
+    : B_DESERIALIZE_BUFFER_CHUNK_SIZE_;
+  uint8_t *data;
+  // NOTE(strager): bind_buffer_ requires a non-NULL
+  // pointer, even for empty buffers.
+  if (!b_allocate(
+      capacity > 0 ? capacity : 1, (void **) &data, e)) {
+    return false;
+  }
+  size_t read_size = 0;
+  for (;;) {
+    if (!b_deserialize_bytes(
+        source,
+        capacity - read_size,
+        data + read_size,
+        e)) {
+      goto fail;
+    }
+    read_size = capacity;
+    if (read_size == size) {
+      break;
+    }
+    capacity = size - capacity < capacity
+      ? size
+      : capacity * 2;
+    uint8_t *new_data;
+    if (!b_reallocate(
+        data, capacity, (void **) &new_data, e)) {
+      goto fail;
+    }
+    data = new_data;
+  }
+  *out = (struct Buffer_) {
+    .data = data,
+    .size = size,
+  };
+  return true;
+
+fail:
+  b_deallocate(data);
+  return false;
+}
+
+static B_WUR B_FUNC bool
+deserialize_uuid_(
+    B_BORROW struct B_ByteSource *source,
+    B_OUT struct B_UUID *out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(source);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  return b_deserialize_bytes(
+    source, sizeof(out->data), out->data, e);
+}
+
+static B_WUR B_FUNC bool
+record_execution_locked_(
     B_BORROW struct B_Database *database,
-    B_TRANSFER struct Buffer_ from_data,
-    struct B_UUID const from_uuid,
-    B_TRANSFER struct Buffer_ to_data,
-    struct B_UUID const to_uuid,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_BORROW struct B_ExecutionRecord const *record,
     B_OUT struct B_Error *e) {
   B_PRECONDITION(database);
-  B_PRECONDITION(from_data.data);
-  B_PRECONDITION(to_data.data);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_PRECONDITION(record);
   B_OUT_PARAMETER(e);
 
-  sqlite3_stmt *stmt = database->insert_dependency_stmt;
+  struct Buffer_ question_buffer;
+  if (!encode_question_(
+      question, question_vtable, &question_buffer, e)) {
+    return false;
+  }
 
+  sqlite3_stmt *stmt = database->insert_execution_stmt;
   bool ok;
-
-  bool need_free_from_data = true;
-  bool need_free_to_data = true;
-
-  ok = bind_uuid_(
-    stmt,
-    B_INSERT_DEPENDENCY_FROM_QUESTION_UUID,
-    from_uuid,
-    e);
-  if (!ok) goto done_no_reset;
+  int rc;
 
   ok = bind_buffer_(
     stmt,
-    B_INSERT_DEPENDENCY_FROM_QUESTION_DATA,
-    from_data,
+    B_INSERT_EXECUTION_QUESTION_DATA,
+    question_buffer,
     e);
-  need_free_from_data = false;
   if (!ok) goto done_no_reset;
 
   ok = bind_uuid_(
     stmt,
-    B_INSERT_DEPENDENCY_TO_QUESTION_UUID,
-    to_uuid,
+    B_INSERT_EXECUTION_QUESTION_UUID,
+    question_vtable->uuid,
     e);
   if (!ok) goto done_no_reset;
 
-  ok = bind_buffer_(
-    stmt,
-    B_INSERT_DEPENDENCY_TO_QUESTION_DATA,
-    to_data,
-    e);
-  need_free_to_data = false;
-  if (!ok) goto done_no_reset;
+  struct {
+    int host_parameter_name;
+    int64_t value;
+  } const columns[] = {
+    {B_INSERT_EXECUTION_STARTED_AT, record->started_at_ms},
+    {B_INSERT_EXECUTION_WALL_TIME_US, record->wall_time_us},
+    {B_INSERT_EXECUTION_CPU_TIME_US, record->cpu_time_us},
+    {
+      B_INSERT_EXECUTION_PEAK_RSS_BYTES,
+      record->peak_rss_bytes,
+    },
+    {B_INSERT_EXECUTION_EXIT_STATUS, record->exit_status},
+    {B_INSERT_EXECUTION_BYTES_READ, record->bytes_read},
+    {
+      B_INSERT_EXECUTION_BYTES_WRITTEN,
+      record->bytes_written,
+    },
+  };
+  for (size_t i = 0;
+      i < sizeof(columns) / sizeof(*columns);
+      ++i) {
+    rc = sqlite3_bind_int64(
+      stmt,
+      columns[i].host_parameter_name,
+      columns[i].value);
+    if (rc != SQLITE_OK) {
+      *e = b_sqlite3_error(rc);
+      ok = false;
+      goto done_no_reset;
+    }
+  }
 
   ok = b_sqlite3_step_expecting_end(stmt, e);
-  // TODO(strager): Error reporting.
+  // Any error was raised by sqlite3_step already.
   (void) sqlite3_reset(stmt);
 
 done_no_reset:
   (void) sqlite3_clear_bindings(stmt);
-  if (need_free_from_data) {
-    b_deallocate(from_data.data);
-  }
-  if (need_free_to_data) {
-    b_deallocate(to_data.data);
-  }
   return ok;
 }
 
 static B_WUR B_FUNC bool
-look_up_answer_locked_(
+summarize_executions_locked_(
     B_BORROW struct B_Database *database,
     B_BORROW struct B_IQuestion const *question,
     B_BORROW struct B_QuestionVTable const *question_vtable,
-    B_OPTIONAL_OUT_TRANSFER struct B_IAnswer **out,
+    B_OUT struct B_ExecutionSummary *out,
     B_OUT struct B_Error *e) {
   B_PRECONDITION(database);
   B_PRECONDITION(question);
@@ -750,127 +4349,206 @@ look_up_answer_locked_(
   B_OUT_PARAMETER(out);
   B_OUT_PARAMETER(e);
 
-  bool ok;
-  int rc;
-
-  bool need_free_question_buffer = true;
-
   struct Buffer_ question_buffer;
-  if (!b_question_serialize_to_memory(
-      question,
-      question_vtable,
-      &question_buffer.data,
-      &question_buffer.size,
-      e)) {
+  if (!encode_question_(
+      question, question_vtable, &question_buffer, e)) {
     return false;
   }
 
-  sqlite3_stmt *stmt = database->select_answer_stmt;
+  sqlite3_stmt *stmt = database->summarize_executions_stmt;
+  bool ok;
+  int rc;
 
   ok = bind_buffer_(
     stmt,
-    B_SELECT_ANSWER_QUESTION_DATA,
+    B_SUMMARIZE_EXECUTIONS_QUESTION_DATA,
     question_buffer,
     e);
-  need_free_question_buffer = false;
   if (!ok) goto done_no_reset;
 
   ok = bind_uuid_(
     stmt,
-    B_SELECT_ANSWER_QUESTION_UUID,
+    B_SUMMARIZE_EXECUTIONS_QUESTION_UUID,
     question_vtable->uuid,
     e);
   if (!ok) goto done_no_reset;
 
-  // Grab the first row.
   rc = sqlite3_step(stmt);
-  if (rc == SQLITE_DONE) {
-    // No data.
-    *out = NULL;
-    ok = true;
-    goto done_reset;
-  } else if (rc != SQLITE_ROW) {
-    B_ASSERT(rc != SQLITE_OK);
+  if (rc != SQLITE_ROW) {
+    // An aggregate query always produces exactly one row.
+    B_ASSERT(rc != SQLITE_DONE);
     *e = b_sqlite3_error(rc);
     ok = false;
     goto done_reset;
   }
+  // NOTE(strager): NULL (e.g. MAX of no rows) reads as 0,
+  // and AVG is truncated towards zero.
+  *out = (struct B_ExecutionSummary) {
+    .execution_count = sqlite3_column_int64(
+      stmt, B_SUMMARIZE_EXECUTIONS_COUNT),
+    .failure_count = sqlite3_column_int64(
+      stmt, B_SUMMARIZE_EXECUTIONS_FAILURE_COUNT),
+    .mean_wall_time_us = sqlite3_column_int64(
+      stmt, B_SUMMARIZE_EXECUTIONS_MEAN_WALL_TIME_US),
+    .max_wall_time_us = sqlite3_column_int64(
+      stmt, B_SUMMARIZE_EXECUTIONS_MAX_WALL_TIME_US),
+    .mean_cpu_time_us = sqlite3_column_int64(
+      stmt, B_SUMMARIZE_EXECUTIONS_MEAN_CPU_TIME_US),
+    .max_peak_rss_bytes = sqlite3_column_int64(
+      stmt, B_SUMMARIZE_EXECUTIONS_MAX_PEAK_RSS_BYTES),
+    .mean_bytes_read = sqlite3_column_int64(
+      stmt, B_SUMMARIZE_EXECUTIONS_MEAN_BYTES_READ),
+    .mean_bytes_written = sqlite3_column_int64(
+      stmt, B_SUMMARIZE_EXECUTIONS_MEAN_BYTES_WRITTEN),
+    .last_started_at_ms = sqlite3_column_int64(
+      stmt, B_SUMMARIZE_EXECUTIONS_LAST_STARTED_AT),
+  };
+  ok = b_sqlite3_step_expecting_end(stmt, e);
 
-  // Deserialize the answer.
-  struct Buffer_ answer_buffer;
-  // NOTE(strager): answer_buffer.data is valid until
-  // the call to b_sqlite3_step_expecting_end.
-  // NOTE(strager): Calls must be performed in this order
-  // (sqlite3_column_blob then sqlite3_column_bytes)
-  // according to the sqlite3 documentation.
-  answer_buffer.data = (void *) sqlite3_column_blob(
-    stmt, B_SELECT_ANSWER_ANSWER_DATA);
-  if (!answer_buffer.data
-      && sqlite3_errcode(database->handle)
-        == SQLITE_NOMEM) {
-    *e = b_sqlite3_error(SQLITE_NOMEM);
-    ok = false;
-    goto done_reset;
-  }
-  answer_buffer.size = (size_t) sqlite3_column_bytes(
-    stmt, B_SELECT_ANSWER_ANSWER_DATA);
-  if (!answer_buffer.data) {
-    // "The return value from sqlite3_column_blob() for
-    // a zero-length BLOB is a NULL pointer."
-    B_ASSERT(answer_buffer.size == 0);
-  }
-  struct B_IAnswer *answer;
-  ok = b_answer_deserialize_from_memory(
-    question_vtable->answer_vtable,
-    answer_buffer.data,
-    answer_buffer.size,
-    &answer,
-    e);
-  // Ignore errors, as our lookup is done.
-  (void) b_sqlite3_step_expecting_end(
-    stmt, &(struct B_Error) {.posix_error = 0});
-  if (!ok) {
-    goto done_reset;
-  }
-  *out = answer;
-
-  // TODO(strager): Error reporting.
 done_reset:
+  // Any error was raised by sqlite3_step already.
   (void) sqlite3_reset(stmt);
 
 done_no_reset:
   (void) sqlite3_clear_bindings(stmt);
-  if (need_free_question_buffer) {
-    b_deallocate(question_buffer.data);
-  }
   return ok;
 }
 
 static B_WUR B_FUNC bool
-b_check_all_locked_(
+summarize_all_executions_locked_(
     B_BORROW struct B_Database *database,
-    B_BORROW struct B_QuestionVTable const *const *vtables,
-    size_t vtable_count,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t count,
+    B_OUT struct B_ExecutionSummary *out,
     B_OUT struct B_Error *e) {
   B_PRECONDITION(database);
-  B_PRECONDITION(vtables);
+  B_PRECONDITION(questions);
+  B_PRECONDITION(question_vtables);
+  B_PRECONDITION(out);
   B_OUT_PARAMETER(e);
 
-  database->udf.vtables = vtables;
-  database->udf.vtable_count = vtable_count;
+  // See look_up_answers_locked_.
+  if (!exec_locked_(database, "BEGIN;", e)) {
+    return false;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    if (!summarize_executions_locked_(
+        database,
+        questions[i],
+        question_vtables[i],
+        &out[i],
+        e)) {
+      goto fail;
+    }
+  }
+  if (!exec_locked_(database, "COMMIT;", e)) {
+    goto fail;
+  }
+  return true;
 
-  bool ok = b_sqlite3_step_expecting_end(
-    database->recheck_all_answers_stmt, e);
-  // TODO(strager): Error reporting.
-  (void) sqlite3_reset(
-    database->recheck_all_answers_stmt);
+fail:
+  (void) exec_locked_(
+    database,
+    "ROLLBACK;",
+    &(struct B_Error) {.posix_error = 0});
+  return false;
+}
 
-  database->udf.vtables = NULL;
-  database->udf.vtable_count = 0;
+// Serializes and encodes a question for use as a
+// question_data column.  See NOTE[blob encoding].
+static B_WUR B_FUNC bool
+encode_question_(
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_OUT_TRANSFER struct Buffer_ *out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct Buffer_ buffer;
+  if (!b_question_serialize_to_memory(
+      question,
+      question_vtable,
+      &buffer.data,
+      &buffer.size,
+      e)) {
+    return false;
+  }
+  if (!encode_buffer_(&buffer, e)) {
+    b_deallocate(buffer.data);
+    return false;
+  }
+  *out = buffer;
+  return true;
+}
 
+static B_WUR B_FUNC bool
+exec_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW char const *query,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(query);
+  B_OUT_PARAMETER(e);
+
+  int rc = sqlite3_exec(
+    database->handle, query, NULL, NULL, NULL);
+  if (rc != SQLITE_OK) {
+    *e = b_sqlite3_error(rc);
+    return false;
+  }
+  return true;
+}
+
+static B_WUR B_FUNC bool
+query_int_locked_(
+    B_BORROW struct B_Database *database,
+    B_BORROW char const *query,
+    size_t query_size,
+    B_OUT int *out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(database);
+  B_PRECONDITION(query);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  sqlite3_stmt *stmt;
+  if (!b_sqlite3_prepare(
+      database->handle, query, query_size, &stmt, e)) {
+    return false;
+  }
+  bool ok;
+  int rc = sqlite3_step(stmt);
+  if (rc == SQLITE_ROW) {
+    *out = sqlite3_column_int(stmt, 0);
+    ok = b_sqlite3_step_expecting_end(stmt, e);
+  } else if (rc == SQLITE_DONE) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    ok = false;
+  } else {
+    *e = b_sqlite3_error(rc);
+    ok = false;
+  }
+  (void) sqlite3_finalize(stmt);
   return ok;
 }
 
+static int64_t
+current_time_ms_(
+    void) {
+  struct timespec now;
+  int rc = clock_gettime(CLOCK_REALTIME, &now);
+  // CLOCK_REALTIME is always supported.
+  B_ASSERT(rc == 0);
+  (void) rc;
+  return (int64_t) now.tv_sec * 1000
+    + (int64_t) (now.tv_nsec / 1000000);
+}
+
 static B_WUR B_FUNC bool
 bind_uuid_(
     B_BORROW sqlite3_stmt *stmt,
@@ -986,14 +4664,24 @@ question_answer_matches_locked_(
   }
 
   // Deserialize question.
-  if (!b_question_deserialize_from_memory(
-      question_vtable,
+  struct DecodedBuffer_ decoded_question;
+  if (!decode_buffer_(
       question_data.data,
       question_data.size,
-      &question,
+      &decoded_question,
       &e)) {
     goto fail;
   }
+  bool deserialized = b_question_deserialize_from_memory(
+    question_vtable,
+    decoded_question.data,
+    decoded_question.size,
+    &question,
+    &e);
+  release_decoded_buffer_(&decoded_question);
+  if (!deserialized) {
+    goto fail;
+  }
 
   // Get actual answer.
   struct B_IAnswer *answer;
@@ -1027,13 +4715,22 @@ question_answer_matches_locked_(
     goto fail;
   }
   question_data.data = NULL;
+  struct DecodedBuffer_ decoded_answer;
+  if (!decode_buffer_(
+      answer_data,
+      answer_data_size,
+      &decoded_answer,
+      &e)) {
+    goto fail;
+  }
 
   // Check answer.
-  result = (answer_data_size == actual_answer_data.size)
+  result = (decoded_answer.size == actual_answer_data.size)
     && (memcmp(
-      answer_data,
+      decoded_answer.data,
       actual_answer_data.data,
-      answer_data_size) == 0);
+      decoded_answer.size) == 0);
+  release_decoded_buffer_(&decoded_answer);
   goto done;
 
 done:
@@ -1057,6 +4754,192 @@ fail:
   goto done;
 }
 
+// NOTE[b_encode_blob]: encode_blob_ is a UDF in sqlite3
+// bound to b_encode_blob.  Its signature is:
+//
+// b_encode_blob(data BLOB NOT NULL) BLOB NOT NULL
+//
+// b_encode_blob returns data encoded as described by
+// NOTE[blob encoding].  It is used by schema migrations.
+static void
+encode_blob_(
+    B_BORROW sqlite3_context *context,
+    int arg_count,
+    B_BORROW sqlite3_value **args) {
+  B_PRECONDITION(context);
+  B_PRECONDITION(arg_count == 1);
+  B_PRECONDITION(args);
+
+  struct B_Error e;
+  void const *data;
+  size_t data_size;
+  if (!b_sqlite3_value_blob(
+      args[0], &data, &data_size, &e)) {
+    goto fail;
+  }
+  struct Buffer_ buffer;
+  // b_allocate requires a non-zero size.
+  if (!b_allocate(
+      data_size > 0 ? data_size : 1,
+      (void **) &buffer.data,
+      &e)) {
+    goto fail;
+  }
+  memcpy(buffer.data, data, data_size);
+  buffer.size = data_size;
+  if (!encode_buffer_(&buffer, &e)) {
+    b_deallocate(buffer.data);
+    goto fail;
+  }
+  B_ASSERT(buffer.size <= INT_MAX);
+  sqlite3_result_blob(
+    context,
+    buffer.data,
+    (int) buffer.size,
+    deallocate_buffer_data_);
+  return;
+
+fail:
+  if (e.posix_error == ENOMEM) {
+    sqlite3_result_error_nomem(context);
+  } else {
+    sqlite3_result_error_code(context, SQLITE_ERROR);
+  }
+}
+
+// Replaces *buffer with its encoded form.  See
+// NOTE[blob encoding].  On failure, *buffer is unchanged.
+static B_WUR B_FUNC bool
+encode_buffer_(
+    B_IN_OUT struct Buffer_ *buffer,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(buffer);
+  B_PRECONDITION(buffer->data);
+  B_OUT_PARAMETER(e);
+
+  struct Buffer_ raw = *buffer;
+  uint8_t *encoded;
+  if (!b_allocate(raw.size + 1, (void **) &encoded, e)) {
+    return false;
+  }
+  size_t encoded_size;
+  size_t compressed_size;
+  // Compress only if it saves space compared to storing
+  // raw.
+  if (raw.size >= B_BLOB_COMPRESSION_THRESHOLD_
+      && b_lz_compress(
+        raw.data,
+        raw.size,
+        &encoded[B_BLOB_LZ_HEADER_SIZE_],
+        raw.size - B_BLOB_LZ_HEADER_SIZE_,
+        &compressed_size)) {
+    encoded[0] = B_BLOB_LZ_;
+    uint64_t size_64 = raw.size;
+    for (size_t i = 0; i < 8; ++i) {
+      encoded[1 + i]
+        = (uint8_t) (size_64 >> (8 * (7 - i)));
+    }
+    encoded_size
+      = B_BLOB_LZ_HEADER_SIZE_ + compressed_size;
+  } else {
+    encoded[0] = B_BLOB_RAW_;
+    memcpy(&encoded[1], raw.data, raw.size);
+    encoded_size = raw.size + 1;
+  }
+  b_deallocate(raw.data);
+  *buffer = (struct Buffer_) {
+    .data = encoded,
+    .size = encoded_size,
+  };
+  return true;
+}
+
+// See NOTE[blob encoding].  If the blob is corrupt, raises
+// EINVAL.
+static B_WUR B_FUNC bool
+decode_buffer_(
+    B_BORROW uint8_t const *data,
+    size_t data_size,
+    B_OUT_TRANSFER struct DecodedBuffer_ *out,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  if (data_size < 1) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    return false;
+  }
+  B_ASSERT(data);
+  switch (data[0]) {
+  case B_BLOB_RAW_:
+    *out = (struct DecodedBuffer_) {
+      .data = &data[1],
+      .size = data_size - 1,
+      .storage = NULL,
+    };
+    return true;
+
+  case B_BLOB_LZ_:
+    {
+      if (data_size < B_BLOB_LZ_HEADER_SIZE_) {
+        *e = (struct B_Error) {.posix_error = EINVAL};
+        return false;
+      }
+      uint64_t size_64 = 0;
+      for (size_t i = 0; i < 8; ++i) {
+        size_64 = (size_64 << 8) | data[1 + i];
+      }
+      // sqlite3 cannot store larger blobs, and the
+      // compressed data cannot decompress to more than
+      // B_LZ_MAX_EXPANSION times its size, so a larger size
+      // indicates corruption.  Check before allocating.
+      uint64_t compressed_size_64
+        = (uint64_t) (data_size - B_BLOB_LZ_HEADER_SIZE_);
+      if (size_64 > (uint64_t) INT_MAX
+          || size_64
+            > compressed_size_64 * B_LZ_MAX_EXPANSION) {
+        *e = (struct B_Error) {.posix_error = EINVAL};
+        return false;
+      }
+      size_t size = (size_t) size_64;
+      uint8_t *storage;
+      if (!b_allocate(
+          size > 0 ? size : 1, (void **) &storage, e)) {
+        return false;
+      }
+      if (!b_lz_decompress(
+          &data[B_BLOB_LZ_HEADER_SIZE_],
+          data_size - B_BLOB_LZ_HEADER_SIZE_,
+          storage,
+          size,
+          e)) {
+        b_deallocate(storage);
+        return false;
+      }
+      *out = (struct DecodedBuffer_) {
+        .data = storage,
+        .size = size,
+        .storage = storage,
+      };
+      return true;
+    }
+
+  default:
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    return false;
+  }
+}
+
+static void
+release_decoded_buffer_(
+    B_TRANSFER struct DecodedBuffer_ *buffer) {
+  B_PRECONDITION(buffer);
+
+  if (buffer->storage) {
+    b_deallocate(buffer->storage);
+  }
+}
+
 static B_WUR B_FUNC bool
 value_uuid_(
     B_BORROW sqlite3_value *value,
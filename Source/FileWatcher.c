@@ -0,0 +1,632 @@
+// NOTE[file watcher]: b_database_check_all queries every
+// answer, so every B_FileQuestion's file is read on every
+// build.  A B_FileWatcher asks the kernel which watched
+// files might have changed, so a long-lived process (see
+// NOTE[daemon]) only rechecks those files with
+// b_database_check_changed.
+//
+// inotify watches inodes, and editors often save a file by
+// replacing it, so the watcher watches the directory of
+// each watched file instead, and matches events' names
+// against watched paths.  Paths are compared textually, so
+// "a/b" and "a//b" are different files.
+//
+// If a directory cannot be watched (e.g. it does not
+// exist, or it was deleted or renamed), every watched file
+// in it is reported by each b_file_watcher_take_changes
+// until the directory can be watched again, including the
+// call which watches it again.  If the kernel's event
+// queue overflows, events are lost, and
+// b_file_watcher_take_changes reports the overflow
+// instead.
+//
+// Directories are found by linear search, both when a file
+// is watched and for each event, so handling an event
+// takes time proportional to the number of watched
+// directories.
+
+#include <B/Private/Config.h>
+
+#if B_CONFIG_INOTIFY
+# include <B/Error.h>
+# include <B/FileQuestion.h>
+# include <B/FileWatcher.h>
+# include <B/Memory.h>
+# include <B/Private/Assertions.h>
+# include <B/Private/Memory.h>
+# include <B/Private/QuestionMap.h>
+
+# include <errno.h>
+# include <fcntl.h>
+# include <stddef.h>
+# include <string.h>
+# include <sys/inotify.h>
+# include <unistd.h>
+
+// Events on a directory which might change a file in it,
+// or which stop the directory from being watched.
+# define B_FILE_WATCHER_EVENTS_ \
+  (IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE \
+    | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO \
+    | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+struct B_FileWatcherDirectory_ {
+  char *path;
+  // -1 if the directory is not being watched.
+  int wd;
+  // Scratch space for b_file_watcher_take_changes.
+  bool was_unwatched;
+};
+
+struct B_FileWatcherFile_ {
+  char *path;
+  struct B_FileWatcherDirectory_ *directory;
+  // Whether the file is in B_FileWatcher::changed.
+  bool changed;
+};
+
+struct B_FileWatcher {
+  int fd;
+  // Maps B_FileQuestion keys to B_FileWatcherFile_-s.
+  struct B_QuestionMap *files_by_path;
+  struct B_FileWatcherFile_ **files;
+  size_t file_count;
+  // Capacity of both files and changed, so a file can
+  // always be added to changed.
+  size_t file_capacity;
+  struct B_FileWatcherDirectory_ **directories;
+  size_t directory_count;
+  size_t directory_capacity;
+  // Files which might have changed since the last
+  // b_file_watcher_take_changes.
+  struct B_FileWatcherFile_ **changed;
+  size_t changed_count;
+  bool overflowed;
+};
+
+// Grows *array, an array of pointers, so it can hold at
+// least one more element.
+static B_WUR B_FUNC bool
+b_file_watcher_reserve_(
+    B_IN_OUT void ***array,
+    size_t count,
+    size_t capacity,
+    B_OUT size_t *out_capacity,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(array);
+  B_OUT_PARAMETER(out_capacity);
+  B_OUT_PARAMETER(e);
+
+  if (count < capacity) {
+    *out_capacity = capacity;
+    return true;
+  }
+  size_t new_capacity = capacity ? capacity * 2 : 16;
+  void **new_array;
+  bool ok;
+  if (*array) {
+    ok = b_reallocate(
+      *array,
+      sizeof(**array) * new_capacity,
+      (void **) &new_array,
+      e);
+  } else {
+    ok = b_allocate2(
+      sizeof(**array),
+      new_capacity,
+      (void **) &new_array,
+      e);
+  }
+  if (!ok) {
+    return false;
+  }
+  *array = new_array;
+  *out_capacity = new_capacity;
+  return true;
+}
+
+static B_FUNC void
+b_file_watcher_add_watch_(
+    B_BORROW struct B_FileWatcher *watcher,
+    B_BORROW struct B_FileWatcherDirectory_ *directory) {
+  B_PRECONDITION(watcher);
+  B_PRECONDITION(directory);
+
+  // If the directory cannot be watched (e.g. ENOENT, or
+  // ENOSPC if the user's watch limit is reached), its
+  // files are reported changed until it can be.  See
+  // NOTE[file watcher].
+  directory->wd = inotify_add_watch(
+    watcher->fd, directory->path, B_FILE_WATCHER_EVENTS_);
+}
+
+static B_FUNC void
+b_file_watcher_mark_changed_(
+    B_BORROW struct B_FileWatcher *watcher,
+    B_BORROW struct B_FileWatcherFile_ *file) {
+  B_PRECONDITION(watcher);
+  B_PRECONDITION(file);
+
+  if (file->changed) {
+    return;
+  }
+  B_ASSERT(watcher->changed_count < watcher->file_capacity);
+  watcher->changed[watcher->changed_count] = file;
+  watcher->changed_count += 1;
+  file->changed = true;
+}
+
+static B_WUR B_FUNC bool
+b_file_watcher_file_changed_(
+    B_BORROW struct B_FileWatcher *watcher,
+    B_BORROW struct B_FileWatcherDirectory_ *directory,
+    B_BORROW char const *name,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(watcher);
+  B_PRECONDITION(directory);
+  B_PRECONDITION(name);
+  B_OUT_PARAMETER(e);
+
+  // Undo b_file_watcher_directory_path_.
+  char const *directory_path = directory->path;
+  char const *separator = "/";
+  if (strcmp(directory_path, ".") == 0) {
+    directory_path = "";
+    separator = "";
+  } else if (strcmp(directory_path, "/") == 0) {
+    separator = "";
+  }
+  size_t path_size = strlen(directory_path)
+    + strlen(separator) + strlen(name) + 1;
+  char *path;
+  if (!b_allocate(path_size, (void **) &path, e)) {
+    return false;
+  }
+  strcpy(path, directory_path);
+  strcat(path, separator);
+  strcat(path, name);
+
+  struct B_QuestionKey key;
+  bool ok = b_question_key_initialize(
+    (struct B_IQuestion const *) path,
+    b_file_question_vtable(),
+    &key,
+    e);
+  b_deallocate(path);
+  if (!ok) {
+    return false;
+  }
+  void *file;
+  b_question_map_find(watcher->files_by_path, &key, &file);
+  b_question_key_deinitialize(&key);
+  if (file) {
+    b_file_watcher_mark_changed_(watcher, file);
+  }
+  return true;
+}
+
+// Reads queued events without blocking.
+static B_WUR B_FUNC bool
+b_file_watcher_read_events_(
+    B_BORROW struct B_FileWatcher *watcher,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(watcher);
+  B_OUT_PARAMETER(e);
+
+  union {
+    struct inotify_event event;
+    char bytes[4096];
+  } buffer;
+  for (;;) {
+    ssize_t rc = read(
+      watcher->fd, buffer.bytes, sizeof(buffer.bytes));
+    if (rc == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+      *e = (struct B_Error) {.posix_error = errno};
+      return false;
+    }
+    B_ASSERT(rc > 0);
+    size_t offset = 0;
+    while (offset < (size_t) rc) {
+      struct inotify_event const *event
+        = (struct inotify_event const *)
+          &buffer.bytes[offset];
+      offset += sizeof(*event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        watcher->overflowed = true;
+        continue;
+      }
+      // Several directory paths can name one directory.
+      for (size_t i = 0;
+          i < watcher->directory_count;
+          ++i) {
+        struct B_FileWatcherDirectory_ *directory
+          = watcher->directories[i];
+        if (directory->wd != event->wd) {
+          continue;
+        }
+        if (event->mask & IN_IGNORED) {
+          directory->wd = -1;
+        } else if (event->mask & IN_MOVE_SELF) {
+          // The watch follows the directory, not its path.
+          (void) inotify_rm_watch(watcher->fd, event->wd);
+          directory->wd = -1;
+        } else if (event->len > 0) {
+          if (!b_file_watcher_file_changed_(
+              watcher, directory, event->name, e)) {
+            return false;
+          }
+        }
+      }
+    }
+  }
+}
+
+// Returns the directory part of path ("." if there is
+// none).
+static B_WUR B_FUNC bool
+b_file_watcher_directory_path_(
+    B_BORROW char const *path,
+    B_OUT_TRANSFER char **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(path);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  char const *slash = strrchr(path, '/');
+  if (!slash) {
+    return b_strdup(".", out, e);
+  }
+  if (slash == path) {
+    return b_strdup("/", out, e);
+  }
+  size_t length = (size_t) (slash - path);
+  char *directory;
+  if (!b_allocate(length + 1, (void **) &directory, e)) {
+    return false;
+  }
+  memcpy(directory, path, length);
+  directory[length] = '\0';
+  *out = directory;
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_file_watcher_directory_(
+    B_BORROW struct B_FileWatcher *watcher,
+    B_BORROW char const *file_path,
+    B_OUT_BORROW struct B_FileWatcherDirectory_ **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(watcher);
+  B_PRECONDITION(file_path);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  char *path;
+  if (!b_file_watcher_directory_path_(
+      file_path, &path, e)) {
+    return false;
+  }
+  for (size_t i = 0; i < watcher->directory_count; ++i) {
+    if (strcmp(watcher->directories[i]->path, path) == 0) {
+      b_deallocate(path);
+      *out = watcher->directories[i];
+      return true;
+    }
+  }
+
+  struct B_FileWatcherDirectory_ *directory;
+  if (!b_file_watcher_reserve_(
+      (void ***) &watcher->directories,
+      watcher->directory_count,
+      watcher->directory_capacity,
+      &watcher->directory_capacity,
+      e)) {
+    b_deallocate(path);
+    return false;
+  }
+  if (!b_allocate(
+      sizeof(*directory), (void **) &directory, e)) {
+    b_deallocate(path);
+    return false;
+  }
+  *directory = (struct B_FileWatcherDirectory_) {
+    .path = path,
+    .wd = -1,
+    .was_unwatched = false,
+  };
+  b_file_watcher_add_watch_(watcher, directory);
+  watcher->directories[watcher->directory_count]
+    = directory;
+  watcher->directory_count += 1;
+  *out = directory;
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_file_watcher_allocate(
+    B_OUT_TRANSFER struct B_FileWatcher **out,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_FileWatcher *watcher = NULL;
+  struct B_QuestionMap *files_by_path = NULL;
+  int fd = inotify_init();
+  if (fd == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    goto fail;
+  }
+  int fd_flags = fcntl(fd, F_GETFD);
+  int fl_flags = fcntl(fd, F_GETFL);
+  if (fd_flags == -1
+      || fl_flags == -1
+      || fcntl(fd, F_SETFD, fd_flags | FD_CLOEXEC) == -1
+      || fcntl(fd, F_SETFL, fl_flags | O_NONBLOCK) == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    goto fail;
+  }
+  if (!b_question_map_allocate(&files_by_path, e)) {
+    files_by_path = NULL;
+    goto fail;
+  }
+  if (!b_allocate(
+      sizeof(*watcher), (void **) &watcher, e)) {
+    goto fail;
+  }
+  *watcher = (struct B_FileWatcher) {
+    .fd = fd,
+    .files_by_path = files_by_path,
+    .files = NULL,
+    .file_count = 0,
+    .file_capacity = 0,
+    .directories = NULL,
+    .directory_count = 0,
+    .directory_capacity = 0,
+    .changed = NULL,
+    .changed_count = 0,
+    .overflowed = false,
+  };
+  *out = watcher;
+  return true;
+
+fail:
+  if (files_by_path) {
+    b_question_map_deallocate(files_by_path);
+  }
+  if (fd != -1) {
+    (void) close(fd);
+  }
+  return false;
+}
+
+B_EXPORT_FUNC void
+b_file_watcher_deallocate(
+    B_TRANSFER struct B_FileWatcher *watcher) {
+  B_PRECONDITION(watcher);
+
+  // Closing the inotify instance removes its watches.
+  (void) close(watcher->fd);
+  b_question_map_deallocate(watcher->files_by_path);
+  for (size_t i = 0; i < watcher->file_count; ++i) {
+    b_deallocate(watcher->files[i]->path);
+    b_deallocate(watcher->files[i]);
+  }
+  for (size_t i = 0; i < watcher->directory_count; ++i) {
+    b_deallocate(watcher->directories[i]->path);
+    b_deallocate(watcher->directories[i]);
+  }
+  if (watcher->files) {
+    b_deallocate(watcher->files);
+  }
+  if (watcher->changed) {
+    b_deallocate(watcher->changed);
+  }
+  if (watcher->directories) {
+    b_deallocate(watcher->directories);
+  }
+  b_deallocate(watcher);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_file_watcher_watch(
+    B_BORROW struct B_FileWatcher *watcher,
+    B_BORROW char const *file_path,
+    B_OUT bool *out_added,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(watcher);
+  B_PRECONDITION(file_path);
+  B_OUT_PARAMETER(out_added);
+  B_OUT_PARAMETER(e);
+
+  struct B_QuestionKey key;
+  if (!b_question_key_initialize(
+      (struct B_IQuestion const *) file_path,
+      b_file_question_vtable(),
+      &key,
+      e)) {
+    return false;
+  }
+  void *existing;
+  b_question_map_find(
+    watcher->files_by_path, &key, &existing);
+  if (existing) {
+    b_question_key_deinitialize(&key);
+    *out_added = false;
+    return true;
+  }
+
+  struct B_FileWatcherDirectory_ *directory;
+  struct B_FileWatcherFile_ *file = NULL;
+  size_t capacity;
+  if (!b_file_watcher_directory_(
+      watcher, file_path, &directory, e)) {
+    goto fail;
+  }
+  if (!b_file_watcher_reserve_(
+      (void ***) &watcher->files,
+      watcher->file_count,
+      watcher->file_capacity,
+      &capacity,
+      e)) {
+    goto fail;
+  }
+  if (!b_file_watcher_reserve_(
+      (void ***) &watcher->changed,
+      watcher->file_count,
+      watcher->file_capacity,
+      &capacity,
+      e)) {
+    goto fail;
+  }
+  watcher->file_capacity = capacity;
+  if (!b_allocate(sizeof(*file), (void **) &file, e)) {
+    file = NULL;
+    goto fail;
+  }
+  *file = (struct B_FileWatcherFile_) {
+    .path = NULL,
+    .directory = directory,
+    .changed = false,
+  };
+  if (!b_strdup(file_path, &file->path, e)) {
+    goto fail;
+  }
+  if (!b_question_map_insert(
+      watcher->files_by_path, &key, file, e)) {
+    b_deallocate(file->path);
+    goto fail;
+  }
+  watcher->files[watcher->file_count] = file;
+  watcher->file_count += 1;
+  *out_added = true;
+  return true;
+
+fail:
+  if (file) {
+    b_deallocate(file);
+  }
+  b_question_key_deinitialize(&key);
+  return false;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_file_watcher_take_changes(
+    B_BORROW struct B_FileWatcher *watcher,
+    B_BORROW B_FileWatcherCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT bool *out_overflowed,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(watcher);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(out_overflowed);
+  B_OUT_PARAMETER(e);
+
+  if (!b_file_watcher_read_events_(watcher, e)) {
+    return false;
+  }
+
+  // Files in unwatched directories might have changed,
+  // even if the directory can be watched again now.  See
+  // NOTE[file watcher].
+  bool any_unwatched = false;
+  for (size_t i = 0; i < watcher->directory_count; ++i) {
+    struct B_FileWatcherDirectory_ *directory
+      = watcher->directories[i];
+    if (directory->wd == -1) {
+      directory->was_unwatched = true;
+      b_file_watcher_add_watch_(watcher, directory);
+      any_unwatched = true;
+    }
+  }
+  if (any_unwatched) {
+    for (size_t i = 0; i < watcher->file_count; ++i) {
+      struct B_FileWatcherFile_ *file = watcher->files[i];
+      if (file->directory->was_unwatched) {
+        b_file_watcher_mark_changed_(watcher, file);
+      }
+    }
+    for (size_t i = 0; i < watcher->directory_count; ++i) {
+      watcher->directories[i]->was_unwatched = false;
+    }
+  }
+
+  *out_overflowed = watcher->overflowed;
+  if (!watcher->overflowed) {
+    for (size_t i = 0; i < watcher->changed_count; ++i) {
+      // If callback fails, the remaining changes are
+      // reported by the next call.
+      if (!callback(
+          callback_opaque, watcher->changed[i]->path, e)) {
+        return false;
+      }
+    }
+  }
+  for (size_t i = 0; i < watcher->changed_count; ++i) {
+    watcher->changed[i]->changed = false;
+  }
+  watcher->changed_count = 0;
+  watcher->overflowed = false;
+  return true;
+}
+
+#else
+# include <B/Error.h>
+# include <B/FileWatcher.h>
+# include <B/Private/Assertions.h>
+
+# include <errno.h>
+
+B_WUR B_EXPORT_FUNC bool
+b_file_watcher_allocate(
+    B_OUT_TRANSFER struct B_FileWatcher **out,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  *e = (struct B_Error) {.posix_error = ENOTSUP};
+  return false;
+}
+
+B_EXPORT_FUNC void
+b_file_watcher_deallocate(
+    B_TRANSFER struct B_FileWatcher *watcher) {
+  B_PRECONDITION(watcher);
+  B_BUG();
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_file_watcher_watch(
+    B_BORROW struct B_FileWatcher *watcher,
+    B_BORROW char const *file_path,
+    B_OUT bool *out_added,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(watcher);
+  (void) file_path;
+  (void) out_added;
+  (void) e;
+  B_BUG();
+  return false;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_file_watcher_take_changes(
+    B_BORROW struct B_FileWatcher *watcher,
+    B_BORROW B_FileWatcherCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT bool *out_overflowed,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(watcher);
+  (void) callback;
+  (void) callback_opaque;
+  (void) out_overflowed;
+  (void) e;
+  B_BUG();
+  return false;
+}
+#endif
@@ -0,0 +1,522 @@
+// NOTE[jobserver]: GNU make shares job slots between
+// recursive makes with a jobserver: a pipe (or, since make
+// 4.4, a named FIFO) holding one byte ("token") for each
+// job slot but one.  Every process in the tree has one
+// implicit job slot.  Before running another job at the
+// same time, a process reads a token, and it writes the
+// token back when the job finishes.  make tells child
+// processes about the jobserver through MAKEFLAGS, e.g.
+// "-j8 --jobserver-auth=3,4".
+//
+// b_jobserver_allocate_from_environment makes us a client
+// of a parent make's jobserver.
+// b_jobserver_allocate_server makes us the jobserver for
+// build tools we run.  Either way, a B_ProcessQueue given
+// the jobserver holds a token for each running process
+// except the first.
+//
+// Acquiring a token must not block the run loop.  A
+// jobserver pipe's file status flags are shared by every
+// process in the tree, and some versions of make misbehave
+// if the pipe is non-blocking, so we leave the flags
+// alone.  Instead, we poll the read end without waiting
+// before reading it.  If another process takes the token
+// between the poll and the read, the read waits until some
+// job returns a token.  (A FIFO is opened separately by
+// each process, so we open ours non-blocking.)
+
+#include <B/Error.h>
+#include <B/Jobserver.h>
+#include <B/Memory.h>
+#include <B/Private/Assertions.h>
+#include <B/Private/Memory.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct B_Jobserver {
+  int read_fd;
+  // May equal read_fd.
+  int write_fd;
+  // Whether b_jobserver_deallocate closes read_fd and
+  // write_fd.
+  bool owns_fds;
+  // Whether b_jobserver_deallocate restores MAKEFLAGS to
+  // old_makeflags.
+  bool owns_makeflags;
+  // NULL if MAKEFLAGS was unset.
+  char *old_makeflags;
+
+  // Tokens read and not yet written back.  make wants the
+  // same bytes back.
+  char *tokens;
+  size_t token_count;
+  size_t token_capacity;
+};
+
+static B_WUR B_FUNC bool
+b_jobserver_allocate_(
+    int read_fd,
+    int write_fd,
+    bool owns_fds,
+    B_OUT_TRANSFER struct B_Jobserver **out,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_Jobserver *jobserver;
+  if (!b_allocate(
+      sizeof(*jobserver), (void **) &jobserver, e)) {
+    return false;
+  }
+  *jobserver = (struct B_Jobserver) {
+    .read_fd = read_fd,
+    .write_fd = write_fd,
+    .owns_fds = owns_fds,
+    .owns_makeflags = false,
+    .old_makeflags = NULL,
+    .tokens = NULL,
+    .token_count = 0,
+    .token_capacity = 0,
+  };
+  *out = jobserver;
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_jobserver_write_(
+    int fd,
+    B_BORROW char const *bytes,
+    size_t size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(bytes);
+  B_OUT_PARAMETER(e);
+
+  while (size > 0) {
+    ssize_t rc = write(fd, bytes, size);
+    if (rc == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      *e = (struct B_Error) {.posix_error = errno};
+      return false;
+    }
+    bytes += rc;
+    size -= (size_t) rc;
+  }
+  return true;
+}
+
+// Finds the value of the last --jobserver-auth= (make 4.2
+// and newer) or --jobserver-fds= (older make) option in
+// makeflags.  Returns NULL if there is none.
+static B_FUNC char const *
+b_jobserver_find_auth_(
+    B_BORROW char const *makeflags,
+    B_OUT size_t *out_size) {
+  B_PRECONDITION(makeflags);
+  B_OUT_PARAMETER(out_size);
+
+  static char const *const options[] = {
+    "--jobserver-auth=",
+    "--jobserver-fds=",
+  };
+  char const *value = NULL;
+  for (size_t i = 0; i < 2; ++i) {
+    char const *p = makeflags;
+    while ((p = strstr(p, options[i]))) {
+      p += strlen(options[i]);
+      if (!value || p > value) {
+        value = p;
+      }
+    }
+  }
+  if (!value) {
+    return NULL;
+  }
+  *out_size = strcspn(value, " \t");
+  return value;
+}
+
+static B_WUR B_FUNC bool
+b_jobserver_parse_fd_(
+    B_BORROW char const *begin,
+    B_BORROW char const *end,
+    B_OUT int *out) {
+  B_PRECONDITION(begin);
+  B_PRECONDITION(end);
+  B_OUT_PARAMETER(out);
+
+  if (begin == end) {
+    return false;
+  }
+  int fd = 0;
+  for (char const *p = begin; p != end; ++p) {
+    if (*p < '0' || *p > '9') {
+      return false;
+    }
+    if (fd > (INT_MAX - 9) / 10) {
+      return false;
+    }
+    fd = fd * 10 + (*p - '0');
+  }
+  *out = fd;
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_jobserver_open_fifo_(
+    B_BORROW char const *path,
+    size_t path_size,
+    B_OUT_TRANSFER struct B_Jobserver **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(path);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  char *path_copy;
+  if (!b_allocate(
+      path_size + 1, (void **) &path_copy, e)) {
+    return false;
+  }
+  memcpy(path_copy, path, path_size);
+  path_copy[path_size] = '\0';
+  // Child processes open the FIFO themselves, so our file
+  // descriptor need not be inherited.
+  int fd = open(path_copy, O_RDWR | O_NONBLOCK);
+  int open_errno = errno;
+  b_deallocate(path_copy);
+  if (fd == -1) {
+    *e = (struct B_Error) {.posix_error = open_errno};
+    return false;
+  }
+  if (fcntl(fd, F_SETFD, FD_CLOEXEC) == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    (void) close(fd);
+    return false;
+  }
+  if (!b_jobserver_allocate_(fd, fd, true, out, e)) {
+    (void) close(fd);
+    return false;
+  }
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_jobserver_allocate_from_environment(
+    B_OUT_TRANSFER struct B_Jobserver **out,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  char const *makeflags = getenv("MAKEFLAGS");
+  if (!makeflags) {
+    *e = (struct B_Error) {.posix_error = ENOENT};
+    return false;
+  }
+  size_t auth_size;
+  char const *auth
+    = b_jobserver_find_auth_(makeflags, &auth_size);
+  if (!auth) {
+    *e = (struct B_Error) {.posix_error = ENOENT};
+    return false;
+  }
+
+  static char const fifo_prefix[] = "fifo:";
+  size_t fifo_prefix_size = sizeof(fifo_prefix) - 1;
+  if (auth_size > fifo_prefix_size
+      && strncmp(auth, fifo_prefix, fifo_prefix_size)
+        == 0) {
+    return b_jobserver_open_fifo_(
+      auth + fifo_prefix_size,
+      auth_size - fifo_prefix_size,
+      out,
+      e);
+  }
+
+  char const *auth_end = auth + auth_size;
+  char const *comma = memchr(auth, ',', auth_size);
+  int read_fd;
+  int write_fd;
+  if (!comma
+      || !b_jobserver_parse_fd_(auth, comma, &read_fd)
+      || !b_jobserver_parse_fd_(
+        comma + 1, auth_end, &write_fd)) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    return false;
+  }
+  // make closes the jobserver's file descriptors for
+  // commands it doesn't consider recursive.
+  if (fcntl(read_fd, F_GETFD) == -1
+      || fcntl(write_fd, F_GETFD) == -1) {
+    *e = (struct B_Error) {.posix_error = EBADF};
+    return false;
+  }
+  // See NOTE[jobserver].
+  return b_jobserver_allocate_(
+    read_fd, write_fd, false, out, e);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_jobserver_allocate_server(
+    size_t job_slots,
+    B_OUT_TRANSFER struct B_Jobserver **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(job_slots > 0);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  // All tokens are written at once, so the pipe must be
+  // able to hold them.
+  if (job_slots - 1 > (size_t) PIPE_BUF) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    return false;
+  }
+
+  int fds[2] = {-1, -1};
+  char *tokens = NULL;
+  char *old_makeflags = NULL;
+  char *makeflags = NULL;
+  struct B_Jobserver *jobserver = NULL;
+  if (pipe(fds) == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    fds[0] = -1;
+    fds[1] = -1;
+    goto fail;
+  }
+  if (job_slots > 1) {
+    if (!b_allocate(
+        job_slots - 1, (void **) &tokens, e)) {
+      goto fail;
+    }
+    memset(tokens, '+', job_slots - 1);
+    if (!b_jobserver_write_(
+        fds[1], tokens, job_slots - 1, e)) {
+      goto fail;
+    }
+  }
+
+  char const *old = getenv("MAKEFLAGS");
+  if (old && !b_strdup(old, &old_makeflags, e)) {
+    goto fail;
+  }
+  char const *separator = old && old[0] ? " " : "";
+  if (!old) {
+    old = "";
+  }
+  static char const format[]
+    = "%s%s-j%lu --jobserver-auth=%d,%d";
+  int size = snprintf(
+    NULL,
+    0,
+    format,
+    old,
+    separator,
+    (unsigned long) job_slots,
+    fds[0],
+    fds[1]);
+  if (size < 0) {
+    *e = (struct B_Error) {.posix_error = errno};
+    goto fail;
+  }
+  if (!b_allocate(
+      (size_t) size + 1, (void **) &makeflags, e)) {
+    goto fail;
+  }
+  (void) snprintf(
+    makeflags,
+    (size_t) size + 1,
+    format,
+    old,
+    separator,
+    (unsigned long) job_slots,
+    fds[0],
+    fds[1]);
+
+  if (!b_jobserver_allocate_(
+      fds[0], fds[1], true, &jobserver, e)) {
+    goto fail;
+  }
+  if (setenv("MAKEFLAGS", makeflags, 1) == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    goto fail;
+  }
+  jobserver->owns_makeflags = true;
+  jobserver->old_makeflags = old_makeflags;
+  b_deallocate(makeflags);
+  if (tokens) {
+    b_deallocate(tokens);
+  }
+  *out = jobserver;
+  return true;
+
+fail:
+  if (jobserver) {
+    b_deallocate(jobserver);
+  }
+  if (makeflags) {
+    b_deallocate(makeflags);
+  }
+  if (old_makeflags) {
+    b_deallocate(old_makeflags);
+  }
+  if (tokens) {
+    b_deallocate(tokens);
+  }
+  for (size_t i = 0; i < 2; ++i) {
+    if (fds[i] != -1) {
+      (void) close(fds[i]);
+    }
+  }
+  return false;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_jobserver_deallocate(
+    B_TRANSFER struct B_Jobserver *jobserver,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(jobserver);
+  B_OUT_PARAMETER(e);
+
+  bool ok = true;
+  if (jobserver->token_count > 0) {
+    ok = b_jobserver_write_(
+      jobserver->write_fd,
+      jobserver->tokens,
+      jobserver->token_count,
+      e);
+  }
+  if (jobserver->owns_makeflags) {
+    int rc;
+    if (jobserver->old_makeflags) {
+      rc = setenv(
+        "MAKEFLAGS", jobserver->old_makeflags, 1);
+    } else {
+      rc = unsetenv("MAKEFLAGS");
+    }
+    if (rc == -1 && ok) {
+      *e = (struct B_Error) {.posix_error = errno};
+      ok = false;
+    }
+  }
+  if (jobserver->owns_fds) {
+    (void) close(jobserver->read_fd);
+    if (jobserver->write_fd != jobserver->read_fd) {
+      (void) close(jobserver->write_fd);
+    }
+  }
+  if (jobserver->old_makeflags) {
+    b_deallocate(jobserver->old_makeflags);
+  }
+  if (jobserver->tokens) {
+    b_deallocate(jobserver->tokens);
+  }
+  b_deallocate(jobserver);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_jobserver_try_acquire(
+    B_BORROW struct B_Jobserver *jobserver,
+    B_OUT bool *acquired,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(jobserver);
+  B_OUT_PARAMETER(acquired);
+  B_OUT_PARAMETER(e);
+
+  // Make room first so a token read is never lost.
+  if (jobserver->token_count == jobserver->token_capacity) {
+    size_t capacity = jobserver->token_capacity
+      ? jobserver->token_capacity * 2
+      : 16;
+    char *tokens;
+    bool ok;
+    if (jobserver->tokens) {
+      ok = b_reallocate(
+        jobserver->tokens, capacity, (void **) &tokens, e);
+    } else {
+      ok = b_allocate(capacity, (void **) &tokens, e);
+    }
+    if (!ok) {
+      return false;
+    }
+    jobserver->tokens = tokens;
+    jobserver->token_capacity = capacity;
+  }
+
+  for (;;) {
+    // See NOTE[jobserver].
+    struct pollfd poll_fd = {
+      .fd = jobserver->read_fd,
+      .events = POLLIN,
+      .revents = 0,
+    };
+    int poll_rc = poll(&poll_fd, 1, 0);
+    if (poll_rc == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      *e = (struct B_Error) {.posix_error = errno};
+      return false;
+    }
+    if (poll_rc == 0) {
+      *acquired = false;
+      return true;
+    }
+    char token;
+    ssize_t rc = read(jobserver->read_fd, &token, 1);
+    if (rc == 1) {
+      jobserver->tokens[jobserver->token_count] = token;
+      jobserver->token_count += 1;
+      *acquired = true;
+      return true;
+    }
+    if (rc == 0) {
+      // The jobserver went away.
+      *acquired = false;
+      return true;
+    }
+    if (errno == EINTR) {
+      continue;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      *acquired = false;
+      return true;
+    }
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_jobserver_release(
+    B_BORROW struct B_Jobserver *jobserver,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(jobserver);
+  B_PRECONDITION(jobserver->token_count > 0);
+  B_OUT_PARAMETER(e);
+
+  if (!b_jobserver_write_(
+      jobserver->write_fd,
+      &jobserver->tokens[jobserver->token_count - 1],
+      1,
+      e)) {
+    return false;
+  }
+  jobserver->token_count -= 1;
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC size_t
+b_jobserver_held_count(
+    B_BORROW struct B_Jobserver const *jobserver) {
+  B_PRECONDITION(jobserver);
+
+  return jobserver->token_count;
+}
@@ -1,27 +1,449 @@
 #include <B/Error.h>
 #include <B/Main.h>
 #include <B/Memory.h>
+#include <B/AnswerContext.h>
+#include <B/AnswerFuture.h>
+#include <B/Database.h>
+#include <B/Private/AnswerCache.h>
 #include <B/Private/AnswerContext.h>
 #include <B/Private/Assertions.h>
 #include <B/Private/Database.h>
 #include <B/Private/Log.h>
 #include <B/Private/Main.h>
 #include <B/Private/Memory.h>
+#include <B/Private/QuestionMap.h>
+#include <B/ProcessQueue.h>
 #include <B/QuestionAnswer.h>
 #include <B/RunLoop.h>
+#include <B/Tracer.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+enum {
+  B_MAIN_ANSWER_CACHE_CAPACITY_ = 4096,
+  B_MAIN_READY_INITIAL_CAPACITY_ = 64,
+  B_MAIN_NODE_LIST_INITIAL_CAPACITY_ = 4,
+  // How long cancelled processes get to exit after
+  // SIGTERM.  See NOTE[cancellation].
+  B_MAIN_TERMINATE_GRACE_PERIOD_MS_ = 100,
+};
+
+struct B_MainNodeList_ {
+  struct B_MainNode **nodes;
+  size_t count;
+  size_t capacity;
+};
+
+// See NOTE[dependency cycles].
+struct B_MainNode {
+  // Borrowed from the question's B_AnswerContext while
+  // in_flight.
+  struct B_AnswerFuture *future;
+  struct B_IQuestion const *question;
+  struct B_QuestionVTable const *question_vtable;
+  bool in_flight;
+
+  // Position in the topological order: a node's order is
+  // less than its dependencies' orders.
+  uint64_t order;
+  // Edges to nodes which are no longer in flight are
+  // skipped, and are dropped when this node finishes.
+  struct B_MainNodeList_ dependencies;
+  struct B_MainNodeList_ dependants;
+  // One reference for main->in_flight, plus one for each
+  // edge list holding the node.
+  size_t reference_count;
+
+  // The question's answer context while it is in flight,
+  // or NULL.  See NOTE[priorities].
+  struct B_AnswerContext *answer_context;
+
+  // Longest estimated critical path of the node's
+  // dependants.  See NOTE[critical path scheduling].
+  int64_t dependant_path_us;
+  // Mean wall time of the question's recent executions.
+  // Zero until the node is estimated.
+  int64_t cost_us;
+  // Index of answer_context in main->ready, or SIZE_MAX if
+  // it is not there.
+  size_t ready_index;
+
+  // Scratch space for b_main_add_edge_.
+  bool visited;
+  struct B_MainNode *search_parent;
+};
+
+// See NOTE[critical path scheduling].
+struct B_MainReadyEntry_ {
+  struct B_AnswerContext *answer_context;
+  // Copy of answer_context->priority.  See
+  // NOTE[priorities].
+  int priority;
+  int64_t critical_path_us;
+  uint64_t sequence;
+};
 
 struct B_Main {
   struct B_Database *database;
   struct B_RunLoop *run_loop;
   B_MainCallback *callback;
   void *callback_opaque;
+
+  // Questions being answered, mapped to their
+  // B_MainNode-s.  See NOTE[in-flight questions].
+  struct B_QuestionMap *in_flight;
+
+  // See NOTE[dependency cycles].
+  uint64_t next_order;
+  B_MainCycleCallback *cycle_callback;
+  void *cycle_callback_opaque;
+  // Scratch space for b_main_add_edge_.
+  struct B_MainNodeList_ search_stack;
+  struct B_MainNodeList_ search_forward;
+  struct B_MainNodeList_ search_backward;
+
+  // Recently-answered questions.  See NOTE[answer cache].
+  struct B_AnswerCache *answer_cache;
+
+  // Nodes whose answer contexts wait for their estimates
+  // before entering ready.  See NOTE[critical path
+  // scheduling].
+  struct B_MainNodeList_ unestimated;
+  // Answer contexts waiting for main->callback, as a binary
+  // max-heap.  See NOTE[critical path scheduling].
+  struct B_MainReadyEntry_ *ready;
+  size_t ready_count;
+  size_t ready_capacity;
+  uint64_t next_ready_sequence;
+  // Whether b_main_dispatch_callback_ is queued on
+  // run_loop.
+  bool dispatch_scheduled;
+
+  // NULL if prefetching is disabled.  See NOTE[prefetch].
+  struct B_QuestionVTable const *const *prefetch_vtables;
+  size_t prefetch_vtable_count;
+
+  // NULL if processes are started immediately.
+  struct B_ProcessQueue *process_queue;
+  // Used instead of process_queue if process_queue is
+  // NULL, so b_main_cancel can find running processes.
+  // Has no limit.
+  struct B_ProcessQueue *unlimited_process_queue;
+
+  // See NOTE[cancellation].
+  bool cancel_on_failure;
+  bool cancelled;
+
+  // NULL if worker functions run on the run loop's
+  // thread.  See NOTE[worker threads].
+  struct B_WorkerPool *worker_pool;
+
+  // NULL if tracing is disabled.  See NOTE[tracing].
+  struct B_Tracer *tracer;
+  uint64_t next_trace_id;
+
+  // See NOTE[main observers].
+  struct B_MainObserver observer;
+  void *observer_opaque;
+};
+
+// NOTE[in-flight questions]: If b_main_answer is called
+// for a question which is already being answered, the
+// caller shares the existing B_AnswerFuture instead of
+// answering the question again.  A question is in flight
+// from when its B_AnswerContext is allocated until its
+// answer is recorded (or it fails).  After that, the
+// answer cache or the database answers the question.
+
+// NOTE[dependency cycles]: If question A needs B and B
+// needs A (perhaps through other questions), neither
+// future ever resolves.  B_Main detects such cycles as
+// they form.  In-flight questions are the nodes of a
+// graph, and b_main_need adds an edge from the needing
+// question to the needed question if the latter is in
+// flight.  (Answered questions cannot be part of a
+// cycle.)
+//
+// B_Main keeps the nodes in a topological order, updated
+// incrementally with the Pearce-Kelly algorithm.  A new
+// node is ordered after every existing node, so needing a
+// new question (the common case) costs one comparison.
+// Only if an edge contradicts the order does B_Main
+// search, and only among nodes between the edge's
+// endpoints in the order.  The searches are iterative, so
+// deep graphs do not overflow the stack.
+//
+// If an edge would complete a cycle, it is not added.
+// Instead, b_answer_context_need gives a future which
+// failed with ELOOP, and the cycle is reported to the
+// cycle callback (see b_main_set_cycle_callback).  The
+// needing question then typically fails, failing the rest
+// of the cycle with it.
+//
+// Nodes are removed when their questions are answered (or
+// fail).  Removing nodes keeps the order topological.
+
+// NOTE[answer cache]: Looking up an answer in the database
+// costs a query, a deserialization, and a new
+// B_AnswerFuture.  A question needed by many dependents
+// would pay this cost for each dependent.  Instead, B_Main
+// keeps resolved B_AnswerFuture-s in a bounded
+// B_AnswerCache, so repeat lookups cost a hash probe.
+//
+// The cache lives as long as the B_Main.  Like the
+// database, it is not invalidated if files change during
+// the build; call b_database_check_all before allocating a
+// B_Main.  A long-lived B_Main (e.g. B_Daemon's) must
+// instead call b_main_forget for each question
+// b_database_check_all invalidated.
+
+// NOTE[critical path scheduling]: New answer contexts are
+// not dispatched to main->callback immediately.  Instead,
+// they wait in main->ready, and a single run loop function
+// (b_main_dispatch_callback_) dispatches them, longest
+// estimated critical path first.  Questions discovered
+// while dispatching are queued behind (or ahead of) the
+// remaining ones according to their estimates.
+//
+// A question's cost is the mean wall time of its recent
+// executions (see NOTE[execution history]), which
+// excludes waiting on dependencies.  A question's critical
+// path is its cost plus the longest critical path of the
+// questions which need it.  The chain of questions above
+// a question must wait for it, so this is the least time
+// left in the build once the question is dispatched.
+// Dispatching the longest chains first keeps the build's
+// makespan short.  Questions with no history cost zero.
+// Ties are broken in FIFO order.
+//
+// A question's dependants are only known as they need it.
+// Each new question starts with its needer's critical
+// path, and b_main_need raises the critical path of a
+// question in flight if a dependant with a longer path
+// needs it.  (Raising it after the question is dispatched
+// has no effect.)
+//
+// Costs come from the database.  Rather than querying for
+// each new question, new answer contexts wait in
+// main->unestimated, and b_main_dispatch_callback_ looks
+// up all of their costs in one transaction before
+// dispatching.
+//
+// NOTE[priorities]: Priorities override critical path
+// estimates: answer contexts with a higher priority are
+// dispatched first.  A question needed with
+// b_answer_context_need_with_priority gets (at least) the
+// given priority; a question needed with
+// b_answer_context_need inherits its needer's priority,
+// so a whole subgraph is prioritized.  If a question in
+// flight is needed with a higher priority, its priority
+// and the priorities of its in-flight dependencies are
+// raised.  b_answer_context_exec gives the answer
+// context's priority to the process queue.  (Processes
+// already waiting in the queue keep their old priority.)
+
+// NOTE[batched needs]: A question often needs many
+// questions at once (e.g. a link needs every object file).
+// b_main_need_all handles them as a batch: it records all
+// of the dependencies in one database transaction, then
+// looks up all of the uncached answers in another.
+// Dispatching is already batched: b_main_schedule_ adds
+// at most one function to the run loop for any number of
+// ready answer contexts.
+
+// NOTE[prefetch]: Normally, a question's dependencies are
+// discovered one at a time as main->callback calls
+// b_answer_context_need.  With b_main_enable_prefetch,
+// dispatching a question first calls b_main_answer on each
+// dependency recorded when the question was last answered
+// (see b_database_recorded_dependencies), so dependencies
+// start in parallel.  When the question later needs a
+// prefetched dependency, it shares the in-flight or cached
+// answer.  If the question's dependencies changed,
+// prefetched answers go unused (but are still recorded in
+// the database).
+
+// NOTE[cancellation]: b_main_cancel makes a failed build
+// stop quickly.  While main is cancelled:
+//
+// * Answer contexts are failed with ECANCELED instead of
+//   being dispatched to main->callback.
+// * b_answer_context_exec raises ECANCELED.
+//
+// Cancelling also cancels processes waiting in main's
+// process queue and terminates running processes (see
+// b_process_terminate).  The processes' callbacks then
+// fail their answer contexts as usual, and the failures
+// reach dependants through their futures.  (Functions
+// running on worker threads are not interrupted.)
+//
+// Cancellation ends once no question is in flight, so a
+// later b_main_answer (e.g. for a daemon's next build) is
+// answered normally.
+//
+// With b_main_set_cancel_on_failure, the first question
+// to fail cancels main, like make without -k.  (Waiting
+// for the root question's future to fail is not enough:
+// a future needing several questions fails only after
+// all of them finish.)
+
+// NOTE[main observers]: main->callback answers questions;
+// a B_MainObserver only watches.  Metrics, progress
+// displays, and the like are built on observers outside
+// B_Main.  main keeps a copy of the observer, so each hook
+// site is one branch on a function pointer which is
+// usually NULL, hinted with B_UNLIKELY.  Hooks cannot
+// fail, and cannot stop main; an observer which needs to
+// report an error must remember it.
+
+struct B_MainPrefetch_ {
+  struct B_IQuestion *question;
+  struct B_QuestionVTable const *question_vtable;
 };
 
+// Replicated questions to prefetch.
+struct B_MainPrefetchList_ {
+  struct B_MainPrefetch_ *entries;
+  size_t count;
+  size_t capacity;
+};
+
+static B_FUNC bool
+b_main_answer_(
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_IQuestion *,
+    B_BORROW struct B_QuestionVTable const *,
+    B_OUT_TRANSFER struct B_AnswerFuture **,
+    B_OUT struct B_Error *);
+
 struct B_AnswerContextCallbackClosure_ {
   struct B_Main *main;
   struct B_AnswerContext *answer_context;
+  struct B_MainNode *node;
+  // Owned by main->in_flight until the future completes.
+  struct B_QuestionKey key;
 };
 
+static B_WUR B_FUNC bool
+b_main_node_list_push_(
+    B_BORROW struct B_MainNodeList_ *list,
+    B_BORROW struct B_MainNode *node,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(list);
+  B_PRECONDITION(node);
+  B_OUT_PARAMETER(e);
+
+  if (list->count == list->capacity) {
+    size_t capacity = list->capacity == 0
+      ? B_MAIN_NODE_LIST_INITIAL_CAPACITY_
+      : list->capacity * 2;
+    struct B_MainNode **nodes;
+    bool ok;
+    if (list->nodes) {
+      ok = b_reallocate(
+        list->nodes,
+        sizeof(*nodes) * capacity,
+        (void **) &nodes,
+        e);
+    } else {
+      ok = b_allocate2(
+        sizeof(*nodes),
+        capacity,
+        (void **) &nodes,
+        e);
+    }
+    if (!ok) {
+      return false;
+    }
+    list->nodes = nodes;
+    list->capacity = capacity;
+  }
+  list->nodes[list->count] = node;
+  list->count += 1;
+  return true;
+}
+
+static B_FUNC void
+b_main_node_list_deinitialize_(
+    B_TRANSFER struct B_MainNodeList_ *list) {
+  B_PRECONDITION(list);
+
+  if (list->nodes) {
+    b_deallocate(list->nodes);
+  }
+  *list = (struct B_MainNodeList_) {
+    .nodes = NULL,
+    .count = 0,
+    .capacity = 0,
+  };
+}
+
+static B_FUNC void
+b_main_node_release_(
+    B_TRANSFER struct B_MainNode *node) {
+  B_PRECONDITION(node);
+  B_PRECONDITION(node->reference_count > 0);
+
+  node->reference_count -= 1;
+  if (node->reference_count == 0) {
+    B_ASSERT(!node->in_flight);
+    b_deallocate(node);
+  }
+}
+
+B_FUNC void
+b_main_node_retain(
+    B_BORROW struct B_MainNode *node) {
+  B_PRECONDITION(node);
+  B_PRECONDITION(node->reference_count > 0);
+
+  node->reference_count += 1;
+}
+
+B_FUNC void
+b_main_node_release(
+    B_TRANSFER struct B_MainNode *node) {
+  b_main_node_release_(node);
+}
+
+B_WUR B_FUNC B_BORROW struct B_AnswerContext *
+b_main_node_answer_context(
+    B_BORROW struct B_MainNode *node) {
+  B_PRECONDITION(node);
+
+  return node->answer_context;
+}
+
+// Removes the node from the graph.  See NOTE[dependency
+// cycles].
+static B_FUNC void
+b_main_node_finish_(
+    B_TRANSFER struct B_MainNode *node) {
+  B_PRECONDITION(node);
+  B_PRECONDITION(node->in_flight);
+
+  node->in_flight = false;
+  node->answer_context = NULL;
+  node->future = NULL;
+  node->question = NULL;
+  node->question_vtable = NULL;
+  struct B_MainNodeList_ *lists[] = {
+    &node->dependencies,
+    &node->dependants,
+  };
+  for (size_t i = 0;
+      i < sizeof(lists) / sizeof(*lists);
+      ++i) {
+    for (size_t j = 0; j < lists[i]->count; ++j) {
+      b_main_node_release_(lists[i]->nodes[j]);
+    }
+    b_main_node_list_deinitialize_(lists[i]);
+  }
+  b_main_node_release_(node);
+}
+
 static B_FUNC bool
 b_answer_context_callback_(
     B_BORROW struct B_AnswerFuture *future,
@@ -35,28 +457,66 @@ b_answer_context_callback_(
     = callback_data;
   struct B_AnswerContext *ac = closure->answer_context;
   B_ASSERT(future == ac->answer_future);
+  if (closure->main->tracer) {
+    b_tracer_end_async(
+      closure->main->tracer,
+      "question",
+      "question",
+      ac->trace_id,
+      b_tracer_now_us());
+  }
+  // See NOTE[in-flight questions].
+  void *in_flight_node;
+  struct B_QuestionKey key;
+  b_question_map_remove(
+    closure->main->in_flight,
+    &closure->key,
+    &in_flight_node,
+    &key);
+  B_ASSERT(in_flight_node == closure->node);
+  B_ASSERT(closure->node->future == future);
+  b_main_node_finish_(closure->node);
+  if (b_question_map_count(closure->main->in_flight) == 0) {
+    // See NOTE[cancellation].
+    closure->main->cancelled = false;
+  }
   enum B_AnswerFutureState state;
   if (!b_answer_future_state(future, &state, e)) {
+    b_question_key_deinitialize(&key);
     return false;
   }
   switch (state) {
   case B_FUTURE_PENDING:
+    b_question_key_deinitialize(&key);
     B_NYI();  // B_BUG();?
     return false;
   case B_FUTURE_FAILED:
-    // Nothing to do.
+    b_question_key_deinitialize(&key);
+    if (B_UNLIKELY(closure->main->observer.failed)) {
+      // See NOTE[main observers].
+      closure->main->observer.failed(
+        closure->main->observer_opaque,
+        closure->main,
+        ac->question,
+        ac->question_vtable);
+    }
+    if (closure->main->cancel_on_failure
+        && !closure->main->cancelled) {
+      // See NOTE[cancellation].
+      return b_main_cancel(closure->main, e);
+    }
     return true;
   case B_FUTURE_RESOLVED:
     {
       size_t count;
       if (!b_answer_future_answer_count(
           future, &count, e)) {
-        return false;
+        goto fail;
       }
       B_ASSERT(count == 1);
       struct B_IAnswer const *answer;
       if (!b_answer_future_answer(future, 0, &answer, e)) {
-        return false;
+        goto fail;
       }
       if (!b_database_record_answer(
           closure->main->database,
@@ -64,195 +524,1562 @@ b_answer_context_callback_(
           ac->question_vtable,
           answer,
           e)) {
-        return false;
+        goto fail;
+      }
+      // See NOTE[answer cache].
+      if (!b_answer_cache_insert(
+          closure->main->answer_cache, &key, future, e)) {
+        goto fail;
+      }
+      if (B_UNLIKELY(closure->main->observer.resolved)) {
+        // See NOTE[main observers].
+        closure->main->observer.resolved(
+          closure->main->observer_opaque,
+          closure->main,
+          ac->question,
+          ac->question_vtable);
       }
       return true;
     }
   }
   B_UNREACHABLE();
-}
 
-struct B_MainAnswerCallbackClosure_ {
-  struct B_Main *main;
-  struct B_AnswerContext *answer_context;
-};
+fail:
+  b_question_key_deinitialize(&key);
+  return false;
+}
 
+// Whether a should be dispatched after b.
 static B_FUNC bool
-b_main_answer_callback_(
-    B_BORROW void const *callback_data,
+b_main_ready_entry_less_(
+    B_BORROW struct B_MainReadyEntry_ const *a,
+    B_BORROW struct B_MainReadyEntry_ const *b) {
+  B_PRECONDITION(a);
+  B_PRECONDITION(b);
+
+  if (a->priority != b->priority) {
+    return a->priority < b->priority;
+  }
+  if (a->critical_path_us != b->critical_path_us) {
+    return a->critical_path_us < b->critical_path_us;
+  }
+  return a->sequence > b->sequence;
+}
+
+static B_FUNC void
+b_main_ready_swap_(
+    B_BORROW struct B_Main *main,
+    size_t i,
+    size_t j) {
+  B_PRECONDITION(main);
+
+  struct B_MainReadyEntry_ tmp = main->ready[i];
+  main->ready[i] = main->ready[j];
+  main->ready[j] = tmp;
+  main->ready[i].answer_context->main_node->ready_index = i;
+  main->ready[j].answer_context->main_node->ready_index = j;
+}
+
+static B_FUNC void
+b_main_ready_sift_up_(
+    B_BORROW struct B_Main *main,
+    size_t i) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(i < main->ready_count);
+
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (!b_main_ready_entry_less_(
+        &main->ready[parent], &main->ready[i])) {
+      break;
+    }
+    b_main_ready_swap_(main, parent, i);
+    i = parent;
+  }
+}
+
+// Makes room for count more answer contexts in
+// main->ready.
+static B_WUR B_FUNC bool
+b_main_ready_reserve_(
+    B_BORROW struct B_Main *main,
+    size_t count,
     B_OUT struct B_Error *e) {
-  B_PRECONDITION(callback_data);
+  B_PRECONDITION(main);
   B_OUT_PARAMETER(e);
 
-  struct B_MainAnswerCallbackClosure_ const *closure
-    = callback_data;
-  if (!closure->main->callback(
-      closure->main->callback_opaque,
-      closure->main,
-      closure->answer_context,
+  size_t needed = main->ready_count + count;
+  if (needed <= main->ready_capacity) {
+    return true;
+  }
+  size_t capacity = main->ready_capacity * 2;
+  while (capacity < needed) {
+    capacity *= 2;
+  }
+  struct B_MainReadyEntry_ *ready;
+  if (!b_reallocate(
+      main->ready,
+      sizeof(*ready) * capacity,
+      (void **) &ready,
       e)) {
     return false;
   }
+  main->ready = ready;
+  main->ready_capacity = capacity;
   return true;
 }
 
-static B_FUNC bool
-b_main_answer_cancel_callback_(
-    B_BORROW void const *callback_data,
-    B_OUT struct B_Error *e) {
-  B_PRECONDITION(callback_data);
-  B_OUT_PARAMETER(e);
+// See b_main_ready_reserve_.
+static B_FUNC void
+b_main_ready_push_(
+    B_BORROW struct B_Main *main,
+    B_TRANSFER struct B_AnswerContext *ac,
+    int64_t critical_path_us) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(ac);
+  B_PRECONDITION(main->ready_count < main->ready_capacity);
 
-  struct B_MainAnswerCallbackClosure_ const *closure
-    = callback_data;
-  if (!b_answer_context_deallocate(
-      closure->answer_context, e)) {
-    return false;
+  size_t i = main->ready_count;
+  main->ready[i] = (struct B_MainReadyEntry_) {
+    .answer_context = ac,
+    .priority = ac->priority,
+    .critical_path_us = critical_path_us,
+    .sequence = main->next_ready_sequence,
+  };
+  ac->main_node->ready_index = i;
+  main->ready_count += 1;
+  main->next_ready_sequence += 1;
+  b_main_ready_sift_up_(main, i);
+  if (main->tracer) {
+    // See NOTE[tracing].
+    b_tracer_begin_async(
+      main->tracer,
+      "question",
+      "ready",
+      ac->trace_id,
+      b_tracer_now_us(),
+      NULL);
   }
-  return true;
 }
 
-static B_FUNC bool
-b_main_cache_miss_callback_(
+static B_FUNC B_TRANSFER struct B_AnswerContext *
+b_main_ready_pop_(
+    B_BORROW struct B_Main *main) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(main->ready_count > 0);
+
+  struct B_AnswerContext *ac
+    = main->ready[0].answer_context;
+  ac->main_node->ready_index = SIZE_MAX;
+  main->ready_count -= 1;
+  main->ready[0] = main->ready[main->ready_count];
+  if (main->ready_count > 0) {
+    main->ready[0].answer_context->main_node->ready_index
+      = 0;
+  }
+  size_t i = 0;
+  for (;;) {
+    size_t largest = i;
+    size_t children[2] = {2 * i + 1, 2 * i + 2};
+    for (size_t j = 0; j < 2; ++j) {
+      size_t child = children[j];
+      if (child < main->ready_count
+          && b_main_ready_entry_less_(
+            &main->ready[largest], &main->ready[child])) {
+        largest = child;
+      }
+    }
+    if (largest == i) {
+      break;
+    }
+    b_main_ready_swap_(main, i, largest);
+    i = largest;
+  }
+  if (main->tracer) {
+    b_tracer_end_async(
+      main->tracer,
+      "question",
+      "ready",
+      ac->trace_id,
+      b_tracer_now_us());
+  }
+  return ac;
+}
+
+// Deallocates answer contexts which were never dispatched.
+static B_WUR B_FUNC bool
+b_main_clear_ready_(
     B_BORROW struct B_Main *main,
-    B_BORROW struct B_IQuestion *question,
-    B_BORROW struct B_QuestionVTable const *question_vtable,
-    B_OUT_TRANSFER struct B_AnswerFuture **out,
     B_OUT struct B_Error *e) {
   B_PRECONDITION(main);
-  B_PRECONDITION(question);
-  B_PRECONDITION(question_vtable);
-  B_OUT_PARAMETER(out);
   B_OUT_PARAMETER(e);
 
-  // First check the database.
-  struct B_IAnswer *answer;
-  if (!b_database_look_up_answer(
-      main->database,
-      question,
-      question_vtable,
-      &answer,
-      e)) {
-    return false;
-  }
-  if (answer) {
-    struct B_AnswerFuture *future;
-    if (!b_answer_future_allocate_one(
-        question_vtable->answer_vtable, &future, e)) {
-      B_NYI();  // TODO(strager): Clean up.
+  while (main->unestimated.count > 0) {
+    size_t last = main->unestimated.count - 1;
+    struct B_MainNode *node = main->unestimated.nodes[last];
+    if (!b_answer_context_deallocate(
+        node->answer_context, e)) {
       return false;
     }
-    if (!b_answer_future_resolve(future, answer, e)) {
-      B_NYI();  // TODO(strager): Clean up.
+    main->unestimated.count -= 1;
+  }
+  while (main->ready_count > 0) {
+    struct B_AnswerContext *ac = b_main_ready_pop_(main);
+    if (!b_answer_context_deallocate(ac, e)) {
       return false;
     }
-    *out = future;
-    return true;
   }
+  return true;
+}
 
-  struct B_AnswerContext *ac;
-  if (!b_answer_context_allocate(
-      main->database,
-      main,
-      question,
-      question_vtable,
-      &ac,
+static B_FUNC int64_t
+b_main_node_critical_path_us_(
+    B_BORROW struct B_MainNode const *node) {
+  B_PRECONDITION(node);
+
+  return node->dependant_path_us + node->cost_us;
+}
+
+// Looks up the costs of the answer contexts in
+// main->unestimated and moves them to main->ready.  See
+// NOTE[critical path scheduling].
+static B_WUR B_FUNC bool
+b_main_estimate_(
+    B_BORROW struct B_Main *main,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(main->unestimated.count > 0);
+  B_OUT_PARAMETER(e);
+
+  bool ok;
+  size_t count = main->unestimated.count;
+  struct B_MainNode **nodes = main->unestimated.nodes;
+  struct B_IQuestion const **questions = NULL;
+  struct B_QuestionVTable const **vtables = NULL;
+  struct B_ExecutionSummary *summaries = NULL;
+  if (!b_main_ready_reserve_(main, count, e)) {
+    goto fail;
+  }
+  if (!b_allocate2(
+      sizeof(*questions),
+      count,
+      (void **) &questions,
       e)) {
-    return false;
+    questions = NULL;
+    goto fail;
   }
-  struct B_AnswerContextCallbackClosure_ ac_closure = {
-    .main = main,
-    .answer_context = ac,
-  };
-  if (!b_answer_future_add_callback(
-      ac->answer_future,
-      b_answer_context_callback_,
-      &ac_closure,
-      sizeof(ac_closure),
+  if (!b_allocate2(
+      sizeof(*vtables),
+      count,
+      (void **) &vtables,
       e)) {
-    B_NYI();
-    return false;
+    vtables = NULL;
+    goto fail;
   }
-  struct B_MainAnswerCallbackClosure_ callback_closure = {
-    .main = main,
-    .answer_context = ac,
-  };
-  if (!b_run_loop_add_function(
-      main->run_loop,
-      b_main_answer_callback_,
-      b_main_answer_cancel_callback_,
-      &callback_closure,
-      sizeof(callback_closure),
+  if (!b_allocate2(
+      sizeof(*summaries),
+      count,
+      (void **) &summaries,
       e)) {
-    B_NYI();
-    return false;
+    summaries = NULL;
+    goto fail;
   }
-  struct B_AnswerFuture *future = ac->answer_future;
-  b_answer_future_retain(future);
-  *out = future;
-  return true;
+  for (size_t i = 0; i < count; ++i) {
+    questions[i] = nodes[i]->question;
+    vtables[i] = nodes[i]->question_vtable;
+  }
+  if (!b_database_summarize_all_executions(
+      main->database,
+      questions,
+      vtables,
+      count,
+      summaries,
+      e)) {
+    goto fail;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    struct B_MainNode *node = nodes[i];
+    node->cost_us = summaries[i].mean_wall_time_us;
+    b_main_ready_push_(
+      main,
+      node->answer_context,
+      b_main_node_critical_path_us_(node));
+  }
+  main->unestimated.count = 0;
+  ok = true;
+
+done:
+  if (questions) {
+    b_deallocate(questions);
+  }
+  if (vtables) {
+    b_deallocate(vtables);
+  }
+  if (summaries) {
+    b_deallocate(summaries);
+  }
+  return ok;
+
+fail:
+  ok = false;
+  goto done;
 }
 
-B_WUR B_EXPORT_FUNC bool
-b_main_allocate(
-    B_BORROW struct B_Database *db,
-    B_BORROW struct B_RunLoop *run_loop,
-    B_BORROW B_MainCallback *callback,
-    B_BORROW void *callback_opaque,
-    B_OUT_TRANSFER struct B_Main **out,
+static B_FUNC bool
+b_main_collect_prefetch_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
     B_OUT struct B_Error *e) {
-  B_PRECONDITION(db);
-  B_PRECONDITION(callback);
-  B_OUT_PARAMETER(out);
+  B_PRECONDITION(opaque);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
   B_OUT_PARAMETER(e);
 
-  struct B_Main *main;
-  if (!b_allocate(sizeof(*main), (void **) &main, e)) {
+  struct B_MainPrefetchList_ *list = opaque;
+  if (list->count == list->capacity) {
+    size_t capacity
+      = list->capacity == 0 ? 8 : list->capacity * 2;
+    struct B_MainPrefetch_ *entries;
+    bool ok;
+    if (list->entries) {
+      ok = b_reallocate(
+        list->entries,
+        sizeof(*entries) * capacity,
+        (void **) &entries,
+        e);
+    } else {
+      ok = b_allocate2(
+        sizeof(*entries),
+        capacity,
+        (void **) &entries,
+        e);
+    }
+    if (!ok) {
+      return false;
+    }
+    list->entries = entries;
+    list->capacity = capacity;
+  }
+  // See NOTE[question references].
+  struct B_IQuestion *retained;
+  if (!b_question_retain(
+      question, question_vtable, &retained, e)) {
     return false;
   }
-  *main = (struct B_Main) {
-    .database = db,
-    .run_loop = run_loop,
-    .callback = callback,
-    .callback_opaque = callback_opaque,
+  list->entries[list->count] = (struct B_MainPrefetch_) {
+    .question = retained,
+    .question_vtable = question_vtable,
   };
-  *out = main;
-  return true;
-}
-
-B_WUR B_EXPORT_FUNC bool
-b_main_deallocate(
-    B_TRANSFER struct B_Main *main,
-    B_OUT struct B_Error *e) {
-  B_PRECONDITION(main);
-  B_OUT_PARAMETER(e);
-
-  b_deallocate(main);
+  list->count += 1;
   return true;
 }
 
-B_WUR B_EXPORT_FUNC bool
-b_main_answer(
+// See NOTE[prefetch].
+static B_WUR B_FUNC bool
+b_main_prefetch_(
     B_BORROW struct B_Main *main,
-    B_BORROW struct B_IQuestion *question,
+    B_BORROW struct B_IQuestion const *question,
     B_BORROW struct B_QuestionVTable const *question_vtable,
-    B_OUT_TRANSFER struct B_AnswerFuture **out,
     B_OUT struct B_Error *e) {
   B_PRECONDITION(main);
+  B_PRECONDITION(main->prefetch_vtables);
   B_PRECONDITION(question);
   B_PRECONDITION(question_vtable);
-  B_OUT_PARAMETER(out);
   B_OUT_PARAMETER(e);
 
-  struct B_AnswerFuture *future;
-  // TODO(strager): Implement caching so calls of
-  // b_main_answer for the same question are serialized.
-  if (!b_main_cache_miss_callback_(
-      main, question, question_vtable, &future, e)) {
-    return false;
+  // Collect dependencies first; b_main_answer queries the
+  // database.
+  struct B_MainPrefetchList_ list = {
+    .entries = NULL,
+    .count = 0,
+    .capacity = 0,
+  };
+  bool ok = b_database_recorded_dependencies(
+    main->database,
+    question,
+    question_vtable,
+    main->prefetch_vtables,
+    main->prefetch_vtable_count,
+    b_main_collect_prefetch_,
+    &list,
+    e);
+  for (size_t i = 0; i < list.count; ++i) {
+    struct B_MainPrefetch_ *entry = &list.entries[i];
+    if (ok) {
+      struct B_AnswerFuture *future;
+      ok = b_main_answer_(
+        main,
+        entry->question,
+        entry->question_vtable,
+        &future,
+        e);
+      if (ok) {
+        // The answer is kept alive by main (while in
+        // flight) or by the cache.
+        b_answer_future_release(future);
+      }
+    }
+    b_question_release(
+      entry->question, entry->question_vtable);
   }
-  *out = future;
-  return true;
+  if (list.entries) {
+    b_deallocate(list.entries);
+  }
+  return ok;
+}
+
+struct B_MainDispatchClosure_ {
+  struct B_Main *main;
+};
+
+static B_FUNC bool
+b_main_dispatch_callback_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_MainDispatchClosure_ const *closure
+    = callback_data;
+  struct B_Main *main = closure->main;
+  B_ASSERT(main->dispatch_scheduled);
+  // See NOTE[critical path scheduling].
+  while (main->ready_count > 0
+      || main->unestimated.count > 0) {
+    if (main->unestimated.count > 0) {
+      if (!b_main_estimate_(main, e)) {
+        main->dispatch_scheduled = false;
+        return false;
+      }
+    }
+    struct B_AnswerContext *ac = b_main_ready_pop_(main);
+    if (main->cancelled) {
+      // See NOTE[cancellation].
+      if (!b_answer_context_fail(
+          ac,
+          (struct B_Error) {.posix_error = ECANCELED},
+          e)) {
+        main->dispatch_scheduled = false;
+        return false;
+      }
+      continue;
+    }
+    if (main->prefetch_vtables) {
+      // See NOTE[prefetch].
+      struct B_Error prefetch_error;
+      if (!b_main_prefetch_(
+          main,
+          ac->question,
+          ac->question_vtable,
+          &prefetch_error)) {
+        // Prefetching is only an optimization; ac will
+        // need its dependencies anyway.
+      }
+    }
+    if (B_UNLIKELY(main->observer.dispatched)) {
+      // See NOTE[main observers].
+      main->observer.dispatched(
+        main->observer_opaque,
+        main,
+        ac->question,
+        ac->question_vtable);
+    }
+    int64_t dispatched_at_us
+      = main->tracer ? b_tracer_now_us() : 0;
+    uint64_t trace_id = ac->trace_id;
+    b_answer_context_mark_dispatched(ac);
+    // NOTE(strager): The callback may deallocate ac.
+    bool ok = main->callback(
+      main->callback_opaque, main, ac, e);
+    if (main->tracer) {
+      b_tracer_span(
+        main->tracer,
+        "dispatch",
+        "dispatch",
+        dispatched_at_us,
+        b_tracer_now_us(),
+        &(struct B_TraceArg) {
+          .name = "question",
+          .string = NULL,
+          .string_size = 0,
+          .integer = (int64_t) trace_id,
+        });
+    }
+    if (!ok) {
+      main->dispatch_scheduled = false;
+      return false;
+    }
+  }
+  main->dispatch_scheduled = false;
+  return true;
+}
+
+static B_FUNC bool
+b_main_dispatch_cancel_callback_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_MainDispatchClosure_ const *closure
+    = callback_data;
+  closure->main->dispatch_scheduled = false;
+  return b_main_clear_ready_(closure->main, e);
+}
+
+// Queues the answer context for main->callback.  See
+// NOTE[critical path scheduling].  On failure, ac is not
+// queued.
+static B_WUR B_FUNC bool
+b_main_schedule_(
+    B_BORROW struct B_Main *main,
+    B_TRANSFER struct B_AnswerContext *ac,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(ac);
+  B_PRECONDITION(ac->main_node);
+  B_OUT_PARAMETER(e);
+
+  if (!b_main_node_list_push_(
+      &main->unestimated, ac->main_node, e)) {
+    return false;
+  }
+  if (!main->dispatch_scheduled) {
+    struct B_MainDispatchClosure_ closure = {
+      .main = main,
+    };
+    if (!b_run_loop_add_function(
+        main->run_loop,
+        b_main_dispatch_callback_,
+        b_main_dispatch_cancel_callback_,
+        &closure,
+        sizeof(closure),
+        e)) {
+      goto fail;
+    }
+    main->dispatch_scheduled = true;
+  }
+  return true;
+
+fail:
+  B_ASSERT(main->unestimated.count > 0);
+  main->unestimated.count -= 1;
+  return false;
+}
+
+static int
+b_main_node_order_compare_(
+    void const *a,
+    void const *b) {
+  uint64_t a_order
+    = (*(struct B_MainNode *const *) a)->order;
+  uint64_t b_order
+    = (*(struct B_MainNode *const *) b)->order;
+  return (a_order > b_order) - (a_order < b_order);
+}
+
+static int
+b_main_order_compare_(
+    void const *a,
+    void const *b) {
+  uint64_t a_order = *(uint64_t const *) a;
+  uint64_t b_order = *(uint64_t const *) b;
+  return (a_order > b_order) - (a_order < b_order);
+}
+
+// Unmarks nodes visited by b_main_add_edge_.
+static B_FUNC void
+b_main_end_search_(
+    B_BORROW struct B_Main *main) {
+  B_PRECONDITION(main);
+
+  struct B_MainNodeList_ *lists[] = {
+    &main->search_forward,
+    &main->search_backward,
+  };
+  for (size_t i = 0;
+      i < sizeof(lists) / sizeof(*lists);
+      ++i) {
+    for (size_t j = 0; j < lists[i]->count; ++j) {
+      lists[i]->nodes[j]->visited = false;
+      lists[i]->nodes[j]->search_parent = NULL;
+    }
+    lists[i]->count = 0;
+  }
+  main->search_stack.count = 0;
+}
+
+// Marks the node visited by b_main_add_edge_, and queues
+// it to be searched.
+static B_WUR B_FUNC bool
+b_main_visit_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_MainNodeList_ *visited,
+    B_BORROW struct B_MainNode *node,
+    B_BORROW_OPTIONAL struct B_MainNode *parent,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(visited);
+  B_PRECONDITION(node);
+  B_PRECONDITION(!node->visited);
+  B_OUT_PARAMETER(e);
+
+  if (!b_main_node_list_push_(visited, node, e)) {
+    return false;
+  }
+  node->visited = true;
+  node->search_parent = parent;
+  return b_main_node_list_push_(
+    &main->search_stack, node, e);
+}
+
+// Calls main->cycle_callback with the cycle found by
+// b_main_add_edge_: from, to, ..., to's dependant which
+// needs from.
+static B_WUR B_FUNC bool
+b_main_report_cycle_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_MainNode *from,
+    B_BORROW struct B_MainNode *to,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(from);
+  B_PRECONDITION(to);
+  B_OUT_PARAMETER(e);
+
+  if (!main->cycle_callback) {
+    return true;
+  }
+  // Follow search_parent links from `from` back to `to`.
+  size_t count = 1;
+  for (struct B_MainNode *node = from;
+      node != to;
+      node = node->search_parent) {
+    B_ASSERT(node->search_parent);
+    count += 1;
+  }
+  struct B_IQuestion const **questions;
+  if (!b_allocate2(
+      sizeof(*questions),
+      count,
+      (void **) &questions,
+      e)) {
+    return false;
+  }
+  struct B_QuestionVTable const **vtables;
+  if (!b_allocate2(
+      sizeof(*vtables), count, (void **) &vtables, e)) {
+    b_deallocate(questions);
+    return false;
+  }
+  questions[0] = from->question;
+  vtables[0] = from->question_vtable;
+  size_t i = count;
+  for (struct B_MainNode *node = from->search_parent;
+      node;
+      node = node->search_parent) {
+    i -= 1;
+    questions[i] = node->question;
+    vtables[i] = node->question_vtable;
+    if (node == to) {
+      break;
+    }
+  }
+  B_ASSERT(i == 1);
+  bool ok = main->cycle_callback(
+    main->cycle_callback_opaque,
+    questions,
+    vtables,
+    count,
+    e);
+  b_deallocate(vtables);
+  b_deallocate(questions);
+  return ok;
+}
+
+// Gives the nodes visited by b_main_add_edge_ new orders,
+// so from's dependants come before to's dependencies.
+static B_WUR B_FUNC bool
+b_main_reorder_(
+    B_BORROW struct B_Main *main,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_OUT_PARAMETER(e);
+
+  struct B_MainNodeList_ *backward = &main->search_backward;
+  struct B_MainNodeList_ *forward = &main->search_forward;
+  size_t count = backward->count + forward->count;
+  uint64_t *orders;
+  if (!b_allocate2(
+      sizeof(*orders), count, (void **) &orders, e)) {
+    return false;
+  }
+  qsort(
+    backward->nodes,
+    backward->count,
+    sizeof(*backward->nodes),
+    b_main_node_order_compare_);
+  qsort(
+    forward->nodes,
+    forward->count,
+    sizeof(*forward->nodes),
+    b_main_node_order_compare_);
+  for (size_t i = 0; i < backward->count; ++i) {
+    orders[i] = backward->nodes[i]->order;
+  }
+  for (size_t i = 0; i < forward->count; ++i) {
+    orders[backward->count + i] = forward->nodes[i]->order;
+  }
+  qsort(
+    orders, count, sizeof(*orders), b_main_order_compare_);
+  for (size_t i = 0; i < backward->count; ++i) {
+    backward->nodes[i]->order = orders[i];
+  }
+  for (size_t i = 0; i < forward->count; ++i) {
+    forward->nodes[i]->order = orders[backward->count + i];
+  }
+  b_deallocate(orders);
+  return true;
+}
+
+// Adds an edge from `from` (the dependant) to `to` (the
+// dependency), unless the edge would complete a cycle.
+// See NOTE[dependency cycles].
+static B_WUR B_FUNC bool
+b_main_add_edge_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_MainNode *from,
+    B_BORROW struct B_MainNode *to,
+    B_OUT bool *out_cycle,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(from);
+  B_PRECONDITION(from->in_flight);
+  B_PRECONDITION(to);
+  B_PRECONDITION(to->in_flight);
+  B_OUT_PARAMETER(out_cycle);
+  B_OUT_PARAMETER(e);
+
+  if (from == to) {
+    if (!b_main_report_cycle_(main, from, to, e)) {
+      return false;
+    }
+    *out_cycle = true;
+    return true;
+  }
+
+  if (from->order > to->order) {
+    uint64_t lower = to->order;
+    uint64_t upper = from->order;
+
+    // Search forward from `to` for `from`.
+    bool found = false;
+    if (!b_main_visit_(
+        main, &main->search_forward, to, NULL, e)) {
+      goto fail;
+    }
+    while (!found && main->search_stack.count > 0) {
+      main->search_stack.count -= 1;
+      struct B_MainNode *node = main->search_stack.nodes[
+        main->search_stack.count];
+      for (size_t i = 0;
+          i < node->dependencies.count;
+          ++i) {
+        struct B_MainNode *next
+          = node->dependencies.nodes[i];
+        if (!next->in_flight || next->visited) {
+          continue;
+        }
+        if (next == from) {
+          from->search_parent = node;
+          found = true;
+          break;
+        }
+        if (next->order < upper) {
+          if (!b_main_visit_(
+              main, &main->search_forward, next, node, e)) {
+            goto fail;
+          }
+        }
+      }
+    }
+    if (found) {
+      bool ok = b_main_report_cycle_(main, from, to, e);
+      from->search_parent = NULL;
+      b_main_end_search_(main);
+      if (!ok) {
+        return false;
+      }
+      *out_cycle = true;
+      return true;
+    }
+
+    // Search backward from `from`.
+    main->search_stack.count = 0;
+    if (!b_main_visit_(
+        main, &main->search_backward, from, NULL, e)) {
+      goto fail;
+    }
+    while (main->search_stack.count > 0) {
+      main->search_stack.count -= 1;
+      struct B_MainNode *node = main->search_stack.nodes[
+        main->search_stack.count];
+      for (size_t i = 0; i < node->dependants.count; ++i) {
+        struct B_MainNode *next = node->dependants.nodes[i];
+        if (!next->in_flight || next->visited) {
+          continue;
+        }
+        if (next->order > lower) {
+          if (!b_main_visit_(
+              main,
+              &main->search_backward,
+              next,
+              node,
+              e)) {
+            goto fail;
+          }
+        }
+      }
+    }
+
+    if (!b_main_reorder_(main, e)) {
+      goto fail;
+    }
+    b_main_end_search_(main);
+  }
+  B_ASSERT(from->order < to->order);
+
+  if (!b_main_node_list_push_(&from->dependencies, to, e)) {
+    return false;
+  }
+  if (!b_main_node_list_push_(&to->dependants, from, e)) {
+    from->dependencies.count -= 1;
+    return false;
+  }
+  to->reference_count += 1;
+  from->reference_count += 1;
+  *out_cycle = false;
+  return true;
+
+fail:
+  b_main_end_search_(main);
+  return false;
+}
+
+// Raises the priority of node and of its in-flight
+// dependencies to at least priority.  See
+// NOTE[priorities].
+static B_WUR B_FUNC bool
+b_main_raise_priority_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_MainNode *node,
+    int priority,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(node);
+  B_OUT_PARAMETER(e);
+
+  // Priorities only increase, so each node is pushed at
+  // most once per call.
+  struct B_MainNodeList_ *stack = &main->search_stack;
+  B_ASSERT(stack->count == 0);
+  if (!b_main_node_list_push_(stack, node, e)) {
+    return false;
+  }
+  while (stack->count > 0) {
+    stack->count -= 1;
+    struct B_MainNode *current = stack->nodes[stack->count];
+    struct B_AnswerContext *ac = current->answer_context;
+    if (!current->in_flight || !ac
+        || ac->priority >= priority) {
+      continue;
+    }
+    ac->priority = priority;
+    size_t ready_index = current->ready_index;
+    if (ready_index != SIZE_MAX) {
+      B_ASSERT(
+        main->ready[ready_index].answer_context == ac);
+      main->ready[ready_index].priority = priority;
+      b_main_ready_sift_up_(main, ready_index);
+    }
+    struct B_MainNodeList_ *dependencies
+      = &current->dependencies;
+    for (size_t i = 0; i < dependencies->count; ++i) {
+      if (!b_main_node_list_push_(
+          stack, dependencies->nodes[i], e)) {
+        stack->count = 0;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Raises the critical path of node to at least its cost
+// plus dependant_path_us.  See NOTE[critical path
+// scheduling].
+static B_FUNC void
+b_main_raise_critical_path_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_MainNode *node,
+    int64_t dependant_path_us) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(node);
+
+  struct B_AnswerContext *ac = node->answer_context;
+  if (!node->in_flight || !ac
+      || node->dependant_path_us >= dependant_path_us) {
+    return;
+  }
+  node->dependant_path_us = dependant_path_us;
+  // If ac is in main->unestimated, b_main_estimate_ will
+  // see the new path.
+  size_t ready_index = node->ready_index;
+  if (ready_index != SIZE_MAX) {
+    B_ASSERT(main->ready[ready_index].answer_context == ac);
+    main->ready[ready_index].critical_path_us
+      = b_main_node_critical_path_us_(node);
+    b_main_ready_sift_up_(main, ready_index);
+  }
+}
+
+// Sets *out to the future for the question if it is in
+// flight or was answered earlier in this session.
+// Otherwise, sets *out to NULL.
+static B_FUNC void
+b_main_find_future_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_BORROW struct B_QuestionKey const *key,
+    B_OUT_TRANSFER struct B_AnswerFuture **out) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_PRECONDITION(key);
+  B_OUT_PARAMETER(out);
+
+  // First check questions being answered.  See
+  // NOTE[in-flight questions].
+  void *in_flight_node;
+  b_question_map_find(
+    main->in_flight, key, &in_flight_node);
+  if (in_flight_node) {
+    struct B_AnswerFuture *future
+      = ((struct B_MainNode *) in_flight_node)->future;
+    b_answer_future_retain(future);
+    *out = future;
+    return;
+  }
+
+  // Then check answers resolved earlier in this session.
+  // See NOTE[answer cache].
+  b_answer_cache_look_up(main->answer_cache, key, out);
+  if (B_UNLIKELY(main->observer.cache_hit) && *out) {
+    // See NOTE[main observers].
+    main->observer.cache_hit(
+      main->observer_opaque,
+      main,
+      question,
+      question_vtable,
+      B_MAIN_CACHE_HIT_MEMORY);
+  }
+}
+
+// Creates a resolved future for an answer found in the
+// database.
+static B_FUNC bool
+b_main_resolve_from_database_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_TRANSFER struct B_QuestionKey *question_key,
+    B_TRANSFER struct B_IAnswer *answer,
+    B_OUT_TRANSFER struct B_AnswerFuture **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_PRECONDITION(question_key);
+  B_PRECONDITION(answer);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  if (B_UNLIKELY(main->observer.cache_hit)) {
+    // See NOTE[main observers].
+    main->observer.cache_hit(
+      main->observer_opaque,
+      main,
+      question,
+      question_vtable,
+      B_MAIN_CACHE_HIT_DATABASE);
+  }
+  struct B_QuestionKey key = *question_key;
+  struct B_AnswerFuture *future;
+  if (!b_answer_future_allocate_one(
+      question_vtable->answer_vtable, &future, e)) {
+    question_vtable->answer_vtable->deallocate(answer);
+    b_question_key_deinitialize(&key);
+    return false;
+  }
+  // The future owns answer, even if resolving fails.
+  if (!b_answer_future_resolve(future, answer, e)) {
+    goto fail;
+  }
+  if (!b_answer_cache_insert(
+      main->answer_cache, &key, future, e)) {
+    goto fail;
+  }
+  *out = future;
+  return true;
+
+fail:
+  b_question_key_deinitialize(&key);
+  b_answer_future_release(future);
+  return false;
+}
+
+// Fails and deallocates an answer context which
+// b_main_start_ could not put in flight.
+static B_FUNC void
+b_main_discard_answer_context_(
+    B_BORROW struct B_Main *main,
+    B_TRANSFER struct B_AnswerContext *ac,
+    struct B_Error error) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(ac);
+
+  if (main->tracer) {
+    b_tracer_end_async(
+      main->tracer,
+      "question",
+      "question",
+      ac->trace_id,
+      b_tracer_now_us());
+  }
+  if (!b_answer_future_fail(
+      ac->answer_future,
+      error,
+      &(struct B_Error) {.posix_error = 0})) {
+    // The future has no callbacks, so this cannot fail.
+  }
+  if (!b_answer_context_deallocate(
+      ac, &(struct B_Error) {.posix_error = 0})) {
+    // The future failed, so this cannot fail.
+  }
+}
+
+// Creates and schedules a B_AnswerContext for the
+// question.  Sets *out_node (if out_node is not NULL) to
+// its node.  dependant_path_us is the critical path of the
+// question's needer, or 0.  See NOTE[critical path
+// scheduling].
+static B_FUNC bool
+b_main_start_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_IQuestion *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_TRANSFER struct B_QuestionKey *question_key,
+    int priority,
+    int64_t dependant_path_us,
+    B_OUT_TRANSFER struct B_AnswerFuture **out,
+    B_OPTIONAL B_OUT_BORROW struct B_MainNode **out_node,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_PRECONDITION(question_key);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_QuestionKey key = *question_key;
+  struct B_AnswerContext *ac;
+  if (!b_answer_context_allocate(
+      main->database,
+      main,
+      question,
+      question_vtable,
+      &ac,
+      e)) {
+    b_question_key_deinitialize(&key);
+    return false;
+  }
+  ac->priority = priority;
+  ac->trace_id = main->next_trace_id;
+  main->next_trace_id += 1;
+  if (main->tracer) {
+    // See NOTE[tracing].
+    b_tracer_begin_async(
+      main->tracer,
+      "question",
+      "question",
+      ac->trace_id,
+      b_tracer_now_us(),
+      &(struct B_TraceArg) {
+        .name = "question",
+        .string = key.data,
+        .string_size = key.data_size,
+        .integer = 0,
+      });
+  }
+  struct B_MainNode *node;
+  if (!b_allocate(sizeof(*node), (void **) &node, e)) {
+    b_question_key_deinitialize(&key);
+    b_main_discard_answer_context_(main, ac, *e);
+    return false;
+  }
+  // See NOTE[dependency cycles].
+  *node = (struct B_MainNode) {
+    .future = ac->answer_future,
+    .question = ac->question,
+    .question_vtable = ac->question_vtable,
+    .in_flight = true,
+    .order = main->next_order,
+    .dependencies = {
+      .nodes = NULL,
+      .count = 0,
+      .capacity = 0,
+    },
+    .dependants = {
+      .nodes = NULL,
+      .count = 0,
+      .capacity = 0,
+    },
+    .reference_count = 1,
+    .answer_context = ac,
+    .dependant_path_us = dependant_path_us,
+    .cost_us = 0,
+    .ready_index = SIZE_MAX,
+    .visited = false,
+    .search_parent = NULL,
+  };
+  main->next_order += 1;
+  ac->main_node = node;
+  struct B_QuestionKey key_copy = key;
+  if (!b_question_map_insert(
+      main->in_flight, &key, node, e)) {
+    goto fail_node;
+  }
+  struct B_AnswerContextCallbackClosure_ ac_closure = {
+    .main = main,
+    .answer_context = ac,
+    .node = node,
+    .key = key_copy,
+  };
+  if (!b_answer_future_add_callback(
+      ac->answer_future,
+      b_answer_context_callback_,
+      &ac_closure,
+      sizeof(ac_closure),
+      e)) {
+    void *in_flight_node;
+    b_question_map_remove(
+      main->in_flight, &key_copy, &in_flight_node, &key);
+    B_ASSERT(in_flight_node == node);
+    goto fail_node;
+  }
+  if (!b_main_schedule_(main, ac, e)) {
+    goto fail_scheduling;
+  }
+  struct B_AnswerFuture *future = ac->answer_future;
+  b_answer_future_retain(future);
+  *out = future;
+  if (out_node) {
+    *out_node = node;
+  }
+  return true;
+
+fail_node:
+  b_deallocate(node);
+  b_question_key_deinitialize(&key);
+  b_main_discard_answer_context_(main, ac, *e);
+  return false;
+
+fail_scheduling:
+  // b_answer_context_callback_ removes node from
+  // main->in_flight.
+  if (!b_answer_future_fail(
+      ac->answer_future,
+      *e,
+      &(struct B_Error) {.posix_error = 0})) {
+    // The error from b_main_schedule_ is more useful.
+  }
+  if (!b_answer_context_deallocate(
+      ac, &(struct B_Error) {.posix_error = 0})) {
+    // The future failed, so this cannot fail.
+  }
+  return false;
+}
+
+// If a new B_AnswerContext is created for the question,
+// sets *out_node (if out_node is not NULL) to its node.
+// Otherwise, sets *out_node to NULL.
+static B_FUNC bool
+b_main_cache_miss_callback_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_IQuestion *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_TRANSFER struct B_QuestionKey *question_key,
+    int priority,
+    B_OUT_TRANSFER struct B_AnswerFuture **out,
+    B_OPTIONAL B_OUT_BORROW struct B_MainNode **out_node,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_PRECONDITION(question_key);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  if (out_node) {
+    *out_node = NULL;
+  }
+
+  struct B_AnswerFuture *future;
+  b_main_find_future_(
+    main, question, question_vtable, question_key, &future);
+  if (future) {
+    b_question_key_deinitialize(question_key);
+    *out = future;
+    return true;
+  }
+
+  // Then check the database.
+  struct B_IAnswer *answer;
+  if (!b_database_look_up_answer(
+      main->database,
+      question,
+      question_vtable,
+      &answer,
+      e)) {
+    b_question_key_deinitialize(question_key);
+    return false;
+  }
+  if (answer) {
+    return b_main_resolve_from_database_(
+      main,
+      question,
+      question_vtable,
+      question_key,
+      answer,
+      out,
+      e);
+  }
+  return b_main_start_(
+    main,
+    question,
+    question_vtable,
+    question_key,
+    priority,
+    0,
+    out,
+    out_node,
+    e);
+}
+
+static B_FUNC bool
+b_main_answer_(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_IQuestion *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_OUT_TRANSFER struct B_AnswerFuture **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  if (B_UNLIKELY(main->observer.question_requested)) {
+    // See NOTE[main observers].
+    main->observer.question_requested(
+      main->observer_opaque,
+      main,
+      question,
+      question_vtable);
+  }
+  struct B_QuestionKey key;
+  if (!b_question_key_initialize(
+      question, question_vtable, &key, e)) {
+    return false;
+  }
+  return b_main_cache_miss_callback_(
+    main, question, question_vtable, &key, 0, out, NULL, e);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_main_allocate(
+    B_BORROW struct B_Database *db,
+    B_BORROW struct B_RunLoop *run_loop,
+    B_BORROW B_MainCallback *callback,
+    B_BORROW void *callback_opaque,
+    B_OUT_TRANSFER struct B_Main **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(db);
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(callback);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_ProcessQueue *unlimited_process_queue;
+  if (!b_process_queue_allocate(
+      run_loop,
+      SIZE_MAX,
+      &unlimited_process_queue,
+      e)) {
+    return false;
+  }
+  struct B_QuestionMap *in_flight;
+  if (!b_question_map_allocate(&in_flight, e)) {
+    goto fail_process_queue;
+  }
+  struct B_AnswerCache *answer_cache;
+  if (!b_answer_cache_allocate(
+      B_MAIN_ANSWER_CACHE_CAPACITY_, &answer_cache, e)) {
+    b_question_map_deallocate(in_flight);
+    goto fail_process_queue;
+  }
+  struct B_MainReadyEntry_ *ready;
+  if (!b_allocate2(
+      sizeof(*ready),
+      B_MAIN_READY_INITIAL_CAPACITY_,
+      (void **) &ready,
+      e)) {
+    b_answer_cache_deallocate(answer_cache);
+    b_question_map_deallocate(in_flight);
+    goto fail_process_queue;
+  }
+  struct B_Main *main;
+  if (!b_allocate(sizeof(*main), (void **) &main, e)) {
+    b_deallocate(ready);
+    b_answer_cache_deallocate(answer_cache);
+    b_question_map_deallocate(in_flight);
+    goto fail_process_queue;
+  }
+  *main = (struct B_Main) {
+    .database = db,
+    .run_loop = run_loop,
+    .callback = callback,
+    .callback_opaque = callback_opaque,
+    .in_flight = in_flight,
+    .next_order = 0,
+    .cycle_callback = NULL,
+    .cycle_callback_opaque = NULL,
+    .search_stack = {
+      .nodes = NULL,
+      .count = 0,
+      .capacity = 0,
+    },
+    .search_forward = {
+      .nodes = NULL,
+      .count = 0,
+      .capacity = 0,
+    },
+    .search_backward = {
+      .nodes = NULL,
+      .count = 0,
+      .capacity = 0,
+    },
+    .answer_cache = answer_cache,
+    .unestimated = {
+      .nodes = NULL,
+      .count = 0,
+      .capacity = 0,
+    },
+    .ready = ready,
+    .ready_count = 0,
+    .ready_capacity = B_MAIN_READY_INITIAL_CAPACITY_,
+    .next_ready_sequence = 0,
+    .dispatch_scheduled = false,
+    .prefetch_vtables = NULL,
+    .prefetch_vtable_count = 0,
+    .process_queue = NULL,
+    .unlimited_process_queue = unlimited_process_queue,
+    .cancel_on_failure = false,
+    .cancelled = false,
+    .worker_pool = NULL,
+    .tracer = NULL,
+    .next_trace_id = 0,
+    .observer = {
+      .question_requested = NULL,
+      .cache_hit = NULL,
+      .dispatched = NULL,
+      .resolved = NULL,
+      .failed = NULL,
+      .dependency_recorded = NULL,
+      .process_started = NULL,
+      .process_exited = NULL,
+    },
+    .observer_opaque = NULL,
+  };
+  *out = main;
+  return true;
+
+fail_process_queue:
+  if (!b_process_queue_deallocate(
+      unlimited_process_queue,
+      &(struct B_Error) {.posix_error = 0})) {
+    // The queue is empty, so this cannot fail.
+  }
+  return false;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_main_deallocate(
+    B_TRANSFER struct B_Main *main,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_OUT_PARAMETER(e);
+
+  if (!b_main_clear_ready_(main, e)) {
+    return false;
+  }
+  b_main_node_list_deinitialize_(&main->unestimated);
+  b_deallocate(main->ready);
+  b_main_node_list_deinitialize_(&main->search_stack);
+  b_main_node_list_deinitialize_(&main->search_forward);
+  b_main_node_list_deinitialize_(&main->search_backward);
+  b_answer_cache_deallocate(main->answer_cache);
+  b_question_map_deallocate(main->in_flight);
+  bool ok = b_process_queue_deallocate(
+    main->unlimited_process_queue, e);
+  b_deallocate(main);
+  return ok;
+}
+
+B_EXPORT_FUNC void
+b_main_enable_prefetch(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t vtable_count) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(vtables);
+
+  main->prefetch_vtables = vtables;
+  main->prefetch_vtable_count = vtable_count;
+}
+
+B_EXPORT_FUNC void
+b_main_set_process_queue(
+    B_BORROW struct B_Main *main,
+    B_BORROW_OPTIONAL struct B_ProcessQueue *queue) {
+  B_PRECONDITION(main);
+
+  main->process_queue = queue;
+}
+
+B_EXPORT_FUNC void
+b_main_set_cancel_on_failure(
+    B_BORROW struct B_Main *main,
+    bool cancel_on_failure) {
+  B_PRECONDITION(main);
+
+  main->cancel_on_failure = cancel_on_failure;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_main_cancel(
+    B_BORROW struct B_Main *main,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_OUT_PARAMETER(e);
+
+  // See NOTE[cancellation].
+  if (b_question_map_count(main->in_flight) == 0) {
+    return true;
+  }
+  main->cancelled = true;
+  if (main->process_queue) {
+    if (!b_process_queue_cancel(
+        main->process_queue,
+        B_MAIN_TERMINATE_GRACE_PERIOD_MS_,
+        e)) {
+      return false;
+    }
+  }
+  return b_process_queue_cancel(
+    main->unlimited_process_queue,
+    B_MAIN_TERMINATE_GRACE_PERIOD_MS_,
+    e);
+}
+
+B_EXPORT_FUNC void
+b_main_set_worker_pool(
+    B_BORROW struct B_Main *main,
+    B_BORROW_OPTIONAL struct B_WorkerPool *pool) {
+  B_PRECONDITION(main);
+
+  main->worker_pool = pool;
+}
+
+B_EXPORT_FUNC void
+b_main_set_tracer(
+    B_BORROW struct B_Main *main,
+    B_BORROW_OPTIONAL struct B_Tracer *tracer) {
+  B_PRECONDITION(main);
+
+  main->tracer = tracer;
+  b_process_queue_set_tracer(
+    main->unlimited_process_queue, tracer);
+}
+
+B_EXPORT_FUNC void
+b_main_set_observer(
+    B_BORROW struct B_Main *main,
+    B_BORROW_OPTIONAL struct B_MainObserver const *observer,
+    B_BORROW void *observer_opaque) {
+  B_PRECONDITION(main);
+
+  if (observer) {
+    main->observer = *observer;
+  } else {
+    main->observer = (struct B_MainObserver) {
+      .question_requested = NULL,
+      .cache_hit = NULL,
+      .dispatched = NULL,
+      .resolved = NULL,
+      .failed = NULL,
+      .dependency_recorded = NULL,
+      .process_started = NULL,
+      .process_exited = NULL,
+    };
+  }
+  main->observer_opaque = observer_opaque;
+}
+
+B_EXPORT_FUNC void
+b_main_set_cycle_callback(
+    B_BORROW struct B_Main *main,
+    B_BORROW_OPTIONAL B_MainCycleCallback *callback,
+    B_BORROW void *callback_opaque) {
+  B_PRECONDITION(main);
+
+  main->cycle_callback = callback;
+  main->cycle_callback_opaque = callback_opaque;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_main_answer(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_IQuestion *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_OUT_TRANSFER struct B_AnswerFuture **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_AnswerFuture *future;
+  // See NOTE[in-flight questions].
+  if (!b_main_answer_(
+      main, question, question_vtable, &future, e)) {
+    return false;
+  }
+  *out = future;
+  return true;
 }
 
 B_WUR B_FUNC B_BORROW struct B_RunLoop *
@@ -262,3 +2089,390 @@ b_main_run_loop(
 
   return main->run_loop;
 }
+
+B_WUR B_FUNC B_BORROW struct B_ProcessQueue *
+b_main_process_queue(
+    B_BORROW struct B_Main *main) {
+  B_PRECONDITION(main);
+
+  return main->process_queue;
+}
+
+B_WUR B_FUNC B_BORROW struct B_ProcessQueue *
+b_main_unlimited_process_queue(
+    B_BORROW struct B_Main *main) {
+  B_PRECONDITION(main);
+
+  return main->unlimited_process_queue;
+}
+
+B_WUR B_FUNC bool
+b_main_cancelled(
+    B_BORROW struct B_Main *main) {
+  B_PRECONDITION(main);
+
+  return main->cancelled;
+}
+
+B_WUR B_FUNC B_BORROW struct B_WorkerPool *
+b_main_worker_pool(
+    B_BORROW struct B_Main *main) {
+  B_PRECONDITION(main);
+
+  return main->worker_pool;
+}
+
+B_WUR B_FUNC B_BORROW struct B_Tracer *
+b_main_tracer(
+    B_BORROW struct B_Main *main) {
+  B_PRECONDITION(main);
+
+  return main->tracer;
+}
+
+B_WUR B_FUNC B_BORROW struct B_MainObserver const *
+b_main_observer(
+    B_BORROW struct B_Main *main,
+    B_OUT_BORROW void **opaque) {
+  B_PRECONDITION(main);
+  B_OUT_PARAMETER(opaque);
+
+  *opaque = main->observer_opaque;
+  return &main->observer;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_main_forget(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_OUT_PARAMETER(e);
+
+  struct B_QuestionKey key;
+  if (!b_question_key_initialize(
+      question, question_vtable, &key, e)) {
+    return false;
+  }
+  // See NOTE[answer cache].
+  b_answer_cache_remove(main->answer_cache, &key);
+  b_question_key_deinitialize(&key);
+  return true;
+}
+
+B_WUR B_FUNC bool
+b_main_need(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_AnswerContext *ac,
+    B_BORROW struct B_IQuestion *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    int priority,
+    B_OUT_TRANSFER struct B_AnswerFuture **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+
+  return b_main_need_all(
+    main,
+    ac,
+    &question,
+    &question_vtable,
+    1,
+    priority,
+    out,
+    e);
+}
+
+// State for one question given to b_main_need_all.
+struct B_MainNeed_ {
+  struct B_QuestionKey key;
+  // If false, key is uninitialized or was transferred.
+  bool has_key;
+  // From the database, or NULL.
+  struct B_IAnswer *answer;
+};
+
+// See NOTE[batched needs].
+B_WUR B_FUNC bool
+b_main_need_all(
+    B_BORROW struct B_Main *main,
+    B_BORROW struct B_AnswerContext *ac,
+    B_BORROW struct B_IQuestion *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *vtables,
+    size_t count,
+    int priority,
+    B_OUT_TRANSFER struct B_AnswerFuture **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(main);
+  B_PRECONDITION(ac);
+  B_PRECONDITION(ac->main_node);
+  B_PRECONDITION(questions);
+  B_PRECONDITION(vtables);
+  B_PRECONDITION(count > 0);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  bool ok;
+  for (size_t i = 0; i < count; ++i) {
+    out[i] = NULL;
+  }
+  struct B_MainNeed_ *needs = NULL;
+  // Questions to give to the database.
+  struct B_IQuestion const **batch_questions = NULL;
+  struct B_QuestionVTable const **batch_vtables = NULL;
+  struct B_IAnswer **batch_answers = NULL;
+  // Index into needs of each batch_answers entry.
+  size_t *batch_indices = NULL;
+  size_t batch_count;
+  if (!b_allocate2(
+      sizeof(*needs), count, (void **) &needs, e)) {
+    needs = NULL;
+    goto fail;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    needs[i].has_key = false;
+    needs[i].answer = NULL;
+  }
+  if (!b_allocate2(
+      sizeof(*batch_questions),
+      count,
+      (void **) &batch_questions,
+      e)) {
+    batch_questions = NULL;
+    goto fail;
+  }
+  if (!b_allocate2(
+      sizeof(*batch_vtables),
+      count,
+      (void **) &batch_vtables,
+      e)) {
+    batch_vtables = NULL;
+    goto fail;
+  }
+  if (!b_allocate2(
+      sizeof(*batch_answers),
+      count,
+      (void **) &batch_answers,
+      e)) {
+    batch_answers = NULL;
+    goto fail;
+  }
+  if (!b_allocate2(
+      sizeof(*batch_indices),
+      count,
+      (void **) &batch_indices,
+      e)) {
+    batch_indices = NULL;
+    goto fail;
+  }
+
+  // Add edges to questions in flight.  See
+  // NOTE[dependency cycles].
+  batch_count = 0;
+  for (size_t i = 0; i < count; ++i) {
+    struct B_MainNeed_ *need = &needs[i];
+    if (B_UNLIKELY(main->observer.question_requested)) {
+      // See NOTE[main observers].
+      main->observer.question_requested(
+        main->observer_opaque,
+        main,
+        questions[i],
+        vtables[i]);
+    }
+    if (!b_question_key_initialize(
+        questions[i], vtables[i], &need->key, e)) {
+      goto fail;
+    }
+    need->has_key = true;
+    void *in_flight_node;
+    b_question_map_find(
+      main->in_flight, &need->key, &in_flight_node);
+    if (in_flight_node) {
+      bool cycle;
+      if (!b_main_add_edge_(
+          main, ac->main_node, in_flight_node, &cycle, e)) {
+        goto fail;
+      }
+      if (cycle) {
+        b_question_key_deinitialize(&need->key);
+        need->has_key = false;
+        if (!b_answer_future_allocate_one(
+            vtables[i]->answer_vtable, &out[i], e)) {
+          out[i] = NULL;
+          goto fail;
+        }
+        if (!b_answer_future_fail(
+            out[i],
+            (struct B_Error) {.posix_error = ELOOP},
+            e)) {
+          goto fail;
+        }
+        continue;
+      }
+      // See NOTE[priorities].
+      if (!b_main_raise_priority_(
+          main, in_flight_node, priority, e)) {
+        goto fail;
+      }
+      // See NOTE[critical path scheduling].
+      b_main_raise_critical_path_(
+        main,
+        in_flight_node,
+        b_main_node_critical_path_us_(ac->main_node));
+    }
+    batch_questions[batch_count] = questions[i];
+    batch_vtables[batch_count] = vtables[i];
+    batch_count += 1;
+  }
+
+  if (!b_database_record_dependencies(
+      main->database,
+      ac->question,
+      ac->question_vtable,
+      batch_questions,
+      batch_vtables,
+      batch_count,
+      e)) {
+    goto fail;
+  }
+  if (B_UNLIKELY(main->observer.dependency_recorded)) {
+    // See NOTE[main observers].
+    for (size_t j = 0; j < batch_count; ++j) {
+      main->observer.dependency_recorded(
+        main->observer_opaque,
+        main,
+        ac->question,
+        ac->question_vtable,
+        batch_questions[j],
+        batch_vtables[j]);
+    }
+  }
+
+  // Look up answers in the database for questions which
+  // are not in flight or cached.
+  batch_count = 0;
+  for (size_t i = 0; i < count; ++i) {
+    struct B_MainNeed_ *need = &needs[i];
+    if (!need->has_key) {
+      continue;
+    }
+    b_main_find_future_(
+      main, questions[i], vtables[i], &need->key, &out[i]);
+    if (out[i]) {
+      b_question_key_deinitialize(&need->key);
+      need->has_key = false;
+      continue;
+    }
+    batch_questions[batch_count] = questions[i];
+    batch_vtables[batch_count] = vtables[i];
+    batch_indices[batch_count] = i;
+    batch_count += 1;
+  }
+  if (!b_database_look_up_answers(
+      main->database,
+      batch_questions,
+      batch_vtables,
+      batch_count,
+      batch_answers,
+      e)) {
+    goto fail;
+  }
+  for (size_t j = 0; j < batch_count; ++j) {
+    needs[batch_indices[j]].answer = batch_answers[j];
+  }
+
+  for (size_t i = 0; i < count; ++i) {
+    struct B_MainNeed_ *need = &needs[i];
+    if (!need->has_key) {
+      continue;
+    }
+    // A question might be given more than once.
+    b_main_find_future_(
+      main, questions[i], vtables[i], &need->key, &out[i]);
+    if (out[i]) {
+      b_question_key_deinitialize(&need->key);
+      need->has_key = false;
+      continue;
+    }
+    need->has_key = false;
+    if (need->answer) {
+      struct B_IAnswer *answer = need->answer;
+      need->answer = NULL;
+      if (!b_main_resolve_from_database_(
+          main,
+          questions[i],
+          vtables[i],
+          &need->key,
+          answer,
+          &out[i],
+          e)) {
+        out[i] = NULL;
+        goto fail;
+      }
+      continue;
+    }
+    struct B_MainNode *node;
+    if (!b_main_start_(
+        main,
+        questions[i],
+        vtables[i],
+        &need->key,
+        priority,
+        b_main_node_critical_path_us_(ac->main_node),
+        &out[i],
+        &node,
+        e)) {
+      out[i] = NULL;
+      goto fail;
+    }
+    // A new node is ordered after ac's node, so this edge
+    // cannot complete a cycle.
+    bool cycle;
+    if (!b_main_add_edge_(
+        main, ac->main_node, node, &cycle, e)) {
+      goto fail;
+    }
+    B_ASSERT(!cycle);
+  }
+  ok = true;
+
+done:
+  if (needs) {
+    for (size_t i = 0; i < count; ++i) {
+      if (needs[i].has_key) {
+        b_question_key_deinitialize(&needs[i].key);
+      }
+      if (needs[i].answer) {
+        vtables[i]->answer_vtable->deallocate(
+          needs[i].answer);
+      }
+    }
+    b_deallocate(needs);
+  }
+  if (batch_questions) {
+    b_deallocate(batch_questions);
+  }
+  if (batch_vtables) {
+    b_deallocate(batch_vtables);
+  }
+  if (batch_answers) {
+    b_deallocate(batch_answers);
+  }
+  if (batch_indices) {
+    b_deallocate(batch_indices);
+  }
+  return ok;
+
+fail:
+  for (size_t i = 0; i < count; ++i) {
+    if (out[i]) {
+      b_answer_future_release(out[i]);
+      out[i] = NULL;
+    }
+  }
+  ok = false;
+  goto done;
+}
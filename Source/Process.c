@@ -1,5 +1,23 @@
+#include <B/Error.h>
+#include <B/Memory.h>
 #include <B/Private/Assertions.h>
+#include <B/Private/Config.h>
+#include <B/Private/Log.h>
+#include <B/Private/Memory.h>
 #include <B/Process.h>
+#include <B/RunLoop.h>
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if B_CONFIG_POSIX_PROCESS
+# include <signal.h>
+# include <sys/types.h>
+# include <sys/wait.h>
+# include <unistd.h>
+#endif
 
 B_WUR B_EXPORT_FUNC bool
 b_process_exit_status_equal(
@@ -23,3 +41,178 @@ b_process_exit_status_equal(
     B_BUG();
   }
 }
+
+#if B_CONFIG_POSIX_PROCESS
+// Whether the process exited, without reaping it.
+static B_WUR B_FUNC bool
+b_process_exited_(
+    B_ProcessID process_id,
+    B_OUT bool *out_exited,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(out_exited);
+  B_OUT_PARAMETER(e);
+
+  siginfo_t info;
+  info.si_pid = 0;
+  int rc;
+  do {
+    rc = waitid(
+      P_PID,
+      (id_t) process_id,
+      &info,
+      WEXITED | WNOHANG | WNOWAIT);
+  } while (rc == -1 && errno == EINTR);
+  if (rc == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+  *out_exited = info.si_pid != 0;
+  return true;
+}
+#endif
+
+// NOTE[process groups]: b_run_loop_exec starts each
+// process as the leader of a new process group, so
+// b_process_terminate signals the whole group: a compiler
+// driver's compiler, or a shell's pipeline, is terminated
+// along with the process the run loop waits for.
+//
+// A consequence is that processes are not in the
+// terminal's foreground process group: they do not
+// receive SIGINT from Ctrl-C, and a process reading from
+// the terminal is stopped by SIGTTIN.  Programs must catch
+// SIGINT and SIGTERM themselves and cancel their processes
+// (e.g. with b_main_cancel), as the SelfCompile example
+// does, and must not run commands which read from the
+// terminal.
+//
+// The process group's ID is the leader's process ID.  The
+// leader is unreaped while it is being terminated, so the
+// ID cannot be reused and kill cannot hit an unrelated
+// group.  A process not started by b_run_loop_exec (e.g.
+// given to b_run_loop_add_process_id) might not lead a
+// group; it is signalled alone.
+
+#if B_CONFIG_POSIX_PROCESS
+// Sends signal_number to process_id's process group, or
+// to process_id alone if it does not lead a group.
+static B_WUR B_FUNC bool
+b_process_signal_group_(
+    B_ProcessID process_id,
+    int signal_number,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(e);
+
+  if (kill(-(pid_t) process_id, signal_number) == 0) {
+    return true;
+  }
+  if (errno != ESRCH) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+  if (kill((pid_t) process_id, signal_number) == -1) {
+    *e = (struct B_Error) {.posix_error = errno};
+    return false;
+  }
+  return true;
+}
+
+struct B_ProcessTerminateClosure_ {
+  size_t process_count;
+  B_ProcessID process_ids[];
+};
+
+// Forces each process group still around after the grace
+// period to exit.
+static B_FUNC bool
+b_process_kill_callback_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_ProcessTerminateClosure_ const *closure
+    = callback_data;
+  for (size_t i = 0; i < closure->process_count; ++i) {
+    bool exited;
+    if (!b_process_exited_(
+        closure->process_ids[i], &exited, e)) {
+      if (e->posix_error == ECHILD) {
+        // The run loop reaped the process, so its ID might
+        // have been reused.
+        continue;
+      }
+      return false;
+    }
+    // An exited leader's group might still have running
+    // processes, so signal it anyway.
+    if (!b_process_signal_group_(
+        closure->process_ids[i], SIGKILL, e)) {
+      if (e->posix_error == ESRCH) {
+        // Everything in the group exited.
+        continue;
+      }
+      return false;
+    }
+  }
+  return true;
+}
+#endif
+
+B_WUR B_EXPORT_FUNC bool
+b_process_terminate(
+    B_BORROW struct B_RunLoop *run_loop,
+    B_BORROW B_ProcessID const *process_ids,
+    size_t process_count,
+    int64_t grace_period_ms,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(process_ids || process_count == 0);
+  B_PRECONDITION(grace_period_ms >= 0);
+  B_OUT_PARAMETER(e);
+
+#if B_CONFIG_POSIX_PROCESS
+  if (process_count == 0) {
+    return true;
+  }
+  // See NOTE[process groups].
+  for (size_t i = 0; i < process_count; ++i) {
+    if (!b_process_signal_group_(
+        process_ids[i], SIGTERM, e)) {
+      return false;
+    }
+  }
+  size_t header_size = offsetof(
+    struct B_ProcessTerminateClosure_, process_ids);
+  if (process_count
+      > (SIZE_MAX - header_size) / sizeof(*process_ids)) {
+    *e = (struct B_Error) {.posix_error = ENOMEM};
+    return false;
+  }
+  size_t closure_size = header_size
+    + sizeof(*process_ids) * process_count;
+  struct B_ProcessTerminateClosure_ *closure;
+  if (!b_allocate(closure_size, (void **) &closure, e)) {
+    return false;
+  }
+  closure->process_count = process_count;
+  memcpy(
+    closure->process_ids,
+    process_ids,
+    sizeof(*process_ids) * process_count);
+  // If the run loop is deallocated before the grace period
+  // ends, force the processes to exit then.
+  bool ok = b_run_loop_add_timer(
+    run_loop,
+    grace_period_ms,
+    b_process_kill_callback_,
+    b_process_kill_callback_,
+    closure,
+    closure_size,
+    e);
+  b_deallocate(closure);
+  return ok;
+#else
+# error "Unknown process implementation"
+#endif
+}
@@ -0,0 +1,865 @@
+// NOTE[process queue]: b_run_loop_exec_basic starts a
+// process immediately.  A B_ProcessQueue instead starts a
+// process only if fewer than job_slots of its processes
+// are running (like make's -j), and, if the process is in
+// a pool, fewer than the pool's slots of the pool's
+// processes are running.  Otherwise, the process waits.
+//
+// Whenever a process exits, waiting processes are started
+// in priority order (then in the order they were queued),
+// skipping processes whose pools are full.
+//
+// If the queue has a jobserver (see NOTE[jobserver]), each
+// running process except the first also needs a jobserver
+// token.  The run loop cannot wait for tokens, so a
+// process waiting for a token starts only after another of
+// the queue's processes exits.  A token freed by another
+// program sharing the jobserver does not wake the queue.
+//
+// NOTE[memory budget]: If the queue has a memory budget,
+// a process starts only if the memory estimates of the
+// running processes plus its own fit in the budget.  (The
+// first running process always starts, even if it alone
+// exceeds the budget.)  A process which does not fit
+// blocks processes queued after it, so a stream of small
+// processes cannot starve a big one (e.g. a link).
+
+#include <B/Error.h>
+#include <B/Jobserver.h>
+#include <B/Memory.h>
+#include <B/Private/Assertions.h>
+#include <B/Private/Callback.h>
+#include <B/Private/Memory.h>
+#include <B/Process.h>
+#include <B/ProcessQueue.h>
+#include <B/Tracer.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+  B_PROCESS_QUEUE_NO_POOL_ = -1,
+};
+
+struct B_ProcessQueuePool_ {
+  char *name;
+  size_t slots;
+  size_t running_count;
+};
+
+struct B_ProcessQueueRequest_ {
+  // Next waiting (or running) request.
+  struct B_ProcessQueueRequest_ *next;
+  // Set when the process starts.
+  B_ProcessID process_id;
+  // Index into B_ProcessQueue::pools, or
+  // B_PROCESS_QUEUE_NO_POOL_.
+  int pool_index;
+  // Never B_PROCESS_QUEUE_UNKNOWN_MEMORY.  See
+  // NOTE[memory budget].
+  int64_t memory_bytes;
+  // Higher starts first.
+  int priority;
+  // NULL-terminated.  Strings are stored after the
+  // pointers in the same allocation.
+  char **command_args;
+  // Optional.
+  B_ProcessQueueStartFunction *start_callback;
+  B_RunLoopProcessFunction *callback;
+  B_RunLoopFunction *cancel_callback;
+  union B_UserData user_data;
+};
+
+struct B_ProcessQueue {
+  struct B_RunLoop *run_loop;
+  size_t job_slots;
+  size_t running_count;
+  // Unordered.  See b_process_queue_cancel.
+  struct B_ProcessQueueRequest_ *running_head;
+  // Optional.  Borrowed.
+  struct B_Jobserver *jobserver;
+  // Optional.  Borrowed.  See NOTE[tracing].
+  struct B_Tracer *tracer;
+
+  // 0 if unlimited.  See NOTE[memory budget].
+  int64_t memory_budget_bytes;
+  // Used for B_PROCESS_QUEUE_UNKNOWN_MEMORY.
+  int64_t default_memory_bytes;
+  // Sum of the estimates of running processes.
+  int64_t running_memory_bytes;
+  // Whether a waiting process does not fit in the memory
+  // budget.
+  bool memory_blocked;
+
+  struct B_ProcessQueuePool_ *pools;
+  size_t pool_count;
+
+  // Sorted by descending priority, then FIFO.
+  struct B_ProcessQueueRequest_ *waiting_head;
+  struct B_ProcessQueueRequest_ *waiting_tail;
+  size_t waiting_count;
+};
+
+// The closure given to the run loop for a running
+// request.
+struct B_ProcessQueueClosure_ {
+  struct B_ProcessQueue *queue;
+  struct B_ProcessQueueRequest_ *request;
+};
+
+static B_WUR B_FUNC bool
+b_process_queue_start_waiting_(
+    B_BORROW struct B_ProcessQueue *,
+    B_OUT struct B_Error *);
+
+static B_FUNC void
+b_process_queue_deallocate_request_(
+    B_TRANSFER struct B_ProcessQueueRequest_ *request) {
+  B_PRECONDITION(request);
+
+  b_deallocate(request->command_args);
+  b_deallocate(request);
+}
+
+// Bookkeeping for a request whose process exited or was
+// cancelled.
+static B_FUNC void
+b_process_queue_finish_(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_BORROW struct B_ProcessQueueRequest_ *request) {
+  B_PRECONDITION(queue);
+  B_PRECONDITION(request);
+
+  B_ASSERT(queue->running_count > 0);
+  queue->running_count -= 1;
+  struct B_ProcessQueueRequest_ **link
+    = &queue->running_head;
+  while (*link != request) {
+    B_ASSERT(*link);
+    link = &(*link)->next;
+  }
+  *link = request->next;
+  request->next = NULL;
+  if (queue->tracer) {
+    b_tracer_end_async(
+      queue->tracer,
+      "process",
+      request->command_args[0],
+      (uint64_t) request->process_id,
+      b_tracer_now_us());
+  }
+  B_ASSERT(queue->running_memory_bytes
+    >= request->memory_bytes);
+  queue->running_memory_bytes -= request->memory_bytes;
+  if (request->pool_index != B_PROCESS_QUEUE_NO_POOL_) {
+    struct B_ProcessQueuePool_ *pool
+      = &queue->pools[request->pool_index];
+    B_ASSERT(pool->running_count > 0);
+    pool->running_count -= 1;
+  }
+}
+
+// Takes a jobserver token if another running process
+// needs one.  See NOTE[jobserver].
+static B_WUR B_FUNC bool
+b_process_queue_acquire_token_(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_OUT bool *acquired,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(queue);
+  B_OUT_PARAMETER(acquired);
+  B_OUT_PARAMETER(e);
+
+  if (!queue->jobserver || queue->running_count == 0) {
+    *acquired = true;
+    return true;
+  }
+  return b_jobserver_try_acquire(
+    queue->jobserver, acquired, e);
+}
+
+// Returns jobserver tokens no running process needs.
+static B_WUR B_FUNC bool
+b_process_queue_release_tokens_(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(queue);
+  B_OUT_PARAMETER(e);
+
+  if (!queue->jobserver) {
+    return true;
+  }
+  size_t needed = queue->running_count > 0
+    ? queue->running_count - 1
+    : 0;
+  while (b_jobserver_held_count(queue->jobserver)
+      > needed) {
+    if (!b_jobserver_release(queue->jobserver, e)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static B_FUNC bool
+b_process_queue_exit_callback_(
+    B_BORROW struct B_ProcessExitStatus const *exit_status,
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(exit_status);
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_ProcessQueueClosure_ const *closure
+    = callback_data;
+  struct B_ProcessQueue *queue = closure->queue;
+  struct B_ProcessQueueRequest_ *request = closure->request;
+  b_process_queue_finish_(queue, request);
+  struct B_Error release_error;
+  bool released = b_process_queue_release_tokens_(
+    queue, &release_error);
+  bool ok = request->callback(
+    exit_status, request->user_data.bytes, e);
+  b_process_queue_deallocate_request_(request);
+  if (!ok) {
+    return false;
+  }
+  if (!released) {
+    *e = release_error;
+    return false;
+  }
+  return b_process_queue_start_waiting_(queue, e);
+}
+
+static B_FUNC bool
+b_process_queue_cancel_callback_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_ProcessQueueClosure_ const *closure
+    = callback_data;
+  struct B_ProcessQueueRequest_ *request = closure->request;
+  b_process_queue_finish_(closure->queue, request);
+  struct B_Error release_error;
+  bool released = b_process_queue_release_tokens_(
+    closure->queue, &release_error);
+  bool ok = request->cancel_callback(
+    request->user_data.bytes, e);
+  b_process_queue_deallocate_request_(request);
+  if (!ok) {
+    return false;
+  }
+  if (!released) {
+    *e = release_error;
+    return false;
+  }
+  return true;
+}
+
+static B_FUNC bool
+b_process_queue_fits_memory_(
+    B_BORROW struct B_ProcessQueue const *queue,
+    B_BORROW struct B_ProcessQueueRequest_ const *request) {
+  B_PRECONDITION(queue);
+  B_PRECONDITION(request);
+
+  if (queue->memory_budget_bytes == 0
+      || queue->running_count == 0) {
+    return true;
+  }
+  return request->memory_bytes
+    <= queue->memory_budget_bytes
+      - queue->running_memory_bytes;
+}
+
+static B_FUNC bool
+b_process_queue_can_start_(
+    B_BORROW struct B_ProcessQueue const *queue,
+    B_BORROW struct B_ProcessQueueRequest_ const *request) {
+  B_PRECONDITION(queue);
+  B_PRECONDITION(request);
+
+  if (queue->running_count >= queue->job_slots) {
+    return false;
+  }
+  if (request->pool_index != B_PROCESS_QUEUE_NO_POOL_) {
+    struct B_ProcessQueuePool_ const *pool
+      = &queue->pools[request->pool_index];
+    if (pool->running_count >= pool->slots) {
+      return false;
+    }
+  }
+  return b_process_queue_fits_memory_(queue, request);
+}
+
+// On success, the run loop owns request.
+static B_WUR B_FUNC bool
+b_process_queue_start_(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_BORROW struct B_ProcessQueueRequest_ *request,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(queue);
+  B_PRECONDITION(request);
+  B_PRECONDITION(
+    b_process_queue_can_start_(queue, request));
+  B_OUT_PARAMETER(e);
+
+  struct B_ProcessQueueClosure_ closure = {
+    .queue = queue,
+    .request = request,
+  };
+  if (!b_run_loop_exec(
+      queue->run_loop,
+      (char const *const *) request->command_args,
+      b_process_queue_exit_callback_,
+      b_process_queue_cancel_callback_,
+      &closure,
+      sizeof(closure),
+      &request->process_id,
+      e)) {
+    return false;
+  }
+  if (queue->tracer) {
+    struct B_TraceArg arg = {
+      .name = "pid",
+      .string = NULL,
+      .string_size = 0,
+      .integer = (int64_t) request->process_id,
+    };
+    b_tracer_begin_async(
+      queue->tracer,
+      "process",
+      request->command_args[0],
+      (uint64_t) request->process_id,
+      b_tracer_now_us(),
+      &arg);
+  }
+  if (request->start_callback) {
+    request->start_callback(
+      request->process_id, request->user_data.bytes);
+  }
+  request->next = queue->running_head;
+  queue->running_head = request;
+  queue->running_count += 1;
+  queue->running_memory_bytes += request->memory_bytes;
+  if (request->pool_index != B_PROCESS_QUEUE_NO_POOL_) {
+    queue->pools[request->pool_index].running_count += 1;
+  }
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_process_queue_start_waiting_(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(queue);
+  B_OUT_PARAMETER(e);
+
+  struct B_ProcessQueueRequest_ **link
+    = &queue->waiting_head;
+  struct B_ProcessQueueRequest_ *previous = NULL;
+  queue->memory_blocked = false;
+  while (*link
+      && queue->running_count < queue->job_slots) {
+    struct B_ProcessQueueRequest_ *request = *link;
+    if (!b_process_queue_fits_memory_(queue, request)) {
+      // See NOTE[memory budget].
+      queue->memory_blocked = true;
+      break;
+    }
+    if (!b_process_queue_can_start_(queue, request)) {
+      previous = request;
+      link = &request->next;
+      continue;
+    }
+    bool acquired;
+    if (!b_process_queue_acquire_token_(
+        queue, &acquired, e)) {
+      return false;
+    }
+    if (!acquired) {
+      // No other request can start either.
+      break;
+    }
+    *link = request->next;
+    if (queue->waiting_tail == request) {
+      queue->waiting_tail = previous;
+    }
+    queue->waiting_count -= 1;
+    request->next = NULL;
+    struct B_Error start_error;
+    if (!b_process_queue_start_(
+        queue, request, &start_error)) {
+      if (!b_process_queue_release_tokens_(queue, e)) {
+        b_process_queue_deallocate_request_(request);
+        return false;
+      }
+      // The caller of b_process_queue_exec_basic is gone,
+      // so report the failure through cancel_callback.
+      bool ok = request->cancel_callback(
+        request->user_data.bytes, e);
+      b_process_queue_deallocate_request_(request);
+      if (!ok) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Copies a NULL-terminated array of strings into a single
+// allocation.
+static B_WUR B_FUNC bool
+b_process_queue_copy_args_(
+    B_BORROW char const *const *args,
+    B_OUT_TRANSFER char ***out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(args);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  size_t arg_count = 0;
+  size_t string_size = 0;
+  for (char const *const *arg = args; *arg; ++arg) {
+    arg_count += 1;
+    string_size += strlen(*arg) + 1;
+  }
+  size_t pointers_size = sizeof(char *) * (arg_count + 1);
+  char **copy;
+  if (!b_allocate(
+      pointers_size + string_size, (void **) &copy, e)) {
+    return false;
+  }
+  char *strings = (char *) copy + pointers_size;
+  for (size_t i = 0; i < arg_count; ++i) {
+    size_t size = strlen(args[i]) + 1;
+    memcpy(strings, args[i], size);
+    copy[i] = strings;
+    strings += size;
+  }
+  copy[arg_count] = NULL;
+  *out = copy;
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_allocate(
+    B_BORROW struct B_RunLoop *run_loop,
+    size_t job_slots,
+    B_OUT_TRANSFER struct B_ProcessQueue **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(job_slots > 0);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_ProcessQueue *queue;
+  if (!b_allocate(sizeof(*queue), (void **) &queue, e)) {
+    return false;
+  }
+  *queue = (struct B_ProcessQueue) {
+    .run_loop = run_loop,
+    .job_slots = job_slots,
+    .running_count = 0,
+    .running_head = NULL,
+    .jobserver = NULL,
+    .tracer = NULL,
+    .memory_budget_bytes = 0,
+    .default_memory_bytes = 0,
+    .running_memory_bytes = 0,
+    .memory_blocked = false,
+    .pools = NULL,
+    .pool_count = 0,
+    .waiting_head = NULL,
+    .waiting_tail = NULL,
+    .waiting_count = 0,
+  };
+  *out = queue;
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_deallocate(
+    B_TRANSFER struct B_ProcessQueue *queue,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(queue);
+  B_OUT_PARAMETER(e);
+
+  bool ok = true;
+  while (queue->waiting_head) {
+    struct B_ProcessQueueRequest_ *request
+      = queue->waiting_head;
+    queue->waiting_head = request->next;
+    if (ok) {
+      ok = request->cancel_callback(
+        request->user_data.bytes, e);
+    }
+    b_process_queue_deallocate_request_(request);
+  }
+  for (size_t i = 0; i < queue->pool_count; ++i) {
+    b_deallocate(queue->pools[i].name);
+  }
+  if (queue->pools) {
+    b_deallocate(queue->pools);
+  }
+  b_deallocate(queue);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_cancel(
+    B_BORROW struct B_ProcessQueue *queue,
+    int64_t grace_period_ms,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(queue);
+  B_PRECONDITION(grace_period_ms >= 0);
+  B_OUT_PARAMETER(e);
+
+  // Cancel waiting processes first, so running processes
+  // exiting cannot start them.  A cancel callback might
+  // queue another process, which is cancelled too.
+  bool ok = true;
+  while (queue->waiting_head) {
+    struct B_ProcessQueueRequest_ *request
+      = queue->waiting_head;
+    queue->waiting_head = request->next;
+    if (!queue->waiting_head) {
+      queue->waiting_tail = NULL;
+    }
+    queue->waiting_count -= 1;
+    queue->memory_blocked = false;
+    if (ok) {
+      ok = request->cancel_callback(
+        request->user_data.bytes, e);
+    }
+    b_process_queue_deallocate_request_(request);
+  }
+  if (!ok) {
+    return false;
+  }
+  if (queue->running_count == 0) {
+    return true;
+  }
+
+  // The run loop reports each process's exit as usual.
+  B_ProcessID *process_ids;
+  if (!b_allocate2(
+      sizeof(*process_ids),
+      queue->running_count,
+      (void **) &process_ids,
+      e)) {
+    return false;
+  }
+  size_t process_count = 0;
+  for (struct B_ProcessQueueRequest_ *request
+        = queue->running_head;
+      request;
+      request = request->next) {
+    B_ASSERT(process_count < queue->running_count);
+    process_ids[process_count] = request->process_id;
+    process_count += 1;
+  }
+  ok = b_process_terminate(
+    queue->run_loop,
+    process_ids,
+    process_count,
+    grace_period_ms,
+    e);
+  b_deallocate(process_ids);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_add_pool(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_BORROW char const *pool_name,
+    size_t slots,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(queue);
+  B_PRECONDITION(pool_name);
+  B_PRECONDITION(slots > 0);
+  B_OUT_PARAMETER(e);
+
+  for (size_t i = 0; i < queue->pool_count; ++i) {
+    if (strcmp(queue->pools[i].name, pool_name) == 0) {
+      *e = (struct B_Error) {.posix_error = EEXIST};
+      return false;
+    }
+  }
+  if (queue->pool_count >= INT_MAX) {
+    *e = (struct B_Error) {.posix_error = ENOMEM};
+    return false;
+  }
+  char *name;
+  if (!b_strdup(pool_name, &name, e)) {
+    return false;
+  }
+  size_t pools_size
+    = sizeof(*queue->pools) * (queue->pool_count + 1);
+  struct B_ProcessQueuePool_ *pools;
+  bool ok;
+  if (queue->pools) {
+    ok = b_reallocate(
+      queue->pools, pools_size, (void **) &pools, e);
+  } else {
+    ok = b_allocate(pools_size, (void **) &pools, e);
+  }
+  if (!ok) {
+    b_deallocate(name);
+    return false;
+  }
+  pools[queue->pool_count] = (struct B_ProcessQueuePool_) {
+    .name = name,
+    .slots = slots,
+    .running_count = 0,
+  };
+  queue->pools = pools;
+  queue->pool_count += 1;
+  return true;
+}
+
+B_EXPORT_FUNC void
+b_process_queue_set_jobserver(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_BORROW_OPTIONAL struct B_Jobserver *jobserver) {
+  B_PRECONDITION(queue);
+  B_PRECONDITION(queue->running_count == 0);
+
+  queue->jobserver = jobserver;
+}
+
+B_EXPORT_FUNC void
+b_process_queue_set_tracer(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_BORROW_OPTIONAL struct B_Tracer *tracer) {
+  B_PRECONDITION(queue);
+  B_PRECONDITION(queue->running_count == 0);
+
+  queue->tracer = tracer;
+}
+
+B_EXPORT_FUNC void
+b_process_queue_set_memory_budget(
+    B_BORROW struct B_ProcessQueue *queue,
+    int64_t budget_bytes,
+    int64_t default_process_bytes) {
+  B_PRECONDITION(queue);
+  B_PRECONDITION(budget_bytes >= 0);
+  B_PRECONDITION(default_process_bytes >= 0);
+  B_PRECONDITION(queue->running_count == 0);
+  B_PRECONDITION(queue->waiting_count == 0);
+
+  queue->memory_budget_bytes = budget_bytes;
+  queue->default_memory_bytes = default_process_bytes;
+}
+
+B_WUR B_EXPORT_FUNC size_t
+b_process_queue_running_count(
+    B_BORROW struct B_ProcessQueue const *queue) {
+  B_PRECONDITION(queue);
+
+  return queue->running_count;
+}
+
+B_WUR B_EXPORT_FUNC size_t
+b_process_queue_waiting_count(
+    B_BORROW struct B_ProcessQueue const *queue) {
+  B_PRECONDITION(queue);
+
+  return queue->waiting_count;
+}
+
+B_WUR B_EXPORT_FUNC int64_t
+b_process_queue_running_memory_bytes(
+    B_BORROW struct B_ProcessQueue const *queue) {
+  B_PRECONDITION(queue);
+
+  return queue->running_memory_bytes;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_exec_basic(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_BORROW_OPTIONAL char const *pool_name,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  return b_process_queue_exec(
+    queue,
+    pool_name,
+    B_PROCESS_QUEUE_UNKNOWN_MEMORY,
+    command_args,
+    callback,
+    cancel_callback,
+    callback_data,
+    callback_data_size,
+    e);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_exec(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_BORROW_OPTIONAL char const *pool_name,
+    int64_t memory_bytes,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  return b_process_queue_exec_with_priority(
+    queue,
+    pool_name,
+    memory_bytes,
+    0,
+    command_args,
+    callback,
+    cancel_callback,
+    callback_data,
+    callback_data_size,
+    e);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_exec_with_priority(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_BORROW_OPTIONAL char const *pool_name,
+    int64_t memory_bytes,
+    int priority,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  return b_process_queue_exec_with_start_callback(
+    queue,
+    pool_name,
+    memory_bytes,
+    priority,
+    command_args,
+    NULL,
+    callback,
+    cancel_callback,
+    callback_data,
+    callback_data_size,
+    e);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_process_queue_exec_with_start_callback(
+    B_BORROW struct B_ProcessQueue *queue,
+    B_BORROW_OPTIONAL char const *pool_name,
+    int64_t memory_bytes,
+    int priority,
+    B_BORROW char const *const *command_args,
+    B_OPTIONAL B_ProcessQueueStartFunction *start_callback,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(queue);
+  B_PRECONDITION(command_args);
+  B_PRECONDITION(command_args[0]);
+  B_PRECONDITION(
+    memory_bytes >= 0
+      || memory_bytes == B_PROCESS_QUEUE_UNKNOWN_MEMORY);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(e);
+
+  int pool_index = B_PROCESS_QUEUE_NO_POOL_;
+  if (pool_name) {
+    for (size_t i = 0; i < queue->pool_count; ++i) {
+      if (strcmp(queue->pools[i].name, pool_name) == 0) {
+        pool_index = (int) i;
+        break;
+      }
+    }
+  }
+
+  size_t request_size = offsetof(
+    struct B_ProcessQueueRequest_,
+    user_data.bytes[callback_data_size]);
+  struct B_ProcessQueueRequest_ *request;
+  if (!b_allocate(request_size, (void **) &request, e)) {
+    return false;
+  }
+  char **args;
+  if (!b_process_queue_copy_args_(command_args, &args, e)) {
+    b_deallocate(request);
+    return false;
+  }
+  request->next = NULL;
+  request->process_id = 0;
+  request->pool_index = pool_index;
+  request->memory_bytes
+    = memory_bytes == B_PROCESS_QUEUE_UNKNOWN_MEMORY
+    ? queue->default_memory_bytes
+    : memory_bytes;
+  request->priority = priority;
+  request->command_args = args;
+  request->start_callback = start_callback;
+  request->callback = callback;
+  request->cancel_callback = cancel_callback;
+  if (callback_data) {
+    memcpy(
+      request->user_data.bytes,
+      callback_data,
+      callback_data_size);
+  }
+
+  // A process blocked on memory goes first.  See
+  // NOTE[memory budget].
+  if (!queue->memory_blocked
+      && b_process_queue_can_start_(queue, request)) {
+    bool acquired;
+    if (!b_process_queue_acquire_token_(
+        queue, &acquired, e)) {
+      b_process_queue_deallocate_request_(request);
+      return false;
+    }
+    if (acquired) {
+      if (!b_process_queue_start_(queue, request, e)) {
+        struct B_Error release_error;
+        if (!b_process_queue_release_tokens_(
+            queue, &release_error)) {
+          // Report the start error instead.
+        }
+        b_process_queue_deallocate_request_(request);
+        return false;
+      }
+      return true;
+    }
+  }
+  if (!b_process_queue_fits_memory_(queue, request)) {
+    queue->memory_blocked = true;
+  }
+  struct B_ProcessQueueRequest_ **link
+    = &queue->waiting_head;
+  if (queue->waiting_tail
+      && queue->waiting_tail->priority >= priority) {
+    // Common case: append.
+    link = &queue->waiting_tail->next;
+  } else {
+    while (*link && (*link)->priority >= priority) {
+      link = &(*link)->next;
+    }
+  }
+  request->next = *link;
+  *link = request;
+  if (!request->next) {
+    queue->waiting_tail = request;
+  }
+  queue->waiting_count += 1;
+  return true;
+}
@@ -4,6 +4,49 @@
 #include <B/QuestionAnswer.h>
 #include <B/Serialize.h>
 
+// NOTE[question references]: Questions are immutable, so
+// B_Main does not need its own copy of a question.  If a
+// question type is reference counted (i.e. its vtable has
+// retain and release), B_Main, B_AnswerContext, and the
+// prefetch list share one instance of each question,
+// retaining it instead of replicating it.  Question types
+// which are not reference counted (e.g. file questions,
+// which are plain C strings) are replicated as before.
+
+B_WUR B_EXPORT_FUNC bool
+b_question_retain(
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *vtable,
+    B_OUT_TRANSFER struct B_IQuestion **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(question);
+  B_PRECONDITION(vtable);
+  B_PRECONDITION(!vtable->retain == !vtable->release);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  if (vtable->retain) {
+    *out = vtable->retain(question);
+    return true;
+  }
+  return vtable->replicate(question, out, e);
+}
+
+B_EXPORT_FUNC void
+b_question_release(
+    B_TRANSFER struct B_IQuestion *question,
+    B_BORROW struct B_QuestionVTable const *vtable) {
+  B_PRECONDITION(question);
+  B_PRECONDITION(vtable);
+  B_PRECONDITION(!vtable->retain == !vtable->release);
+
+  if (vtable->release) {
+    vtable->release(question);
+  } else {
+    vtable->deallocate(question);
+  }
+}
+
 B_WUR B_EXPORT_FUNC bool
 b_question_serialize_to_memory(
     B_BORROW struct B_IQuestion const *question,
@@ -0,0 +1,291 @@
+#include <B/Error.h>
+#include <B/Memory.h>
+#include <B/Private/Assertions.h>
+#include <B/Private/Memory.h>
+#include <B/Private/QuestionMap.h>
+#include <B/QuestionAnswer.h>
+
+#include <string.h>
+
+enum {
+  B_QUESTION_MAP_INITIAL_BUCKET_COUNT_ = 64,
+};
+
+struct B_QuestionMapEntry_ {
+  struct B_QuestionMapEntry_ *next;
+  struct B_QuestionKey key;
+  void *value;
+};
+
+struct B_QuestionMap {
+  // bucket_count is a power of two.
+  struct B_QuestionMapEntry_ **buckets;
+  size_t bucket_count;
+  size_t entry_count;
+};
+
+// FNV-1a.
+static uint64_t
+b_hash_bytes_(
+    uint64_t hash,
+    B_BORROW uint8_t const *data,
+    size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= data[i];
+    hash *= UINT64_C(1099511628211);
+  }
+  return hash;
+}
+
+static B_FUNC struct B_QuestionMapEntry_ **
+b_question_map_bucket_(
+    B_BORROW struct B_QuestionMap const *map,
+    uint64_t hash) {
+  return &map->buckets[
+    (size_t) hash & (map->bucket_count - 1)];
+}
+
+static B_WUR B_FUNC bool
+b_question_map_grow_(
+    B_BORROW struct B_QuestionMap *map,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(map);
+  B_OUT_PARAMETER(e);
+
+  size_t old_bucket_count = map->bucket_count;
+  struct B_QuestionMapEntry_ **old_buckets = map->buckets;
+  size_t bucket_count = old_bucket_count * 2;
+  struct B_QuestionMapEntry_ **buckets;
+  if (!b_allocate2(
+      sizeof(*buckets),
+      bucket_count,
+      (void **) &buckets,
+      e)) {
+    return false;
+  }
+  for (size_t i = 0; i < bucket_count; ++i) {
+    buckets[i] = NULL;
+  }
+  map->buckets = buckets;
+  map->bucket_count = bucket_count;
+  for (size_t i = 0; i < old_bucket_count; ++i) {
+    struct B_QuestionMapEntry_ *entry = old_buckets[i];
+    while (entry) {
+      struct B_QuestionMapEntry_ *next = entry->next;
+      struct B_QuestionMapEntry_ **bucket
+        = b_question_map_bucket_(map, entry->key.hash);
+      entry->next = *bucket;
+      *bucket = entry;
+      entry = next;
+    }
+  }
+  b_deallocate(old_buckets);
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_question_key_initialize(
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *vtable,
+    B_OUT_TRANSFER struct B_QuestionKey *out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(question);
+  B_PRECONDITION(vtable);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  uint8_t *data;
+  size_t data_size;
+  if (!b_question_serialize_to_memory(
+      question, vtable, &data, &data_size, e)) {
+    return false;
+  }
+  uint64_t hash = UINT64_C(14695981039346656037);
+  hash = b_hash_bytes_(
+    hash, vtable->uuid.data, sizeof(vtable->uuid.data));
+  hash = b_hash_bytes_(hash, data, data_size);
+  *out = (struct B_QuestionKey) {
+    .uuid = vtable->uuid,
+    .data = data,
+    .data_size = data_size,
+    .hash = hash,
+  };
+  return true;
+}
+
+B_EXPORT_FUNC void
+b_question_key_deinitialize(
+    B_TRANSFER struct B_QuestionKey *key) {
+  B_PRECONDITION(key);
+
+  if (key->data) {
+    b_deallocate(key->data);
+  }
+  key->data = NULL;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_question_key_equal(
+    B_BORROW struct B_QuestionKey const *a,
+    B_BORROW struct B_QuestionKey const *b) {
+  B_PRECONDITION(a);
+  B_PRECONDITION(b);
+
+  return a->hash == b->hash
+    && a->data_size == b->data_size
+    && b_uuid_equal(&a->uuid, &b->uuid)
+    && (a->data_size == 0
+      || memcmp(a->data, b->data, a->data_size) == 0);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_question_map_allocate(
+    B_OUT_TRANSFER struct B_QuestionMap **out,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_QuestionMap *map;
+  if (!b_allocate(sizeof(*map), (void **) &map, e)) {
+    return false;
+  }
+  size_t bucket_count
+    = B_QUESTION_MAP_INITIAL_BUCKET_COUNT_;
+  struct B_QuestionMapEntry_ **buckets;
+  if (!b_allocate2(
+      sizeof(*buckets),
+      bucket_count,
+      (void **) &buckets,
+      e)) {
+    b_deallocate(map);
+    return false;
+  }
+  for (size_t i = 0; i < bucket_count; ++i) {
+    buckets[i] = NULL;
+  }
+  *map = (struct B_QuestionMap) {
+    .buckets = buckets,
+    .bucket_count = bucket_count,
+    .entry_count = 0,
+  };
+  *out = map;
+  return true;
+}
+
+B_EXPORT_FUNC void
+b_question_map_deallocate(
+    B_TRANSFER struct B_QuestionMap *map) {
+  B_PRECONDITION(map);
+
+  for (size_t i = 0; i < map->bucket_count; ++i) {
+    struct B_QuestionMapEntry_ *entry = map->buckets[i];
+    while (entry) {
+      struct B_QuestionMapEntry_ *next = entry->next;
+      b_question_key_deinitialize(&entry->key);
+      b_deallocate(entry);
+      entry = next;
+    }
+  }
+  b_deallocate(map->buckets);
+  b_deallocate(map);
+}
+
+B_WUR B_EXPORT_FUNC size_t
+b_question_map_count(
+    B_BORROW struct B_QuestionMap const *map) {
+  B_PRECONDITION(map);
+
+  return map->entry_count;
+}
+
+B_EXPORT_FUNC void
+b_question_map_find(
+    B_BORROW struct B_QuestionMap const *map,
+    B_BORROW struct B_QuestionKey const *key,
+    B_OUT_BORROW void **out) {
+  B_PRECONDITION(map);
+  B_PRECONDITION(key);
+  B_OUT_PARAMETER(out);
+
+  for (struct B_QuestionMapEntry_ *entry
+      = *b_question_map_bucket_(map, key->hash);
+      entry;
+      entry = entry->next) {
+    if (b_question_key_equal(&entry->key, key)) {
+      *out = entry->value;
+      return;
+    }
+  }
+  *out = NULL;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_question_map_insert(
+    B_BORROW struct B_QuestionMap *map,
+    B_TRANSFER struct B_QuestionKey *key,
+    B_BORROW void *value,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(map);
+  B_PRECONDITION(key);
+  B_PRECONDITION(value);
+  B_OUT_PARAMETER(e);
+
+#if !defined(NDEBUG)
+  void *existing_value;
+  b_question_map_find(map, key, &existing_value);
+  B_PRECONDITION(!existing_value);
+#endif
+
+  // Keep the load factor at most 1.
+  if (map->entry_count >= map->bucket_count) {
+    if (!b_question_map_grow_(map, e)) {
+      return false;
+    }
+  }
+  struct B_QuestionMapEntry_ *entry;
+  if (!b_allocate(sizeof(*entry), (void **) &entry, e)) {
+    return false;
+  }
+  struct B_QuestionMapEntry_ **bucket
+    = b_question_map_bucket_(map, key->hash);
+  *entry = (struct B_QuestionMapEntry_) {
+    .next = *bucket,
+    .key = *key,
+    .value = value,
+  };
+  *bucket = entry;
+  map->entry_count += 1;
+  return true;
+}
+
+B_EXPORT_FUNC void
+b_question_map_remove(
+    B_BORROW struct B_QuestionMap *map,
+    B_BORROW struct B_QuestionKey const *key,
+    B_OUT_BORROW void **out,
+    B_OPTIONAL_OUT_TRANSFER struct B_QuestionKey *out_key) {
+  B_PRECONDITION(map);
+  B_PRECONDITION(key);
+  B_OUT_PARAMETER(out);
+
+  for (struct B_QuestionMapEntry_ **link
+      = b_question_map_bucket_(map, key->hash);
+      *link;
+      link = &(*link)->next) {
+    struct B_QuestionMapEntry_ *entry = *link;
+    if (b_question_key_equal(&entry->key, key)) {
+      *link = entry->next;
+      *out = entry->value;
+      if (out_key) {
+        *out_key = entry->key;
+      } else {
+        b_question_key_deinitialize(&entry->key);
+      }
+      b_deallocate(entry);
+      B_ASSERT(map->entry_count > 0);
+      map->entry_count -= 1;
+      return;
+    }
+  }
+  *out = NULL;
+}
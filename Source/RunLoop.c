@@ -44,6 +44,15 @@ b_run_loop_deallocate(
   run_loop->vtable.deallocate(run_loop);
 }
 
+B_EXPORT_FUNC void
+b_run_loop_set_tracer(
+    B_BORROW struct B_RunLoop *run_loop,
+    B_BORROW_OPTIONAL struct B_Tracer *tracer) {
+  B_PRECONDITION(run_loop);
+
+  run_loop->tracer = tracer;
+}
+
 B_WUR B_EXPORT_FUNC bool
 b_run_loop_add_function(
     B_BORROW struct B_RunLoop *run_loop,
@@ -96,6 +105,34 @@ b_run_loop_add_process_id(
   return true;
 }
 
+B_WUR B_EXPORT_FUNC bool
+b_run_loop_add_timer(
+    B_BORROW struct B_RunLoop *run_loop,
+    int64_t delay_ms,
+    B_RunLoopFunction *callback,
+    B_RunLoopFunction *cancel,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(delay_ms >= 0);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel);
+  B_OUT_PARAMETER(e);
+
+  if (!run_loop->vtable.add_timer(
+      run_loop,
+      delay_ms,
+      callback,
+      cancel,
+      callback_data,
+      callback_data_size,
+      e)) {
+    return false;
+  }
+  return true;
+}
+
 B_WUR B_EXPORT_FUNC bool
 b_run_loop_run(
     B_BORROW struct B_RunLoop *run_loop,
@@ -132,31 +169,62 @@ b_environ_(
 #endif
 
 B_WUR B_EXPORT_FUNC bool
-b_run_loop_exec_basic(
+b_run_loop_exec(
     B_BORROW struct B_RunLoop *run_loop,
     B_BORROW char const *const *command_args,
     B_RunLoopProcessFunction *callback,
     B_RunLoopFunction *cancel_callback,
     B_BORROW void const *callback_data,
     size_t callback_data_size,
+    B_OUT B_ProcessID *out_process_id,
     B_OUT struct B_Error *e) {
   B_PRECONDITION(run_loop);
   B_PRECONDITION(command_args);
   B_PRECONDITION(command_args[0]);
   B_PRECONDITION(callback);
   B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(out_process_id);
   B_OUT_PARAMETER(e);
 
+  if (run_loop->vtable.exec) {
+    return run_loop->vtable.exec(
+      run_loop,
+      command_args,
+      callback,
+      cancel_callback,
+      callback_data,
+      callback_data_size,
+      out_process_id,
+      e);
+  }
+
 #if B_CONFIG_POSIX_SPAWN
+  // Start the process in its own process group, so
+  // b_process_terminate can signal the processes it starts
+  // too.  See NOTE[process groups].
+  posix_spawnattr_t attr;
+  int rc = posix_spawnattr_init(&attr);
+  if (rc != 0) {
+    *e = (struct B_Error) {.posix_error = rc};
+    return false;
+  }
+  rc = posix_spawnattr_setflags(
+    &attr, POSIX_SPAWN_SETPGROUP);
+  if (rc == 0) {
+    rc = posix_spawnattr_setpgroup(&attr, 0);
+  }
   pid_t pid;
-  int rc = posix_spawnp(
-    &pid,
-    command_args[0],
-    NULL,
-    NULL,
-    // FIXME(strager): This cast looks like a bug.
-    (char *const *) command_args,
-    b_environ_());
+  if (rc == 0) {
+    rc = posix_spawnp(
+      &pid,
+      command_args[0],
+      NULL,
+      &attr,
+      // FIXME(strager): This cast looks like a bug.
+      (char *const *) command_args,
+      b_environ_());
+  }
+  (void) posix_spawnattr_destroy(&attr);
   if (rc != 0) {
     *e = (struct B_Error) {.posix_error = rc};
     return false;
@@ -172,8 +240,30 @@ b_run_loop_exec_basic(
     // Should we kill the child or something?
     return false;
   }
+  *out_process_id = pid;
   return true;
 #else
 # error "Unknown process start implementation"
 #endif
 }
+
+B_WUR B_EXPORT_FUNC bool
+b_run_loop_exec_basic(
+    B_BORROW struct B_RunLoop *run_loop,
+    B_BORROW char const *const *command_args,
+    B_RunLoopProcessFunction *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  B_ProcessID process_id;
+  return b_run_loop_exec(
+    run_loop,
+    command_args,
+    callback,
+    cancel_callback,
+    callback_data,
+    callback_data_size,
+    &process_id,
+    e);
+}
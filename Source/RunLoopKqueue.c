@@ -11,6 +11,7 @@
 # include <B/Private/RunLoopUtil.h>
 # include <B/Process.h>
 # include <B/RunLoop.h>
+# include <B/Tracer.h>
 
 # include <errno.h>
 # include <limits.h>
@@ -18,6 +19,7 @@
 # include <string.h>
 # include <sys/event.h>
 # include <sys/wait.h>
+# include <time.h>
 # include <unistd.h>
 
 enum {
@@ -37,6 +39,7 @@ struct B_RunLoopKqueue_ {
   int fd;
   bool stop;
   B_RunLoopFunctionList functions;
+  B_RunLoopTimerList timers;
 };
 
 B_STATIC_ASSERT(
@@ -52,6 +55,7 @@ b_run_loop_deallocate_(
     = (struct B_RunLoopKqueue_ *) run_loop;
   b_run_loop_function_list_deinitialize(
     run_loop, &rl->functions);
+  b_run_loop_timer_list_deinitialize(&rl->timers);
   (void) close(rl->fd);
   b_deallocate(rl);
 }
@@ -112,6 +116,34 @@ b_run_loop_add_function_(
   return true;
 }
 
+static B_WUR B_FUNC bool
+b_run_loop_add_timer_(
+    B_BORROW struct B_RunLoop *run_loop,
+    int64_t delay_ms,
+    B_TRANSFER B_RunLoopFunction *callback,
+    B_TRANSFER B_RunLoopFunction *cancel_callback,
+    B_TRANSFER void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(e);
+
+  struct B_RunLoopKqueue_ *rl
+    = (struct B_RunLoopKqueue_ *) run_loop;
+  // Timers are added on the run loop's thread, so the next
+  // kevent sees the new deadline without a notify.
+  return b_run_loop_timer_list_add_timer(
+    &rl->timers,
+    b_run_loop_deadline_us(b_run_loop_now_us(), delay_ms),
+    callback,
+    cancel_callback,
+    callback_data,
+    callback_data_size,
+    e);
+}
+
 struct B_RunLoopKqueueProcessFallbackClosure_ {
   struct B_ProcessExitStatus exit_status;
   B_RunLoopProcessFunction *callback;
@@ -272,16 +304,21 @@ retry:;
   }
 }
 
-static B_FUNC void
+static B_WUR B_FUNC bool
 b_run_loop_drain_functions_(
-    B_BORROW struct B_RunLoopKqueue_ *rl) {
+    B_BORROW struct B_RunLoopKqueue_ *rl,
+    B_OUT struct B_Error *e) {
   B_PRECONDITION(rl);
+  B_OUT_PARAMETER(e);
 
   bool keep_going = true;
   while (keep_going && !rl->stop) {
-    b_run_loop_function_list_run_one(
-      &rl->super, &rl->functions, &keep_going);
+    if (!b_run_loop_function_list_run_one(
+        &rl->super, &rl->functions, &keep_going, e)) {
+      return false;
+    }
   }
+  return true;
 }
 
 static B_WUR B_FUNC bool
@@ -295,13 +332,23 @@ b_run_loop_run_(
     = (struct B_RunLoopKqueue_ *) run_loop;
   while (!rl->stop) {
     struct kevent events[10];
+    // See NOTE[tracing].
+    int64_t idle_start_us
+      = rl->super.tracer ? b_tracer_now_us() : 0;
+    int timeout_ms = b_run_loop_timer_list_timeout_ms(
+      &rl->timers, b_run_loop_now_us());
+    struct timespec timeout = {
+      .tv_sec = timeout_ms / 1000,
+      .tv_nsec = (long) (timeout_ms % 1000) * 1000 * 1000,
+    };
     int event_count = kevent(
       rl->fd,
       NULL,
       0,
       events,
       sizeof(events) / sizeof(*events),
-      NULL);
+      timeout_ms == -1 ? NULL : &timeout);
+    b_run_loop_trace_idle(run_loop, idle_start_us);
     if (event_count == -1) {
       *e = (struct B_Error) {.posix_error = errno};
       return false;
@@ -337,8 +384,18 @@ b_run_loop_run_(
       }
     }
 
-    b_run_loop_drain_functions_(rl);
+    if (!b_run_loop_drain_functions_(rl, e)) {
+      return false;
+    }
+    if (!rl->stop) {
+      if (!b_run_loop_timer_list_run_due(
+          &rl->timers, b_run_loop_now_us(), e)) {
+        return false;
+      }
+    }
   }
+  // Allow the run loop to be run again.
+  rl->stop = false;
   return true;
 }
 
@@ -397,13 +454,21 @@ b_run_loop_allocate_kqueue(
         .add_process_id = b_run_loop_add_process_id_,
         .run = b_run_loop_run_,
         .stop = b_run_loop_stop_,
+        .exec = NULL,
+        .add_timer = b_run_loop_add_timer_,
       },
+      .tracer = NULL,
     },
     .fd = fd,
     .stop = false,
     // .functions
+    // .timers
   };
-  b_run_loop_function_list_initialize(&rl->functions);
+  if (!b_run_loop_function_list_initialize(
+      &rl->functions, e)) {
+    goto fail;
+  }
+  b_run_loop_timer_list_initialize(&rl->timers);
   *out = &rl->super;
   return true;
 
@@ -1,3 +1,7 @@
+// For wait4.
+#define _BSD_SOURCE
+#define _DEFAULT_SOURCE
+
 #include <B/Private/Config.h>
 
 #if B_CONFIG_POSIX_SIGNALS && B_CONFIG_POSIX_PROCESS
@@ -11,6 +15,7 @@
 # include <B/Private/RunLoopUtil.h>
 # include <B/Process.h>
 # include <B/RunLoop.h>
+# include <B/Tracer.h>
 
 # if B_CONFIG_EVENTFD
 #  define B_USE_EVENTFD_ 1
@@ -28,6 +33,10 @@
 # include <sys/wait.h>
 # include <unistd.h>
 
+# if B_CONFIG_WAIT4
+#  include <sys/resource.h>
+# endif
+
 # if B_USE_EVENTFD_
 #  include <sys/eventfd.h>
 # endif
@@ -45,7 +54,7 @@ struct B_RunLoopSigchldProcessEntry_ {
 
     // Set when this entry is removed from the RunLoop's
     // processes list.
-    int waitpid_status;
+    struct B_ProcessExitStatus exit_status;
   } u;
   B_RunLoopProcessFunction *callback;
   B_RunLoopFunction *cancel_callback;
@@ -63,6 +72,7 @@ struct B_RunLoopSigchld_ {
 # endif
   bool stop;
   B_RunLoopFunctionList functions;
+  B_RunLoopTimerList timers;
   B_SLIST_HEAD(, B_RunLoopSigchldProcessEntry_) processes;
 };
 
@@ -153,6 +163,7 @@ b_run_loop_deallocate_(
     = (struct B_RunLoopSigchld_ *) run_loop;
   b_run_loop_function_list_deinitialize(
     run_loop, &rl->functions);
+  b_run_loop_timer_list_deinitialize(&rl->timers);
 # if B_USE_EVENTFD_
   (void) close(rl->functions_eventfd);
 # endif
@@ -228,6 +239,34 @@ b_run_loop_add_function_(
   return true;
 }
 
+static B_WUR B_FUNC bool
+b_run_loop_add_timer_(
+    B_BORROW struct B_RunLoop *run_loop,
+    int64_t delay_ms,
+    B_TRANSFER B_RunLoopFunction *callback,
+    B_TRANSFER B_RunLoopFunction *cancel_callback,
+    B_TRANSFER void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(e);
+
+  struct B_RunLoopSigchld_ *rl
+    = (struct B_RunLoopSigchld_ *) run_loop;
+  // Timers are added on the run loop's thread, so the next
+  // poll sees the new deadline without a notify.
+  return b_run_loop_timer_list_add_timer(
+    &rl->timers,
+    b_run_loop_deadline_us(b_run_loop_now_us(), delay_ms),
+    callback,
+    cancel_callback,
+    callback_data,
+    callback_data_size,
+    e);
+}
+
 static B_WUR B_FUNC bool
 b_run_loop_add_process_id_(
     B_BORROW struct B_RunLoop *run_loop,
@@ -270,30 +309,40 @@ b_run_loop_add_process_id_(
   return true;
 }
 
-static B_FUNC void
+static B_WUR B_FUNC bool
 b_run_loop_drain_functions_(
-    B_BORROW struct B_RunLoopSigchld_ *rl) {
+    B_BORROW struct B_RunLoopSigchld_ *rl,
+    B_OUT struct B_Error *e) {
   B_PRECONDITION(rl);
+  B_OUT_PARAMETER(e);
 
   bool keep_going = true;
   while (keep_going && !rl->stop) {
-    b_run_loop_function_list_run_one(
-      &rl->super, &rl->functions, &keep_going);
+    if (!b_run_loop_function_list_run_one(
+        &rl->super, &rl->functions, &keep_going, e)) {
+      return false;
+    }
   }
+  return true;
 }
 
 static B_FUNC bool
 b_run_loop_check_process_(
     pid_t pid,
     B_OUT bool *exited,
-    B_OUT int *waitpid_status,
+    B_OUT struct B_ProcessExitStatus *exit_status,
     B_OUT struct B_Error *e) {
   B_OUT_PARAMETER(exited);
-  B_OUT_PARAMETER(waitpid_status);
+  B_OUT_PARAMETER(exit_status);
   B_OUT_PARAMETER(e);
 
   int status;
+# if B_CONFIG_WAIT4
+  struct rusage rusage;
+  pid_t rc = wait4(pid, &status, WNOHANG, &rusage);
+# else
   pid_t rc = waitpid(pid, &status, WNOHANG);
+# endif
   if (rc == -1) {
     // FIXME(strager): Can we get EINTR here?
     B_ASSERT(errno != EINTR);
@@ -305,7 +354,12 @@ b_run_loop_check_process_(
   } else {
     B_ASSERT(rc == pid);
     *exited = true;
-    *waitpid_status = status;
+    *exit_status
+      = b_exit_status_from_waitpid_status(status);
+# if B_CONFIG_WAIT4
+    exit_status->usage
+      = b_process_resource_usage_from_rusage(&rusage);
+# endif
     return true;
   }
 }
@@ -325,12 +379,12 @@ b_run_loop_check_processes_(
   struct B_RunLoopSigchldProcessEntry_ *prev = NULL;
   B_SLIST_FOREACH_SAFE(
       entry, &rl->processes, link, temp_entry) {
-    int waitpid_status;
+    struct B_ProcessExitStatus exit_status;
     bool exited;
     if (!b_run_loop_check_process_(
         entry->u.pid,
         &exited,
-        &waitpid_status,
+        &exit_status,
         &(struct B_Error) {.posix_error = 0})) {
       B_NYI();
     }
@@ -341,7 +395,7 @@ b_run_loop_check_processes_(
         B_SLIST_REMOVE_HEAD(&rl->processes, link);
       }
       B_SLIST_INSERT_HEAD(&exited_processes, entry, link);
-      entry->u.waitpid_status = waitpid_status;
+      entry->u.exit_status = exit_status;
     } else {
       prev = entry;
     }
@@ -349,11 +403,8 @@ b_run_loop_check_processes_(
 
   B_SLIST_FOREACH_SAFE(
       entry, &exited_processes, link, temp_entry) {
-    struct B_ProcessExitStatus exit_status
-      = b_exit_status_from_waitpid_status(
-        entry->u.waitpid_status);
     if (!entry->callback(
-        &exit_status,
+        &entry->u.exit_status,
         entry->user_data.bytes,
         &(struct B_Error) {.posix_error = 0})) {
       B_NYI();
@@ -395,7 +446,13 @@ b_run_loop_run_(
     };
     nfds_t pollfd_count
       = sizeof(pollfds) / sizeof(*pollfds);
-    int events = poll(pollfds, pollfd_count, -1);
+    // See NOTE[tracing].
+    int64_t idle_start_us
+      = rl->super.tracer ? b_tracer_now_us() : 0;
+    int timeout_ms = b_run_loop_timer_list_timeout_ms(
+      &rl->timers, b_run_loop_now_us());
+    int events = poll(pollfds, pollfd_count, timeout_ms);
+    b_run_loop_trace_idle(run_loop, idle_start_us);
     bool check_functions = false;
     bool check_processes = false;
     if (events == -1) {
@@ -420,12 +477,22 @@ b_run_loop_run_(
       }
     }
     if (check_functions) {
-      b_run_loop_drain_functions_(rl);
+      if (!b_run_loop_drain_functions_(rl, e)) {
+        return false;
+      }
     }
     if (check_processes) {
       b_run_loop_check_processes_(rl);
     }
+    if (!rl->stop) {
+      if (!b_run_loop_timer_list_run_due(
+          &rl->timers, b_run_loop_now_us(), e)) {
+        return false;
+      }
+    }
   }
+  // Allow the run loop to be run again.
+  rl->stop = false;
   return true;
 }
 
@@ -602,7 +669,10 @@ b_run_loop_allocate_sigchld_no_install(
         .add_process_id = b_run_loop_add_process_id_,
         .run = b_run_loop_run_,
         .stop = b_run_loop_stop_,
+        .exec = NULL,
+        .add_timer = b_run_loop_add_timer_,
       },
+      .tracer = NULL,
     },
 # if B_USE_EVENTFD_
     .functions_eventfd = functions_eventfd,
@@ -613,9 +683,14 @@ b_run_loop_allocate_sigchld_no_install(
 # endif
     .stop = false,
     // .functions
+    // .timers
     .processes = B_SLIST_HEAD_INITIALIZER(&rl->processes),
   };
-  b_run_loop_function_list_initialize(&rl->functions);
+  if (!b_run_loop_function_list_initialize(
+      &rl->functions, e)) {
+    goto fail;
+  }
+  b_run_loop_timer_list_initialize(&rl->timers);
   *out = &rl->super;
   return true;
 
@@ -0,0 +1,405 @@
+#include <B/Error.h>
+#include <B/Memory.h>
+#include <B/Private/Assertions.h>
+#include <B/Private/Callback.h>
+#include <B/Private/Log.h>
+#include <B/Private/Memory.h>
+#include <B/Private/Queue.h>
+#include <B/Private/RunLoopUtil.h>
+#include <B/Process.h>
+#include <B/RunLoop.h>
+#include <B/Simulator.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+enum {
+  // Simulated process IDs start above any real process ID
+  // (e.g. Linux's PID_MAX_LIMIT), so signalling one by
+  // mistake cannot hit a real process.
+  B_RUN_LOOP_SIMULATED_FIRST_PROCESS_ID_ = 1 << 30,
+};
+
+struct B_RunLoopSimulatedProcessEntry_ {
+  B_SLIST_ENTRY(B_RunLoopSimulatedProcessEntry_) link;
+  // Virtual time.
+  int64_t started_at_us;
+  int64_t exits_at_us;
+  struct B_ProcessExitStatus exit_status;
+  B_RunLoopProcessFunction *callback;
+  B_RunLoopFunction *cancel_callback;
+  union B_UserData user_data;
+};
+
+struct B_RunLoopSimulated_ {
+  struct B_RunLoop super;
+  B_SimulatedProcessFunction *process_function;
+  void *process_function_opaque;
+  bool stop;
+  B_RunLoopFunctionList functions;
+  // Deadlines are in virtual time.
+  B_RunLoopTimerList timers;
+  // Sorted by exits_at_us.  Processes exiting at the same
+  // time are in the order they were started.
+  B_SLIST_HEAD(, B_RunLoopSimulatedProcessEntry_)
+    processes;
+  int64_t now_us;
+  B_ProcessID next_process_id;
+  size_t running_count;
+  size_t peak_running_count;
+  size_t exited_count;
+  int64_t busy_us;
+};
+
+B_STATIC_ASSERT(
+  offsetof(struct B_RunLoopSimulated_, super) == 0,
+  "super must be the first member of B_RunLoopSimulated_");
+
+static B_WUR B_FUNC void
+b_run_loop_deallocate_(
+    B_TRANSFER struct B_RunLoop *run_loop) {
+  B_PRECONDITION(run_loop);
+
+  struct B_RunLoopSimulated_ *rl
+    = (struct B_RunLoopSimulated_ *) run_loop;
+  b_run_loop_function_list_deinitialize(
+    run_loop, &rl->functions);
+  b_run_loop_timer_list_deinitialize(&rl->timers);
+  struct B_RunLoopSimulatedProcessEntry_ *entry;
+  struct B_RunLoopSimulatedProcessEntry_ *temp_entry;
+  B_SLIST_FOREACH_SAFE(
+      entry, &rl->processes, link, temp_entry) {
+    if (!entry->cancel_callback(
+        entry->user_data.bytes,
+        &(struct B_Error) {.posix_error = 0})) {
+      // Ignore, like b_run_loop_function_list_deinitialize.
+    }
+    b_deallocate(entry);
+  }
+  b_deallocate(rl);
+}
+
+static B_WUR B_FUNC bool
+b_run_loop_add_function_(
+    B_BORROW struct B_RunLoop *run_loop,
+    B_TRANSFER B_RunLoopFunction *callback,
+    B_TRANSFER B_RunLoopFunction *cancel_callback,
+    B_TRANSFER void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(e);
+
+  struct B_RunLoopSimulated_ *rl
+    = (struct B_RunLoopSimulated_ *) run_loop;
+  return b_run_loop_function_list_add_function(
+    &rl->functions,
+    callback,
+    cancel_callback,
+    callback_data,
+    callback_data_size,
+    e);
+}
+
+static B_WUR B_FUNC bool
+b_run_loop_add_timer_(
+    B_BORROW struct B_RunLoop *run_loop,
+    int64_t delay_ms,
+    B_TRANSFER B_RunLoopFunction *callback,
+    B_TRANSFER B_RunLoopFunction *cancel_callback,
+    B_TRANSFER void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(e);
+
+  struct B_RunLoopSimulated_ *rl
+    = (struct B_RunLoopSimulated_ *) run_loop;
+  return b_run_loop_timer_list_add_timer(
+    &rl->timers,
+    b_run_loop_deadline_us(rl->now_us, delay_ms),
+    callback,
+    cancel_callback,
+    callback_data,
+    callback_data_size,
+    e);
+}
+
+static B_WUR B_FUNC bool
+b_run_loop_add_process_id_(
+    B_BORROW struct B_RunLoop *run_loop,
+    B_ProcessID pid,
+    B_TRANSFER B_RunLoopProcessFunction *callback,
+    B_TRANSFER B_RunLoopFunction *cancel_callback,
+    B_TRANSFER void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(e);
+
+  (void) pid;
+  (void) callback_data;
+  (void) callback_data_size;
+  // Real processes do not run in virtual time.
+  *e = (struct B_Error) {.posix_error = ENOTSUP};
+  return false;
+}
+
+static B_WUR B_FUNC bool
+b_run_loop_exec_(
+    B_BORROW struct B_RunLoop *run_loop,
+    B_BORROW char const *const *command_args,
+    B_TRANSFER B_RunLoopProcessFunction *callback,
+    B_TRANSFER B_RunLoopFunction *cancel_callback,
+    B_TRANSFER void const *callback_data,
+    size_t callback_data_size,
+    B_OUT B_ProcessID *out_process_id,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(command_args);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(out_process_id);
+  B_OUT_PARAMETER(e);
+
+  struct B_RunLoopSimulated_ *rl
+    = (struct B_RunLoopSimulated_ *) run_loop;
+  int64_t duration_us;
+  struct B_ProcessExitStatus exit_status;
+  if (!rl->process_function(
+      rl->process_function_opaque,
+      command_args,
+      &duration_us,
+      &exit_status,
+      e)) {
+    return false;
+  }
+  if (duration_us < 0) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    return false;
+  }
+  size_t header_size = offsetof(
+    struct B_RunLoopSimulatedProcessEntry_,
+    user_data.bytes);
+  if (callback_data_size > SIZE_MAX - header_size) {
+    *e = (struct B_Error) {.posix_error = ENOMEM};
+    return false;
+  }
+  size_t entry_size = header_size + callback_data_size;
+  struct B_RunLoopSimulatedProcessEntry_ *entry;
+  if (!b_allocate(entry_size, (void **) &entry, e)) {
+    return false;
+  }
+  entry->started_at_us = rl->now_us;
+  entry->exits_at_us = rl->now_us + duration_us;
+  entry->exit_status = exit_status;
+  entry->callback = callback;
+  entry->cancel_callback = cancel_callback;
+  if (callback_data) {
+    memcpy(
+      entry->user_data.bytes,
+      callback_data,
+      callback_data_size);
+  }
+  struct B_RunLoopSimulatedProcessEntry_ *prev = NULL;
+  struct B_RunLoopSimulatedProcessEntry_ *other;
+  B_SLIST_FOREACH(other, &rl->processes, link) {
+    if (other->exits_at_us > entry->exits_at_us) {
+      break;
+    }
+    prev = other;
+  }
+  if (prev) {
+    B_SLIST_INSERT_AFTER(prev, entry, link);
+  } else {
+    B_SLIST_INSERT_HEAD(&rl->processes, entry, link);
+  }
+  rl->running_count += 1;
+  if (rl->running_count > rl->peak_running_count) {
+    rl->peak_running_count = rl->running_count;
+  }
+  *out_process_id = rl->next_process_id;
+  rl->next_process_id += 1;
+  return true;
+}
+
+// Advances virtual time to the next process's exit and
+// calls its callback.
+static B_WUR B_FUNC bool
+b_run_loop_exit_next_process_(
+    B_BORROW struct B_RunLoopSimulated_ *rl,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(rl);
+  B_PRECONDITION(!B_SLIST_EMPTY(&rl->processes));
+  B_OUT_PARAMETER(e);
+
+  struct B_RunLoopSimulatedProcessEntry_ *entry
+    = B_SLIST_FIRST(&rl->processes);
+  B_SLIST_REMOVE_HEAD(&rl->processes, link);
+  B_ASSERT(entry->exits_at_us >= rl->now_us);
+  rl->now_us = entry->exits_at_us;
+  B_ASSERT(rl->running_count > 0);
+  rl->running_count -= 1;
+  rl->exited_count += 1;
+  rl->busy_us += entry->exits_at_us - entry->started_at_us;
+  bool ok = entry->callback(
+    &entry->exit_status, entry->user_data.bytes, e);
+  b_deallocate(entry);
+  return ok;
+}
+
+static B_WUR B_FUNC bool
+b_run_loop_run_(
+    B_BORROW struct B_RunLoop *run_loop,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_OUT_PARAMETER(e);
+
+  struct B_RunLoopSimulated_ *rl
+    = (struct B_RunLoopSimulated_ *) run_loop;
+  while (!rl->stop) {
+    bool ran_function;
+    if (!b_run_loop_function_list_run_one(
+        run_loop, &rl->functions, &ran_function, e)) {
+      return false;
+    }
+    if (ran_function) {
+      continue;
+    }
+    // Advance virtual time to whichever comes first: the
+    // next timer or the next process's exit.
+    int64_t deadline_us;
+    bool have_timer = b_run_loop_timer_list_next_deadline(
+      &rl->timers, &deadline_us);
+    struct B_RunLoopSimulatedProcessEntry_ const *process
+      = B_SLIST_FIRST(&rl->processes);
+    if (have_timer
+        && (!process
+          || deadline_us <= process->exits_at_us)) {
+      if (deadline_us > rl->now_us) {
+        rl->now_us = deadline_us;
+      }
+      if (!b_run_loop_timer_list_run_due(
+          &rl->timers, rl->now_us, e)) {
+        return false;
+      }
+      continue;
+    }
+    if (!process) {
+      // Nothing could ever stop the run loop.
+      *e = (struct B_Error) {.posix_error = EDEADLK};
+      return false;
+    }
+    if (!b_run_loop_exit_next_process_(rl, e)) {
+      return false;
+    }
+  }
+  // Allow the run loop to be run again.
+  rl->stop = false;
+  return true;
+}
+
+static B_WUR B_FUNC bool
+b_run_loop_stop_(
+    B_BORROW struct B_RunLoop *run_loop,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_OUT_PARAMETER(e);
+
+  struct B_RunLoopSimulated_ *rl
+    = (struct B_RunLoopSimulated_ *) run_loop;
+  rl->stop = true;
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_run_loop_allocate_simulated(
+    B_BORROW B_SimulatedProcessFunction *process_function,
+    B_BORROW void *process_function_opaque,
+    B_OUT_TRANSFER struct B_RunLoop **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(process_function);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_RunLoopSimulated_ *rl;
+  if (!b_allocate(sizeof(*rl), (void **) &rl, e)) {
+    return false;
+  }
+  *rl = (struct B_RunLoopSimulated_) {
+    .super = {
+      .vtable = {
+        .deallocate = b_run_loop_deallocate_,
+        .add_function = b_run_loop_add_function_,
+        .add_process_id = b_run_loop_add_process_id_,
+        .run = b_run_loop_run_,
+        .stop = b_run_loop_stop_,
+        .exec = b_run_loop_exec_,
+        .add_timer = b_run_loop_add_timer_,
+      },
+      .tracer = NULL,
+    },
+    .process_function = process_function,
+    .process_function_opaque = process_function_opaque,
+    .stop = false,
+    // .functions
+    // .timers
+    .processes = B_SLIST_HEAD_INITIALIZER(&rl->processes),
+    .now_us = 0,
+    .next_process_id
+      = B_RUN_LOOP_SIMULATED_FIRST_PROCESS_ID_,
+    .running_count = 0,
+    .peak_running_count = 0,
+    .exited_count = 0,
+    .busy_us = 0,
+  };
+  if (!b_run_loop_function_list_initialize(
+      &rl->functions, e)) {
+    b_deallocate(rl);
+    return false;
+  }
+  b_run_loop_timer_list_initialize(&rl->timers);
+  *out = &rl->super;
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC int64_t
+b_run_loop_simulated_now_us(
+    B_BORROW struct B_RunLoop *run_loop) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(run_loop->vtable.exec == b_run_loop_exec_);
+
+  return ((struct B_RunLoopSimulated_ *) run_loop)->now_us;
+}
+
+B_EXPORT_FUNC void
+b_run_loop_simulated_report(
+    B_BORROW struct B_RunLoop *run_loop,
+    size_t core_count,
+    B_OUT struct B_SimulationReport *out) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(run_loop->vtable.exec == b_run_loop_exec_);
+  B_OUT_PARAMETER(out);
+
+  struct B_RunLoopSimulated_ const *rl
+    = (struct B_RunLoopSimulated_ const *) run_loop;
+  // Virtual time advances when a process exits or a timer
+  // fires.
+  int64_t core_us = (int64_t) core_count * rl->now_us;
+  *out = (struct B_SimulationReport) {
+    .makespan_us = rl->now_us,
+    .process_count = rl->exited_count,
+    .peak_running_count = rl->peak_running_count,
+    .busy_us = rl->busy_us,
+    .idle_core_us = core_us > rl->busy_us
+      ? core_us - rl->busy_us
+      : 0,
+  };
+}
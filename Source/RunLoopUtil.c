@@ -4,15 +4,31 @@
 #include <B/Private/Callback.h>
 #include <B/Private/Log.h>
 #include <B/Private/Memory.h>
+#include <B/Private/Mutex.h>
 #include <B/Private/RunLoopUtil.h>
+#include <B/Tracer.h>
 
+#include <errno.h>
+#include <limits.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #if B_CONFIG_POSIX_PROCESS
 # include <sys/wait.h>
 #endif
 
+#if B_CONFIG_WAIT4
+# include <sys/resource.h>
+#endif
+
+enum {
+  // Shorter waits are not recorded, so a busy run loop
+  // does not flood the trace.  See NOTE[tracing].
+  B_RUN_LOOP_IDLE_TRACE_US_ = 50,
+};
+
 struct B_RunLoopFunctionEntry {
   B_SLIST_ENTRY(B_RunLoopFunctionEntry) link;
   B_RunLoopFunction *callback;
@@ -20,12 +36,26 @@ struct B_RunLoopFunctionEntry {
   union B_UserData user_data;
 };
 
-B_FUNC void
+struct B_RunLoopTimerEntry {
+  B_SLIST_ENTRY(B_RunLoopTimerEntry) link;
+  int64_t deadline_us;
+  B_RunLoopFunction *callback;
+  B_RunLoopFunction *cancel_callback;
+  union B_UserData user_data;
+};
+
+B_WUR B_FUNC bool
 b_run_loop_function_list_initialize(
-    B_BORROW B_RunLoopFunctionList *functions) {
-  B_PRECONDITION(functions);
+    B_OUT_TRANSFER B_RunLoopFunctionList *functions,
+    B_OUT struct B_Error *e) {
+  B_OUT_PARAMETER(functions);
+  B_OUT_PARAMETER(e);
 
-  B_SLIST_INIT(functions);
+  if (!b_mutex_initialize(&functions->lock, e)) {
+    return false;
+  }
+  B_SLIST_INIT(&functions->entries);
+  return true;
 }
 
 B_FUNC void
@@ -38,17 +68,24 @@ b_run_loop_function_list_deinitialize(
   struct B_RunLoopFunctionEntry *entry;
   struct B_RunLoopFunctionEntry *temp_entry;
   B_SLIST_FOREACH_SAFE(
-      entry, functions, link, temp_entry) {
+      entry, &functions->entries, link, temp_entry) {
     if (!entry->cancel_callback(
         entry->user_data.bytes,
         &(struct B_Error) {.posix_error = 0})) {
-      B_NYI();
+      // b_run_loop_deallocate cannot report errors.
+      // Cancel the remaining functions anyway.
     }
     b_deallocate(entry);
     // FIXME(strager): Should we keep iterating until the
     // list is empty? What if the list is mutated while we
     // iterate?
   }
+  if (!b_mutex_destroy(
+      &functions->lock,
+      &(struct B_Error) {.posix_error = 0})) {
+    // Ignore.  The lock is not held, so at worst the
+    // mutex's resources leak.
+  }
   b_scribble(functions, sizeof(*functions));
 }
 
@@ -81,33 +118,219 @@ b_run_loop_function_list_add_function(
       callback_data,
       callback_data_size);
   }
-  B_SLIST_INSERT_HEAD(functions, entry, link);
+  b_mutex_lock(&functions->lock);
+  B_SLIST_INSERT_HEAD(&functions->entries, entry, link);
+  b_mutex_unlock(&functions->lock);
   return true;
 }
 
-B_FUNC void
+B_WUR B_FUNC bool
 b_run_loop_function_list_run_one(
     B_BORROW struct B_RunLoop *run_loop,
     B_BORROW B_RunLoopFunctionList *functions,
-    B_OUT bool *keep_going) {
+    B_OUT bool *keep_going,
+    B_OUT struct B_Error *e) {
   B_PRECONDITION(run_loop);
   B_PRECONDITION(functions);
   B_OUT_PARAMETER(keep_going);
+  B_OUT_PARAMETER(e);
 
+  b_mutex_lock(&functions->lock);
   struct B_RunLoopFunctionEntry *entry
-    = B_SLIST_FIRST(functions);
+    = B_SLIST_FIRST(&functions->entries);
+  if (entry) {
+    B_SLIST_REMOVE_HEAD(&functions->entries, link);
+  }
+  b_mutex_unlock(&functions->lock);
   if (!entry) {
     *keep_going = false;
-    return;
-  }
-  B_SLIST_REMOVE_HEAD(functions, link);
-  if (!entry->callback(
-      entry->user_data.bytes,
-      &(struct B_Error) {.posix_error = 0})) {
-    B_NYI();
+    return true;
   }
+  bool ok = entry->callback(entry->user_data.bytes, e);
   b_deallocate(entry);
   *keep_going = true;
+  return ok;
+}
+
+B_FUNC void
+b_run_loop_timer_list_initialize(
+    B_OUT_TRANSFER B_RunLoopTimerList *timers) {
+  B_OUT_PARAMETER(timers);
+
+  B_SLIST_INIT(&timers->entries);
+}
+
+B_FUNC void
+b_run_loop_timer_list_deinitialize(
+    B_TRANSFER B_RunLoopTimerList *timers) {
+  B_PRECONDITION(timers);
+
+  struct B_RunLoopTimerEntry *entry;
+  struct B_RunLoopTimerEntry *temp_entry;
+  B_SLIST_FOREACH_SAFE(
+      entry, &timers->entries, link, temp_entry) {
+    if (!entry->cancel_callback(
+        entry->user_data.bytes,
+        &(struct B_Error) {.posix_error = 0})) {
+      // Nobody is left to report the error to.
+    }
+    b_deallocate(entry);
+  }
+  b_scribble(timers, sizeof(*timers));
+}
+
+B_WUR B_FUNC bool
+b_run_loop_timer_list_add_timer(
+    B_BORROW B_RunLoopTimerList *timers,
+    int64_t deadline_us,
+    B_TRANSFER B_RunLoopFunction *callback,
+    B_TRANSFER B_RunLoopFunction *cancel_callback,
+    B_TRANSFER void const *callback_data,
+    size_t callback_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(timers);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(e);
+
+  size_t header_size = offsetof(
+    struct B_RunLoopTimerEntry, user_data.bytes);
+  if (callback_data_size > SIZE_MAX - header_size) {
+    *e = (struct B_Error) {.posix_error = ENOMEM};
+    return false;
+  }
+  size_t entry_size = header_size + callback_data_size;
+  struct B_RunLoopTimerEntry *entry;
+  if (!b_allocate(entry_size, (void **) &entry, e)) {
+    return false;
+  }
+  entry->deadline_us = deadline_us;
+  entry->callback = callback;
+  entry->cancel_callback = cancel_callback;
+  if (callback_data) {
+    memcpy(
+      entry->user_data.bytes,
+      callback_data,
+      callback_data_size);
+  }
+  struct B_RunLoopTimerEntry *prev = NULL;
+  struct B_RunLoopTimerEntry *other;
+  B_SLIST_FOREACH(other, &timers->entries, link) {
+    if (other->deadline_us > deadline_us) {
+      break;
+    }
+    prev = other;
+  }
+  if (prev) {
+    B_SLIST_INSERT_AFTER(prev, entry, link);
+  } else {
+    B_SLIST_INSERT_HEAD(&timers->entries, entry, link);
+  }
+  return true;
+}
+
+B_WUR B_FUNC bool
+b_run_loop_timer_list_next_deadline(
+    B_BORROW B_RunLoopTimerList const *timers,
+    B_OUT int64_t *out_deadline_us) {
+  B_PRECONDITION(timers);
+  B_OUT_PARAMETER(out_deadline_us);
+
+  struct B_RunLoopTimerEntry const *entry
+    = B_SLIST_FIRST(&timers->entries);
+  if (!entry) {
+    return false;
+  }
+  *out_deadline_us = entry->deadline_us;
+  return true;
+}
+
+B_WUR B_FUNC int
+b_run_loop_timer_list_timeout_ms(
+    B_BORROW B_RunLoopTimerList const *timers,
+    int64_t now_us) {
+  B_PRECONDITION(timers);
+
+  int64_t deadline_us;
+  if (!b_run_loop_timer_list_next_deadline(
+      timers, &deadline_us)) {
+    return -1;
+  }
+  if (deadline_us <= now_us) {
+    return 0;
+  }
+  int64_t timeout_ms = (deadline_us - now_us + 999) / 1000;
+  return timeout_ms > INT_MAX ? INT_MAX : (int) timeout_ms;
+}
+
+B_WUR B_FUNC bool
+b_run_loop_timer_list_run_due(
+    B_BORROW B_RunLoopTimerList *timers,
+    int64_t now_us,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(timers);
+  B_OUT_PARAMETER(e);
+
+  // A callback may add timers, so take one at a time.
+  for (;;) {
+    struct B_RunLoopTimerEntry *entry
+      = B_SLIST_FIRST(&timers->entries);
+    if (!entry || entry->deadline_us > now_us) {
+      return true;
+    }
+    B_SLIST_REMOVE_HEAD(&timers->entries, link);
+    bool ok = entry->callback(entry->user_data.bytes, e);
+    b_deallocate(entry);
+    if (!ok) {
+      return false;
+    }
+  }
+}
+
+B_WUR B_FUNC int64_t
+b_run_loop_now_us(
+    void) {
+  struct timespec now;
+  int rc = clock_gettime(CLOCK_MONOTONIC, &now);
+  // CLOCK_MONOTONIC is always supported.
+  B_ASSERT(rc == 0);
+  (void) rc;
+  return (int64_t) now.tv_sec * 1000000
+    + (int64_t) (now.tv_nsec / 1000);
+}
+
+B_WUR B_FUNC int64_t
+b_run_loop_deadline_us(
+    int64_t now_us,
+    int64_t delay_ms) {
+  B_PRECONDITION(now_us >= 0);
+  B_PRECONDITION(delay_ms >= 0);
+
+  if (delay_ms > (INT64_MAX - now_us) / 1000) {
+    return INT64_MAX;
+  }
+  return now_us + delay_ms * 1000;
+}
+
+B_FUNC void
+b_run_loop_trace_idle(
+    B_BORROW struct B_RunLoop *run_loop,
+    int64_t idle_start_us) {
+  B_PRECONDITION(run_loop);
+
+  if (!run_loop->tracer) {
+    return;
+  }
+  int64_t now_us = b_tracer_now_us();
+  if (now_us - idle_start_us >= B_RUN_LOOP_IDLE_TRACE_US_) {
+    b_tracer_span(
+      run_loop->tracer,
+      "run loop",
+      "idle",
+      idle_start_us,
+      now_us,
+      NULL);
+  }
 }
 
 #if B_CONFIG_POSIX_PROCESS
@@ -122,12 +345,16 @@ b_exit_status_from_waitpid_status(
     exit_status.type = B_PROCESS_EXIT_STATUS_CODE;
     exit_status.u.code.exit_code
       = WEXITSTATUS(waitpid_status);
+    memset(
+      &exit_status.usage, 0, sizeof(exit_status.usage));
     return exit_status;
   } else if (WIFSIGNALED(waitpid_status)) {
     struct B_ProcessExitStatus exit_status;
     exit_status.type = B_PROCESS_EXIT_STATUS_SIGNAL;
     exit_status.u.signal.signal_number
       = WTERMSIG(waitpid_status);
+    memset(
+      &exit_status.usage, 0, sizeof(exit_status.usage));
     return exit_status;
   } else {
     B_ASSERT(!WIFSTOPPED(waitpid_status));
@@ -135,3 +362,35 @@ b_exit_status_from_waitpid_status(
   }
 }
 #endif
+
+#if B_CONFIG_WAIT4
+static int64_t
+b_timeval_us_(
+    struct timeval tv) {
+  return (int64_t) tv.tv_sec * 1000000
+    + (int64_t) tv.tv_usec;
+}
+
+B_WUR B_FUNC struct B_ProcessResourceUsage
+b_process_resource_usage_from_rusage(
+    B_BORROW struct rusage const *rusage) {
+  B_PRECONDITION(rusage);
+
+  // ru_inblock and ru_oublock count 512-byte blocks.
+  enum { BLOCK_SIZE = 512 };
+  struct B_ProcessResourceUsage usage;
+  usage.cpu_time_us = b_timeval_us_(rusage->ru_utime)
+    + b_timeval_us_(rusage->ru_stime);
+# if B_CONFIG_RUSAGE_MAXRSS_BYTES
+  usage.peak_rss_bytes = (int64_t) rusage->ru_maxrss;
+# else
+  usage.peak_rss_bytes
+    = (int64_t) rusage->ru_maxrss * 1024;
+# endif
+  usage.bytes_read
+    = (int64_t) rusage->ru_inblock * BLOCK_SIZE;
+  usage.bytes_written
+    = (int64_t) rusage->ru_oublock * BLOCK_SIZE;
+  return usage;
+}
+#endif
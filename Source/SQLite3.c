@@ -3,15 +3,63 @@
 #include <B/Private/Log.h>
 #include <B/Private/SQLite3.h>
 
+#include <errno.h>
 #include <limits.h>
 #include <sqlite3.h>
 
 B_WUR B_FUNC struct B_Error
 b_sqlite3_error(
     int sqlite_rc) {
-  (void) sqlite_rc;
-  B_NYI();
-  return (struct B_Error) {.posix_error = 0};
+  B_PRECONDITION(sqlite_rc != SQLITE_OK);
+  B_PRECONDITION(sqlite_rc != SQLITE_ROW);
+  B_PRECONDITION(sqlite_rc != SQLITE_DONE);
+
+  int posix_error;
+  // Extended result codes share their primary result
+  // code's low byte.
+  switch (sqlite_rc & 0xFF) {
+  case SQLITE_NOMEM:
+    posix_error = ENOMEM;
+    break;
+  case SQLITE_BUSY:
+  case SQLITE_LOCKED:
+    posix_error = EBUSY;
+    break;
+  case SQLITE_PERM:
+  case SQLITE_AUTH:
+    posix_error = EACCES;
+    break;
+  case SQLITE_READONLY:
+    posix_error = EROFS;
+    break;
+  case SQLITE_INTERRUPT:
+    posix_error = EINTR;
+    break;
+  case SQLITE_FULL:
+    posix_error = ENOSPC;
+    break;
+  case SQLITE_CANTOPEN:
+    posix_error = ENOENT;
+    break;
+  case SQLITE_CORRUPT:
+  case SQLITE_NOTADB:
+  case SQLITE_MISMATCH:
+  case SQLITE_CONSTRAINT:
+    posix_error = EINVAL;
+    break;
+  case SQLITE_TOOBIG:
+    posix_error = E2BIG;
+    break;
+  case SQLITE_MISUSE:
+  case SQLITE_RANGE:
+    B_BUG();
+    posix_error = EINVAL;
+    break;
+  default:
+    posix_error = EIO;
+    break;
+  }
+  return (struct B_Error) {.posix_error = posix_error};
 }
 
 B_WUR B_EXPORT_FUNC bool
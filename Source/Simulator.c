@@ -0,0 +1,528 @@
+// NOTE[simulation]: A B_Simulation replays a recorded
+// build through a real B_Main (and, if given one, a real
+// B_ProcessQueue), so scheduling changes can be measured
+// deterministically and without running any tools.
+//
+// Time is virtual.  The simulation's run loop (see
+// b_run_loop_allocate_simulated) never starts processes;
+// instead, each process exits after its simulated
+// duration, in order of exit time, and functions run
+// instantly between exits.  The same history therefore
+// always gives the same B_SimulationReport.
+//
+// b_simulation_dispatch answers each question from the
+// history database:
+//
+// * The question needs the questions it was recorded
+//   needing (see b_database_recorded_dependencies), all
+//   at once.
+// * If the question's recorded executions took time or
+//   memory, it then runs a simulated process with
+//   b_answer_context_exec.  The process runs for the
+//   question's mean wall time (which excludes waits; see
+//   NOTE[execution time]), uses its mean CPU time, and
+//   peaks at its maximum RSS.  CPU time is not used as the
+//   duration, since it overstates multithreaded tools and
+//   understates I/O-bound ones.
+// * The question is answered with its recorded answer, or
+//   fails with ENOENT if it has none.
+//
+// Processes are not queued in pools, since pool names are
+// not recorded.  The duration, CPU time, and RSS of a
+// simulated process are passed to the run loop in its
+// command line.
+
+#include <B/AnswerContext.h>
+#include <B/AnswerFuture.h>
+#include <B/Database.h>
+#include <B/Error.h>
+#include <B/Memory.h>
+#include <B/Private/AnswerContext.h>
+#include <B/Private/Assertions.h>
+#include <B/Private/Database.h>
+#include <B/Private/Memory.h>
+#include <B/Process.h>
+#include <B/QuestionAnswer.h>
+#include <B/RunLoop.h>
+#include <B/Simulator.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct B_Simulation {
+  struct B_Database *history;
+  struct B_QuestionVTable const *const *question_vtables;
+  size_t question_vtable_count;
+  struct B_RunLoop *run_loop;
+};
+
+struct B_SimulationQuestion_ {
+  struct B_IQuestion *question;
+  struct B_QuestionVTable const *question_vtable;
+};
+
+struct B_SimulationQuestionList_ {
+  struct B_SimulationQuestion_ *entries;
+  size_t count;
+  size_t capacity;
+};
+
+// The closure given to futures and processes.
+struct B_SimulationClosure_ {
+  struct B_Simulation *simulation;
+  struct B_AnswerContext *ac;
+};
+
+static B_FUNC void
+b_simulation_question_list_deinitialize_(
+    B_TRANSFER struct B_SimulationQuestionList_ *list) {
+  B_PRECONDITION(list);
+
+  for (size_t i = 0; i < list->count; ++i) {
+    b_question_release(
+      list->entries[i].question,
+      list->entries[i].question_vtable);
+  }
+  if (list->entries) {
+    b_deallocate(list->entries);
+  }
+}
+
+static B_FUNC bool
+b_simulation_collect_question_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *question_vtable,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(opaque);
+  B_PRECONDITION(question);
+  B_PRECONDITION(question_vtable);
+  B_OUT_PARAMETER(e);
+
+  struct B_SimulationQuestionList_ *list = opaque;
+  if (list->count == list->capacity) {
+    size_t capacity
+      = list->capacity == 0 ? 8 : list->capacity * 2;
+    struct B_SimulationQuestion_ *entries;
+    bool ok;
+    if (list->entries) {
+      ok = b_reallocate(
+        list->entries,
+        sizeof(*entries) * capacity,
+        (void **) &entries,
+        e);
+    } else {
+      ok = b_allocate2(
+        sizeof(*entries),
+        capacity,
+        (void **) &entries,
+        e);
+    }
+    if (!ok) {
+      return false;
+    }
+    list->entries = entries;
+    list->capacity = capacity;
+  }
+  // See NOTE[question references].
+  struct B_IQuestion *retained;
+  if (!b_question_retain(
+      question, question_vtable, &retained, e)) {
+    return false;
+  }
+  list->entries[list->count]
+    = (struct B_SimulationQuestion_) {
+      .question = retained,
+      .question_vtable = question_vtable,
+    };
+  list->count += 1;
+  return true;
+}
+
+// Records a summary of each answered question's
+// executions in database.
+static B_WUR B_FUNC bool
+b_simulation_copy_history_(
+    B_BORROW struct B_Simulation *simulation,
+    B_BORROW struct B_Database *database,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(simulation);
+  B_PRECONDITION(database);
+  B_OUT_PARAMETER(e);
+
+  // Collect questions first; callbacks must not call into
+  // the database.
+  struct B_SimulationQuestionList_ list = {
+    .entries = NULL,
+    .count = 0,
+    .capacity = 0,
+  };
+  bool ok = b_database_answered_questions(
+    simulation->history,
+    simulation->question_vtables,
+    simulation->question_vtable_count,
+    b_simulation_collect_question_,
+    &list,
+    e);
+  for (size_t i = 0; ok && i < list.count; ++i) {
+    struct B_SimulationQuestion_ *entry = &list.entries[i];
+    struct B_ExecutionSummary summary;
+    ok = b_database_summarize_executions(
+      simulation->history,
+      entry->question,
+      entry->question_vtable,
+      &summary,
+      e);
+    if (!ok || summary.execution_count == 0) {
+      continue;
+    }
+    struct B_ExecutionRecord record = {
+      .started_at_ms = summary.last_started_at_ms,
+      .wall_time_us = summary.mean_wall_time_us,
+      .cpu_time_us = summary.mean_cpu_time_us,
+      .peak_rss_bytes = summary.max_peak_rss_bytes,
+      .exit_status = 0,
+      .bytes_read = summary.mean_bytes_read,
+      .bytes_written = summary.mean_bytes_written,
+    };
+    ok = b_database_record_execution(
+      database,
+      entry->question,
+      entry->question_vtable,
+      &record,
+      e);
+  }
+  b_simulation_question_list_deinitialize_(&list);
+  return ok;
+}
+
+// Parses the command line built by b_simulation_exec_.
+static B_FUNC bool
+b_simulation_process_(
+    B_BORROW void *opaque,
+    B_BORROW char const *const *command_args,
+    B_OUT int64_t *duration_us,
+    B_OUT struct B_ProcessExitStatus *exit_status,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(command_args);
+  B_OUT_PARAMETER(duration_us);
+  B_OUT_PARAMETER(exit_status);
+  B_OUT_PARAMETER(e);
+
+  (void) opaque;
+  if (!command_args[0] || !command_args[1]
+      || !command_args[2] || !command_args[3]
+      || command_args[4]) {
+    *e = (struct B_Error) {.posix_error = EINVAL};
+    return false;
+  }
+  int64_t wall_time_us = strtoll(command_args[1], NULL, 10);
+  int64_t cpu_time_us = strtoll(command_args[2], NULL, 10);
+  int64_t peak_rss_bytes
+    = strtoll(command_args[3], NULL, 10);
+  *duration_us = wall_time_us;
+  memset(exit_status, 0, sizeof(*exit_status));
+  exit_status->type = B_PROCESS_EXIT_STATUS_CODE;
+  exit_status->u.code.exit_code = 0;
+  exit_status->usage.cpu_time_us = cpu_time_us;
+  exit_status->usage.peak_rss_bytes = peak_rss_bytes;
+  return true;
+}
+
+// Answers the question with its recorded answer.
+static B_WUR B_FUNC bool
+b_simulation_succeed_(
+    B_BORROW struct B_Simulation *simulation,
+    B_TRANSFER struct B_AnswerContext *ac,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(simulation);
+  B_PRECONDITION(ac);
+  B_OUT_PARAMETER(e);
+
+  struct B_IAnswer *answer;
+  if (!b_database_look_up_answer(
+      simulation->history,
+      ac->question,
+      ac->question_vtable,
+      &answer,
+      e)) {
+    return false;
+  }
+  if (!answer) {
+    return b_answer_context_fail(
+      ac, (struct B_Error) {.posix_error = ENOENT}, e);
+  }
+  return b_answer_context_succeed_answer(ac, answer, e);
+}
+
+static B_FUNC bool
+b_simulation_exec_callback_(
+    B_BORROW struct B_ProcessExitStatus const *exit_status,
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(exit_status);
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_SimulationClosure_ const *closure
+    = callback_data;
+  return b_simulation_succeed_(
+    closure->simulation, closure->ac, e);
+}
+
+static B_FUNC bool
+b_simulation_cancel_callback_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_SimulationClosure_ const *closure
+    = callback_data;
+  return b_answer_context_fail(
+    closure->ac,
+    (struct B_Error) {.posix_error = ECANCELED},
+    e);
+}
+
+// Runs the question's simulated process (if it had one),
+// then answers the question.
+static B_WUR B_FUNC bool
+b_simulation_exec_(
+    B_BORROW struct B_Simulation *simulation,
+    B_TRANSFER struct B_AnswerContext *ac,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(simulation);
+  B_PRECONDITION(ac);
+  B_OUT_PARAMETER(e);
+
+  struct B_ExecutionSummary summary;
+  if (!b_database_summarize_executions(
+      simulation->history,
+      ac->question,
+      ac->question_vtable,
+      &summary,
+      e)) {
+    return false;
+  }
+  if (summary.mean_wall_time_us == 0
+      && summary.max_peak_rss_bytes == 0) {
+    return b_simulation_succeed_(simulation, ac, e);
+  }
+  char wall_time_us[32];
+  char cpu_time_us[32];
+  char peak_rss_bytes[32];
+  (void) snprintf(
+    wall_time_us,
+    sizeof(wall_time_us),
+    "%" PRId64,
+    summary.mean_wall_time_us);
+  (void) snprintf(
+    cpu_time_us,
+    sizeof(cpu_time_us),
+    "%" PRId64,
+    summary.mean_cpu_time_us);
+  (void) snprintf(
+    peak_rss_bytes,
+    sizeof(peak_rss_bytes),
+    "%" PRId64,
+    summary.max_peak_rss_bytes);
+  char const *command_args[] = {
+    "simulated",
+    wall_time_us,
+    cpu_time_us,
+    peak_rss_bytes,
+    NULL,
+  };
+  struct B_SimulationClosure_ closure = {
+    .simulation = simulation,
+    .ac = ac,
+  };
+  return b_answer_context_exec(
+    ac,
+    NULL,
+    command_args,
+    b_simulation_exec_callback_,
+    b_simulation_cancel_callback_,
+    &closure,
+    sizeof(closure),
+    e);
+}
+
+static B_FUNC bool
+b_simulation_dependencies_answered_(
+    B_BORROW struct B_AnswerFuture *future,
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(future);
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_SimulationClosure_ const *closure
+    = callback_data;
+  enum B_AnswerFutureState state;
+  if (!b_answer_future_state(future, &state, e)) {
+    return false;
+  }
+  if (state != B_FUTURE_RESOLVED) {
+    return b_answer_context_fail(
+      closure->ac,
+      (struct B_Error) {.posix_error = ENOENT},
+      e);
+  }
+  return b_simulation_exec_(
+    closure->simulation, closure->ac, e);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_simulation_allocate(
+    B_BORROW struct B_Database *history,
+    B_BORROW struct B_Database *database,
+    B_BORROW struct B_QuestionVTable const *const *
+      question_vtables,
+    size_t question_vtable_count,
+    B_OUT_TRANSFER struct B_Simulation **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(history);
+  B_PRECONDITION(database);
+  B_PRECONDITION(history != database);
+  B_PRECONDITION(question_vtables);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_Simulation *simulation;
+  if (!b_allocate(
+      sizeof(*simulation), (void **) &simulation, e)) {
+    return false;
+  }
+  *simulation = (struct B_Simulation) {
+    .history = history,
+    .question_vtables = question_vtables,
+    .question_vtable_count = question_vtable_count,
+    .run_loop = NULL,
+  };
+  if (!b_simulation_copy_history_(
+      simulation, database, e)) {
+    goto fail;
+  }
+  if (!b_run_loop_allocate_simulated(
+      b_simulation_process_,
+      simulation,
+      &simulation->run_loop,
+      e)) {
+    goto fail;
+  }
+  *out = simulation;
+  return true;
+
+fail:
+  b_deallocate(simulation);
+  return false;
+}
+
+B_EXPORT_FUNC void
+b_simulation_deallocate(
+    B_TRANSFER struct B_Simulation *simulation) {
+  B_PRECONDITION(simulation);
+
+  b_run_loop_deallocate(simulation->run_loop);
+  b_deallocate(simulation);
+}
+
+B_WUR B_EXPORT_FUNC B_BORROW struct B_RunLoop *
+b_simulation_run_loop(
+    B_BORROW struct B_Simulation *simulation) {
+  B_PRECONDITION(simulation);
+
+  return simulation->run_loop;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_simulation_dispatch(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *main,
+    B_TRANSFER struct B_AnswerContext *ac,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(opaque);
+  B_PRECONDITION(main);
+  B_PRECONDITION(ac);
+  B_OUT_PARAMETER(e);
+
+  struct B_Simulation *simulation = opaque;
+  B_PRECONDITION(ac->database != simulation->history);
+  // Collect dependencies first; b_answer_context_need
+  // queries the database.
+  struct B_SimulationQuestionList_ list = {
+    .entries = NULL,
+    .count = 0,
+    .capacity = 0,
+  };
+  if (!b_database_recorded_dependencies(
+      simulation->history,
+      ac->question,
+      ac->question_vtable,
+      simulation->question_vtables,
+      simulation->question_vtable_count,
+      b_simulation_collect_question_,
+      &list,
+      e)) {
+    b_simulation_question_list_deinitialize_(&list);
+    return false;
+  }
+  if (list.count == 0) {
+    b_simulation_question_list_deinitialize_(&list);
+    return b_simulation_exec_(simulation, ac, e);
+  }
+  struct B_IQuestion **questions = NULL;
+  struct B_QuestionVTable const **question_vtables = NULL;
+  struct B_AnswerFuture *future = NULL;
+  bool ok = b_allocate2(
+    sizeof(*questions),
+    list.count,
+    (void **) &questions,
+    e);
+  ok = ok && b_allocate2(
+    sizeof(*question_vtables),
+    list.count,
+    (void **) &question_vtables,
+    e);
+  if (ok) {
+    for (size_t i = 0; i < list.count; ++i) {
+      questions[i] = list.entries[i].question;
+      question_vtables[i]
+        = list.entries[i].question_vtable;
+    }
+    ok = b_answer_context_need(
+      ac,
+      questions,
+      question_vtables,
+      list.count,
+      &future,
+      e);
+  }
+  if (question_vtables) {
+    b_deallocate(question_vtables);
+  }
+  if (questions) {
+    b_deallocate(questions);
+  }
+  b_simulation_question_list_deinitialize_(&list);
+  if (!ok) {
+    return false;
+  }
+  struct B_SimulationClosure_ closure = {
+    .simulation = simulation,
+    .ac = ac,
+  };
+  ok = b_answer_future_add_callback(
+    future,
+    b_simulation_dependencies_answered_,
+    &closure,
+    sizeof(closure),
+    e);
+  b_answer_future_release(future);
+  return ok;
+}
@@ -0,0 +1,344 @@
+// NOTE[tracing]: A B_Tracer records where a build spends
+// its time.  Give it to B_Main (b_main_set_tracer),
+// B_Database (b_database_set_tracer), B_ProcessQueue
+// (b_process_queue_set_tracer), and B_RunLoop
+// (b_run_loop_set_tracer) to record:
+//
+// * the lifetime of each question (category "question"),
+//   including time spent ready but not dispatched
+//   ("ready"), and time spent waiting on dependencies
+//   ("need"),
+// * each call of B_Main's callback ("dispatch"),
+// * each process, with its process ID ("process"), and
+//   each b_answer_context_exec, including time spent
+//   queued ("exec"),
+// * database writes ("database") and waits for the
+//   database's lock longer than
+//   B_DATABASE_LOCK_WAIT_TRACE_US_ ("lock wait"), and
+// * waits by the run loop for work longer than
+//   B_RUN_LOOP_IDLE_TRACE_US_ ("idle").
+//
+// Events are written in Chrome's trace event format (a
+// JSON array) as they happen, through a stdio buffer, so
+// tracing needs no memory proportional to the build's
+// size.  If the build crashes, the file lacks its closing
+// bracket, which Chrome's trace viewer tolerates.  Without
+// a tracer, the cost of tracing is a NULL check.
+
+#include <B/Error.h>
+#include <B/Memory.h>
+#include <B/Private/Assertions.h>
+#include <B/Private/Memory.h>
+#include <B/Private/Mutex.h>
+#include <B/Tracer.h>
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+struct B_Tracer {
+  // Guards the fields below.
+  struct B_Mutex lock;
+  FILE *file;
+  // The first error encountered while writing, or 0.
+  int posix_error;
+};
+
+// Chrome's trace viewer stores numbers as doubles, so
+// pthread_t values cannot be used as thread IDs.  Each
+// thread is instead given a small number when it first
+// writes an event.
+static pthread_once_t
+b_tracer_thread_key_once_ = PTHREAD_ONCE_INIT;
+
+static pthread_key_t
+b_tracer_thread_key_;
+
+static pthread_mutex_t
+b_tracer_thread_lock_ = PTHREAD_MUTEX_INITIALIZER;
+
+static uintptr_t
+b_tracer_next_thread_id_ = 1;
+
+static void
+b_tracer_create_thread_key_(
+    void) {
+  int rc = pthread_key_create(&b_tracer_thread_key_, NULL);
+  B_ASSERT(rc == 0);
+  (void) rc;
+}
+
+static B_FUNC uintptr_t
+b_tracer_thread_id_(
+    void) {
+  int rc = pthread_once(
+    &b_tracer_thread_key_once_,
+    b_tracer_create_thread_key_);
+  B_ASSERT(rc == 0);
+  uintptr_t id = (uintptr_t) pthread_getspecific(
+    b_tracer_thread_key_);
+  if (id == 0) {
+    rc = pthread_mutex_lock(&b_tracer_thread_lock_);
+    B_ASSERT(rc == 0);
+    id = b_tracer_next_thread_id_;
+    b_tracer_next_thread_id_ += 1;
+    rc = pthread_mutex_unlock(&b_tracer_thread_lock_);
+    B_ASSERT(rc == 0);
+    // If this fails, the next event gets a new ID.
+    (void) pthread_setspecific(
+      b_tracer_thread_key_, (void *) id);
+  }
+  (void) rc;
+  return id;
+}
+
+// Must be called with tracer->lock held.
+static B_FUNC void
+b_tracer_check_error_locked_(
+    B_BORROW struct B_Tracer *tracer,
+    int rc) {
+  B_PRECONDITION(tracer);
+
+  if (rc < 0 && tracer->posix_error == 0) {
+    tracer->posix_error = errno == 0 ? EIO : errno;
+  }
+}
+
+// Writes a JSON string.  Must be called with tracer->lock
+// held.
+static B_FUNC void
+b_tracer_write_string_locked_(
+    B_BORROW struct B_Tracer *tracer,
+    B_BORROW uint8_t const *data,
+    size_t size) {
+  B_PRECONDITION(tracer);
+  B_PRECONDITION(data || size == 0);
+
+  FILE *file = tracer->file;
+  b_tracer_check_error_locked_(tracer, putc('"', file));
+  for (size_t i = 0; i < size; ++i) {
+    uint8_t c = data[i];
+    int rc;
+    if (c == '"' || c == '\\') {
+      rc = fprintf(file, "\\%c", c);
+    } else if (c < 0x20 || c >= 0x7f) {
+      // Escaping bytes >= 0x80 keeps the file valid
+      // UTF-8, but mangles non-ASCII text.
+      rc = fprintf(file, "\\u%04x", c);
+    } else {
+      rc = putc(c, file);
+    }
+    b_tracer_check_error_locked_(tracer, rc);
+  }
+  b_tracer_check_error_locked_(tracer, putc('"', file));
+}
+
+// Writes one event.  at_us and (if duration_us is not
+// negative) duration_us are given; id is given if
+// has_id.
+static B_FUNC void
+b_tracer_write_event_(
+    B_BORROW struct B_Tracer *tracer,
+    char phase,
+    B_BORROW char const *category,
+    B_BORROW char const *name,
+    int64_t at_us,
+    int64_t duration_us,
+    bool has_id,
+    uint64_t id,
+    B_BORROW_OPTIONAL struct B_TraceArg const *arg) {
+  B_PRECONDITION(tracer);
+  B_PRECONDITION(category);
+  B_PRECONDITION(name);
+
+  uintptr_t thread_id = b_tracer_thread_id_();
+  pid_t process_id = getpid();
+  b_mutex_lock(&tracer->lock);
+  FILE *file = tracer->file;
+  int rc = fprintf(
+    file,
+    "{\"ph\":\"%c\",\"cat\":\"%s\",\"name\":\"%s\","
+      "\"pid\":%ld,\"tid\":%" PRIuPTR ",\"ts\":%" PRId64,
+    phase,
+    category,
+    name,
+    (long) process_id,
+    thread_id,
+    at_us);
+  b_tracer_check_error_locked_(tracer, rc);
+  if (duration_us >= 0) {
+    rc = fprintf(file, ",\"dur\":%" PRId64, duration_us);
+    b_tracer_check_error_locked_(tracer, rc);
+  }
+  if (has_id) {
+    rc = fprintf(file, ",\"id\":%" PRIu64, id);
+    b_tracer_check_error_locked_(tracer, rc);
+  }
+  if (arg) {
+    rc = fprintf(file, ",\"args\":{\"%s\":", arg->name);
+    b_tracer_check_error_locked_(tracer, rc);
+    if (arg->string) {
+      b_tracer_write_string_locked_(
+        tracer, arg->string, arg->string_size);
+    } else {
+      rc = fprintf(file, "%" PRId64, arg->integer);
+      b_tracer_check_error_locked_(tracer, rc);
+    }
+    b_tracer_check_error_locked_(tracer, putc('}', file));
+  }
+  b_tracer_check_error_locked_(tracer, fputs("},\n", file));
+  b_mutex_unlock(&tracer->lock);
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_tracer_open(
+    B_BORROW char const *path,
+    B_OUT_TRANSFER struct B_Tracer **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(path);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_Tracer *tracer;
+  if (!b_allocate(sizeof(*tracer), (void **) &tracer, e)) {
+    return false;
+  }
+  *tracer = (struct B_Tracer) {
+    // .lock
+    .file = NULL,
+    .posix_error = 0,
+  };
+  if (!b_mutex_initialize(&tracer->lock, e)) {
+    b_deallocate(tracer);
+    return false;
+  }
+  tracer->file = fopen(path, "w");
+  if (!tracer->file) {
+    *e = (struct B_Error) {.posix_error = errno};
+    goto fail;
+  }
+  if (fputs("[\n", tracer->file) < 0) {
+    *e = (struct B_Error) {.posix_error = errno};
+    goto fail;
+  }
+  *out = tracer;
+  return true;
+
+fail:
+  if (tracer->file) {
+    (void) fclose(tracer->file);
+  }
+  if (!b_mutex_destroy(
+      &tracer->lock,
+      &(struct B_Error) {.posix_error = 0})) {
+    // Ignore.
+  }
+  b_deallocate(tracer);
+  return false;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_tracer_close(
+    B_TRANSFER struct B_Tracer *tracer,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(tracer);
+  B_OUT_PARAMETER(e);
+
+  // Events end with a comma, so end the array with an
+  // event which names the process.
+  b_mutex_lock(&tracer->lock);
+  int rc = fprintf(
+    tracer->file,
+    "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%ld,"
+      "\"args\":{\"name\":\"b\"}}\n]\n",
+    (long) getpid());
+  b_tracer_check_error_locked_(tracer, rc);
+  if (fclose(tracer->file) != 0) {
+    b_tracer_check_error_locked_(tracer, -1);
+  }
+  int posix_error = tracer->posix_error;
+  b_mutex_unlock(&tracer->lock);
+  struct B_Error destroy_error;
+  if (!b_mutex_destroy(&tracer->lock, &destroy_error)) {
+    if (posix_error == 0) {
+      posix_error = destroy_error.posix_error;
+    }
+  }
+  b_deallocate(tracer);
+  if (posix_error != 0) {
+    *e = (struct B_Error) {.posix_error = posix_error};
+    return false;
+  }
+  return true;
+}
+
+B_WUR B_EXPORT_FUNC int64_t
+b_tracer_now_us(
+    void) {
+  struct timespec now;
+  int rc = clock_gettime(CLOCK_MONOTONIC, &now);
+  // CLOCK_MONOTONIC is always supported.
+  B_ASSERT(rc == 0);
+  (void) rc;
+  return (int64_t) now.tv_sec * 1000000
+    + (int64_t) (now.tv_nsec / 1000);
+}
+
+B_EXPORT_FUNC void
+b_tracer_span(
+    B_BORROW struct B_Tracer *tracer,
+    B_BORROW char const *category,
+    B_BORROW char const *name,
+    int64_t start_us,
+    int64_t end_us,
+    B_BORROW_OPTIONAL struct B_TraceArg const *arg) {
+  B_PRECONDITION(tracer);
+  B_PRECONDITION(category);
+  B_PRECONDITION(name);
+  B_PRECONDITION(start_us <= end_us);
+
+  b_tracer_write_event_(
+    tracer,
+    'X',
+    category,
+    name,
+    start_us,
+    end_us - start_us,
+    false,
+    0,
+    arg);
+}
+
+B_EXPORT_FUNC void
+b_tracer_begin_async(
+    B_BORROW struct B_Tracer *tracer,
+    B_BORROW char const *category,
+    B_BORROW char const *name,
+    uint64_t id,
+    int64_t at_us,
+    B_BORROW_OPTIONAL struct B_TraceArg const *arg) {
+  B_PRECONDITION(tracer);
+  B_PRECONDITION(category);
+  B_PRECONDITION(name);
+
+  b_tracer_write_event_(
+    tracer, 'b', category, name, at_us, -1, true, id, arg);
+}
+
+B_EXPORT_FUNC void
+b_tracer_end_async(
+    B_BORROW struct B_Tracer *tracer,
+    B_BORROW char const *category,
+    B_BORROW char const *name,
+    uint64_t id,
+    int64_t at_us) {
+  B_PRECONDITION(tracer);
+  B_PRECONDITION(category);
+  B_PRECONDITION(name);
+
+  b_tracer_write_event_(
+    tracer, 'e', category, name, at_us, -1, true, id, NULL);
+}
@@ -0,0 +1,404 @@
+// NOTE[worker threads]: B_Main, B_AnswerContext,
+// B_AnswerFuture, B_ProcessQueue, and B_RunLoop are not
+// thread-safe: they must only be used on the thread
+// running the run loop.  (The exception is
+// b_run_loop_add_function, which may be called from any
+// thread.)  B_Database locks itself, so it may be used
+// from any thread.
+//
+// Questions which need CPU time in-process (e.g. parsing,
+// hashing, or generating code) can still use several
+// cores.  A B_WorkerPool runs functions on its own
+// threads, then reports completion by adding a function
+// to the run loop.  A worker function may only touch its
+// work data (and thread-safe objects it points to); it
+// must not touch the B_AnswerContext which submitted it.
+// The callback, which runs on the run loop's thread, then
+// uses the results, e.g. by calling
+// b_answer_context_succeed.  See
+// b_answer_context_run_in_worker.
+//
+// Worker threads block all signals, so signals (such as
+// SIGCHLD) are delivered to the run loop's thread.
+//
+// If a worker thread cannot add a completion to the run
+// loop (e.g. because it is out of memory), the work is
+// kept aside with that error.  The next completion to run
+// fails it by calling its callback with the error as
+// work_error.  If the pool is deallocated first, its
+// cancel callback is called instead.
+
+#include <B/Error.h>
+#include <B/Memory.h>
+#include <B/Private/Assertions.h>
+#include <B/Private/Callback.h>
+#include <B/Private/Log.h>
+#include <B/Private/Memory.h>
+#include <B/Private/Mutex.h>
+#include <B/RunLoop.h>
+#include <B/WorkerPool.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+struct B_WorkerPoolWork_ {
+  // Next queued work.
+  struct B_WorkerPoolWork_ *next;
+  B_WorkerPoolFunction *function;
+  B_WorkerPoolCallback *callback;
+  B_RunLoopFunction *cancel_callback;
+  // Set by the worker thread.
+  struct B_Error work_error;
+  union B_UserData user_data;
+};
+
+struct B_WorkerPool {
+  struct B_RunLoop *run_loop;
+  pthread_t *threads;
+  size_t thread_count;
+
+  // Guards the fields below.
+  struct B_Mutex lock;
+  // Signalled when work is queued or stopping is set.
+  pthread_cond_t work_queued;
+  // Work which has not started, in submission order.
+  struct B_WorkerPoolWork_ *first_work;
+  struct B_WorkerPoolWork_ *last_work;
+  // Work whose completion could not be added to the run
+  // loop.  work_error is why.
+  struct B_WorkerPoolWork_ *undelivered_work;
+  bool stopping;
+};
+
+struct B_WorkerPoolDoneClosure_ {
+  struct B_WorkerPool *pool;
+  struct B_WorkerPoolWork_ *work;
+};
+
+static B_FUNC bool
+b_worker_pool_work_done_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_WorkerPoolDoneClosure_ const *closure
+    = callback_data;
+  struct B_WorkerPool *pool = closure->pool;
+  struct B_WorkerPoolWork_ *work = closure->work;
+  bool ok = work->callback(
+    work->user_data.bytes, work->work_error, e);
+  b_deallocate(work);
+
+  b_mutex_lock(&pool->lock);
+  work = pool->undelivered_work;
+  pool->undelivered_work = NULL;
+  b_mutex_unlock(&pool->lock);
+  while (work) {
+    struct B_WorkerPoolWork_ *next = work->next;
+    if (ok) {
+      ok = work->callback(
+        work->user_data.bytes, work->work_error, e);
+    } else {
+      if (!work->callback(
+          work->user_data.bytes,
+          work->work_error,
+          &(struct B_Error) {.posix_error = 0})) {
+        // e already holds the first error.
+      }
+    }
+    b_deallocate(work);
+    work = next;
+  }
+  return ok;
+}
+
+static B_FUNC bool
+b_worker_pool_work_cancelled_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(callback_data);
+  B_OUT_PARAMETER(e);
+
+  struct B_WorkerPoolDoneClosure_ const *closure
+    = callback_data;
+  struct B_WorkerPoolWork_ *work = closure->work;
+  bool ok = work->cancel_callback(
+    work->user_data.bytes, e);
+  b_deallocate(work);
+  return ok;
+}
+
+// Takes the next queued work, waiting if there is none.
+// Returns NULL if the pool is stopping.
+static B_FUNC struct B_WorkerPoolWork_ *
+b_worker_pool_take_work_(
+    B_BORROW struct B_WorkerPool *pool) {
+  B_PRECONDITION(pool);
+
+  b_mutex_lock(&pool->lock);
+  while (!pool->stopping && !pool->first_work) {
+    int rc = pthread_cond_wait(
+      &pool->work_queued, &pool->lock.mutex);
+    B_ASSERT(rc == 0);
+    (void) rc;
+  }
+  struct B_WorkerPoolWork_ *work = NULL;
+  if (!pool->stopping) {
+    work = pool->first_work;
+    pool->first_work = work->next;
+    if (!pool->first_work) {
+      pool->last_work = NULL;
+    }
+  }
+  b_mutex_unlock(&pool->lock);
+  return work;
+}
+
+static void *
+b_worker_pool_thread_(
+    void *opaque) {
+  struct B_WorkerPool *pool = opaque;
+  struct B_WorkerPoolWork_ *work;
+  while ((work = b_worker_pool_take_work_(pool))) {
+    struct B_WorkerPoolDoneClosure_ closure = {
+      .pool = pool,
+      .work = work,
+    };
+    struct B_Error work_error;
+    work->work_error = (struct B_Error) {.posix_error = 0};
+    if (!work->function(
+        work->user_data.bytes, &work_error)) {
+      work->work_error = work_error;
+    }
+    struct B_Error e;
+    if (!b_run_loop_add_function(
+        pool->run_loop,
+        b_worker_pool_work_done_,
+        b_worker_pool_work_cancelled_,
+        &closure,
+        sizeof(closure),
+        &e)) {
+      // See NOTE[worker threads].
+      work->work_error = e;
+      b_mutex_lock(&pool->lock);
+      work->next = pool->undelivered_work;
+      pool->undelivered_work = work;
+      b_mutex_unlock(&pool->lock);
+    }
+  }
+  return NULL;
+}
+
+// Wakes and joins the first thread_count threads.
+static B_FUNC void
+b_worker_pool_stop_threads_(
+    B_BORROW struct B_WorkerPool *pool,
+    size_t thread_count) {
+  B_PRECONDITION(pool);
+
+  b_mutex_lock(&pool->lock);
+  pool->stopping = true;
+  int rc = pthread_cond_broadcast(&pool->work_queued);
+  B_ASSERT(rc == 0);
+  b_mutex_unlock(&pool->lock);
+  for (size_t i = 0; i < thread_count; ++i) {
+    rc = pthread_join(pool->threads[i], NULL);
+    B_ASSERT(rc == 0);
+  }
+  (void) rc;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_worker_pool_allocate(
+    B_BORROW struct B_RunLoop *run_loop,
+    size_t thread_count,
+    B_OUT_TRANSFER struct B_WorkerPool **out,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(run_loop);
+  B_PRECONDITION(thread_count > 0);
+  B_OUT_PARAMETER(out);
+  B_OUT_PARAMETER(e);
+
+  struct B_WorkerPool *pool = NULL;
+  pthread_t *threads = NULL;
+  bool lock_initialized = false;
+  bool cond_initialized = false;
+  if (!b_allocate2(
+      sizeof(*threads),
+      thread_count,
+      (void **) &threads,
+      e)) {
+    threads = NULL;
+    goto fail;
+  }
+  if (!b_allocate(sizeof(*pool), (void **) &pool, e)) {
+    pool = NULL;
+    goto fail;
+  }
+  *pool = (struct B_WorkerPool) {
+    .run_loop = run_loop,
+    .threads = threads,
+    .thread_count = 0,
+    // .lock
+    // .work_queued
+    .first_work = NULL,
+    .last_work = NULL,
+    .undelivered_work = NULL,
+    .stopping = false,
+  };
+  if (!b_mutex_initialize(&pool->lock, e)) {
+    goto fail;
+  }
+  lock_initialized = true;
+  int rc = pthread_cond_init(&pool->work_queued, NULL);
+  if (rc != 0) {
+    *e = (struct B_Error) {.posix_error = rc};
+    goto fail;
+  }
+  cond_initialized = true;
+
+  // See NOTE[worker threads].
+  sigset_t all_signals;
+  sigset_t old_signals;
+  (void) sigfillset(&all_signals);
+  rc = pthread_sigmask(
+    SIG_SETMASK, &all_signals, &old_signals);
+  if (rc != 0) {
+    *e = (struct B_Error) {.posix_error = rc};
+    goto fail;
+  }
+  for (size_t i = 0; i < thread_count; ++i) {
+    rc = pthread_create(
+      &threads[i], NULL, b_worker_pool_thread_, pool);
+    if (rc != 0) {
+      *e = (struct B_Error) {.posix_error = rc};
+      break;
+    }
+    pool->thread_count += 1;
+  }
+  int mask_rc = pthread_sigmask(
+    SIG_SETMASK, &old_signals, NULL);
+  B_ASSERT(mask_rc == 0);
+  (void) mask_rc;
+  if (pool->thread_count != thread_count) {
+    goto fail;
+  }
+  *out = pool;
+  return true;
+
+fail:
+  if (pool) {
+    b_worker_pool_stop_threads_(pool, pool->thread_count);
+    if (cond_initialized) {
+      (void) pthread_cond_destroy(&pool->work_queued);
+    }
+    if (lock_initialized) {
+      if (!b_mutex_destroy(
+          &pool->lock,
+          &(struct B_Error) {.posix_error = 0})) {
+        // Ignore.
+      }
+    }
+    b_deallocate(pool);
+  }
+  if (threads) {
+    b_deallocate(threads);
+  }
+  return false;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_worker_pool_deallocate(
+    B_TRANSFER struct B_WorkerPool *pool,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(pool);
+  B_OUT_PARAMETER(e);
+
+  b_worker_pool_stop_threads_(pool, pool->thread_count);
+  bool ok = true;
+  struct B_WorkerPoolWork_ *lists[] = {
+    pool->first_work,
+    pool->undelivered_work,
+  };
+  for (size_t i = 0; i < sizeof(lists) / sizeof(*lists);
+      ++i) {
+    struct B_WorkerPoolWork_ *work = lists[i];
+    while (work) {
+      struct B_WorkerPoolWork_ *next = work->next;
+      if (ok) {
+        ok = work->cancel_callback(
+          work->user_data.bytes, e);
+      }
+      b_deallocate(work);
+      work = next;
+    }
+  }
+  int rc = pthread_cond_destroy(&pool->work_queued);
+  B_ASSERT(rc == 0);
+  (void) rc;
+  struct B_Error destroy_error;
+  if (!b_mutex_destroy(&pool->lock, &destroy_error)) {
+    if (ok) {
+      *e = destroy_error;
+    }
+    ok = false;
+  }
+  b_deallocate(pool->threads);
+  b_deallocate(pool);
+  return ok;
+}
+
+B_WUR B_EXPORT_FUNC bool
+b_worker_pool_submit(
+    B_BORROW struct B_WorkerPool *pool,
+    B_WorkerPoolFunction *function,
+    B_WorkerPoolCallback *callback,
+    B_RunLoopFunction *cancel_callback,
+    B_BORROW void const *work_data,
+    size_t work_data_size,
+    B_OUT struct B_Error *e) {
+  B_PRECONDITION(pool);
+  B_PRECONDITION(function);
+  B_PRECONDITION(callback);
+  B_PRECONDITION(cancel_callback);
+  B_OUT_PARAMETER(e);
+
+  size_t header_size = offsetof(
+    struct B_WorkerPoolWork_, user_data.bytes);
+  if (work_data_size > SIZE_MAX - header_size) {
+    *e = (struct B_Error) {.posix_error = ENOMEM};
+    return false;
+  }
+  size_t work_size = header_size + work_data_size;
+  struct B_WorkerPoolWork_ *work;
+  if (!b_allocate(work_size, (void **) &work, e)) {
+    return false;
+  }
+  work->next = NULL;
+  work->function = function;
+  work->callback = callback;
+  work->cancel_callback = cancel_callback;
+  if (work_data) {
+    memcpy(
+      work->user_data.bytes, work_data, work_data_size);
+  }
+
+  b_mutex_lock(&pool->lock);
+  B_ASSERT(!pool->stopping);
+  if (pool->last_work) {
+    pool->last_work->next = work;
+  } else {
+    pool->first_work = work;
+  }
+  pool->last_work = work;
+  int rc = pthread_cond_signal(&pool->work_queued);
+  B_ASSERT(rc == 0);
+  (void) rc;
+  b_mutex_unlock(&pool->lock);
+  return true;
+}
@@ -0,0 +1,161 @@
+#include <B/AnswerFuture.h>
+#include <B/Error.h>
+#include <B/FileQuestion.h>
+#include <B/Private/AnswerCache.h>
+#include <B/Private/AnswerFuture.h>
+#include <B/Private/QuestionMap.h>
+#include <B/QuestionAnswer.h>
+
+#include <cstddef>
+#include <gtest/gtest.h>
+
+static B_FUNC void
+b_dummy_answer_deallocate_(
+    B_TRANSFER struct B_IAnswer *) {
+}
+
+static struct B_AnswerVTable
+b_dummy_answer_vtable_ = {
+  b_dummy_answer_deallocate_,
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+};
+
+static int
+b_dummy_answer_;
+
+static struct B_AnswerFuture *
+b_resolved_future_() {
+  struct B_Error e;
+  struct B_AnswerFuture *future;
+  EXPECT_TRUE(b_answer_future_allocate_one(
+    &b_dummy_answer_vtable_, &future, &e));
+  EXPECT_TRUE(b_answer_future_resolve(
+    future,
+    reinterpret_cast<struct B_IAnswer *>(&b_dummy_answer_),
+    &e));
+  return future;
+}
+
+static struct B_QuestionKey
+b_file_question_key_(
+    char const *file_path) {
+  struct B_Error e;
+  struct B_QuestionKey key;
+  EXPECT_TRUE(b_question_key_initialize(
+    static_cast<struct B_IQuestion const *>(
+      static_cast<void const *>(file_path)),
+    b_file_question_vtable(),
+    &key,
+    &e));
+  return key;
+}
+
+// Inserts the future under the key, then releases the
+// caller's reference to the future.
+static void
+b_insert_(
+    struct B_AnswerCache *cache,
+    char const *file_path,
+    struct B_AnswerFuture *future) {
+  struct B_Error e;
+  struct B_QuestionKey key
+    = b_file_question_key_(file_path);
+  EXPECT_TRUE(b_answer_cache_insert(
+    cache, &key, future, &e));
+  b_answer_future_release(future);
+}
+
+static struct B_AnswerFuture *
+b_look_up_(
+    struct B_AnswerCache *cache,
+    char const *file_path) {
+  struct B_QuestionKey key
+    = b_file_question_key_(file_path);
+  struct B_AnswerFuture *future;
+  b_answer_cache_look_up(cache, &key, &future);
+  b_question_key_deinitialize(&key);
+  return future;
+}
+
+TEST(TestAnswerCache, LookUpInsertedFuture) {
+  struct B_Error e;
+  struct B_AnswerCache *cache;
+  ASSERT_TRUE(b_answer_cache_allocate(4, &cache, &e));
+
+  struct B_AnswerFuture *future = b_resolved_future_();
+  b_insert_(cache, "a.c", future);
+  EXPECT_EQ(1U, b_answer_cache_count(cache));
+
+  struct B_AnswerFuture *found = b_look_up_(cache, "a.c");
+  EXPECT_EQ(future, found);
+  if (found) {
+    b_answer_future_release(found);
+  }
+  EXPECT_FALSE(b_look_up_(cache, "b.c"));
+
+  b_answer_cache_deallocate(cache);
+}
+
+TEST(TestAnswerCache, EvictsUnreferencedEntryWhenFull) {
+  struct B_Error e;
+  struct B_AnswerCache *cache;
+  ASSERT_TRUE(b_answer_cache_allocate(2, &cache, &e));
+
+  b_insert_(cache, "a.c", b_resolved_future_());
+  b_insert_(cache, "b.c", b_resolved_future_());
+
+  // Looking up a.c gives it a second chance, so b.c is
+  // evicted instead.
+  struct B_AnswerFuture *a = b_look_up_(cache, "a.c");
+  ASSERT_TRUE(a);
+  b_answer_future_release(a);
+  b_insert_(cache, "c.c", b_resolved_future_());
+  EXPECT_EQ(2U, b_answer_cache_count(cache));
+
+  struct B_AnswerFuture *b = b_look_up_(cache, "b.c");
+  EXPECT_FALSE(b);
+  char const *const cached_paths[] = {"a.c", "c.c"};
+  for (size_t i = 0; i < 2; ++i) {
+    struct B_AnswerFuture *future
+      = b_look_up_(cache, cached_paths[i]);
+    EXPECT_TRUE(future) << cached_paths[i];
+    if (future) {
+      b_answer_future_release(future);
+    }
+  }
+
+  b_answer_cache_deallocate(cache);
+}
+
+TEST(TestAnswerCache, RemovedSlotIsReused) {
+  struct B_Error e;
+  struct B_AnswerCache *cache;
+  ASSERT_TRUE(b_answer_cache_allocate(2, &cache, &e));
+
+  b_insert_(cache, "a.c", b_resolved_future_());
+  b_insert_(cache, "b.c", b_resolved_future_());
+  struct B_QuestionKey key = b_file_question_key_("a.c");
+  b_answer_cache_remove(cache, &key);
+  b_answer_cache_remove(cache, &key);
+  b_question_key_deinitialize(&key);
+  EXPECT_EQ(1U, b_answer_cache_count(cache));
+  EXPECT_FALSE(b_look_up_(cache, "a.c"));
+
+  // c.c takes a.c's slot instead of evicting b.c.
+  b_insert_(cache, "c.c", b_resolved_future_());
+  EXPECT_EQ(2U, b_answer_cache_count(cache));
+  char const *const cached_paths[] = {"b.c", "c.c"};
+  for (size_t i = 0; i < 2; ++i) {
+    struct B_AnswerFuture *future
+      = b_look_up_(cache, cached_paths[i]);
+    EXPECT_TRUE(future) << cached_paths[i];
+    if (future) {
+      b_answer_future_release(future);
+    }
+  }
+
+  b_answer_cache_deallocate(cache);
+}
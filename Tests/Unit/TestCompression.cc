@@ -0,0 +1,133 @@
+#include <B/Error.h>
+#include <B/Private/Compression.h>
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Compresses then decompresses data, expecting the
+// original data.  Returns the compressed size.
+static size_t
+b_lz_round_trip_(
+    std::vector<uint8_t> const &data) {
+  struct B_Error e;
+
+  // b_lz_compress requires a non-NULL pointer, even for
+  // empty data.
+  uint8_t const empty = 0;
+  uint8_t const *data_pointer
+    = data.empty() ? &empty : &data[0];
+
+  std::vector<uint8_t> compressed(data.size() * 2 + 16);
+  size_t compressed_size;
+  EXPECT_TRUE(b_lz_compress(
+    data_pointer,
+    data.size(),
+    &compressed[0],
+    compressed.size(),
+    &compressed_size));
+
+  std::vector<uint8_t> decompressed(data.size() + 1);
+  EXPECT_TRUE(b_lz_decompress(
+    &compressed[0],
+    compressed_size,
+    &decompressed[0],
+    data.size(),
+    &e));
+  decompressed.resize(data.size());
+  EXPECT_EQ(data, decompressed);
+  return compressed_size;
+}
+
+TEST(TestCompression, RoundTripEmpty) {
+  b_lz_round_trip_(std::vector<uint8_t>());
+}
+
+TEST(TestCompression, RoundTripRepetitiveDataShrinks) {
+  std::vector<uint8_t> data;
+  for (size_t i = 0; i < 10000; ++i) {
+    data.push_back(static_cast<uint8_t>("abcdefg"[i % 7]));
+  }
+  EXPECT_LT(b_lz_round_trip_(data), data.size() / 10);
+}
+
+TEST(TestCompression, RoundTripRunOfOneByte) {
+  std::vector<uint8_t> data(1000, 0x42);
+  EXPECT_LT(
+    b_lz_round_trip_(data), static_cast<size_t>(20));
+}
+
+TEST(TestCompression, LongRunStaysWithinMaxExpansion) {
+  std::vector<uint8_t> data(1000000, 0x42);
+  size_t compressed_size = b_lz_round_trip_(data);
+  EXPECT_LE(
+    data.size(), compressed_size * B_LZ_MAX_EXPANSION);
+}
+
+TEST(TestCompression, RoundTripPseudoRandomData) {
+  std::vector<uint8_t> data;
+  uint32_t state = 12345;
+  for (size_t i = 0; i < 100000; ++i) {
+    state = state * 1103515245 + 12345;
+    data.push_back(static_cast<uint8_t>(state >> 16));
+  }
+  b_lz_round_trip_(data);
+}
+
+TEST(TestCompression, CompressFailsIfOutputTooSmall) {
+  std::vector<uint8_t> data;
+  uint32_t state = 12345;
+  for (size_t i = 0; i < 1000; ++i) {
+    state = state * 1103515245 + 12345;
+    data.push_back(static_cast<uint8_t>(state >> 16));
+  }
+  std::vector<uint8_t> compressed(data.size() / 2);
+  size_t compressed_size;
+  EXPECT_FALSE(b_lz_compress(
+    &data[0],
+    data.size(),
+    &compressed[0],
+    compressed.size(),
+    &compressed_size));
+}
+
+TEST(TestCompression, DecompressWithWrongSizeFails) {
+  struct B_Error e;
+
+  std::vector<uint8_t> data(1000, 0x42);
+  std::vector<uint8_t> compressed(100);
+  size_t compressed_size;
+  ASSERT_TRUE(b_lz_compress(
+    &data[0],
+    data.size(),
+    &compressed[0],
+    compressed.size(),
+    &compressed_size));
+
+  std::vector<uint8_t> decompressed(data.size());
+  EXPECT_FALSE(b_lz_decompress(
+    &compressed[0],
+    compressed_size,
+    &decompressed[0],
+    data.size() - 1,
+    &e));
+  EXPECT_EQ(EINVAL, e.posix_error);
+}
+
+TEST(TestCompression, DecompressBadOffsetFails) {
+  struct B_Error e;
+
+  // One literal, then a match at offset 2 (before the
+  // start of the output).
+  uint8_t const compressed[] = {0x10, 'x', 0x02, 0x00};
+  uint8_t decompressed[5];
+  EXPECT_FALSE(b_lz_decompress(
+    compressed,
+    sizeof(compressed),
+    decompressed,
+    sizeof(decompressed),
+    &e));
+  EXPECT_EQ(EINVAL, e.posix_error);
+}
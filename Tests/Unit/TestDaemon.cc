@@ -0,0 +1,206 @@
+#include "Util/TemporaryDirectory.h"
+
+#include <B/AnswerContext.h>
+#include <B/AnswerFuture.h>
+#include <B/Daemon.h>
+#include <B/Database.h>
+#include <B/Error.h>
+#include <B/FileQuestion.h>
+#include <B/Main.h>
+#include <B/QuestionAnswer.h>
+#include <B/RunLoop.h>
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <string>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct B_DaemonTestState_ {
+  struct B_Daemon *daemon;
+  size_t dispatch_count;
+};
+
+B_FUNC bool
+b_dispatch_question_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_TRANSFER struct B_AnswerContext *ac,
+    B_OUT struct B_Error *e) {
+  B_DaemonTestState_ *state
+    = static_cast<B_DaemonTestState_ *>(opaque);
+  state->dispatch_count += 1;
+  if (!b_daemon_report_progress(
+      state->daemon, "dispatched", e)) {
+    return false;
+  }
+  return b_answer_context_succeed(ac, e);
+}
+
+B_FUNC bool
+b_count_progress_(
+    B_BORROW void *opaque,
+    B_BORROW char const *message,
+    B_OUT struct B_Error *) {
+  if (std::string(message) == "dispatched") {
+    *static_cast<size_t *>(opaque) += 1;
+  }
+  return true;
+}
+
+bool
+b_write_file_(
+    std::string const &file_path,
+    char const *contents) {
+  FILE *file = fopen(file_path.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  fputs(contents, file);
+  return fclose(file) == 0;
+}
+
+// Asks the daemon about file_path, returning how many
+// times the daemon dispatched a question, or -1 on error.
+int
+b_client_answer_(
+    std::string const &socket_path,
+    std::string const &file_path) {
+  struct B_Error e;
+  size_t progress_count = 0;
+  enum B_AnswerFutureState state;
+  if (!b_daemon_client_answer(
+      socket_path.c_str(),
+      static_cast<struct B_IQuestion const *>(
+        static_cast<void const *>(file_path.c_str())),
+      b_file_question_vtable(),
+      b_count_progress_,
+      &progress_count,
+      &state,
+      &e)) {
+    return -1;
+  }
+  if (state != B_FUTURE_RESOLVED) {
+    return -1;
+  }
+  return static_cast<int>(progress_count);
+}
+
+// Runs in a child process.  Returns an exit code.
+int
+b_run_client_requests_(
+    std::string const &socket_path,
+    std::string const &file_path) {
+  // First request: a.c has never been answered.
+  if (b_client_answer_(socket_path, file_path) != 1) {
+    return 1;
+  }
+  // Second request: the daemon reuses its answer.
+  if (b_client_answer_(socket_path, file_path) != 0) {
+    return 2;
+  }
+  // Third request: a.c changed, so the daemon must forget
+  // its cached answer.
+  if (!b_write_file_(file_path, "int x = 2;\n")) {
+    return 3;
+  }
+  if (b_client_answer_(socket_path, file_path) != 1) {
+    return 4;
+  }
+  return 0;
+}
+
+// Runs in a child process.  Returns an exit code.
+int
+b_run_client_(
+    std::string const &socket_path,
+    std::string const &file_path) {
+  int exit_code
+    = b_run_client_requests_(socket_path, file_path);
+  // Stop the daemon even if a request failed.
+  struct B_Error e;
+  if (!b_daemon_client_stop(socket_path.c_str(), &e)) {
+    return 5;
+  }
+  return exit_code;
+}
+
+}
+
+TEST(TestDaemon, AnswersFromCacheUntilFileChanges) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string file_path = temp_dir.path() + "/a.c";
+  std::string socket_path = temp_dir.path() + "/daemon";
+  ASSERT_TRUE(b_write_file_(file_path, "int x = 1;\n"));
+
+  struct B_Error e;
+  struct B_Database *database;
+  ASSERT_TRUE(b_database_open_sqlite3(
+    (temp_dir.path() + "/b.sqlite3").c_str(),
+    SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+    NULL,
+    &database,
+    &e));
+  struct B_RunLoop *run_loop;
+  ASSERT_TRUE(b_run_loop_allocate_preferred(&run_loop, &e));
+  B_DaemonTestState_ state;
+  state.daemon = NULL;
+  state.dispatch_count = 0;
+  struct B_Main *main;
+  ASSERT_TRUE(b_main_allocate(
+    database,
+    run_loop,
+    b_dispatch_question_,
+    &state,
+    &main,
+    &e));
+  struct B_QuestionVTable const *vtables[] = {
+    b_file_question_vtable(),
+  };
+  ASSERT_TRUE(b_daemon_allocate(
+    database,
+    main,
+    run_loop,
+    vtables,
+    1,
+    socket_path.c_str(),
+    &state.daemon,
+    &e));
+
+  // A second daemon cannot listen on the same socket.
+  struct B_Daemon *other_daemon;
+  EXPECT_FALSE(b_daemon_allocate(
+    database,
+    main,
+    run_loop,
+    vtables,
+    1,
+    socket_path.c_str(),
+    &other_daemon,
+    &e));
+  EXPECT_EQ(EADDRINUSE, e.posix_error);
+
+  pid_t pid = fork();
+  ASSERT_NE(-1, pid);
+  if (pid == 0) {
+    _exit(b_run_client_(socket_path, file_path));
+  }
+  EXPECT_TRUE(b_daemon_serve(state.daemon, &e));
+  int status;
+  ASSERT_EQ(pid, waitpid(pid, &status, 0));
+  ASSERT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(0, WEXITSTATUS(status));
+  EXPECT_EQ(2U, state.dispatch_count);
+
+  EXPECT_TRUE(b_daemon_deallocate(state.daemon, &e));
+  EXPECT_NE(0, access(socket_path.c_str(), F_OK));
+  b_run_loop_deallocate(run_loop);
+  EXPECT_TRUE(b_main_deallocate(main, &e));
+  EXPECT_TRUE(b_database_close(database, &e));
+}
@@ -0,0 +1,1183 @@
+#include "Util/TemporaryDirectory.h"
+
+#include <B/Database.h>
+#include <B/Error.h>
+#include <B/FileQuestion.h>
+#include <B/Private/Database.h>
+#include <B/QuestionAnswer.h>
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+#include <sstream>
+#include <stdio.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static struct B_IQuestion const *
+b_question_from_file_path_(
+    std::string const &file_path) {
+  return static_cast<struct B_IQuestion const *>(
+    static_cast<void const *>(file_path.c_str()));
+}
+
+static void
+b_write_file_(
+    std::string const &file_path,
+    std::string const &contents) {
+  FILE *file = fopen(file_path.c_str(), "wb");
+  ASSERT_TRUE(file);
+  ASSERT_EQ(contents.size(), fwrite(
+    contents.data(), 1, contents.size(), file));
+  ASSERT_EQ(0, fclose(file));
+}
+
+static struct B_Database *
+b_open_database_(
+    std::string const &sqlite_path) {
+  struct B_Database *database;
+  struct B_Error e;
+  if (!b_database_open_sqlite3(
+      sqlite_path.c_str(),
+      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+      NULL,
+      &database,
+      &e)) {
+    return NULL;
+  }
+  return database;
+}
+
+// Records the current answer for the file at file_path.
+static void
+b_record_file_answer_(
+    struct B_Database *database,
+    std::string const &file_path) {
+  struct B_Error e;
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  struct B_IAnswer *answer;
+  ASSERT_TRUE(question_vtable->query_answer(
+    b_question_from_file_path_(file_path), &answer, &e));
+  ASSERT_TRUE(answer);
+  ASSERT_TRUE(b_database_record_answer(
+    database,
+    b_question_from_file_path_(file_path),
+    question_vtable,
+    answer,
+    &e));
+  question_vtable->answer_vtable->deallocate(answer);
+}
+
+// Returns true if the database's answer for the file at
+// file_path matches the file's current answer.
+static bool
+b_database_has_current_answer_(
+    struct B_Database *database,
+    std::string const &file_path) {
+  struct B_Error e;
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  struct B_IAnswer *recorded_answer;
+  if (!b_database_look_up_answer(
+      database,
+      b_question_from_file_path_(file_path),
+      question_vtable,
+      &recorded_answer,
+      &e)) {
+    return false;
+  }
+  if (!recorded_answer) {
+    return false;
+  }
+  struct B_IAnswer *actual_answer;
+  if (!question_vtable->query_answer(
+      b_question_from_file_path_(file_path),
+      &actual_answer,
+      &e)) {
+    question_vtable->answer_vtable->deallocate(
+      recorded_answer);
+    return false;
+  }
+  bool equal = actual_answer
+    && question_vtable->answer_vtable->equal(
+      recorded_answer, actual_answer);
+  question_vtable->answer_vtable->deallocate(
+    recorded_answer);
+  if (actual_answer) {
+    question_vtable->answer_vtable->deallocate(
+      actual_answer);
+  }
+  return equal;
+}
+
+TEST(TestDatabase, ImportAnswersFromExport) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string file_path = temp_dir.path() + "/file";
+  std::string export_path = temp_dir.path() + "/export";
+  b_write_file_(file_path, "hello world");
+
+  struct B_Database *source
+    = b_open_database_(temp_dir.path() + "/source.db");
+  ASSERT_TRUE(source);
+  b_record_file_answer_(source, file_path);
+  ASSERT_TRUE(b_database_export(
+    source, export_path.c_str(), &e));
+  ASSERT_TRUE(b_database_close(source, &e));
+
+  struct B_Database *destination
+    = b_open_database_(temp_dir.path() + "/dest.db");
+  ASSERT_TRUE(destination);
+  EXPECT_FALSE(b_database_has_current_answer_(
+    destination, file_path));
+  ASSERT_TRUE(b_database_import(
+    destination, export_path.c_str(), &e));
+  EXPECT_TRUE(b_database_has_current_answer_(
+    destination, file_path));
+  ASSERT_TRUE(b_database_close(destination, &e));
+}
+
+TEST(TestDatabase, ExportCreatesFileWithUmaskMode) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string export_path = temp_dir.path() + "/export";
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  mode_t old_mask = umask(027);
+  bool exported = b_database_export(
+    database, export_path.c_str(), &e);
+  (void) umask(old_mask);
+  ASSERT_TRUE(exported);
+  ASSERT_TRUE(b_database_close(database, &e));
+
+  struct stat status;
+  ASSERT_EQ(0, stat(export_path.c_str(), &status));
+  EXPECT_EQ(
+    static_cast<mode_t>(0640),
+    status.st_mode & static_cast<mode_t>(0777));
+}
+
+TEST(TestDatabase, ImportKeepsExistingAnswers) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string file_path = temp_dir.path() + "/file";
+  std::string export_path = temp_dir.path() + "/export";
+
+  b_write_file_(file_path, "old");
+  struct B_Database *source
+    = b_open_database_(temp_dir.path() + "/source.db");
+  ASSERT_TRUE(source);
+  b_record_file_answer_(source, file_path);
+  ASSERT_TRUE(b_database_export(
+    source, export_path.c_str(), &e));
+  ASSERT_TRUE(b_database_close(source, &e));
+
+  b_write_file_(file_path, "new");
+  struct B_Database *destination
+    = b_open_database_(temp_dir.path() + "/dest.db");
+  ASSERT_TRUE(destination);
+  b_record_file_answer_(destination, file_path);
+  ASSERT_TRUE(b_database_import(
+    destination, export_path.c_str(), &e));
+  EXPECT_TRUE(b_database_has_current_answer_(
+    destination, file_path));
+  ASSERT_TRUE(b_database_close(destination, &e));
+}
+
+TEST(TestDatabase, ImportCorruptExportFailsWithoutChanges) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string file_path = temp_dir.path() + "/file";
+  std::string export_path = temp_dir.path() + "/export";
+  b_write_file_(file_path, "hello world");
+
+  struct B_Database *source
+    = b_open_database_(temp_dir.path() + "/source.db");
+  ASSERT_TRUE(source);
+  b_record_file_answer_(source, file_path);
+  ASSERT_TRUE(b_database_export(
+    source, export_path.c_str(), &e));
+  ASSERT_TRUE(b_database_close(source, &e));
+
+  // Flip a bit in the last byte of the checksum.
+  {
+    FILE *file = fopen(export_path.c_str(), "r+b");
+    ASSERT_TRUE(file);
+    ASSERT_EQ(0, fseek(file, -1, SEEK_END));
+    int byte = fgetc(file);
+    ASSERT_NE(EOF, byte);
+    ASSERT_EQ(0, fseek(file, -1, SEEK_END));
+    ASSERT_NE(EOF, fputc(byte ^ 1, file));
+    ASSERT_EQ(0, fclose(file));
+  }
+
+  struct B_Database *destination
+    = b_open_database_(temp_dir.path() + "/dest.db");
+  ASSERT_TRUE(destination);
+  ASSERT_FALSE(b_database_import(
+    destination, export_path.c_str(), &e));
+  EXPECT_EQ(EINVAL, e.posix_error);
+  EXPECT_FALSE(b_database_has_current_answer_(
+    destination, file_path));
+  ASSERT_TRUE(b_database_close(destination, &e));
+}
+
+TEST(TestDatabase, ImportTruncatedExportFails) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string export_path = temp_dir.path() + "/export";
+  b_write_file_(export_path, "b-cache\n");
+
+  struct B_Database *destination
+    = b_open_database_(temp_dir.path() + "/dest.db");
+  ASSERT_TRUE(destination);
+  ASSERT_FALSE(b_database_import(
+    destination, export_path.c_str(), &e));
+  EXPECT_EQ(EINVAL, e.posix_error);
+  ASSERT_TRUE(b_database_close(destination, &e));
+}
+
+TEST(TestDatabase, MergeUnionsAnswers) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string file_path_1 = temp_dir.path() + "/file_1";
+  std::string file_path_2 = temp_dir.path() + "/file_2";
+  std::string shard_path_1
+    = temp_dir.path() + "/shard_1.db";
+  std::string shard_path_2
+    = temp_dir.path() + "/shard_2.db";
+  b_write_file_(file_path_1, "hello");
+  b_write_file_(file_path_2, "world");
+
+  struct B_Database *shard_1
+    = b_open_database_(shard_path_1);
+  ASSERT_TRUE(shard_1);
+  b_record_file_answer_(shard_1, file_path_1);
+  ASSERT_TRUE(b_database_close(shard_1, &e));
+
+  struct B_Database *shard_2
+    = b_open_database_(shard_path_2);
+  ASSERT_TRUE(shard_2);
+  b_record_file_answer_(shard_2, file_path_2);
+  ASSERT_TRUE(b_database_close(shard_2, &e));
+
+  struct B_Database *destination
+    = b_open_database_(temp_dir.path() + "/dest.db");
+  ASSERT_TRUE(destination);
+  char const *shard_paths[] = {
+    shard_path_1.c_str(),
+    shard_path_2.c_str(),
+  };
+  ASSERT_TRUE(b_database_merge(
+    destination, shard_paths, 2, &e));
+  EXPECT_TRUE(b_database_has_current_answer_(
+    destination, file_path_1));
+  EXPECT_TRUE(b_database_has_current_answer_(
+    destination, file_path_2));
+  ASSERT_TRUE(b_database_close(destination, &e));
+}
+
+TEST(TestDatabase, MergeKeepsMostRecentAnswer) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string file_path = temp_dir.path() + "/file";
+  std::string old_path = temp_dir.path() + "/old.db";
+  std::string new_path = temp_dir.path() + "/new.db";
+
+  b_write_file_(file_path, "old");
+  struct B_Database *old_shard = b_open_database_(old_path);
+  ASSERT_TRUE(old_shard);
+  b_record_file_answer_(old_shard, file_path);
+  ASSERT_TRUE(b_database_close(old_shard, &e));
+
+  // Ensure answers have different timestamps.
+  ASSERT_EQ(0, usleep(10 * 1000));
+
+  b_write_file_(file_path, "new");
+  struct B_Database *new_shard = b_open_database_(new_path);
+  ASSERT_TRUE(new_shard);
+  b_record_file_answer_(new_shard, file_path);
+  ASSERT_TRUE(b_database_close(new_shard, &e));
+
+  struct B_Database *destination
+    = b_open_database_(temp_dir.path() + "/dest.db");
+  ASSERT_TRUE(destination);
+  char const *shard_paths[] = {
+    new_path.c_str(),
+    old_path.c_str(),
+  };
+  ASSERT_TRUE(b_database_merge(
+    destination, shard_paths, 2, &e));
+  EXPECT_TRUE(b_database_has_current_answer_(
+    destination, file_path));
+  ASSERT_TRUE(b_database_close(destination, &e));
+}
+
+TEST(TestDatabase, MergeNonExistentDatabaseFails) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string shard_path
+    = temp_dir.path() + "/non_existent.db";
+
+  struct B_Database *destination
+    = b_open_database_(temp_dir.path() + "/dest.db");
+  ASSERT_TRUE(destination);
+  char const *shard_paths[] = {shard_path.c_str()};
+  ASSERT_FALSE(b_database_merge(
+    destination, shard_paths, 1, &e));
+  EXPECT_EQ(ENOENT, e.posix_error);
+  ASSERT_TRUE(b_database_close(destination, &e));
+}
+
+TEST(TestDatabase, LookUpCompressedQuestion) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  // Long enough to be compressed.  See NOTE[blob
+  // encoding].
+  std::string file_path
+    = temp_dir.path() + "/" + std::string(250, 'x');
+  b_write_file_(file_path, "hello world");
+
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  b_record_file_answer_(database, file_path);
+  EXPECT_TRUE(b_database_has_current_answer_(
+    database, file_path));
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+TEST(TestDatabase, LookUpAnswerWithImpossibleSizeFails) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string file_path = temp_dir.path() + "/file";
+  std::string sqlite_path = temp_dir.path() + "/b.db";
+  b_write_file_(file_path, "hello world");
+
+  struct B_Database *database
+    = b_open_database_(sqlite_path);
+  ASSERT_TRUE(database);
+  b_record_file_answer_(database, file_path);
+  ASSERT_TRUE(b_database_close(database, &e));
+
+  // Claim that two bytes of compressed answer decompress
+  // to almost 2 GiB.  See NOTE[blob encoding].
+  {
+    sqlite3 *handle;
+    ASSERT_EQ(SQLITE_OK, sqlite3_open(
+      sqlite_path.c_str(), &handle));
+    ASSERT_EQ(SQLITE_OK, sqlite3_exec(
+      handle,
+      "UPDATE answers\n"
+      "  SET answer_data = X'01000000007FFFFFF00000';\n",
+      NULL,
+      NULL,
+      NULL));
+    ASSERT_EQ(SQLITE_OK, sqlite3_close(handle));
+  }
+
+  database = b_open_database_(sqlite_path);
+  ASSERT_TRUE(database);
+  struct B_IAnswer *answer;
+  ASSERT_FALSE(b_database_look_up_answer(
+    database,
+    b_question_from_file_path_(file_path),
+    b_file_question_vtable(),
+    &answer,
+    &e));
+  EXPECT_EQ(EINVAL, e.posix_error);
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+TEST(TestDatabase, OpenMigratesOriginalSchema) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string file_path = temp_dir.path() + "/file";
+  std::string sqlite_path = temp_dir.path() + "/b.db";
+  b_write_file_(file_path, "hello world");
+
+  // Create a database with the original schema, including
+  // duplicate rows.
+  {
+    sqlite3 *handle;
+    ASSERT_EQ(SQLITE_OK, sqlite3_open(
+      sqlite_path.c_str(), &handle));
+    ASSERT_EQ(SQLITE_OK, sqlite3_exec(
+      handle,
+      "CREATE TABLE dependencies(\n"
+      "  from_question_uuid BLOB NOT NULL,\n"
+      "  from_question_data BLOB NOT NULL,\n"
+      "  to_question_uuid BLOB NOT NULL,\n"
+      "  to_question_data BLOB NOT NULL);\n"
+      "CREATE TABLE answers(\n"
+      "  question_uuid BLOB NOT NULL,\n"
+      "  question_data BLOB NOT NULL,\n"
+      "  answer_data BLOB NOT NULL);\n"
+      "INSERT INTO dependencies VALUES\n"
+      "  (X'00', X'01', X'02', X'03');\n"
+      "INSERT INTO dependencies VALUES\n"
+      "  (X'00', X'01', X'02', X'03');\n"
+      "INSERT INTO answers VALUES (X'00', X'01', X'02');\n"
+      "INSERT INTO answers VALUES (X'00', X'01', X'03');\n",
+      NULL,
+      NULL,
+      NULL));
+    ASSERT_EQ(SQLITE_OK, sqlite3_close(handle));
+  }
+
+  struct B_Database *database
+    = b_open_database_(sqlite_path);
+  ASSERT_TRUE(database);
+  b_record_file_answer_(database, file_path);
+  EXPECT_TRUE(b_database_has_current_answer_(
+    database, file_path));
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+TEST(TestDatabase, SummarizeExecutionsOfUnexecutedQuestion) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string file_path = temp_dir.path() + "/file";
+
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  struct B_ExecutionSummary summary;
+  ASSERT_TRUE(b_database_summarize_executions(
+    database,
+    b_question_from_file_path_(file_path),
+    b_file_question_vtable(),
+    &summary,
+    &e));
+  EXPECT_EQ(0, summary.execution_count);
+  EXPECT_EQ(0, summary.max_wall_time_us);
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+TEST(TestDatabase, SummarizeExecutionsKeepsRecentHistory) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string file_path = temp_dir.path() + "/file";
+  std::string other_file_path
+    = temp_dir.path() + "/other_file";
+
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  // Record executions taking 1, 2, ..., N microseconds.
+  // Every fourth execution fails.
+  int64_t const history_size = B_EXECUTION_HISTORY_SIZE;
+  int64_t const count = history_size + 4;
+  for (int64_t i = 1; i <= count; ++i) {
+    struct B_ExecutionRecord record;
+    record.started_at_ms = 1000 + i;
+    record.wall_time_us = i;
+    record.cpu_time_us = i * 2;
+    record.peak_rss_bytes = i * 100;
+    record.exit_status = i % 4 == 0 ? 1 : 0;
+    record.bytes_read = 10;
+    record.bytes_written = 20;
+    ASSERT_TRUE(b_database_record_execution(
+      database,
+      b_question_from_file_path_(file_path),
+      b_file_question_vtable(),
+      &record,
+      &e));
+  }
+  struct B_ExecutionRecord other_record;
+  other_record.started_at_ms = 5000;
+  other_record.wall_time_us = 1000000;
+  other_record.cpu_time_us = 0;
+  other_record.peak_rss_bytes = 0;
+  other_record.exit_status = 0;
+  other_record.bytes_read = 0;
+  other_record.bytes_written = 0;
+  ASSERT_TRUE(b_database_record_execution(
+    database,
+    b_question_from_file_path_(other_file_path),
+    b_file_question_vtable(),
+    &other_record,
+    &e));
+
+  struct B_ExecutionSummary summary;
+  ASSERT_TRUE(b_database_summarize_executions(
+    database,
+    b_question_from_file_path_(file_path),
+    b_file_question_vtable(),
+    &summary,
+    &e));
+  // Only executions 5 through 20 are remembered.
+  int64_t const first = count - history_size + 1;
+  EXPECT_EQ(history_size, summary.execution_count);
+  EXPECT_EQ(4, summary.failure_count);
+  // Times exclude the failed executions 8, 12, 16, and 20.
+  EXPECT_EQ(12, summary.mean_wall_time_us);
+  EXPECT_EQ(count - 1, summary.max_wall_time_us);
+  EXPECT_EQ(24, summary.mean_cpu_time_us);
+  EXPECT_EQ(count * 100, summary.max_peak_rss_bytes);
+  EXPECT_EQ(10, summary.mean_bytes_read);
+  EXPECT_EQ(20, summary.mean_bytes_written);
+  EXPECT_EQ(1000 + count, summary.last_started_at_ms);
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+struct B_LoggedInvalidation_ {
+  std::string question;
+  std::string cause;
+  std::string parent;
+  size_t depth;
+};
+
+static bool
+b_log_invalidation_(
+    void *opaque,
+    struct B_Invalidation const *invalidation,
+    struct B_Error *) {
+  std::vector<B_LoggedInvalidation_> *log
+    = static_cast<std::vector<B_LoggedInvalidation_> *>(
+      opaque);
+  B_LoggedInvalidation_ logged;
+  logged.question = static_cast<char const *>(
+    static_cast<void const *>(invalidation->question));
+  logged.cause = static_cast<char const *>(
+    static_cast<void const *>(invalidation->cause));
+  logged.parent = invalidation->parent
+    ? static_cast<char const *>(
+      static_cast<void const *>(invalidation->parent))
+    : "";
+  logged.depth = invalidation->depth;
+  log->push_back(logged);
+  return true;
+}
+
+TEST(TestDatabase, CheckAllLogsInvalidationCauses) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string leaf_path = temp_dir.path() + "/leaf";
+  std::string middle_path = temp_dir.path() + "/middle";
+  std::string root_path = temp_dir.path() + "/root";
+  std::string other_path = temp_dir.path() + "/other";
+  b_write_file_(leaf_path, "leaf");
+  b_write_file_(middle_path, "middle");
+  b_write_file_(root_path, "root");
+  b_write_file_(other_path, "other");
+
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  b_record_file_answer_(database, leaf_path);
+  b_record_file_answer_(database, middle_path);
+  b_record_file_answer_(database, root_path);
+  b_record_file_answer_(database, other_path);
+  // root depends on middle, which depends on leaf.
+  ASSERT_TRUE(b_database_record_dependency(
+    database,
+    b_question_from_file_path_(middle_path),
+    question_vtable,
+    b_question_from_file_path_(leaf_path),
+    question_vtable,
+    &e));
+  ASSERT_TRUE(b_database_record_dependency(
+    database,
+    b_question_from_file_path_(root_path),
+    question_vtable,
+    b_question_from_file_path_(middle_path),
+    question_vtable,
+    &e));
+
+  b_write_file_(leaf_path, "leaf changed");
+  ASSERT_TRUE(b_database_check_all(
+    database, &question_vtable, 1, &e));
+  EXPECT_TRUE(b_database_has_current_answer_(
+    database, other_path));
+
+  std::vector<B_LoggedInvalidation_> log;
+  ASSERT_TRUE(b_database_invalidations(
+    database,
+    &question_vtable,
+    1,
+    b_log_invalidation_,
+    &log,
+    &e));
+  ASSERT_EQ(3U, log.size());
+  EXPECT_EQ(leaf_path, log[0].question);
+  EXPECT_EQ(leaf_path, log[0].cause);
+  EXPECT_EQ("", log[0].parent);
+  EXPECT_EQ(0U, log[0].depth);
+  EXPECT_EQ(middle_path, log[1].question);
+  EXPECT_EQ(leaf_path, log[1].cause);
+  EXPECT_EQ(leaf_path, log[1].parent);
+  EXPECT_EQ(1U, log[1].depth);
+  EXPECT_EQ(root_path, log[2].question);
+  EXPECT_EQ(leaf_path, log[2].cause);
+  EXPECT_EQ(middle_path, log[2].parent);
+  EXPECT_EQ(2U, log[2].depth);
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+TEST(TestDatabase, CheckAllLogsEachDiamondQuestionOnce) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  // A chain of diamonds: top_{i+1} depends on left_i and
+  // right_i, which both depend on top_i.  There are 2^N
+  // paths from top_0 to top_N.
+  size_t const diamond_count = 40;
+  std::vector<std::string> tops;
+  for (size_t i = 0; i <= diamond_count; ++i) {
+    std::ostringstream top;
+    top << temp_dir.path() << "/top" << i;
+    tops.push_back(top.str());
+    b_write_file_(tops[i], "top");
+    b_record_file_answer_(database, tops[i]);
+    if (i == 0) {
+      continue;
+    }
+    char const *const sides[] = {"/left", "/right"};
+    for (size_t j = 0; j < 2; ++j) {
+      std::ostringstream side;
+      side << temp_dir.path() << sides[j] << i;
+      b_write_file_(side.str(), "side");
+      b_record_file_answer_(database, side.str());
+      ASSERT_TRUE(b_database_record_dependency(
+        database,
+        b_question_from_file_path_(tops[i]),
+        question_vtable,
+        b_question_from_file_path_(side.str()),
+        question_vtable,
+        &e));
+      ASSERT_TRUE(b_database_record_dependency(
+        database,
+        b_question_from_file_path_(side.str()),
+        question_vtable,
+        b_question_from_file_path_(tops[i - 1]),
+        question_vtable,
+        &e));
+    }
+  }
+
+  b_write_file_(tops[0], "top changed");
+  ASSERT_TRUE(b_database_check_all(
+    database, &question_vtable, 1, &e));
+
+  std::vector<B_LoggedInvalidation_> log;
+  ASSERT_TRUE(b_database_invalidations(
+    database,
+    &question_vtable,
+    1,
+    b_log_invalidation_,
+    &log,
+    &e));
+  ASSERT_EQ(1 + 3 * diamond_count, log.size());
+  B_LoggedInvalidation_ const &last = log.back();
+  EXPECT_EQ(tops[diamond_count], last.question);
+  EXPECT_EQ(tops[0], last.cause);
+  EXPECT_EQ(2 * diamond_count, last.depth);
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+TEST(TestDatabase, CheckChangedOnlyRechecksGivenQuestions) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string leaf_path = temp_dir.path() + "/leaf";
+  std::string root_path = temp_dir.path() + "/root";
+  std::string other_path = temp_dir.path() + "/other";
+  b_write_file_(leaf_path, "leaf");
+  b_write_file_(root_path, "root");
+  b_write_file_(other_path, "other");
+
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  b_record_file_answer_(database, leaf_path);
+  b_record_file_answer_(database, root_path);
+  b_record_file_answer_(database, other_path);
+  ASSERT_TRUE(b_database_record_dependency(
+    database,
+    b_question_from_file_path_(root_path),
+    question_vtable,
+    b_question_from_file_path_(leaf_path),
+    question_vtable,
+    &e));
+
+  b_write_file_(leaf_path, "leaf changed");
+  b_write_file_(other_path, "other changed");
+  struct B_IQuestion const *checked
+    = b_question_from_file_path_(leaf_path);
+  ASSERT_TRUE(b_database_check_changed(
+    database,
+    &checked,
+    &question_vtable,
+    1,
+    &question_vtable,
+    1,
+    &e));
+  EXPECT_FALSE(b_database_has_current_answer_(
+    database, leaf_path));
+  EXPECT_FALSE(b_database_has_current_answer_(
+    database, root_path));
+  // other changed, but was not checked, so its stale
+  // answer remains.
+  struct B_IAnswer *other_answer;
+  ASSERT_TRUE(b_database_look_up_answer(
+    database,
+    b_question_from_file_path_(other_path),
+    question_vtable,
+    &other_answer,
+    &e));
+  EXPECT_TRUE(other_answer);
+  if (other_answer) {
+    question_vtable->answer_vtable->deallocate(
+      other_answer);
+  }
+
+  std::vector<B_LoggedInvalidation_> log;
+  ASSERT_TRUE(b_database_invalidations(
+    database,
+    &question_vtable,
+    1,
+    b_log_invalidation_,
+    &log,
+    &e));
+  ASSERT_EQ(2U, log.size());
+  EXPECT_EQ(leaf_path, log[0].question);
+  EXPECT_EQ(root_path, log[1].question);
+  EXPECT_EQ(leaf_path, log[1].cause);
+
+  // Checking nothing clears the log.
+  ASSERT_TRUE(b_database_check_changed(
+    database, NULL, NULL, 0, &question_vtable, 1, &e));
+  log.clear();
+  ASSERT_TRUE(b_database_invalidations(
+    database,
+    &question_vtable,
+    1,
+    b_log_invalidation_,
+    &log,
+    &e));
+  EXPECT_EQ(0U, log.size());
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+static bool
+b_log_dependency_(
+    void *opaque,
+    struct B_IQuestion const *question,
+    struct B_QuestionVTable const *,
+    struct B_Error *) {
+  std::vector<std::string> *log
+    = static_cast<std::vector<std::string> *>(opaque);
+  log->push_back(static_cast<char const *>(
+    static_cast<void const *>(question)));
+  return true;
+}
+
+static bool
+b_log_question_path_(
+    void *opaque,
+    struct B_IQuestion const *question,
+    struct B_QuestionVTable const *,
+    struct B_Error *) {
+  std::vector<std::string> *log
+    = static_cast<std::vector<std::string> *>(opaque);
+  log->push_back(static_cast<char const *>(
+    static_cast<void const *>(question)));
+  return true;
+}
+
+TEST(TestDatabase, AnsweredQuestionsSinceMarkSkipsOlder) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string old_path = temp_dir.path() + "/old";
+  std::string new_path = temp_dir.path() + "/new";
+  b_write_file_(old_path, "old");
+  b_write_file_(new_path, "new");
+
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  int64_t empty_mark;
+  ASSERT_TRUE(b_database_answers_mark(
+    database, &empty_mark, &e));
+  EXPECT_EQ(0, empty_mark);
+  b_record_file_answer_(database, old_path);
+  int64_t mark;
+  ASSERT_TRUE(b_database_answers_mark(database, &mark, &e));
+  b_record_file_answer_(database, new_path);
+
+  std::vector<std::string> log;
+  ASSERT_TRUE(b_database_answered_questions_since(
+    database,
+    mark,
+    &question_vtable,
+    1,
+    b_log_question_path_,
+    &log,
+    &e));
+  ASSERT_EQ(1U, log.size());
+  EXPECT_EQ(new_path, log[0]);
+
+  log.clear();
+  ASSERT_TRUE(b_database_answered_questions_since(
+    database,
+    empty_mark,
+    &question_vtable,
+    1,
+    b_log_question_path_,
+    &log,
+    &e));
+  EXPECT_EQ(2U, log.size());
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+TEST(TestDatabase, RecordedDependenciesInRecordedOrder) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  char const *const paths[] = {"b.c", "a.c", "c.c"};
+  for (size_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(b_database_record_dependency(
+      database,
+      b_question_from_file_path_("main"),
+      question_vtable,
+      b_question_from_file_path_(paths[i]),
+      question_vtable,
+      &e));
+  }
+  ASSERT_TRUE(b_database_record_dependency(
+    database,
+    b_question_from_file_path_("other"),
+    question_vtable,
+    b_question_from_file_path_("d.c"),
+    question_vtable,
+    &e));
+
+  std::vector<std::string> log;
+  ASSERT_TRUE(b_database_recorded_dependencies(
+    database,
+    b_question_from_file_path_("main"),
+    question_vtable,
+    &question_vtable,
+    1,
+    b_log_dependency_,
+    &log,
+    &e));
+  ASSERT_EQ(3U, log.size());
+  EXPECT_EQ("b.c", log[0]);
+  EXPECT_EQ("a.c", log[1]);
+  EXPECT_EQ("c.c", log[2]);
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+TEST(TestDatabase, ImportDependenciesFromExport) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  std::string main_path = temp_dir.path() + "/main";
+  std::string export_path = temp_dir.path() + "/export";
+  b_write_file_(main_path, "main");
+  // Long enough to be compressed.  See NOTE[blob
+  // encoding].
+  std::string long_path = temp_dir.path() + "/"
+    + std::string(300, 'x');
+  char const *const paths[] = {"b.c", "a.c"};
+
+  struct B_Database *source
+    = b_open_database_(temp_dir.path() + "/source.db");
+  ASSERT_TRUE(source);
+  b_record_file_answer_(source, main_path);
+  for (size_t i = 0; i < 2; ++i) {
+    ASSERT_TRUE(b_database_record_dependency(
+      source,
+      b_question_from_file_path_(main_path),
+      question_vtable,
+      b_question_from_file_path_(paths[i]),
+      question_vtable,
+      &e));
+  }
+  ASSERT_TRUE(b_database_record_dependency(
+    source,
+    b_question_from_file_path_(main_path),
+    question_vtable,
+    b_question_from_file_path_(long_path),
+    question_vtable,
+    &e));
+  ASSERT_TRUE(b_database_export(
+    source, export_path.c_str(), &e));
+  ASSERT_TRUE(b_database_close(source, &e));
+
+  struct B_Database *destination
+    = b_open_database_(temp_dir.path() + "/dest.db");
+  ASSERT_TRUE(destination);
+  ASSERT_TRUE(b_database_import(
+    destination, export_path.c_str(), &e));
+  EXPECT_TRUE(b_database_has_current_answer_(
+    destination, main_path));
+  std::vector<std::string> log;
+  ASSERT_TRUE(b_database_recorded_dependencies(
+    destination,
+    b_question_from_file_path_(main_path),
+    question_vtable,
+    &question_vtable,
+    1,
+    b_log_dependency_,
+    &log,
+    &e));
+  ASSERT_EQ(3U, log.size());
+  EXPECT_EQ("b.c", log[0]);
+  EXPECT_EQ("a.c", log[1]);
+  EXPECT_EQ(long_path, log[2]);
+  ASSERT_TRUE(b_database_close(destination, &e));
+}
+
+TEST(TestDatabase, ImportHugeTruncatedFieldFails) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string export_path = temp_dir.path() + "/export";
+  // An answer record whose question UUID is followed by a
+  // data field claiming to be almost 2 GiB, but which ends
+  // immediately.
+  std::string contents("b-cache\n", 8);
+  contents += std::string("\0\0\0\3", 4);
+  contents += '\1';
+  contents += std::string(16, 'u');
+  contents += std::string("\0\0\0\0\x7f\xff\xff\xf0", 8);
+  b_write_file_(export_path, contents);
+
+  struct B_Database *destination
+    = b_open_database_(temp_dir.path() + "/dest.db");
+  ASSERT_TRUE(destination);
+  ASSERT_FALSE(b_database_import(
+    destination, export_path.c_str(), &e));
+  EXPECT_EQ(EINVAL, e.posix_error);
+  ASSERT_TRUE(b_database_close(destination, &e));
+}
+
+struct B_LoggedPlanEntry_ {
+  std::string question;
+  bool will_execute;
+  int64_t execution_count;
+  int64_t mean_wall_time_us;
+};
+
+static bool
+b_log_plan_entry_(
+    void *opaque,
+    struct B_PlanEntry const *entry,
+    struct B_Error *) {
+  std::vector<B_LoggedPlanEntry_> *log
+    = static_cast<std::vector<B_LoggedPlanEntry_> *>(
+      opaque);
+  B_LoggedPlanEntry_ logged;
+  logged.question = static_cast<char const *>(
+    static_cast<void const *>(entry->question));
+  logged.will_execute = entry->will_execute;
+  logged.execution_count = entry->execution_count;
+  logged.mean_wall_time_us = entry->mean_wall_time_us;
+  log->push_back(logged);
+  return true;
+}
+
+TEST(TestDatabase, PlanSkipsDependenciesOfReusedAnswers) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  std::string root_path = temp_dir.path() + "/main";
+  std::string stale_path = temp_dir.path() + "/a.c";
+  std::string reused_path = temp_dir.path() + "/b.c";
+  std::string header_path = temp_dir.path() + "/a.h";
+  std::string hidden_path = temp_dir.path() + "/b.h";
+  std::string const edges[][2] = {
+    {root_path, stale_path},
+    {root_path, reused_path},
+    {stale_path, header_path},
+    {reused_path, hidden_path},
+    // Cycles must not loop forever.
+    {header_path, root_path},
+  };
+  for (size_t i = 0; i < sizeof(edges) / sizeof(*edges);
+      ++i) {
+    ASSERT_TRUE(b_database_record_dependency(
+      database,
+      b_question_from_file_path_(edges[i][0]),
+      question_vtable,
+      b_question_from_file_path_(edges[i][1]),
+      question_vtable,
+      &e));
+  }
+  b_write_file_(reused_path, "int b;");
+  b_record_file_answer_(database, reused_path);
+  struct B_ExecutionRecord record;
+  record.started_at_ms = 1000;
+  record.wall_time_us = 250;
+  record.cpu_time_us = 0;
+  record.peak_rss_bytes = 0;
+  record.exit_status = 0;
+  record.bytes_read = 0;
+  record.bytes_written = 0;
+  ASSERT_TRUE(b_database_record_execution(
+    database,
+    b_question_from_file_path_(root_path),
+    question_vtable,
+    &record,
+    &e));
+
+  std::vector<B_LoggedPlanEntry_> log;
+  struct B_IQuestion const *root
+    = b_question_from_file_path_(root_path);
+  ASSERT_TRUE(b_database_plan(
+    database,
+    &root,
+    &question_vtable,
+    1,
+    &question_vtable,
+    1,
+    b_log_plan_entry_,
+    &log,
+    &e));
+  ASSERT_EQ(4U, log.size());
+  EXPECT_EQ(root_path, log[0].question);
+  EXPECT_TRUE(log[0].will_execute);
+  EXPECT_EQ(1, log[0].execution_count);
+  EXPECT_EQ(250, log[0].mean_wall_time_us);
+  for (size_t i = 1; i < log.size(); ++i) {
+    EXPECT_NE(hidden_path, log[i].question);
+    EXPECT_EQ(
+      log[i].question != reused_path,
+      log[i].will_execute) << log[i].question;
+    EXPECT_EQ(0, log[i].execution_count);
+  }
+  ASSERT_TRUE(b_database_close(database, &e));
+}
+
+TEST(TestDatabase, BatchedDependenciesAndLookUps) {
+  struct B_Error e;
+
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string a_path = temp_dir.path() + "/a";
+  std::string b_path = temp_dir.path() + "/b";
+  std::string root_path = temp_dir.path() + "/root";
+  b_write_file_(a_path, "a");
+  b_write_file_(b_path, "b");
+  b_write_file_(root_path, "root");
+
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  struct B_Database *database
+    = b_open_database_(temp_dir.path() + "/b.db");
+  ASSERT_TRUE(database);
+  b_record_file_answer_(database, a_path);
+  b_record_file_answer_(database, b_path);
+  b_record_file_answer_(database, root_path);
+  struct B_IQuestion const *dependencies[] = {
+    b_question_from_file_path_(a_path),
+    b_question_from_file_path_(b_path),
+  };
+  struct B_QuestionVTable const *dependency_vtables[] = {
+    question_vtable,
+    question_vtable,
+  };
+  ASSERT_TRUE(b_database_record_dependencies(
+    database,
+    b_question_from_file_path_(root_path),
+    question_vtable,
+    dependencies,
+    dependency_vtables,
+    2,
+    &e));
+
+  b_write_file_(b_path, "b changed");
+  ASSERT_TRUE(b_database_check_all(
+    database, &question_vtable, 1, &e));
+
+  struct B_IQuestion const *questions[] = {
+    b_question_from_file_path_(a_path),
+    b_question_from_file_path_(root_path),
+    b_question_from_file_path_(b_path),
+  };
+  struct B_QuestionVTable const *vtables[] = {
+    question_vtable,
+    question_vtable,
+    question_vtable,
+  };
+  struct B_IAnswer *answers[3];
+  ASSERT_TRUE(b_database_look_up_answers(
+    database, questions, vtables, 3, answers, &e));
+  EXPECT_TRUE(answers[0]);
+  // root depended upon b, so its answer was deleted.
+  EXPECT_FALSE(answers[1]);
+  EXPECT_FALSE(answers[2]);
+  for (size_t i = 0; i < 3; ++i) {
+    if (answers[i]) {
+      question_vtable->answer_vtable->deallocate(
+        answers[i]);
+    }
+  }
+  ASSERT_TRUE(b_database_close(database, &e));
+}
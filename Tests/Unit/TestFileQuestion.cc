@@ -167,3 +167,61 @@ TEST(TestFile, AnswerFileWithOneOfEveryByte) {
 
   question_vtable->answer_vtable->deallocate(answer);
 }
+
+TEST(TestFile, RetainReplicatesFileQuestions) {
+  struct B_Error e;
+  struct B_QuestionVTable const *question_vtable
+    = b_file_question_vtable();
+  std::string file_path = "/some/file";
+  struct B_IQuestion *retained;
+  ASSERT_TRUE(b_question_retain(
+    b_question_from_file_path_(file_path),
+    question_vtable,
+    &retained,
+    &e));
+  // File questions are not reference counted.
+  EXPECT_NE(
+    b_question_from_file_path_(file_path), retained);
+  char const *retained_path;
+  ASSERT_TRUE(b_file_question_path(
+    retained, &retained_path, &e));
+  EXPECT_EQ(file_path, retained_path);
+  b_question_release(retained, question_vtable);
+}
+
+static int
+b_reference_count_;
+
+static B_FUNC struct B_IQuestion *
+b_counting_retain_(
+    struct B_IQuestion const *question) {
+  b_reference_count_ += 1;
+  return const_cast<struct B_IQuestion *>(question);
+}
+
+static B_FUNC void
+b_counting_release_(
+    struct B_IQuestion *) {
+  b_reference_count_ -= 1;
+}
+
+TEST(TestFile, RetainSharesReferenceCountedQuestions) {
+  struct B_Error e;
+  struct B_QuestionVTable question_vtable
+    = *b_file_question_vtable();
+  question_vtable.retain = b_counting_retain_;
+  question_vtable.release = b_counting_release_;
+  std::string file_path = "/some/file";
+  b_reference_count_ = 1;
+  struct B_IQuestion *retained;
+  ASSERT_TRUE(b_question_retain(
+    b_question_from_file_path_(file_path),
+    &question_vtable,
+    &retained,
+    &e));
+  EXPECT_EQ(
+    b_question_from_file_path_(file_path), retained);
+  EXPECT_EQ(2, b_reference_count_);
+  b_question_release(retained, &question_vtable);
+  EXPECT_EQ(1, b_reference_count_);
+}
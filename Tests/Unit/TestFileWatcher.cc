@@ -0,0 +1,143 @@
+#include "Util/TemporaryDirectory.h"
+
+#include <B/Error.h>
+#include <B/FileWatcher.h>
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+B_FUNC bool
+b_collect_path_(
+    B_BORROW void *opaque,
+    B_BORROW char const *file_path,
+    B_OUT struct B_Error *) {
+  static_cast<std::vector<std::string> *>(opaque)
+    ->push_back(file_path);
+  return true;
+}
+
+bool
+b_write_file_(
+    std::string const &file_path,
+    char const *contents) {
+  FILE *file = fopen(file_path.c_str(), "wb");
+  if (!file) {
+    return false;
+  }
+  fputs(contents, file);
+  return fclose(file) == 0;
+}
+
+std::vector<std::string>
+b_take_changes_(
+    struct B_FileWatcher *watcher) {
+  std::vector<std::string> paths;
+  struct B_Error e;
+  bool overflowed;
+  EXPECT_TRUE(b_file_watcher_take_changes(
+    watcher, b_collect_path_, &paths, &overflowed, &e));
+  EXPECT_FALSE(overflowed);
+  return paths;
+}
+
+}
+
+TEST(TestFileWatcher, ReportsChangedWatchedFiles) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string watched_path = temp_dir.path() + "/a.c";
+  std::string unwatched_path = temp_dir.path() + "/b.c";
+  ASSERT_TRUE(b_write_file_(watched_path, "int a;\n"));
+  ASSERT_TRUE(b_write_file_(unwatched_path, "int b;\n"));
+
+  struct B_Error e;
+  struct B_FileWatcher *watcher;
+  if (!b_file_watcher_allocate(&watcher, &e)) {
+    // No file notification API on this system.
+    ASSERT_EQ(ENOTSUP, e.posix_error);
+    return;
+  }
+  bool added;
+  ASSERT_TRUE(b_file_watcher_watch(
+    watcher, watched_path.c_str(), &added, &e));
+  EXPECT_TRUE(added);
+  ASSERT_TRUE(b_file_watcher_watch(
+    watcher, watched_path.c_str(), &added, &e));
+  EXPECT_FALSE(added);
+  EXPECT_TRUE(b_take_changes_(watcher).empty());
+
+  // Each change is reported once, and changes to
+  // unwatched files are not reported.
+  ASSERT_TRUE(b_write_file_(watched_path, "int a = 1;\n"));
+  ASSERT_TRUE(
+    b_write_file_(unwatched_path, "int b = 1;\n"));
+  std::vector<std::string> changes
+    = b_take_changes_(watcher);
+  ASSERT_EQ(1U, changes.size());
+  EXPECT_EQ(watched_path, changes[0]);
+  EXPECT_TRUE(b_take_changes_(watcher).empty());
+
+  // Replacing the file, as many editors do, is a change.
+  std::string temp_path = temp_dir.path() + "/a.c.tmp";
+  ASSERT_TRUE(b_write_file_(temp_path, "int a = 2;\n"));
+  ASSERT_EQ(
+    0, rename(temp_path.c_str(), watched_path.c_str()));
+  changes = b_take_changes_(watcher);
+  ASSERT_EQ(1U, changes.size());
+  EXPECT_EQ(watched_path, changes[0]);
+
+  b_file_watcher_deallocate(watcher);
+}
+
+TEST(TestFileWatcher, ReportsFilesInRecreatedDirectory) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string directory_path = temp_dir.path() + "/src";
+  std::string file_path = directory_path + "/a.c";
+  ASSERT_EQ(0, mkdir(directory_path.c_str(), 0755));
+  ASSERT_TRUE(b_write_file_(file_path, "int a;\n"));
+
+  struct B_Error e;
+  struct B_FileWatcher *watcher;
+  if (!b_file_watcher_allocate(&watcher, &e)) {
+    // No file notification API on this system.
+    ASSERT_EQ(ENOTSUP, e.posix_error);
+    return;
+  }
+  bool added;
+  ASSERT_TRUE(b_file_watcher_watch(
+    watcher, file_path.c_str(), &added, &e));
+  EXPECT_TRUE(b_take_changes_(watcher).empty());
+
+  ASSERT_EQ(0, unlink(file_path.c_str()));
+  ASSERT_EQ(0, rmdir(directory_path.c_str()));
+  std::vector<std::string> changes
+    = b_take_changes_(watcher);
+  ASSERT_EQ(1U, changes.size());
+  EXPECT_EQ(file_path, changes[0]);
+
+  // The file was recreated while its directory was not
+  // watched, so it is reported even though the directory
+  // is watched again.
+  ASSERT_EQ(0, mkdir(directory_path.c_str(), 0755));
+  ASSERT_TRUE(b_write_file_(file_path, "int a = 1;\n"));
+  changes = b_take_changes_(watcher);
+  ASSERT_EQ(1U, changes.size());
+  EXPECT_EQ(file_path, changes[0]);
+  EXPECT_TRUE(b_take_changes_(watcher).empty());
+
+  // Changes are reported through the new watch.
+  ASSERT_TRUE(b_write_file_(file_path, "int a = 2;\n"));
+  changes = b_take_changes_(watcher);
+  ASSERT_EQ(1U, changes.size());
+  EXPECT_EQ(file_path, changes[0]);
+
+  b_file_watcher_deallocate(watcher);
+}
@@ -0,0 +1,140 @@
+#include <B/Error.h>
+#include <B/Jobserver.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+// Restores MAKEFLAGS when destroyed.
+class B_MakeflagsSaver_ {
+ public:
+  B_MakeflagsSaver_() {
+    char const *makeflags = getenv("MAKEFLAGS");
+    this->was_set_ = makeflags != NULL;
+    if (makeflags) {
+      this->makeflags_ = makeflags;
+    }
+  }
+
+  ~B_MakeflagsSaver_() {
+    if (this->was_set_) {
+      setenv("MAKEFLAGS", this->makeflags_.c_str(), 1);
+    } else {
+      unsetenv("MAKEFLAGS");
+    }
+  }
+
+ private:
+  bool was_set_;
+  std::string makeflags_;
+};
+
+bool
+b_acquire_(
+    struct B_Jobserver *jobserver) {
+  struct B_Error e;
+  bool acquired;
+  EXPECT_TRUE(b_jobserver_try_acquire(
+    jobserver, &acquired, &e));
+  return acquired;
+}
+
+}
+
+TEST(TestJobserver, ServerHandsOutOneTokenPerExtraSlot) {
+  B_MakeflagsSaver_ saver;
+  struct B_Error e;
+  struct B_Jobserver *jobserver;
+  ASSERT_TRUE(b_jobserver_allocate_server(
+    3, &jobserver, &e));
+
+  EXPECT_TRUE(b_acquire_(jobserver));
+  EXPECT_TRUE(b_acquire_(jobserver));
+  EXPECT_FALSE(b_acquire_(jobserver));
+  EXPECT_EQ(2U, b_jobserver_held_count(jobserver));
+
+  ASSERT_TRUE(b_jobserver_release(jobserver, &e));
+  EXPECT_TRUE(b_acquire_(jobserver));
+
+  EXPECT_TRUE(b_jobserver_deallocate(jobserver, &e));
+}
+
+TEST(TestJobserver, ClientSharesServerTokens) {
+  B_MakeflagsSaver_ saver;
+  struct B_Error e;
+  ASSERT_EQ(0, setenv("MAKEFLAGS", "k", 1));
+  struct B_Jobserver *server;
+  ASSERT_TRUE(b_jobserver_allocate_server(2, &server, &e));
+  char const *makeflags = getenv("MAKEFLAGS");
+  ASSERT_TRUE(makeflags);
+  EXPECT_EQ(0, strncmp("k -j2 ", makeflags, 6))
+    << makeflags;
+
+  struct B_Jobserver *client;
+  ASSERT_TRUE(b_jobserver_allocate_from_environment(
+    &client, &e));
+  EXPECT_TRUE(b_acquire_(client));
+  EXPECT_FALSE(b_acquire_(server));
+  ASSERT_TRUE(b_jobserver_release(client, &e));
+  EXPECT_TRUE(b_acquire_(server));
+
+  EXPECT_TRUE(b_jobserver_deallocate(client, &e));
+  EXPECT_TRUE(b_jobserver_deallocate(server, &e));
+  makeflags = getenv("MAKEFLAGS");
+  ASSERT_TRUE(makeflags);
+  EXPECT_STREQ("k", makeflags);
+}
+
+TEST(TestJobserver, MissingJobserverIsReported) {
+  B_MakeflagsSaver_ saver;
+  struct B_Error e;
+  struct B_Jobserver *jobserver;
+
+  ASSERT_EQ(0, setenv("MAKEFLAGS", "ks -j4", 1));
+  EXPECT_FALSE(b_jobserver_allocate_from_environment(
+    &jobserver, &e));
+  EXPECT_EQ(ENOENT, e.posix_error);
+
+  ASSERT_EQ(0, setenv(
+    "MAKEFLAGS", "-j4 --jobserver-auth=x,y", 1));
+  EXPECT_FALSE(b_jobserver_allocate_from_environment(
+    &jobserver, &e));
+  EXPECT_EQ(EINVAL, e.posix_error);
+}
+
+TEST(TestJobserver, ClientLeavesInheritedPipeBlocking) {
+  B_MakeflagsSaver_ saver;
+  struct B_Error e;
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  ASSERT_EQ(1, write(fds[1], "+", 1));
+  char makeflags[64];
+  snprintf(
+    makeflags,
+    sizeof(makeflags),
+    "-j2 --jobserver-auth=%d,%d",
+    fds[0],
+    fds[1]);
+  ASSERT_EQ(0, setenv("MAKEFLAGS", makeflags, 1));
+
+  struct B_Jobserver *client;
+  ASSERT_TRUE(b_jobserver_allocate_from_environment(
+    &client, &e));
+  EXPECT_TRUE(b_acquire_(client));
+  // The pipe is empty, but acquiring does not block.
+  EXPECT_FALSE(b_acquire_(client));
+  // make and its other children share the pipe's flags.
+  EXPECT_EQ(0, fcntl(fds[0], F_GETFL) & O_NONBLOCK);
+  ASSERT_TRUE(b_jobserver_release(client, &e));
+
+  EXPECT_TRUE(b_jobserver_deallocate(client, &e));
+  EXPECT_EQ(0, close(fds[0]));
+  EXPECT_EQ(0, close(fds[1]));
+}
@@ -0,0 +1,945 @@
+#include "Util/TemporaryDirectory.h"
+
+#include <B/AnswerContext.h>
+#include <B/AnswerFuture.h>
+#include <B/Database.h>
+#include <B/Error.h>
+#include <B/FileQuestion.h>
+#include <B/Main.h>
+#include <B/Private/Database.h>
+#include <B/Process.h>
+#include <B/QuestionAnswer.h>
+#include <B/RunLoop.h>
+#include <B/WorkerPool.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <map>
+#include <pthread.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+namespace {
+
+// Maps a file's name to the names of the files it needs.
+typedef std::map<std::string, std::vector<std::string> >
+  B_Graph_;
+
+struct B_MainTestState_ {
+  std::string directory;
+  B_Graph_ graph;
+  std::vector<std::vector<std::string> > cycles;
+  // If non-zero, questions with no dependencies succeed
+  // after running a function on one of this many worker
+  // threads.
+  size_t worker_threads;
+  size_t worker_calls;
+  pthread_t run_loop_thread;
+  // The question named failing fails.  The question named
+  // sleeping runs a process which sleeps for a minute.  The
+  // question named napping runs a process which sleeps for
+  // a fifth of a second.  The question named running runs
+  // a process which exits immediately.
+  std::string failing;
+  std::string sleeping;
+  std::string napping;
+  std::string running;
+  bool cancel_on_failure;
+  // Questions named here need their dependencies with the
+  // given priority.
+  std::map<std::string, int> need_priorities;
+  // Names of questions, in dispatch order.
+  std::vector<std::string> dispatched;
+  // If true, events reported to a B_MainObserver are
+  // recorded in events, e.g. "resolved a".
+  bool observe;
+  std::vector<std::string> events;
+  // Contents of files named here.  Other files are empty.
+  std::map<std::string, std::string> contents;
+  // If true, files' recorded dependencies are prefetched.
+  bool prefetch;
+  // Questions answered right after the root, before the
+  // run loop runs.
+  std::vector<std::string> also_answer;
+  // Questions answered again after the root is answered,
+  // without running the run loop.
+  std::vector<std::string> answer_again;
+  // States of the futures for also_answer then
+  // answer_again, when the root is answered.
+  std::vector<enum B_AnswerFutureState> extra_states;
+  // Number of futures for also_answer which were the
+  // root's future.
+  size_t shared_futures;
+
+  B_MainTestState_() :
+      worker_threads(0),
+      worker_calls(0),
+      run_loop_thread(pthread_self()),
+      cancel_on_failure(false),
+      observe(false),
+      prefetch(false),
+      shared_futures(0) {
+  }
+};
+
+B_FUNC bool
+b_process_exited_(
+    B_BORROW struct B_ProcessExitStatus const *exit_status,
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  struct B_AnswerContext *ac
+    = *static_cast<struct B_AnswerContext *const *>(
+      callback_data);
+  if (exit_status->type == B_PROCESS_EXIT_STATUS_CODE
+      && exit_status->u.code.exit_code == 0) {
+    return b_answer_context_succeed(ac, e);
+  }
+  struct B_Error error;
+  error.posix_error = ECHILD;
+  return b_answer_context_fail(ac, error, e);
+}
+
+B_FUNC bool
+b_process_cancelled_(
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  struct B_AnswerContext *ac
+    = *static_cast<struct B_AnswerContext *const *>(
+      callback_data);
+  struct B_Error error;
+  error.posix_error = ECANCELED;
+  return b_answer_context_fail(ac, error, e);
+}
+
+struct B_WorkerTestData_ {
+  struct B_AnswerContext *ac;
+  B_MainTestState_ *state;
+  pthread_t worker_thread;
+};
+
+B_FUNC bool
+b_record_worker_thread_(
+    B_BORROW void *work_data,
+    B_OUT struct B_Error *) {
+  static_cast<B_WorkerTestData_ *>(work_data)
+    ->worker_thread = pthread_self();
+  return true;
+}
+
+B_FUNC bool
+b_succeed_after_work_(
+    B_BORROW void *work_data,
+    struct B_Error work_error,
+    B_OUT struct B_Error *e) {
+  B_WorkerTestData_ *data
+    = static_cast<B_WorkerTestData_ *>(work_data);
+  EXPECT_EQ(0, work_error.posix_error);
+  EXPECT_TRUE(pthread_equal(
+    data->state->run_loop_thread, pthread_self()));
+  EXPECT_FALSE(pthread_equal(
+    data->state->run_loop_thread, data->worker_thread));
+  data->state->worker_calls += 1;
+  return b_answer_context_succeed(data->ac, e);
+}
+
+B_FUNC bool
+b_fail_cancel_(
+    B_BORROW void const *,
+    B_OUT struct B_Error *) {
+  ADD_FAILURE();
+  return true;
+}
+
+std::string
+b_file_name_(
+    struct B_IQuestion const *question) {
+  std::string path(static_cast<char const *>(
+    static_cast<void const *>(question)));
+  return path.substr(path.rfind('/') + 1);
+}
+
+B_FUNC bool
+b_dependency_answered_(
+    B_BORROW struct B_AnswerFuture *future,
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  struct B_AnswerContext *ac
+    = *static_cast<struct B_AnswerContext *const *>(
+      callback_data);
+  enum B_AnswerFutureState state;
+  if (!b_answer_future_state(future, &state, e)) {
+    return false;
+  }
+  if (state == B_FUTURE_RESOLVED) {
+    return b_answer_context_succeed(ac, e);
+  }
+  struct B_Error error;
+  error.posix_error = ENOENT;
+  return b_answer_context_fail(ac, error, e);
+}
+
+B_FUNC bool
+b_dispatch_question_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_TRANSFER struct B_AnswerContext *ac,
+    B_OUT struct B_Error *e) {
+  B_MainTestState_ *state
+    = static_cast<B_MainTestState_ *>(opaque);
+  struct B_IQuestion *question;
+  struct B_QuestionVTable const *vtable;
+  if (!b_answer_context_question(
+      ac, &question, &vtable, e)) {
+    return false;
+  }
+  std::string name = b_file_name_(question);
+  state->dispatched.push_back(name);
+  if (name == state->failing) {
+    struct B_Error error;
+    error.posix_error = EIO;
+    return b_answer_context_fail(ac, error, e);
+  }
+  if (name == state->sleeping || name == state->napping
+      || name == state->running) {
+    char const *sleep_args[] = {"sleep", "60", NULL};
+    char const *nap_args[] = {"sleep", "0.2", NULL};
+    char const *true_args[] = {"true", NULL};
+    char const *const *args
+      = name == state->sleeping ? sleep_args
+      : name == state->napping ? nap_args
+      : true_args;
+    return b_answer_context_exec_basic(
+      ac,
+      args,
+      b_process_exited_,
+      b_process_cancelled_,
+      &ac,
+      sizeof(ac),
+      e);
+  }
+  std::vector<std::string> const &names
+    = state->graph[name];
+  if (names.empty()) {
+    if (state->worker_threads > 0) {
+      B_WorkerTestData_ data;
+      data.ac = ac;
+      data.state = state;
+      data.worker_thread = state->run_loop_thread;
+      return b_answer_context_run_in_worker(
+        ac,
+        b_record_worker_thread_,
+        b_succeed_after_work_,
+        b_fail_cancel_,
+        &data,
+        sizeof(data),
+        e);
+    }
+    return b_answer_context_succeed(ac, e);
+  }
+  std::vector<struct B_IQuestion *> questions;
+  std::vector<struct B_QuestionVTable const *> vtables;
+  for (size_t i = 0; i < names.size(); ++i) {
+    std::string path = state->directory + "/" + names[i];
+    struct B_IQuestion *dependency;
+    if (!b_file_question_allocate(
+        path.c_str(), &dependency, e)) {
+      return false;
+    }
+    questions.push_back(dependency);
+    vtables.push_back(b_file_question_vtable());
+  }
+  struct B_AnswerFuture *future;
+  bool ok;
+  if (state->need_priorities.count(name)) {
+    ok = b_answer_context_need_with_priority(
+      ac,
+      &questions[0],
+      &vtables[0],
+      questions.size(),
+      state->need_priorities[name],
+      &future,
+      e);
+  } else {
+    ok = b_answer_context_need(
+      ac,
+      &questions[0],
+      &vtables[0],
+      questions.size(),
+      &future,
+      e);
+  }
+  for (size_t i = 0; i < questions.size(); ++i) {
+    vtables[i]->deallocate(questions[i]);
+  }
+  if (!ok) {
+    return false;
+  }
+  ok = b_answer_future_add_callback(
+    future, b_dependency_answered_, &ac, sizeof(ac), e);
+  b_answer_future_release(future);
+  return ok;
+}
+
+B_FUNC bool
+b_record_cycle_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_IQuestion const *const *questions,
+    B_BORROW struct B_QuestionVTable const *const *,
+    size_t count,
+    B_OUT struct B_Error *) {
+  B_MainTestState_ *state
+    = static_cast<B_MainTestState_ *>(opaque);
+  std::vector<std::string> cycle;
+  for (size_t i = 0; i < count; ++i) {
+    cycle.push_back(b_file_name_(questions[i]));
+  }
+  state->cycles.push_back(cycle);
+  return true;
+}
+
+B_FUNC bool
+b_stop_run_loop_(
+    B_BORROW struct B_AnswerFuture *,
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  struct B_RunLoop *run_loop
+    = *static_cast<struct B_RunLoop *const *>(
+      callback_data);
+  return b_run_loop_stop(run_loop, e);
+}
+
+void
+b_observe_(
+    void *opaque,
+    std::string const &event,
+    struct B_IQuestion const *question) {
+  static_cast<B_MainTestState_ *>(opaque)->events.push_back(
+    event + " " + b_file_name_(question));
+}
+
+B_FUNC void
+b_observe_question_requested_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *) {
+  b_observe_(opaque, "requested", question);
+}
+
+B_FUNC void
+b_observe_cache_hit_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *,
+    enum B_MainCacheHit hit) {
+  b_observe_(
+    opaque,
+    hit == B_MAIN_CACHE_HIT_MEMORY
+      ? "memory hit"
+      : "database hit",
+    question);
+}
+
+B_FUNC void
+b_observe_dispatched_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *) {
+  b_observe_(opaque, "dispatched", question);
+}
+
+B_FUNC void
+b_observe_resolved_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *) {
+  b_observe_(opaque, "resolved", question);
+}
+
+B_FUNC void
+b_observe_failed_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *) {
+  b_observe_(opaque, "failed", question);
+}
+
+B_FUNC void
+b_observe_dependency_recorded_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_IQuestion const *from,
+    B_BORROW struct B_QuestionVTable const *,
+    B_BORROW struct B_IQuestion const *to,
+    B_BORROW struct B_QuestionVTable const *) {
+  b_observe_(
+    opaque, "dependency " + b_file_name_(from), to);
+}
+
+B_FUNC void
+b_observe_process_started_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *,
+    B_ProcessID process_id) {
+  EXPECT_GT(process_id, 0);
+  b_observe_(opaque, "started", question);
+}
+
+B_FUNC void
+b_observe_process_exited_(
+    B_BORROW void *opaque,
+    B_BORROW struct B_Main *,
+    B_BORROW struct B_IQuestion const *question,
+    B_BORROW struct B_QuestionVTable const *,
+    B_BORROW struct B_ProcessExitStatus const *
+      exit_status) {
+  EXPECT_EQ(B_PROCESS_EXIT_STATUS_CODE, exit_status->type);
+  b_observe_(opaque, "exited", question);
+}
+
+bool
+b_is_database_hit_(
+    std::string const &event) {
+  return event.compare(0, 12, "database hit") == 0;
+}
+
+// The index of the first event equal to event, or the
+// number of events if there is none.
+size_t
+b_event_index_(
+    B_MainTestState_ const &state,
+    std::string const &event) {
+  return static_cast<size_t>(
+    std::find(
+      state.events.begin(), state.events.end(), event)
+    - state.events.begin());
+}
+
+// The mean recorded wall time of the file named name.
+int64_t
+b_mean_wall_time_us_(
+    B_MainTestState_ *state,
+    std::string const &name) {
+  struct B_Error e;
+  struct B_Database *database;
+  EXPECT_TRUE(b_database_open_sqlite3(
+    (state->directory + "/b.sqlite3").c_str(),
+    SQLITE_OPEN_READWRITE,
+    NULL,
+    &database,
+    &e));
+  std::string path = state->directory + "/" + name;
+  struct B_ExecutionSummary summary;
+  EXPECT_TRUE(b_database_summarize_executions(
+    database,
+    static_cast<struct B_IQuestion const *>(
+      static_cast<void const *>(path.c_str())),
+    b_file_question_vtable(),
+    &summary,
+    &e));
+  EXPECT_EQ(1, summary.execution_count);
+  EXPECT_TRUE(b_database_close(database, &e));
+  return summary.mean_wall_time_us;
+}
+
+// Records an execution of the file named name which ran
+// for wall_time_us.
+void
+b_record_wall_time_us_(
+    B_MainTestState_ *state,
+    std::string const &name,
+    int64_t wall_time_us) {
+  struct B_Error e;
+  struct B_Database *database;
+  ASSERT_TRUE(b_database_open_sqlite3(
+    (state->directory + "/b.sqlite3").c_str(),
+    SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+    NULL,
+    &database,
+    &e));
+  std::string path = state->directory + "/" + name;
+  struct B_ExecutionRecord record;
+  record.started_at_ms = 1000;
+  record.wall_time_us = wall_time_us;
+  record.cpu_time_us = wall_time_us;
+  record.peak_rss_bytes = 0;
+  record.exit_status = 0;
+  record.bytes_read = 0;
+  record.bytes_written = 0;
+  EXPECT_TRUE(b_database_record_execution(
+    database,
+    static_cast<struct B_IQuestion const *>(
+      static_cast<void const *>(path.c_str())),
+    b_file_question_vtable(),
+    &record,
+    &e));
+  EXPECT_TRUE(b_database_close(database, &e));
+}
+
+// Answers the file named name with main.
+struct B_AnswerFuture *
+b_main_answer_file_(
+    B_MainTestState_ *state,
+    struct B_Main *main,
+    std::string const &name) {
+  struct B_Error e;
+  std::string path = state->directory + "/" + name;
+  struct B_IQuestion *question;
+  EXPECT_TRUE(b_file_question_allocate(
+    path.c_str(), &question, &e));
+  struct B_AnswerFuture *future;
+  EXPECT_TRUE(b_main_answer(
+    main, question, b_file_question_vtable(), &future, &e));
+  b_file_question_vtable()->deallocate(question);
+  return future;
+}
+
+// Answers the file named root, returning the state of its
+// future.  Answers invalidated by changed contents are
+// deleted first.
+enum B_AnswerFutureState
+b_answer_(
+    B_MainTestState_ *state,
+    std::string const &root) {
+  struct B_Error e;
+  for (B_Graph_::const_iterator i = state->graph.begin();
+      i != state->graph.end();
+      ++i) {
+    FILE *file = fopen(
+      (state->directory + "/" + i->first).c_str(), "wb");
+    EXPECT_TRUE(file);
+    if (file) {
+      std::string const &contents
+        = state->contents[i->first];
+      EXPECT_EQ(
+        contents.size(),
+        fwrite(contents.data(), 1, contents.size(), file));
+      fclose(file);
+    }
+  }
+  struct B_QuestionVTable const *vtables[] = {
+    b_file_question_vtable(),
+  };
+  struct B_Database *database;
+  EXPECT_TRUE(b_database_open_sqlite3(
+    (state->directory + "/b.sqlite3").c_str(),
+    SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+    NULL,
+    &database,
+    &e));
+  EXPECT_TRUE(b_database_check_all(
+    database, vtables, 1, &e));
+  struct B_RunLoop *run_loop;
+  EXPECT_TRUE(b_run_loop_allocate_preferred(&run_loop, &e));
+  struct B_Main *main;
+  EXPECT_TRUE(b_main_allocate(
+    database,
+    run_loop,
+    b_dispatch_question_,
+    state,
+    &main,
+    &e));
+  b_main_set_cycle_callback(main, b_record_cycle_, state);
+  b_main_set_cancel_on_failure(
+    main, state->cancel_on_failure);
+  if (state->observe) {
+    struct B_MainObserver observer;
+    observer.question_requested
+      = b_observe_question_requested_;
+    observer.cache_hit = b_observe_cache_hit_;
+    observer.dispatched = b_observe_dispatched_;
+    observer.resolved = b_observe_resolved_;
+    observer.failed = b_observe_failed_;
+    observer.dependency_recorded
+      = b_observe_dependency_recorded_;
+    observer.process_started = b_observe_process_started_;
+    observer.process_exited = b_observe_process_exited_;
+    b_main_set_observer(main, &observer, state);
+  }
+  if (state->prefetch) {
+    b_main_enable_prefetch(main, vtables, 1);
+  }
+  struct B_WorkerPool *pool = NULL;
+  if (state->worker_threads > 0) {
+    EXPECT_TRUE(b_worker_pool_allocate(
+      run_loop, state->worker_threads, &pool, &e));
+    b_main_set_worker_pool(main, pool);
+  }
+
+  struct B_AnswerFuture *future
+    = b_main_answer_file_(state, main, root);
+  std::vector<struct B_AnswerFuture *> extra_futures;
+  for (size_t i = 0; i < state->also_answer.size(); ++i) {
+    struct B_AnswerFuture *extra_future
+      = b_main_answer_file_(
+        state, main, state->also_answer[i]);
+    if (extra_future == future) {
+      state->shared_futures += 1;
+    }
+    extra_futures.push_back(extra_future);
+  }
+  EXPECT_TRUE(b_answer_future_add_callback(
+    future,
+    b_stop_run_loop_,
+    &run_loop,
+    sizeof(run_loop),
+    &e));
+  EXPECT_TRUE(b_run_loop_run(run_loop, &e));
+  enum B_AnswerFutureState future_state;
+  EXPECT_TRUE(b_answer_future_state(
+    future, &future_state, &e));
+  b_answer_future_release(future);
+  for (size_t i = 0; i < state->answer_again.size(); ++i) {
+    extra_futures.push_back(b_main_answer_file_(
+      state, main, state->answer_again[i]));
+  }
+  for (size_t i = 0; i < extra_futures.size(); ++i) {
+    enum B_AnswerFutureState extra_state;
+    EXPECT_TRUE(b_answer_future_state(
+      extra_futures[i], &extra_state, &e));
+    state->extra_states.push_back(extra_state);
+    b_answer_future_release(extra_futures[i]);
+  }
+
+  if (pool) {
+    EXPECT_TRUE(b_worker_pool_deallocate(pool, &e));
+  }
+  b_run_loop_deallocate(run_loop);
+  EXPECT_TRUE(b_main_deallocate(main, &e));
+  EXPECT_TRUE(b_database_close(database, &e));
+  return future_state;
+}
+
+}
+
+TEST(TestMain, DependencyCycleFails) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.graph["a"].push_back("b");
+  state.graph["b"].push_back("c");
+  state.graph["c"].push_back("a");
+
+  EXPECT_EQ(B_FUTURE_FAILED, b_answer_(&state, "a"));
+  ASSERT_EQ(1U, state.cycles.size());
+  std::vector<std::string> expected_cycle;
+  expected_cycle.push_back("c");
+  expected_cycle.push_back("a");
+  expected_cycle.push_back("b");
+  EXPECT_EQ(expected_cycle, state.cycles[0]);
+}
+
+TEST(TestMain, QuestionNeedingItselfFails) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.graph["a"].push_back("a");
+
+  EXPECT_EQ(B_FUTURE_FAILED, b_answer_(&state, "a"));
+  ASSERT_EQ(1U, state.cycles.size());
+  EXPECT_EQ(1U, state.cycles[0].size());
+}
+
+TEST(TestMain, EdgeAgainstDiscoveryOrderIsNotACycle) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  // c is discovered after b, but needs b while b waits on
+  // d, so b must be reordered after c.
+  state.graph["a"].push_back("b");
+  state.graph["a"].push_back("c");
+  state.graph["b"].push_back("d");
+  state.graph["c"].push_back("b");
+  state.graph["d"];
+
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "a"));
+  EXPECT_TRUE(state.cycles.empty());
+}
+
+TEST(TestMain, WorkerFunctionsRunOffRunLoopThread) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.worker_threads = 2;
+  state.graph["a"].push_back("b");
+  state.graph["a"].push_back("c");
+  state.graph["b"];
+  state.graph["c"];
+
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "a"));
+  EXPECT_EQ(2U, state.worker_calls);
+}
+
+TEST(TestMain, FailureCancelsRunningProcesses) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.cancel_on_failure = true;
+  state.failing = "b";
+  state.sleeping = "c";
+  state.graph["a"].push_back("b");
+  state.graph["a"].push_back("c");
+  state.graph["b"];
+  state.graph["c"];
+
+  time_t start = time(NULL);
+  EXPECT_EQ(B_FUTURE_FAILED, b_answer_(&state, "a"));
+  // Without cancellation, c's process would run for a
+  // minute.
+  EXPECT_LT(time(NULL) - start, 30);
+}
+
+TEST(TestMain, HigherPriorityQuestionsDispatchFirst) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  // d is dispatched before a, so e is ready before b, but
+  // a needs b with a higher priority.  b's priority is
+  // inherited by f.
+  state.graph["r"].push_back("d");
+  state.graph["r"].push_back("a");
+  state.graph["d"].push_back("e");
+  state.graph["a"].push_back("b");
+  state.graph["b"].push_back("f");
+  state.graph["e"];
+  state.graph["f"];
+  state.need_priorities["a"] = 10;
+
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+  char const *const expected[] = {
+    "r", "d", "a", "b", "f", "e",
+  };
+  EXPECT_EQ(
+    std::vector<std::string>(expected, expected + 6),
+    state.dispatched);
+}
+
+TEST(TestMain, QuestionNeededTwiceInOneBatchIsAnsweredOnce) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.graph["r"].push_back("a");
+  state.graph["r"].push_back("b");
+  state.graph["r"].push_back("a");
+  state.graph["a"];
+  state.graph["b"];
+
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+  char const *const expected[] = {"r", "a", "b"};
+  EXPECT_EQ(
+    std::vector<std::string>(expected, expected + 3),
+    state.dispatched);
+}
+
+TEST(TestMain, ObserverSeesEachStepOfABuild) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.observe = true;
+  state.running = "p";
+  // a is answered before b needs it.
+  state.graph["r"].push_back("a");
+  state.graph["r"].push_back("b");
+  state.graph["r"].push_back("p");
+  state.graph["b"].push_back("a");
+  state.graph["a"];
+  state.graph["p"];
+
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+  char const *const expected[] = {
+    "requested r",
+    "requested a",
+    "requested a",
+    "requested b",
+    "requested p",
+    "dispatched r",
+    "dispatched a",
+    "dispatched b",
+    "dispatched p",
+    "memory hit a",
+    "dependency r a",
+    "dependency r b",
+    "dependency r p",
+    "dependency b a",
+    "started p",
+    "exited p",
+    "resolved r",
+    "resolved a",
+    "resolved b",
+    "resolved p",
+  };
+  std::vector<std::string> events = state.events;
+  std::sort(events.begin(), events.end());
+  std::vector<std::string> sorted_expected(
+    expected,
+    expected + sizeof(expected) / sizeof(*expected));
+  std::sort(sorted_expected.begin(), sorted_expected.end());
+  EXPECT_EQ(sorted_expected, events);
+
+  // The second build finds r's answer in the database.
+  state.events.clear();
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+  char const *const expected_cached[] = {
+    "requested r",
+    "database hit r",
+  };
+  EXPECT_EQ(
+    std::vector<std::string>(
+      expected_cached, expected_cached + 2),
+    state.events);
+}
+
+TEST(TestMain, WallTimeExcludesWaitingOnDependencies) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.napping = "n";
+  state.graph["r"].push_back("n");
+  state.graph["n"];
+
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+  EXPECT_GE(b_mean_wall_time_us_(&state, "n"), 200000);
+  // r spent its time waiting for n.
+  EXPECT_LT(b_mean_wall_time_us_(&state, "r"), 100000);
+}
+
+TEST(TestMain, LongestCriticalPathDispatchesFirst) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.graph["r"].push_back("x");
+  state.graph["r"].push_back("y");
+  state.graph["x"].push_back("p");
+  state.graph["y"].push_back("q");
+  state.graph["p"];
+  state.graph["q"];
+  b_record_wall_time_us_(&state, "x", 100000);
+  b_record_wall_time_us_(&state, "y", 10000);
+  b_record_wall_time_us_(&state, "p", 1000);
+  b_record_wall_time_us_(&state, "q", 50000);
+
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+  // p costs less than y, but x waits on p, so p's critical
+  // path is longer.
+  char const *const expected[] = {
+    "r", "x", "p", "y", "q",
+  };
+  EXPECT_EQ(
+    std::vector<std::string>(expected, expected + 5),
+    state.dispatched);
+}
+
+TEST(TestMain, AnsweringAQuestionInFlightSharesItsFuture) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.napping = "n";
+  state.graph["r"].push_back("n");
+  state.graph["n"];
+  // r is in flight, so answering it again shares it.  n is
+  // in flight when r needs it.
+  state.also_answer.push_back("r");
+  state.also_answer.push_back("n");
+
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+  EXPECT_EQ(1U, state.shared_futures);
+  char const *const expected[] = {"r", "n"};
+  EXPECT_EQ(
+    std::vector<std::string>(expected, expected + 2),
+    state.dispatched);
+  ASSERT_EQ(2U, state.extra_states.size());
+  EXPECT_EQ(B_FUTURE_RESOLVED, state.extra_states[0]);
+  EXPECT_EQ(B_FUTURE_RESOLVED, state.extra_states[1]);
+}
+
+TEST(TestMain, AnsweringAgainHitsMemoryNotDatabase) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.graph["r"].push_back("a");
+  state.graph["a"];
+  // Nothing was answered before, so every database lookup
+  // misses.
+  state.observe = true;
+  state.answer_again.push_back("a");
+  state.answer_again.push_back("r");
+
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+  ASSERT_EQ(2U, state.extra_states.size());
+  EXPECT_EQ(B_FUTURE_RESOLVED, state.extra_states[0]);
+  EXPECT_EQ(B_FUTURE_RESOLVED, state.extra_states[1]);
+  ASSERT_LE(4U, state.events.size());
+  char const *const expected[] = {
+    "requested a",
+    "memory hit a",
+    "requested r",
+    "memory hit r",
+  };
+  EXPECT_EQ(
+    std::vector<std::string>(expected, expected + 4),
+    std::vector<std::string>(
+      state.events.end() - 4, state.events.end()));
+  EXPECT_EQ(
+    state.events.end(),
+    std::find_if(
+      state.events.begin(),
+      state.events.end(),
+      b_is_database_hit_));
+}
+
+TEST(TestMain, PrefetchStartsRecordedDependenciesEarly) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  B_MainTestState_ state;
+  state.directory = temp_dir.path();
+  state.observe = true;
+  state.graph["r"].push_back("a");
+  state.graph["a"];
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+
+  // Changing a invalidates a and r.  Without prefetching,
+  // a is requested only when r needs it.
+  state.contents["a"] = "changed";
+  state.events.clear();
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+  EXPECT_LT(
+    b_event_index_(state, "dispatched r"),
+    b_event_index_(state, "requested a"));
+
+  // With prefetching, a is requested as r is dispatched,
+  // before r needs it.
+  state.contents["a"] = "changed again";
+  state.prefetch = true;
+  state.events.clear();
+  state.dispatched.clear();
+  EXPECT_EQ(B_FUTURE_RESOLVED, b_answer_(&state, "r"));
+  EXPECT_LT(
+    b_event_index_(state, "requested a"),
+    b_event_index_(state, "dispatched r"));
+  char const *const expected[] = {"r", "a"};
+  EXPECT_EQ(
+    std::vector<std::string>(expected, expected + 2),
+    state.dispatched);
+}
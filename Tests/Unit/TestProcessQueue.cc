@@ -0,0 +1,394 @@
+#include <B/Error.h>
+#include <B/Jobserver.h>
+#include <B/Process.h>
+#include <B/ProcessQueue.h>
+#include <B/RunLoop.h>
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct B_ProcessQueueTestState_ {
+  struct B_RunLoop *run_loop;
+  struct B_ProcessQueue *queue;
+  size_t remaining;
+  size_t exited;
+  size_t cancelled;
+  // Most processes seen running at once.
+  size_t max_running;
+};
+
+B_FUNC bool
+b_exit_callback_(
+    B_BORROW struct B_ProcessExitStatus const *exit_status,
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *e) {
+  B_ProcessQueueTestState_ *state
+    = *static_cast<B_ProcessQueueTestState_ *const *>(
+      opaque);
+  EXPECT_EQ(B_PROCESS_EXIT_STATUS_CODE, exit_status->type);
+  // Count the process which just exited.
+  size_t running
+    = b_process_queue_running_count(state->queue) + 1;
+  if (running > state->max_running) {
+    state->max_running = running;
+  }
+  state->exited += 1;
+  state->remaining -= 1;
+  if (state->remaining == 0) {
+    return b_run_loop_stop(state->run_loop, e);
+  }
+  return true;
+}
+
+B_FUNC bool
+b_cancel_callback_(
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *) {
+  B_ProcessQueueTestState_ *state
+    = *static_cast<B_ProcessQueueTestState_ *const *>(
+      opaque);
+  state->cancelled += 1;
+  return true;
+}
+
+B_FUNC bool
+b_terminated_callback_(
+    B_BORROW struct B_ProcessExitStatus const *exit_status,
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *e) {
+  B_ProcessQueueTestState_ *state
+    = *static_cast<B_ProcessQueueTestState_ *const *>(
+      opaque);
+  EXPECT_EQ(
+    B_PROCESS_EXIT_STATUS_SIGNAL, exit_status->type);
+  EXPECT_EQ(SIGTERM, exit_status->u.signal.signal_number);
+  state->exited += 1;
+  return b_run_loop_stop(state->run_loop, e);
+}
+
+B_FUNC bool
+b_killed_callback_(
+    B_BORROW struct B_ProcessExitStatus const *exit_status,
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *e) {
+  B_ProcessQueueTestState_ *state
+    = *static_cast<B_ProcessQueueTestState_ *const *>(
+      opaque);
+  EXPECT_EQ(
+    B_PROCESS_EXIT_STATUS_SIGNAL, exit_status->type);
+  EXPECT_EQ(SIGKILL, exit_status->u.signal.signal_number);
+  state->exited += 1;
+  return b_run_loop_stop(state->run_loop, e);
+}
+
+B_FUNC bool
+b_cancel_queue_callback_(
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *e) {
+  B_ProcessQueueTestState_ *state
+    = *static_cast<B_ProcessQueueTestState_ *const *>(
+      opaque);
+  return b_process_queue_cancel(state->queue, 100, e);
+}
+
+B_FUNC bool
+b_ignore_callback_(
+    B_BORROW void const *,
+    B_OUT struct B_Error *) {
+  return true;
+}
+
+struct B_OrderClosure_ {
+  B_ProcessQueueTestState_ *state;
+  std::vector<int> *order;
+  int id;
+};
+
+B_FUNC bool
+b_record_order_callback_(
+    B_BORROW struct B_ProcessExitStatus const *exit_status,
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *e) {
+  B_OrderClosure_ const *closure
+    = static_cast<B_OrderClosure_ const *>(opaque);
+  closure->order->push_back(closure->id);
+  return b_exit_callback_(
+    exit_status, &closure->state, e);
+}
+
+void
+b_exec_true_with_memory_(
+    B_ProcessQueueTestState_ *state,
+    int64_t memory_bytes) {
+  struct B_Error e;
+  char const *args[] = {"true", NULL};
+  EXPECT_TRUE(b_process_queue_exec(
+    state->queue,
+    NULL,
+    memory_bytes,
+    args,
+    b_exit_callback_,
+    b_cancel_callback_,
+    &state,
+    sizeof(state),
+    &e));
+}
+
+void
+b_exec_true_(
+    B_ProcessQueueTestState_ *state,
+    char const *pool_name) {
+  struct B_Error e;
+  char const *args[] = {"true", NULL};
+  EXPECT_TRUE(b_process_queue_exec_basic(
+    state->queue,
+    pool_name,
+    args,
+    b_exit_callback_,
+    b_cancel_callback_,
+    &state,
+    sizeof(state),
+    &e));
+}
+
+B_ProcessQueueTestState_
+b_create_state_(
+    size_t job_slots,
+    size_t process_count) {
+  struct B_Error e;
+  B_ProcessQueueTestState_ state;
+  EXPECT_TRUE(b_run_loop_allocate_preferred(
+    &state.run_loop, &e));
+  EXPECT_TRUE(b_process_queue_allocate(
+    state.run_loop, job_slots, &state.queue, &e));
+  state.remaining = process_count;
+  state.exited = 0;
+  state.cancelled = 0;
+  state.max_running = 0;
+  return state;
+}
+
+}
+
+TEST(TestProcessQueue, JobSlotsLimitRunningProcesses) {
+  struct B_Error e;
+  B_ProcessQueueTestState_ state = b_create_state_(2, 5);
+  for (size_t i = 0; i < 5; ++i) {
+    b_exec_true_(&state, NULL);
+  }
+  EXPECT_EQ(2U, b_process_queue_running_count(state.queue));
+  EXPECT_EQ(3U, b_process_queue_waiting_count(state.queue));
+
+  ASSERT_TRUE(b_run_loop_run(state.run_loop, &e));
+  EXPECT_EQ(5U, state.exited);
+  EXPECT_EQ(0U, state.cancelled);
+  EXPECT_EQ(2U, state.max_running);
+  EXPECT_EQ(0U, b_process_queue_running_count(state.queue));
+  EXPECT_EQ(0U, b_process_queue_waiting_count(state.queue));
+
+  b_run_loop_deallocate(state.run_loop);
+  EXPECT_TRUE(b_process_queue_deallocate(state.queue, &e));
+}
+
+TEST(TestProcessQueue, PoolsLimitTheirProcesses) {
+  struct B_Error e;
+  B_ProcessQueueTestState_ state = b_create_state_(4, 5);
+  ASSERT_TRUE(b_process_queue_add_pool(
+    state.queue, "link", 1, &e));
+  EXPECT_FALSE(b_process_queue_add_pool(
+    state.queue, "link", 2, &e));
+  EXPECT_EQ(EEXIST, e.posix_error);
+
+  b_exec_true_(&state, "link");
+  b_exec_true_(&state, "link");
+  b_exec_true_(&state, NULL);
+  // Pools which were never added are unlimited.
+  b_exec_true_(&state, "unknown");
+  b_exec_true_(&state, "unknown");
+  EXPECT_EQ(4U, b_process_queue_running_count(state.queue));
+  EXPECT_EQ(1U, b_process_queue_waiting_count(state.queue));
+
+  ASSERT_TRUE(b_run_loop_run(state.run_loop, &e));
+  EXPECT_EQ(5U, state.exited);
+  EXPECT_EQ(0U, b_process_queue_waiting_count(state.queue));
+
+  b_run_loop_deallocate(state.run_loop);
+  EXPECT_TRUE(b_process_queue_deallocate(state.queue, &e));
+}
+
+TEST(TestProcessQueue, DeallocateCancelsWaitingProcesses) {
+  struct B_Error e;
+  B_ProcessQueueTestState_ state = b_create_state_(1, 2);
+  b_exec_true_(&state, NULL);
+  b_exec_true_(&state, NULL);
+  EXPECT_EQ(1U, b_process_queue_waiting_count(state.queue));
+
+  // The queue cancels the waiting process.  (The run loop
+  // might cancel the running process.)
+  b_run_loop_deallocate(state.run_loop);
+  EXPECT_TRUE(b_process_queue_deallocate(state.queue, &e));
+  EXPECT_EQ(0U, state.exited);
+  EXPECT_LE(1U, state.cancelled);
+}
+
+TEST(TestProcessQueue, MemoryBudgetLimitsRunningProcesses) {
+  struct B_Error e;
+  B_ProcessQueueTestState_ state = b_create_state_(4, 4);
+  b_process_queue_set_memory_budget(state.queue, 100, 80);
+
+  b_exec_true_with_memory_(&state, 50);
+  b_exec_true_with_memory_(&state, 40);
+  b_exec_true_with_memory_(
+    &state, B_PROCESS_QUEUE_UNKNOWN_MEMORY);
+  // Fits, but waits behind the process which doesn't.
+  b_exec_true_with_memory_(&state, 0);
+  EXPECT_EQ(2U, b_process_queue_running_count(state.queue));
+  EXPECT_EQ(2U, b_process_queue_waiting_count(state.queue));
+  EXPECT_EQ(
+    90, b_process_queue_running_memory_bytes(state.queue));
+
+  ASSERT_TRUE(b_run_loop_run(state.run_loop, &e));
+  EXPECT_EQ(4U, state.exited);
+  EXPECT_EQ(
+    0, b_process_queue_running_memory_bytes(state.queue));
+
+  b_run_loop_deallocate(state.run_loop);
+  EXPECT_TRUE(b_process_queue_deallocate(state.queue, &e));
+}
+
+TEST(TestProcessQueue, JobserverLimitsRunningProcesses) {
+  struct B_Error e;
+  char const *makeflags = getenv("MAKEFLAGS");
+  bool had_makeflags = makeflags != NULL;
+  std::string old_makeflags = makeflags ? makeflags : "";
+  struct B_Jobserver *jobserver;
+  ASSERT_TRUE(b_jobserver_allocate_server(
+    2, &jobserver, &e));
+  B_ProcessQueueTestState_ state = b_create_state_(4, 3);
+  b_process_queue_set_jobserver(state.queue, jobserver);
+
+  b_exec_true_(&state, NULL);
+  b_exec_true_(&state, NULL);
+  b_exec_true_(&state, NULL);
+  EXPECT_EQ(2U, b_process_queue_running_count(state.queue));
+  EXPECT_EQ(1U, b_jobserver_held_count(jobserver));
+
+  ASSERT_TRUE(b_run_loop_run(state.run_loop, &e));
+  EXPECT_EQ(3U, state.exited);
+  EXPECT_EQ(0U, b_jobserver_held_count(jobserver));
+
+  b_run_loop_deallocate(state.run_loop);
+  EXPECT_TRUE(b_process_queue_deallocate(state.queue, &e));
+  EXPECT_TRUE(b_jobserver_deallocate(jobserver, &e));
+  makeflags = getenv("MAKEFLAGS");
+  EXPECT_EQ(had_makeflags, makeflags != NULL);
+  if (had_makeflags && makeflags) {
+    EXPECT_EQ(old_makeflags, makeflags);
+  }
+}
+
+TEST(TestProcessQueue, CancelTerminatesRunningProcesses) {
+  struct B_Error e;
+  B_ProcessQueueTestState_ state = b_create_state_(1, 2);
+  B_ProcessQueueTestState_ *state_pointer = &state;
+  char const *args[] = {"sleep", "60", NULL};
+  for (size_t i = 0; i < 2; ++i) {
+    ASSERT_TRUE(b_process_queue_exec_basic(
+      state.queue,
+      NULL,
+      args,
+      b_terminated_callback_,
+      b_cancel_callback_,
+      &state_pointer,
+      sizeof(state_pointer),
+      &e));
+  }
+  EXPECT_EQ(1U, b_process_queue_running_count(state.queue));
+  EXPECT_EQ(1U, b_process_queue_waiting_count(state.queue));
+
+  ASSERT_TRUE(
+    b_process_queue_cancel(state.queue, 1000, &e));
+  EXPECT_EQ(1U, state.cancelled);
+  EXPECT_EQ(0U, b_process_queue_waiting_count(state.queue));
+  ASSERT_TRUE(b_run_loop_run(state.run_loop, &e));
+  EXPECT_EQ(1U, state.exited);
+  EXPECT_EQ(0U, b_process_queue_running_count(state.queue));
+
+  b_run_loop_deallocate(state.run_loop);
+  EXPECT_TRUE(b_process_queue_deallocate(state.queue, &e));
+}
+
+TEST(TestProcessQueue, CancelKillsProcessesIgnoringSigterm) {
+  struct B_Error e;
+  B_ProcessQueueTestState_ state = b_create_state_(1, 1);
+  B_ProcessQueueTestState_ *state_pointer = &state;
+  char const *args[] = {
+    "sh", "-c", "trap '' TERM; sleep 60", NULL};
+  ASSERT_TRUE(b_process_queue_exec_basic(
+    state.queue,
+    NULL,
+    args,
+    b_killed_callback_,
+    b_cancel_callback_,
+    &state_pointer,
+    sizeof(state_pointer),
+    &e));
+
+  // Give sh time to ignore SIGTERM.  Cancelling must not
+  // block the run loop during the grace period, and the
+  // process must be killed after it.
+  ASSERT_TRUE(b_run_loop_add_timer(
+    state.run_loop,
+    200,
+    b_cancel_queue_callback_,
+    b_ignore_callback_,
+    &state_pointer,
+    sizeof(state_pointer),
+    &e));
+  ASSERT_TRUE(b_run_loop_run(state.run_loop, &e));
+  EXPECT_EQ(1U, state.exited);
+  EXPECT_EQ(0U, b_process_queue_running_count(state.queue));
+
+  b_run_loop_deallocate(state.run_loop);
+  EXPECT_TRUE(b_process_queue_deallocate(state.queue, &e));
+}
+
+TEST(TestProcessQueue, HigherPriorityProcessesStartFirst) {
+  struct B_Error e;
+  B_ProcessQueueTestState_ state = b_create_state_(1, 5);
+  std::vector<int> order;
+  int const priorities[] = {0, 0, 5, 1, 5};
+  char const *args[] = {"true", NULL};
+  for (int i = 0; i < 5; ++i) {
+    B_OrderClosure_ closure;
+    closure.state = &state;
+    closure.order = &order;
+    closure.id = i;
+    ASSERT_TRUE(b_process_queue_exec_with_priority(
+      state.queue,
+      NULL,
+      B_PROCESS_QUEUE_UNKNOWN_MEMORY,
+      priorities[i],
+      args,
+      b_record_order_callback_,
+      b_cancel_callback_,
+      &closure,
+      sizeof(closure),
+      &e));
+  }
+
+  ASSERT_TRUE(b_run_loop_run(state.run_loop, &e));
+  // Process 0 started immediately.
+  int const expected[] = {0, 2, 4, 3, 1};
+  EXPECT_EQ(
+    std::vector<int>(expected, expected + 5), order);
+
+  b_run_loop_deallocate(state.run_loop);
+  EXPECT_TRUE(b_process_queue_deallocate(state.queue, &e));
+}
@@ -0,0 +1,96 @@
+#include <B/Error.h>
+#include <B/FileQuestion.h>
+#include <B/Private/QuestionMap.h>
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string>
+
+static struct B_QuestionKey
+b_file_question_key_(
+    std::string const &file_path) {
+  struct B_Error e;
+  struct B_QuestionKey key;
+  EXPECT_TRUE(b_question_key_initialize(
+    static_cast<struct B_IQuestion const *>(
+      static_cast<void const *>(file_path.c_str())),
+    b_file_question_vtable(),
+    &key,
+    &e));
+  return key;
+}
+
+static std::string
+b_numbered_path_(
+    int number) {
+  char path[32];
+  snprintf(path, sizeof(path), "%d.c", number);
+  return path;
+}
+
+TEST(TestQuestionMap, EqualQuestionsHaveEqualKeys) {
+  struct B_QuestionKey a = b_file_question_key_("a.c");
+  struct B_QuestionKey a2 = b_file_question_key_("a.c");
+  struct B_QuestionKey b = b_file_question_key_("b.c");
+  EXPECT_TRUE(b_question_key_equal(&a, &a2));
+  EXPECT_FALSE(b_question_key_equal(&a, &b));
+  b_question_key_deinitialize(&a);
+  b_question_key_deinitialize(&a2);
+  b_question_key_deinitialize(&b);
+}
+
+TEST(TestQuestionMap, FindInsertedValues) {
+  struct B_Error e;
+  struct B_QuestionMap *map;
+  ASSERT_TRUE(b_question_map_allocate(&map, &e));
+
+  // Insert enough questions to force the map to grow.
+  int values[1000];
+  for (int i = 0; i < 1000; ++i) {
+    struct B_QuestionKey key
+      = b_file_question_key_(b_numbered_path_(i));
+    ASSERT_TRUE(b_question_map_insert(
+      map, &key, &values[i], &e));
+  }
+  EXPECT_EQ(1000U, b_question_map_count(map));
+
+  for (int i = 0; i < 1000; ++i) {
+    struct B_QuestionKey key
+      = b_file_question_key_(b_numbered_path_(i));
+    void *value;
+    b_question_map_find(map, &key, &value);
+    EXPECT_EQ(&values[i], value);
+    b_question_key_deinitialize(&key);
+  }
+
+  struct B_QuestionKey missing_key
+    = b_file_question_key_("missing");
+  void *missing_value;
+  b_question_map_find(map, &missing_key, &missing_value);
+  EXPECT_FALSE(missing_value);
+  b_question_key_deinitialize(&missing_key);
+
+  b_question_map_deallocate(map);
+}
+
+TEST(TestQuestionMap, RemoveForgetsValue) {
+  struct B_Error e;
+  struct B_QuestionMap *map;
+  ASSERT_TRUE(b_question_map_allocate(&map, &e));
+
+  int value;
+  struct B_QuestionKey key = b_file_question_key_("a.c");
+  ASSERT_TRUE(b_question_map_insert(map, &key, &value, &e));
+
+  struct B_QuestionKey lookup_key
+    = b_file_question_key_("a.c");
+  void *removed_value;
+  b_question_map_remove(map, &lookup_key, &removed_value, NULL);
+  EXPECT_EQ(&value, removed_value);
+  EXPECT_EQ(0U, b_question_map_count(map));
+  b_question_map_remove(map, &lookup_key, &removed_value, NULL);
+  EXPECT_FALSE(removed_value);
+  b_question_key_deinitialize(&lookup_key);
+
+  b_question_map_deallocate(map);
+}
@@ -68,6 +68,17 @@ b_run_loop_function_noop_(
   return true;
 }
 
+B_FUNC bool
+b_run_loop_function_raise_(
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *e) {
+  B_RunLoopClosure_ *closure
+    = *static_cast<B_RunLoopClosure_ *const *>(opaque);
+  closure->calls.push_back(true);
+  e->posix_error = EIO;
+  return false;
+}
+
 }
 
 namespace {
@@ -181,6 +192,63 @@ TEST_P(TestRunLoop, StopFunctionWithClosure) {
   b_run_loop_deallocate(rl);
 }
 
+TEST_P(TestRunLoop, TimersFireInDeadlineOrder) {
+  struct B_Error e;
+  struct B_RunLoop *rl = this->create();
+  B_RunLoopClosure_ closure(rl);
+  B_RunLoopClosure_ *closure_pointer = &closure;
+  ASSERT_TRUE(b_run_loop_add_timer(
+    rl,
+    100,
+    b_run_loop_function_stop_,
+    b_run_loop_function_fail_,
+    &closure_pointer,
+    sizeof(closure_pointer),
+    &e));
+  ASSERT_TRUE(b_run_loop_add_timer(
+    rl,
+    10,
+    b_run_loop_function_noop_,
+    b_run_loop_function_fail_,
+    &closure_pointer,
+    sizeof(closure_pointer),
+    &e));
+  // Never fires; cancelled when the run loop is
+  // deallocated.
+  ASSERT_TRUE(b_run_loop_add_timer(
+    rl,
+    60 * 1000,
+    b_run_loop_function_fail_,
+    b_run_loop_function_noop_,
+    &closure_pointer,
+    sizeof(closure_pointer),
+    &e));
+  ASSERT_TRUE(b_run_loop_run(rl, &e));
+  ASSERT_EQ(2U, closure.calls.size());
+  EXPECT_FALSE(closure.calls[0]);
+  EXPECT_TRUE(closure.calls[1]);
+  b_run_loop_deallocate(rl);
+  EXPECT_EQ(3U, closure.calls.size());
+}
+
+TEST_P(TestRunLoop, FailingFunctionFailsRun) {
+  struct B_Error e;
+  struct B_RunLoop *rl = this->create();
+  B_RunLoopClosure_ closure(rl);
+  B_RunLoopClosure_ *closure_pointer = &closure;
+  ASSERT_TRUE(b_run_loop_add_function(
+    rl,
+    b_run_loop_function_raise_,
+    b_run_loop_function_fail_,
+    &closure_pointer,
+    sizeof(closure_pointer),
+    &e));
+  ASSERT_FALSE(b_run_loop_run(rl, &e));
+  EXPECT_EQ(EIO, e.posix_error);
+  EXPECT_EQ(1U, closure.calls.size());
+  b_run_loop_deallocate(rl);
+}
+
 TEST_P(TestRunLoop, TwoStopFunctions) {
   struct B_Error e;
   struct B_RunLoop *rl = this->create();
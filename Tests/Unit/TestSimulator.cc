@@ -0,0 +1,265 @@
+#include "Util/TemporaryDirectory.h"
+
+#include <B/AnswerFuture.h>
+#include <B/Database.h>
+#include <B/Error.h>
+#include <B/FileQuestion.h>
+#include <B/Main.h>
+#include <B/Private/Database.h>
+#include <B/ProcessQueue.h>
+#include <B/QuestionAnswer.h>
+#include <B/RunLoop.h>
+#include <B/Simulator.h>
+
+#include <gtest/gtest.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <string>
+
+namespace {
+
+struct B_IQuestion const *
+b_question_from_file_path_(
+    std::string const &file_path) {
+  return static_cast<struct B_IQuestion const *>(
+    static_cast<void const *>(file_path.c_str()));
+}
+
+struct B_Database *
+b_open_database_(
+    std::string const &sqlite_path) {
+  struct B_Database *database;
+  struct B_Error e;
+  if (!b_database_open_sqlite3(
+      sqlite_path.c_str(),
+      SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+      NULL,
+      &database,
+      &e)) {
+    return NULL;
+  }
+  return database;
+}
+
+// Records that the file named name was answered by a
+// process which ran for wall_time_us and peaked at
+// peak_rss_bytes of memory, after needing the files named
+// dependencies.  The process used a quarter of its wall
+// time as CPU time, as if it were waiting on I/O.
+void
+b_record_file_(
+    struct B_Database *database,
+    std::string const &directory,
+    std::string const &name,
+    int64_t wall_time_us,
+    int64_t peak_rss_bytes,
+    char const *const *dependencies) {
+  struct B_Error e;
+  std::string path = directory + "/" + name;
+  FILE *file = fopen(path.c_str(), "wb");
+  ASSERT_TRUE(file);
+  ASSERT_EQ(0, fclose(file));
+  struct B_QuestionVTable const *vtable
+    = b_file_question_vtable();
+  struct B_IAnswer *answer;
+  ASSERT_TRUE(vtable->query_answer(
+    b_question_from_file_path_(path), &answer, &e));
+  ASSERT_TRUE(answer);
+  ASSERT_TRUE(b_database_record_answer(
+    database,
+    b_question_from_file_path_(path),
+    vtable,
+    answer,
+    &e));
+  vtable->answer_vtable->deallocate(answer);
+  for (char const *const *dependency = dependencies;
+      *dependency;
+      ++dependency) {
+    std::string dependency_path
+      = directory + "/" + *dependency;
+    ASSERT_TRUE(b_database_record_dependency(
+      database,
+      b_question_from_file_path_(path),
+      vtable,
+      b_question_from_file_path_(dependency_path),
+      vtable,
+      &e));
+  }
+  struct B_ExecutionRecord record;
+  record.started_at_ms = 1000;
+  record.wall_time_us = wall_time_us;
+  record.cpu_time_us = wall_time_us / 4;
+  record.peak_rss_bytes = peak_rss_bytes;
+  record.exit_status = 0;
+  record.bytes_read = 0;
+  record.bytes_written = 0;
+  ASSERT_TRUE(b_database_record_execution(
+    database,
+    b_question_from_file_path_(path),
+    vtable,
+    &record,
+    &e));
+}
+
+// Records a build of app from three sources whose objects
+// take 300, 200, and 100 microseconds to compile.
+void
+b_record_build_(
+    struct B_Database *database,
+    std::string const &directory) {
+  static char const *const none[] = {NULL};
+  static char const *const a_o[] = {"a.c", NULL};
+  static char const *const b_o[] = {"b.c", NULL};
+  static char const *const c_o[] = {"c.c", NULL};
+  static char const *const app[]
+    = {"a.o", "b.o", "c.o", NULL};
+  b_record_file_(
+    database, directory, "a.c", 0, 0, none);
+  b_record_file_(
+    database, directory, "b.c", 0, 0, none);
+  b_record_file_(
+    database, directory, "c.c", 0, 0, none);
+  b_record_file_(
+    database, directory, "a.o", 300, 1000, a_o);
+  b_record_file_(
+    database, directory, "b.o", 200, 1000, b_o);
+  b_record_file_(
+    database, directory, "c.o", 100, 400, c_o);
+  b_record_file_(
+    database, directory, "app", 50, 100, app);
+}
+
+B_FUNC bool
+b_stop_run_loop_(
+    B_BORROW struct B_AnswerFuture *,
+    B_BORROW void const *callback_data,
+    B_OUT struct B_Error *e) {
+  struct B_RunLoop *run_loop
+    = *static_cast<struct B_RunLoop *const *>(
+      callback_data);
+  return b_run_loop_stop(run_loop, e);
+}
+
+// Replays the build recorded by b_record_build_ with the
+// given number of job slots and memory budget (or 0).
+struct B_SimulationReport
+b_simulate_(
+    std::string const &directory,
+    size_t job_slots,
+    int64_t memory_budget_bytes) {
+  struct B_Error e;
+  struct B_SimulationReport report = {0, 0, 0, 0, 0};
+  struct B_Database *history
+    = b_open_database_(directory + "/b.sqlite3");
+  EXPECT_TRUE(history);
+  struct B_Database *database
+    = b_open_database_(":memory:");
+  EXPECT_TRUE(database);
+  if (!history || !database) {
+    return report;
+  }
+  struct B_QuestionVTable const *vtables[] = {
+    b_file_question_vtable(),
+  };
+  struct B_Simulation *simulation;
+  EXPECT_TRUE(b_simulation_allocate(
+    history, database, vtables, 1, &simulation, &e));
+  struct B_RunLoop *run_loop
+    = b_simulation_run_loop(simulation);
+  struct B_ProcessQueue *queue;
+  EXPECT_TRUE(b_process_queue_allocate(
+    run_loop, job_slots, &queue, &e));
+  b_process_queue_set_memory_budget(
+    queue, memory_budget_bytes, 0);
+  struct B_Main *main;
+  EXPECT_TRUE(b_main_allocate(
+    database,
+    run_loop,
+    b_simulation_dispatch,
+    simulation,
+    &main,
+    &e));
+  b_main_set_process_queue(main, queue);
+
+  std::string path = directory + "/app";
+  struct B_IQuestion *question;
+  EXPECT_TRUE(b_file_question_allocate(
+    path.c_str(), &question, &e));
+  struct B_AnswerFuture *future;
+  EXPECT_TRUE(b_main_answer(
+    main, question, b_file_question_vtable(), &future, &e));
+  b_file_question_vtable()->deallocate(question);
+  EXPECT_TRUE(b_answer_future_add_callback(
+    future,
+    b_stop_run_loop_,
+    &run_loop,
+    sizeof(run_loop),
+    &e));
+  EXPECT_TRUE(b_run_loop_run(run_loop, &e));
+  enum B_AnswerFutureState state;
+  EXPECT_TRUE(b_answer_future_state(future, &state, &e));
+  EXPECT_EQ(B_FUTURE_RESOLVED, state);
+  b_answer_future_release(future);
+  b_run_loop_simulated_report(run_loop, job_slots, &report);
+
+  b_simulation_deallocate(simulation);
+  EXPECT_TRUE(b_process_queue_deallocate(queue, &e));
+  EXPECT_TRUE(b_main_deallocate(main, &e));
+  EXPECT_TRUE(b_database_close(database, &e));
+  EXPECT_TRUE(b_database_close(history, &e));
+  return report;
+}
+
+}
+
+TEST(TestSimulator, ReportsMakespanConcurrencyAndIdleCores) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  struct B_Database *history
+    = b_open_database_(temp_dir.path() + "/b.sqlite3");
+  ASSERT_TRUE(history);
+  b_record_build_(history, temp_dir.path());
+  struct B_Error e;
+  ASSERT_TRUE(b_database_close(history, &e));
+
+  // a.o and b.o are compiled first, since their recorded
+  // critical paths are longest.  c.o replaces b.o, and app
+  // is linked after a.o.
+  struct B_SimulationReport report
+    = b_simulate_(temp_dir.path(), 2, 0);
+  EXPECT_EQ(350, report.makespan_us);
+  EXPECT_EQ(4U, report.process_count);
+  EXPECT_EQ(2U, report.peak_running_count);
+  EXPECT_EQ(650, report.busy_us);
+  EXPECT_EQ(2 * 350 - 650, report.idle_core_us);
+
+  // Replaying the same history gives the same report.
+  struct B_SimulationReport again
+    = b_simulate_(temp_dir.path(), 2, 0);
+  EXPECT_EQ(report.makespan_us, again.makespan_us);
+  EXPECT_EQ(report.idle_core_us, again.idle_core_us);
+
+  report = b_simulate_(temp_dir.path(), 1, 0);
+  EXPECT_EQ(650, report.makespan_us);
+  EXPECT_EQ(1U, report.peak_running_count);
+  EXPECT_EQ(0, report.idle_core_us);
+}
+
+TEST(TestSimulator, RecordedMemoryUseLimitsConcurrency) {
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  struct B_Database *history
+    = b_open_database_(temp_dir.path() + "/b.sqlite3");
+  ASSERT_TRUE(history);
+  b_record_build_(history, temp_dir.path());
+  struct B_Error e;
+  ASSERT_TRUE(b_database_close(history, &e));
+
+  // a.o and b.o each peaked at 1000 bytes, so they cannot
+  // run together.  b.o and c.o can.
+  struct B_SimulationReport report
+    = b_simulate_(temp_dir.path(), 2, 1500);
+  EXPECT_EQ(550, report.makespan_us);
+  EXPECT_EQ(2U, report.peak_running_count);
+  EXPECT_EQ(650, report.busy_us);
+}
@@ -0,0 +1,183 @@
+#include "Util/TemporaryDirectory.h"
+
+#include <B/Error.h>
+#include <B/Process.h>
+#include <B/ProcessQueue.h>
+#include <B/RunLoop.h>
+#include <B/Tracer.h>
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string>
+
+namespace {
+
+std::string
+b_read_file_(
+    std::string const &path) {
+  std::string contents;
+  FILE *file = fopen(path.c_str(), "rb");
+  EXPECT_TRUE(file);
+  if (!file) {
+    return contents;
+  }
+  char buffer[4096];
+  size_t size;
+  while ((size = fread(buffer, 1, sizeof(buffer), file))
+      > 0) {
+    contents.append(buffer, size);
+  }
+  EXPECT_EQ(0, fclose(file));
+  return contents;
+}
+
+size_t
+b_count_(
+    std::string const &haystack,
+    std::string const &needle) {
+  size_t count = 0;
+  size_t i = 0;
+  while ((i = haystack.find(needle, i))
+      != std::string::npos) {
+    count += 1;
+    i += needle.size();
+  }
+  return count;
+}
+
+void *
+b_write_spans_(
+    void *opaque) {
+  struct B_Tracer *tracer
+    = static_cast<struct B_Tracer *>(opaque);
+  for (int i = 0; i < 100; ++i) {
+    int64_t start_us = b_tracer_now_us();
+    b_tracer_span(
+      tracer,
+      "test",
+      "span",
+      start_us,
+      b_tracer_now_us(),
+      NULL);
+  }
+  return NULL;
+}
+
+B_FUNC bool
+b_stop_callback_(
+    B_BORROW struct B_ProcessExitStatus const *,
+    B_BORROW void const *opaque,
+    B_OUT struct B_Error *e) {
+  struct B_RunLoop *run_loop
+    = *static_cast<struct B_RunLoop *const *>(opaque);
+  return b_run_loop_stop(run_loop, e);
+}
+
+B_FUNC bool
+b_cancel_callback_(
+    B_BORROW void const *,
+    B_OUT struct B_Error *) {
+  ADD_FAILURE();
+  return true;
+}
+
+}
+
+TEST(TestTracer, EventsFromSeveralThreadsFormAJSONArray) {
+  struct B_Error e;
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string path = temp_dir.path() + "/trace.json";
+
+  struct B_Tracer *tracer;
+  ASSERT_TRUE(b_tracer_open(path.c_str(), &tracer, &e));
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(
+    &thread, NULL, b_write_spans_, tracer));
+  b_write_spans_(tracer);
+  ASSERT_EQ(0, pthread_join(thread, NULL));
+  ASSERT_TRUE(b_tracer_close(tracer, &e));
+
+  std::string trace = b_read_file_(path);
+  EXPECT_EQ("[\n", trace.substr(0, 2));
+  EXPECT_EQ("\n]\n", trace.substr(trace.size() - 3));
+  EXPECT_EQ(200U, b_count_(trace, "\"ph\":\"X\""));
+  // Events are never interleaved.
+  EXPECT_EQ(200U, b_count_(trace, "},\n"));
+}
+
+TEST(TestTracer, StringArgumentsAreEscaped) {
+  struct B_Error e;
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string path = temp_dir.path() + "/trace.json";
+
+  struct B_Tracer *tracer;
+  ASSERT_TRUE(b_tracer_open(path.c_str(), &tracer, &e));
+  static char const string[] = "a\"b\\c\nd";
+  struct B_TraceArg arg;
+  arg.name = "question";
+  arg.string = reinterpret_cast<uint8_t const *>(string);
+  arg.string_size = sizeof(string) - 1;
+  arg.integer = 0;
+  b_tracer_begin_async(
+    tracer, "question", "question", 7, 10, &arg);
+  b_tracer_end_async(tracer, "question", "question", 7, 20);
+  ASSERT_TRUE(b_tracer_close(tracer, &e));
+
+  std::string trace = b_read_file_(path);
+  EXPECT_NE(
+    std::string::npos,
+    trace.find(
+      "\"args\":{\"question\":\"a\\\"b\\\\c\\u000ad\"}"));
+  EXPECT_EQ(1U, b_count_(trace, "\"ph\":\"b\""));
+  EXPECT_EQ(1U, b_count_(trace, "\"ph\":\"e\""));
+  EXPECT_EQ(2U, b_count_(trace, "\"id\":7"));
+}
+
+TEST(TestTracer, ProcessQueueRecordsProcessIDs) {
+  struct B_Error e;
+  B_TemporaryDirectory temp_dir
+    = B_TemporaryDirectory::create();
+  std::string path = temp_dir.path() + "/trace.json";
+
+  struct B_Tracer *tracer;
+  ASSERT_TRUE(b_tracer_open(path.c_str(), &tracer, &e));
+  struct B_RunLoop *run_loop;
+  ASSERT_TRUE(b_run_loop_allocate_preferred(&run_loop, &e));
+  b_run_loop_set_tracer(run_loop, tracer);
+  struct B_ProcessQueue *queue;
+  ASSERT_TRUE(b_process_queue_allocate(
+    run_loop, 1, &queue, &e));
+  b_process_queue_set_tracer(queue, tracer);
+  // Long enough for the run loop to record idle time.
+  char const *args[] = {"sleep", "0.01", NULL};
+  ASSERT_TRUE(b_process_queue_exec_basic(
+    queue,
+    NULL,
+    args,
+    b_stop_callback_,
+    b_cancel_callback_,
+    &run_loop,
+    sizeof(run_loop),
+    &e));
+  ASSERT_TRUE(b_run_loop_run(run_loop, &e));
+  EXPECT_TRUE(b_process_queue_deallocate(queue, &e));
+  b_run_loop_deallocate(run_loop);
+  ASSERT_TRUE(b_tracer_close(tracer, &e));
+
+  std::string trace = b_read_file_(path);
+  EXPECT_EQ(
+    1U,
+    b_count_(
+      trace,
+      "\"ph\":\"b\",\"cat\":\"process\",\"name\":\"sleep\""));
+  EXPECT_EQ(
+    1U,
+    b_count_(
+      trace,
+      "\"ph\":\"e\",\"cat\":\"process\",\"name\":\"sleep\""));
+  EXPECT_EQ(1U, b_count_(trace, "\"args\":{\"pid\":"));
+  EXPECT_LE(1U, b_count_(trace, "\"name\":\"idle\""));
+}
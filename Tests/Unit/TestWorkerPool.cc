@@ -0,0 +1,232 @@
+#include <B/Error.h>
+#include <B/RunLoop.h>
+#include <B/WorkerPool.h>
+
+#include <errno.h>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+// Lets worker functions wait for each other.
+struct B_Rendezvous_ {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int arrived;
+  int callbacks;
+  pthread_t run_loop_thread;
+  struct B_RunLoop *run_loop;
+};
+
+struct B_RendezvousWork_ {
+  B_Rendezvous_ *rendezvous;
+  int input;
+  int output;
+  bool met_other_worker;
+};
+
+B_FUNC bool
+b_meet_other_worker_(
+    B_BORROW void *work_data,
+    B_OUT struct B_Error *) {
+  B_RendezvousWork_ *work
+    = static_cast<B_RendezvousWork_ *>(work_data);
+  B_Rendezvous_ *rendezvous = work->rendezvous;
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  struct timespec deadline;
+  deadline.tv_sec = now.tv_sec + 10;
+  deadline.tv_nsec = now.tv_usec * 1000;
+  pthread_mutex_lock(&rendezvous->mutex);
+  rendezvous->arrived += 1;
+  pthread_cond_broadcast(&rendezvous->cond);
+  while (rendezvous->arrived < 2) {
+    if (pthread_cond_timedwait(
+        &rendezvous->cond,
+        &rendezvous->mutex,
+        &deadline) == ETIMEDOUT) {
+      break;
+    }
+  }
+  work->met_other_worker = rendezvous->arrived >= 2;
+  pthread_mutex_unlock(&rendezvous->mutex);
+  work->output = work->input * work->input;
+  return true;
+}
+
+B_FUNC bool
+b_check_rendezvous_work_(
+    B_BORROW void *work_data,
+    struct B_Error work_error,
+    B_OUT struct B_Error *e) {
+  B_RendezvousWork_ *work
+    = static_cast<B_RendezvousWork_ *>(work_data);
+  B_Rendezvous_ *rendezvous = work->rendezvous;
+  EXPECT_EQ(0, work_error.posix_error);
+  EXPECT_TRUE(pthread_equal(
+    rendezvous->run_loop_thread, pthread_self()));
+  EXPECT_TRUE(work->met_other_worker);
+  EXPECT_EQ(work->input * work->input, work->output);
+  rendezvous->callbacks += 1;
+  if (rendezvous->callbacks == 2) {
+    return b_run_loop_stop(rendezvous->run_loop, e);
+  }
+  return true;
+}
+
+B_FUNC bool
+b_fail_cancel_(
+    B_BORROW void const *,
+    B_OUT struct B_Error *) {
+  ADD_FAILURE();
+  return true;
+}
+
+B_FUNC bool
+b_fail_with_einval_(
+    B_BORROW void *,
+    B_OUT struct B_Error *e) {
+  e->posix_error = EINVAL;
+  return false;
+}
+
+B_FUNC bool
+b_check_einval_then_stop_(
+    B_BORROW void *work_data,
+    struct B_Error work_error,
+    B_OUT struct B_Error *e) {
+  EXPECT_EQ(EINVAL, work_error.posix_error);
+  return b_run_loop_stop(
+    *static_cast<struct B_RunLoop **>(work_data), e);
+}
+
+struct B_OrderWork_ {
+  int volatile *started;
+  int index;
+};
+
+B_FUNC bool
+b_sleep_then_record_start_(
+    B_BORROW void *work_data,
+    B_OUT struct B_Error *) {
+  B_OrderWork_ *work
+    = static_cast<B_OrderWork_ *>(work_data);
+  work->started[work->index] = 1;
+  // Give deallocate time to stop the pool.
+  usleep(200 * 1000);
+  return true;
+}
+
+B_FUNC bool
+b_ignore_callback_(
+    B_BORROW void *,
+    struct B_Error,
+    B_OUT struct B_Error *) {
+  return true;
+}
+
+B_FUNC bool
+b_count_cancel_(
+    B_BORROW void const *work_data,
+    B_OUT struct B_Error *) {
+  B_OrderWork_ const *work
+    = static_cast<B_OrderWork_ const *>(work_data);
+  work->started[work->index] = -1;
+  return true;
+}
+
+}
+
+TEST(TestWorkerPool, FunctionsRunConcurrently) {
+  struct B_Error e;
+  B_Rendezvous_ rendezvous;
+  ASSERT_EQ(
+    0, pthread_mutex_init(&rendezvous.mutex, NULL));
+  ASSERT_EQ(
+    0, pthread_cond_init(&rendezvous.cond, NULL));
+  rendezvous.arrived = 0;
+  rendezvous.callbacks = 0;
+  rendezvous.run_loop_thread = pthread_self();
+  ASSERT_TRUE(b_run_loop_allocate_preferred(
+    &rendezvous.run_loop, &e));
+  struct B_WorkerPool *pool;
+  ASSERT_TRUE(b_worker_pool_allocate(
+    rendezvous.run_loop, 2, &pool, &e));
+
+  for (int i = 0; i < 2; ++i) {
+    B_RendezvousWork_ work;
+    work.rendezvous = &rendezvous;
+    work.input = i + 2;
+    work.output = 0;
+    work.met_other_worker = false;
+    ASSERT_TRUE(b_worker_pool_submit(
+      pool,
+      b_meet_other_worker_,
+      b_check_rendezvous_work_,
+      b_fail_cancel_,
+      &work,
+      sizeof(work),
+      &e));
+  }
+  ASSERT_TRUE(b_run_loop_run(rendezvous.run_loop, &e));
+  EXPECT_EQ(2, rendezvous.callbacks);
+
+  EXPECT_TRUE(b_worker_pool_deallocate(pool, &e));
+  b_run_loop_deallocate(rendezvous.run_loop);
+  pthread_cond_destroy(&rendezvous.cond);
+  pthread_mutex_destroy(&rendezvous.mutex);
+}
+
+TEST(TestWorkerPool, FunctionErrorIsGivenToCallback) {
+  struct B_Error e;
+  struct B_RunLoop *run_loop;
+  ASSERT_TRUE(b_run_loop_allocate_preferred(&run_loop, &e));
+  struct B_WorkerPool *pool;
+  ASSERT_TRUE(b_worker_pool_allocate(
+    run_loop, 1, &pool, &e));
+  ASSERT_TRUE(b_worker_pool_submit(
+    pool,
+    b_fail_with_einval_,
+    b_check_einval_then_stop_,
+    b_fail_cancel_,
+    &run_loop,
+    sizeof(run_loop),
+    &e));
+  ASSERT_TRUE(b_run_loop_run(run_loop, &e));
+  EXPECT_TRUE(b_worker_pool_deallocate(pool, &e));
+  b_run_loop_deallocate(run_loop);
+}
+
+TEST(TestWorkerPool, DeallocateCancelsQueuedFunctions) {
+  struct B_Error e;
+  struct B_RunLoop *run_loop;
+  ASSERT_TRUE(b_run_loop_allocate_preferred(&run_loop, &e));
+  struct B_WorkerPool *pool;
+  ASSERT_TRUE(b_worker_pool_allocate(
+    run_loop, 1, &pool, &e));
+  int volatile started[2] = {0, 0};
+  for (int i = 0; i < 2; ++i) {
+    B_OrderWork_ work;
+    work.started = started;
+    work.index = i;
+    ASSERT_TRUE(b_worker_pool_submit(
+      pool,
+      b_sleep_then_record_start_,
+      b_ignore_callback_,
+      b_count_cancel_,
+      &work,
+      sizeof(work),
+      &e));
+  }
+  // Wait for the first function to start.
+  for (int i = 0; i < 1000 && !started[0]; ++i) {
+    usleep(1000);
+  }
+  EXPECT_TRUE(b_worker_pool_deallocate(pool, &e));
+  EXPECT_EQ(1, started[0]);
+  EXPECT_EQ(-1, started[1]);
+  b_run_loop_deallocate(run_loop);
+}